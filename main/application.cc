@@ -3,6 +3,7 @@
 #include "audio_codec.h"
 #include "board.h"
 #include "display.h"
+#include "event_journal.h"
 #include "mqtt_protocol.h"
 #include "system_info.h"
 #include "touch_handler.h"
@@ -33,11 +34,6 @@ constexpr int64_t kTouchStartAckTimeoutUs = 700'000; // 700ms
 
 #define TAG "Application"
 
-static const char *const STATE_STRINGS[] = {
-    "unknown",    "starting",      "configuring", "idle",
-    "connecting", "listening",     "speaking",    "upgrading",
-    "activating", "audio_testing", "fatal_error", "invalid_state"};
-
 // 声明外部 Otto 动作函数
 extern void OttoSwing(int steps, int speed, int amount);
 extern void OttoJump(int steps, int speed);
@@ -55,25 +51,10 @@ Application::Application() {
 #else
   aec_mode_ = kAecOff;
 #endif
-
-  esp_timer_create_args_t clock_timer_args = {
-      .callback =
-          [](void *arg) {
-            Application *app = (Application *)arg;
-            xEventGroupSetBits(app->event_group_, MAIN_EVENT_CLOCK_TICK);
-          },
-      .arg = this,
-      .dispatch_method = ESP_TIMER_TASK,
-      .name = "clock_timer",
-      .skip_unhandled_events = true};
-  esp_timer_create(&clock_timer_args, &clock_timer_handle_);
 }
 
 Application::~Application() {
-  if (clock_timer_handle_ != nullptr) {
-    esp_timer_stop(clock_timer_handle_);
-    esp_timer_delete(clock_timer_handle_);
-  }
+  clock_timer_.Cancel();
   vEventGroupDelete(event_group_);
 }
 
@@ -161,7 +142,7 @@ void Application::CheckNewVersion(Ota &ota) {
                retry_delay, retry_count, MAX_RETRY);
       for (int i = 0; i < retry_delay; i++) {
         vTaskDelay(pdMS_TO_TICKS(1000));
-        if (device_state_ == kDeviceStateIdle) {
+        if (state_machine_.state() == kDeviceStateIdle) {
           break;
         }
       }
@@ -205,7 +186,7 @@ void Application::CheckNewVersion(Ota &ota) {
       } else {
         vTaskDelay(pdMS_TO_TICKS(10000));
       }
-      if (device_state_ == kDeviceStateIdle) {
+      if (state_machine_.state() == kDeviceStateIdle) {
         break;
       }
     }
@@ -257,7 +238,7 @@ void Application::Alert(const char *status, const char *message,
 }
 
 void Application::DismissAlert() {
-  if (device_state_ == kDeviceStateIdle) {
+  if (state_machine_.state() == kDeviceStateIdle) {
     auto display = Board::GetInstance().GetDisplay();
     display->SetStatus(Lang::Strings::STANDBY);
     display->SetEmotion("neutral");
@@ -266,14 +247,14 @@ void Application::DismissAlert() {
 }
 
 void Application::ToggleChatState() {
-  if (device_state_ == kDeviceStateActivating) {
+  if (state_machine_.state() == kDeviceStateActivating) {
     SetDeviceState(kDeviceStateIdle);
     return;
-  } else if (device_state_ == kDeviceStateWifiConfiguring) {
+  } else if (state_machine_.state() == kDeviceStateWifiConfiguring) {
     audio_service_.EnableAudioTesting(true);
     SetDeviceState(kDeviceStateAudioTesting);
     return;
-  } else if (device_state_ == kDeviceStateAudioTesting) {
+  } else if (state_machine_.state() == kDeviceStateAudioTesting) {
     audio_service_.EnableAudioTesting(false);
     SetDeviceState(kDeviceStateWifiConfiguring);
     return;
@@ -284,8 +265,9 @@ void Application::ToggleChatState() {
     return;
   }
 
-  if (device_state_ == kDeviceStateIdle) {
-    Schedule([this]() {
+  if (state_machine_.state() == kDeviceStateIdle) {
+    Schedule(kTaskPriorityHigh, [this]() {
+      JoinPrewarmOpen();
       if (!protocol_->IsAudioChannelOpened()) {
         SetDeviceState(kDeviceStateConnecting);
         if (!protocol_->OpenAudioChannel()) {
@@ -296,18 +278,18 @@ void Application::ToggleChatState() {
       SetListeningMode(aec_mode_ == kAecOff ? kListeningModeAutoStop
                                             : kListeningModeRealtime);
     });
-  } else if (device_state_ == kDeviceStateSpeaking) {
-    Schedule([this]() { AbortSpeaking(kAbortReasonNone); });
-  } else if (device_state_ == kDeviceStateListening) {
-    Schedule([this]() { protocol_->CloseAudioChannel(); });
+  } else if (state_machine_.state() == kDeviceStateSpeaking) {
+    Schedule(kTaskPriorityHigh, [this]() { AbortSpeaking(kAbortReasonNone); });
+  } else if (state_machine_.state() == kDeviceStateListening) {
+    Schedule(kTaskPriorityHigh, [this]() { protocol_->CloseAudioChannel(); });
   }
 }
 
 void Application::StartListening() {
-  if (device_state_ == kDeviceStateActivating) {
+  if (state_machine_.state() == kDeviceStateActivating) {
     SetDeviceState(kDeviceStateIdle);
     return;
-  } else if (device_state_ == kDeviceStateWifiConfiguring) {
+  } else if (state_machine_.state() == kDeviceStateWifiConfiguring) {
     audio_service_.EnableAudioTesting(true);
     SetDeviceState(kDeviceStateAudioTesting);
     return;
@@ -318,8 +300,9 @@ void Application::StartListening() {
     return;
   }
 
-  if (device_state_ == kDeviceStateIdle) {
-    Schedule([this]() {
+  if (state_machine_.state() == kDeviceStateIdle) {
+    Schedule(kTaskPriorityHigh, [this]() {
+      JoinPrewarmOpen();
       if (!protocol_->IsAudioChannelOpened()) {
         SetDeviceState(kDeviceStateConnecting);
         if (!protocol_->OpenAudioChannel()) {
@@ -329,8 +312,8 @@ void Application::StartListening() {
 
       SetListeningMode(kListeningModeManualStop);
     });
-  } else if (device_state_ == kDeviceStateSpeaking) {
-    Schedule([this]() {
+  } else if (state_machine_.state() == kDeviceStateSpeaking) {
+    Schedule(kTaskPriorityHigh, [this]() {
       AbortSpeaking(kAbortReasonNone);
       SetListeningMode(kListeningModeManualStop);
     });
@@ -338,7 +321,7 @@ void Application::StartListening() {
 }
 
 void Application::StopListening() {
-  if (device_state_ == kDeviceStateAudioTesting) {
+  if (state_machine_.state() == kDeviceStateAudioTesting) {
     audio_service_.EnableAudioTesting(false);
     SetDeviceState(kDeviceStateWifiConfiguring);
     return;
@@ -350,13 +333,13 @@ void Application::StopListening() {
       kDeviceStateIdle,
   };
   // If not valid, do nothing
-  if (std::find(valid_states.begin(), valid_states.end(), device_state_) ==
+  if (std::find(valid_states.begin(), valid_states.end(), state_machine_.state()) ==
       valid_states.end()) {
     return;
   }
 
-  Schedule([this]() {
-    if (device_state_ == kDeviceStateListening) {
+  Schedule(kTaskPriorityHigh, [this]() {
+    if (state_machine_.state() == kDeviceStateListening) {
       protocol_->SendStopListening();
       SetDeviceState(kDeviceStateIdle);
     }
@@ -365,6 +348,8 @@ void Application::StopListening() {
 
 void Application::Start() {
   auto &board = Board::GetInstance();
+  // Before the first state change so the boot record comes first
+  EventJournal::GetInstance().Initialize();
   SetDeviceState(kDeviceStateStarting);
 
   /* Setup the display */
@@ -383,11 +368,19 @@ void Application::Start() {
     xEventGroupSetBits(event_group_, MAIN_EVENT_SEND_AUDIO);
   };
   callbacks.on_wake_word_detected = [this](const std::string &wake_word) {
+    wake_detected_time_us_ = esp_timer_get_time();
     xEventGroupSetBits(event_group_, MAIN_EVENT_WAKE_WORD_DETECTED);
   };
   callbacks.on_vad_change = [this](bool speaking) {
     xEventGroupSetBits(event_group_, MAIN_EVENT_VAD_CHANGE);
   };
+  callbacks.on_playback_drained = [this]() {
+    Schedule(kTaskPriorityHigh, [this]() {
+      if (tts_stop_pending_) {
+        FinishSpeaking();
+      }
+    });
+  };
   audio_service_.SetCallbacks(callbacks);
 
   // 🧠 初始化事件总线和学习系统（NVS存储）
@@ -397,6 +390,15 @@ void Application::Start() {
   auto &event_bus = xiaozhi::EventBus::GetInstance();
   if (event_bus.Initialize() == ESP_OK) {
     ESP_LOGI(TAG, "  ✅ 事件总线初始化成功");
+    // 高频信号：只关心最新值，突发时合并，避免占满事件队列
+    event_bus.SetDeliveryPolicy<xiaozhi::PetStateChangedEvent>(
+        {.latest_wins = true, .min_interval_ms = 1000});
+    event_bus.SetDeliveryPolicy<xiaozhi::EmotionSetEvent>(
+        {.latest_wins = true, .min_interval_ms = 200});
+    event_bus.SetDeliveryPolicy<xiaozhi::LinkStatsEvent>(
+        {.latest_wins = true});
+    event_bus.SetDeliveryPolicy<xiaozhi::ProfileUpdatedEvent>(
+        {.latest_wins = true});
   } else {
     ESP_LOGE(TAG, "  ❌ 事件总线初始化失败");
   }
@@ -441,14 +443,13 @@ void Application::Start() {
   }
 
   // 📡 注册事件监听器（展示事件总线功能）
-  event_bus.Subscribe(xiaozhi::LOGIC_EVENT, xiaozhi::LOGIC_CONVERSATION_END,
-                      [&user_profile](void *event_data) {
-                        ESP_LOGI(TAG, "🎧 Event received: CONVERSATION_END");
-                        ESP_LOGI(TAG,
-                                 "  📊 User stats: 7d互动=%u次, 最爱话题=%s",
-                                 user_profile.GetInteractionCount7d(),
-                                 user_profile.GetFavoriteTopic());
-                      });
+  conversation_end_subscription_ =
+      event_bus.Subscribe<xiaozhi::ConversationEndEvent>([&user_profile]() {
+        ESP_LOGI(TAG, "🎧 Event received: CONVERSATION_END");
+        ESP_LOGI(TAG, "  📊 User stats: 7d互动=%u次, 最爱话题=%s",
+                 user_profile.GetInteractionCount7d(),
+                 user_profile.GetFavoriteTopic());
+      });
   ESP_LOGI(TAG, "  ✅ 注册事件监听器: CONVERSATION_END");
 
   ESP_LOGI(TAG, "━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━");
@@ -487,8 +488,11 @@ void Application::Start() {
       },
       "main_event_loop", 2048 * 4, this, 3, &main_event_loop_task_handle_);
 
-  /* Start the clock timer to update the status bar */
-  esp_timer_start_periodic(clock_timer_handle_, 1000000);
+  /* Start the clock timer to update the status bar, it may run 100ms late
+   * to share a wakeup with other timers */
+  clock_timer_ = TimerService::GetInstance().StartPeriodic(
+      "clock", 1000, 100,
+      [this]() { xEventGroupSetBits(event_group_, MAIN_EVENT_CLOCK_TICK); });
 
   /* Wait for the network to be ready */
   board.StartNetwork();
@@ -528,11 +532,18 @@ void Application::Start() {
   protocol_->OnConnected([this]() { DismissAlert(); });
 
   protocol_->OnNetworkError([this](const std::string &message) {
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+    // A failed speculative open is not the user's concern
+    if (prewarm_opening_) {
+      ESP_LOGW(TAG, "Pre-warm failed: %s", message.c_str());
+      return;
+    }
+#endif
     last_error_message_ = message;
     xEventGroupSetBits(event_group_, MAIN_EVENT_ERROR);
   });
   protocol_->OnIncomingAudio([this](std::unique_ptr<AudioStreamPacket> packet) {
-    if (device_state_ == kDeviceStateSpeaking) {
+    if (state_machine_.state() == kDeviceStateSpeaking) {
       audio_service_.PushPacketToDecodeQueue(std::move(packet));
     }
   });
@@ -547,149 +558,33 @@ void Application::Start() {
   });
   protocol_->OnAudioChannelClosed([this, &board]() {
     board.SetPowerSaveMode(true);
-    Schedule([this]() {
+    Schedule(kTaskPriorityHigh, [this]() {
       auto display = Board::GetInstance().GetDisplay();
       display->SetChatMessage("system", "");
       SetDeviceState(kDeviceStateIdle);
+      message_dispatcher_.LogStats();
+      PublishLinkStats(true);
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+      channel_prewarm_.OnReleased();
+#endif
 
       if (touch_message_pending_) {
         ESP_LOGW(
             TAG,
             "Touch: audio channel closed before message completed (error)");
         touch_message_pending_ = false;
-        touch_waiting_start_ack_ = false;
         touch_start_request_time_us_ = 0;
       }
       touch_channel_opened_for_touch_ = false;
     });
   });
-  protocol_->OnIncomingJson([this, display](const cJSON *root) {
-    // Parse JSON data
-    auto type = cJSON_GetObjectItem(root, "type");
-    if (strcmp(type->valuestring, "listen") == 0) {
-      // Touch events no longer use listen ack mechanism
-      // AI responds directly to MCP notifications
-    } else if (strcmp(type->valuestring, "tts") == 0) {
-      auto state = cJSON_GetObjectItem(root, "state");
-      if (strcmp(state->valuestring, "start") == 0) {
-        Schedule([this]() {
-          aborted_ = false;
-          if (device_state_ == kDeviceStateIdle ||
-              device_state_ == kDeviceStateListening) {
-            SetDeviceState(kDeviceStateSpeaking);
-          }
-        });
-      } else if (strcmp(state->valuestring, "stop") == 0) {
-        Schedule([this]() {
-          if (device_state_ == kDeviceStateSpeaking) {
-            // 🛡️ 等待音频播放完成后再切换状态
-            ESP_LOGI(TAG, "收到 stop 消息，等待音频播放完成...");
-
-            // 等待所有音频队列清空（最多等待10秒）
-            int wait_count = 0;
-            while (!audio_service_.IsIdle() && wait_count < 100) {
-              vTaskDelay(pdMS_TO_TICKS(100)); // 每100ms检查一次
-              wait_count++;
-            }
-
-            if (wait_count >= 100) {
-              ESP_LOGW(TAG, "等待音频播放超时（10秒），强制切换状态");
-            } else {
-              ESP_LOGI(TAG, "音频播放完成，用时 %d ms", wait_count * 100);
-            }
-
-            // 🧠 记录对话（用于用户画像）
-            auto &profile = xiaozhi::UserProfile::GetInstance();
-            profile.RecordInteraction("chat", 5000); // 假设5秒对话
-            profile.CheckAutoSave();
-
-            // 📡 发布对话结束事件（事件总线）
-            auto &event_bus = xiaozhi::EventBus::GetInstance();
-            event_bus.Publish(xiaozhi::LOGIC_EVENT,
-                              xiaozhi::LOGIC_CONVERSATION_END, nullptr);
-            ESP_LOGI(TAG, "📡 Event published: CONVERSATION_END");
-
-            // Ensure microphone is unmuted for the next turn
-            audio_service_.SetInputMute(false);
-
-            if (listening_mode_ == kListeningModeManualStop) {
-              SetDeviceState(kDeviceStateIdle);
-            } else {
-              SetDeviceState(kDeviceStateListening);
-            }
-          }
-        });
-      } else if (strcmp(state->valuestring, "sentence_start") == 0) {
-        auto text = cJSON_GetObjectItem(root, "text");
-        if (cJSON_IsString(text)) {
-          ESP_LOGI(TAG, "<< %s", text->valuestring);
-          Schedule([this, display, message = std::string(text->valuestring)]() {
-            display->SetChatMessage("assistant", message.c_str());
-          });
-        }
-      }
-    } else if (strcmp(type->valuestring, "stt") == 0) {
-      auto text = cJSON_GetObjectItem(root, "text");
-      if (cJSON_IsString(text)) {
-        ESP_LOGI(TAG, ">> %s", text->valuestring);
-        Schedule([this, display, message = std::string(text->valuestring)]() {
-          display->SetChatMessage("user", message.c_str());
-          // 🐾 记录聊天，用于电子宠物任务统计
-          PetSystem::GetInstance().RecordChat();
-        });
-      }
-    } else if (strcmp(type->valuestring, "llm") == 0) {
-      auto emotion = cJSON_GetObjectItem(root, "emotion");
-      if (cJSON_IsString(emotion)) {
-        Schedule(
-            [this, display, emotion_str = std::string(emotion->valuestring)]() {
-              display->SetEmotion(emotion_str.c_str());
-            });
-      }
-    } else if (strcmp(type->valuestring, "mcp") == 0) {
-      auto payload = cJSON_GetObjectItem(root, "payload");
-      if (cJSON_IsObject(payload)) {
-        McpServer::GetInstance().ParseMessage(payload);
-      }
-    } else if (strcmp(type->valuestring, "system") == 0) {
-      auto command = cJSON_GetObjectItem(root, "command");
-      if (cJSON_IsString(command)) {
-        ESP_LOGI(TAG, "System command: %s", command->valuestring);
-        if (strcmp(command->valuestring, "reboot") == 0) {
-          // Do a reboot if user requests a OTA update
-          Schedule([this]() { Reboot(); });
-        } else {
-          ESP_LOGW(TAG, "Unknown system command: %s", command->valuestring);
-        }
-      }
-    } else if (strcmp(type->valuestring, "alert") == 0) {
-      auto status = cJSON_GetObjectItem(root, "status");
-      auto message = cJSON_GetObjectItem(root, "message");
-      auto emotion = cJSON_GetObjectItem(root, "emotion");
-      if (cJSON_IsString(status) && cJSON_IsString(message) &&
-          cJSON_IsString(emotion)) {
-        Alert(status->valuestring, message->valuestring, emotion->valuestring,
-              Lang::Sounds::OGG_VIBRATION);
-      } else {
-        ESP_LOGW(TAG, "Alert command requires status, message and emotion");
-      }
-#if CONFIG_RECEIVE_CUSTOM_MESSAGE
-    } else if (strcmp(type->valuestring, "custom") == 0) {
-      auto payload = cJSON_GetObjectItem(root, "payload");
-      ESP_LOGI(TAG, "Received custom message: %s",
-               cJSON_PrintUnformatted(root));
-      if (cJSON_IsObject(payload)) {
-        Schedule(
-            [this, display,
-             payload_str = std::string(cJSON_PrintUnformatted(payload))]() {
-              display->SetChatMessage("system", payload_str.c_str());
-            });
-      } else {
-        ESP_LOGW(TAG, "Invalid custom message format: missing payload");
-      }
-#endif
-    } else {
-      ESP_LOGW(TAG, "Unknown message type: %s", type->valuestring);
+  RegisterMessageHandlers();
+  mcp_server.RegisterMessageHandlers(message_dispatcher_);
+  protocol_->OnIncomingMessage([this](const IncomingMessage &message) {
+    if (!message_dispatcher_.Dispatch(message)) {
+      auto type = message.type();
+      ESP_LOGW(TAG, "Unknown message type: %.*s", (int)type.size(),
+               type.data());
     }
   });
   bool protocol_started = protocol_->Start();
@@ -708,13 +603,131 @@ void Application::Start() {
   }
 }
 
-// Add a async task to MainLoop
-void Application::Schedule(std::function<void()> callback) {
-  {
-    std::lock_guard<std::mutex> lock(mutex_);
-    main_tasks_.push_back(std::move(callback));
-  }
-  xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
+void Application::RegisterMessageHandlers() {
+  auto display = Board::GetInstance().GetDisplay();
+
+  message_dispatcher_.Register("listen", [](const IncomingMessage &message) {
+    // Touch events no longer use listen ack mechanism
+    // AI responds directly to MCP notifications
+  });
+
+  // tts / stt / llm arrive many times per turn, they only read flat string
+  // fields and never build a cJSON tree
+  message_dispatcher_.Register("tts", [this, display](
+                                          const IncomingMessage &message) {
+    if (message.Equals("state", "start")) {
+      Schedule(kTaskPriorityHigh, [this]() {
+        if (state_machine_.state() == kDeviceStateIdle ||
+            state_machine_.state() == kDeviceStateListening) {
+          SetDeviceState(kDeviceStateSpeaking);
+        }
+      });
+    } else if (message.Equals("state", "stop")) {
+      Schedule(kTaskPriorityHigh, [this]() {
+        if (state_machine_.state() != kDeviceStateSpeaking) {
+          return;
+        }
+        // 🛡️ 音频播放完成后再切换状态，由 on_playback_drained 回调驱动
+        tts_stop_pending_ = true;
+        tts_stop_time_us_ = esp_timer_get_time();
+        if (audio_service_.ArmPlaybackDrained()) {
+          FinishSpeaking();
+        } else {
+          ESP_LOGI(TAG, "收到 stop 消息，等待音频播放完成...");
+          // 最多等待10秒，超时强制切换状态
+          tts_stop_timer_ = TimerService::GetInstance().StartOnce(
+              "tts_stop", 10 * 1000, 100, [this]() {
+                Schedule(kTaskPriorityHigh, [this]() {
+                  if (tts_stop_pending_) {
+                    ESP_LOGW(TAG, "等待音频播放超时（10秒），强制切换状态");
+                    FinishSpeaking();
+                  }
+                });
+              });
+        }
+      });
+    } else if (message.Equals("state", "sentence_start")) {
+      std::string text;
+      if (message.GetString("text", text)) {
+        ESP_LOGI(TAG, "<< %s", text.c_str());
+        Schedule([this, display, message = std::move(text)]() {
+          display->SetChatMessage("assistant", message.c_str());
+        });
+      }
+    }
+  });
+
+  message_dispatcher_.Register("stt", [this, display](
+                                          const IncomingMessage &message) {
+    std::string text;
+    if (message.GetString("text", text)) {
+      ESP_LOGI(TAG, ">> %s", text.c_str());
+      Schedule([this, display, message = std::move(text)]() {
+        display->SetChatMessage("user", message.c_str());
+        // 🐾 记录聊天，用于电子宠物任务统计
+        PetSystem::GetInstance().RecordChat();
+      });
+    }
+  });
+
+  message_dispatcher_.Register("llm", [this, display](
+                                          const IncomingMessage &message) {
+    std::string emotion;
+    if (message.GetString("emotion", emotion)) {
+      xiaozhi::EmoEventData event_data = {};
+      strncpy(event_data.emotion, emotion.c_str(),
+              sizeof(event_data.emotion) - 1);
+      xiaozhi::EventBus::GetInstance()
+          .PublishNonBlocking<xiaozhi::EmotionSetEvent>(event_data);
+      Schedule([this, display, emotion_str = std::move(emotion)]() {
+        display->SetEmotion(emotion_str.c_str());
+      });
+    }
+  });
+
+  message_dispatcher_.Register("system", [this](
+                                             const IncomingMessage &message) {
+    std::string command;
+    if (message.GetString("command", command)) {
+      ESP_LOGI(TAG, "System command: %s", command.c_str());
+      if (command == "reboot") {
+        // Do a reboot if user requests a OTA update
+        Schedule([this]() { Reboot(); });
+      } else {
+        ESP_LOGW(TAG, "Unknown system command: %s", command.c_str());
+      }
+    }
+  });
+
+  message_dispatcher_.Register("alert", [this](const IncomingMessage &message) {
+    std::string status, text, emotion;
+    if (message.GetString("status", status) &&
+        message.GetString("message", text) &&
+        message.GetString("emotion", emotion)) {
+      Alert(status.c_str(), text.c_str(), emotion.c_str(),
+            Lang::Sounds::OGG_VIBRATION);
+    } else {
+      ESP_LOGW(TAG, "Alert command requires status, message and emotion");
+    }
+  });
+
+#if CONFIG_RECEIVE_CUSTOM_MESSAGE
+  message_dispatcher_.Register("custom", [this, display](
+                                             const IncomingMessage &message) {
+    ESP_LOGI(TAG, "Received custom message: %.*s", (int)message.size(),
+             message.data());
+    auto payload = cJSON_GetObjectItem(message.root(), "payload");
+    if (cJSON_IsObject(payload)) {
+      auto payload_json = cJSON_PrintUnformatted(payload);
+      Schedule([this, display, payload_str = std::string(payload_json)]() {
+        display->SetChatMessage("system", payload_str.c_str());
+      });
+      cJSON_free(payload_json);
+    } else {
+      ESP_LOGW(TAG, "Invalid custom message format: missing payload");
+    }
+  });
+#endif
 }
 
 // The Main Event Loop controls the chat state and websocket connection
@@ -728,55 +741,90 @@ void Application::MainEventLoop() {
             MAIN_EVENT_WAKE_WORD_DETECTED | MAIN_EVENT_VAD_CHANGE |
             MAIN_EVENT_CLOCK_TICK | MAIN_EVENT_ERROR,
         pdTRUE, pdFALSE, portMAX_DELAY);
+    loop_profiler_.BeginIteration();
 
     if (bits & MAIN_EVENT_ERROR) {
+      LoopProfiler::Section section(loop_profiler_, "error");
       SetDeviceState(kDeviceStateIdle);
       Alert(Lang::Strings::ERROR, last_error_message_.c_str(), "circle_xmark",
             Lang::Sounds::OGG_EXCLAMATION);
     }
 
     if (bits & MAIN_EVENT_SEND_AUDIO) {
-      while (auto packet = audio_service_.PopPacketFromSendQueue()) {
-        if (protocol_ && !protocol_->SendAudio(std::move(packet))) {
+      LoopProfiler::Section section(loop_profiler_, "send_audio");
+      // 协议可以把发送队列中积压的多帧打包成一条消息发送
+      std::vector<std::unique_ptr<AudioStreamPacket>> packets;
+      while (true) {
+        size_t batch_size =
+            protocol_ ? protocol_->GetAudioBatchSize(
+                            audio_service_.GetSendQueueSize())
+                      : 1;
+        while (packets.size() < batch_size) {
+          auto packet = audio_service_.PopPacketFromSendQueue();
+          if (!packet) {
+            break;
+          }
+          packets.push_back(std::move(packet));
+        }
+        if (packets.empty()) {
           break;
         }
+        if (protocol_ && !protocol_->SendAudioBatch(packets)) {
+          break;
+        }
+        packets.clear();
       }
     }
 
     if (bits & MAIN_EVENT_WAKE_WORD_DETECTED) {
+      LoopProfiler::Section section(loop_profiler_, "wake_word");
       OnWakeWordDetected();
     }
 
     if (bits & MAIN_EVENT_VAD_CHANGE) {
-      if (device_state_ == kDeviceStateListening) {
+      LoopProfiler::Section section(loop_profiler_, "vad_change");
+      if (state_machine_.state() == kDeviceStateListening) {
         auto led = Board::GetInstance().GetLed();
         led->OnStateChanged();
       }
     }
 
     if (bits & MAIN_EVENT_SCHEDULE) {
-      std::unique_lock<std::mutex> lock(mutex_);
-      auto tasks = std::move(main_tasks_);
-      lock.unlock();
-      for (auto &task : tasks) {
-        task();
+      // Run a bounded batch so audio sending and clock ticks are not starved,
+      // every task is timed on its own
+      if (task_queue_.RunPending(MAX_SCHEDULED_TASKS_PER_LOOP,
+                                 &loop_profiler_)) {
+        xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
       }
     }
 
     if (bits & MAIN_EVENT_CLOCK_TICK) {
+      LoopProfiler::Section section(loop_profiler_, "clock_tick");
       clock_ticks_++;
       auto display = Board::GetInstance().GetDisplay();
       display->UpdateStatusBar();
+      CheckChannelPrewarm();
+      EventJournal::GetInstance().CheckHeap();
 
       // Touch events no longer use ack/timeout mechanism
 
       // Print the debug info every 10 seconds
       if (clock_ticks_ % 10 == 0) {
+        if (protocol_ && protocol_->IsAudioChannelOpened()) {
+          PublishLinkStats(false);
+        }
+        if (clock_ticks_ % 60 == 0) {
+          task_queue_.LogStats();
+          loop_profiler_.LogStats();
+          TimerService::GetInstance().LogStats();
+        }
         // SystemInfo::PrintTaskCpuUsage(pdMS_TO_TICKS(1000));
         // SystemInfo::PrintTaskList();
         SystemInfo::PrintHeapStats();
       }
     }
+
+    loop_profiler_.EndIteration();
   }
 }
 
@@ -785,16 +833,33 @@ void Application::OnWakeWordDetected() {
     return;
   }
 
-  if (device_state_ == kDeviceStateIdle) {
+  if (state_machine_.state() == kDeviceStateIdle) {
     audio_service_.EncodeWakeWord();
 
-    if (!protocol_->IsAudioChannelOpened()) {
+    JoinPrewarmOpen();
+    bool prewarmed = protocol_->IsAudioChannelOpened();
+    if (!prewarmed) {
       SetDeviceState(kDeviceStateConnecting);
       if (!protocol_->OpenAudioChannel()) {
         audio_service_.EnableWakeWordDetection(true);
         return;
       }
     }
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+    channel_prewarm_.OnReleased();
+#endif
+
+    // 📡 发布唤醒到通道就绪的时延
+    xiaozhi::WakeLatencyEventData latency = {
+        .latency_ms = (uint32_t)((esp_timer_get_time() -
+                                  wake_detected_time_us_) /
+                                 1000),
+        .prewarmed = prewarmed,
+    };
+    ESP_LOGI(TAG, "Wake to channel ready: %lu ms (prewarmed: %d)",
+             latency.latency_ms, prewarmed);
+    xiaozhi::EventBus::GetInstance().Publish<xiaozhi::WakeChannelReadyEvent>(
+        latency);
 
     auto wake_word = audio_service_.GetLastWakeWord();
     ESP_LOGI(TAG, "Wake word detected: %s", wake_word.c_str());
@@ -813,16 +878,105 @@ void Application::OnWakeWordDetected() {
     // Play the pop up sound to indicate the wake word is detected
     audio_service_.PlaySound(Lang::Sounds::OGG_POPUP);
 #endif
-  } else if (device_state_ == kDeviceStateSpeaking) {
+  } else if (state_machine_.state() == kDeviceStateSpeaking) {
     AbortSpeaking(kAbortReasonWakeWordDetected);
-  } else if (device_state_ == kDeviceStateActivating) {
+  } else if (state_machine_.state() == kDeviceStateActivating) {
     SetDeviceState(kDeviceStateIdle);
   }
 }
 
+LinkStatsSnapshot Application::GetLinkStats() {
+  return protocol_ ? protocol_->GetLinkStats() : LinkStatsSnapshot();
+}
+
+void Application::PublishLinkStats(bool session_end) {
+  auto stats = GetLinkStats();
+  if (stats.duration_ms == 0) {
+    return;
+  }
+  xiaozhi::LinkStatsEventData data = {
+      .rtt_ms = stats.rtt_ms,
+      .jitter_ms = stats.jitter_ms,
+      .loss_permille = stats.loss_permille(),
+      .reorder_permille = stats.reorder_permille(),
+      .rx_kbps = stats.rx_kbps,
+      .tx_kbps = stats.tx_kbps,
+      .session_end = session_end,
+  };
+  ESP_LOGI(TAG,
+           "Link rtt: %lu ms, jitter: %lu ms, loss: %lu‰, reorder: %lu‰, "
+           "rx: %lu kbps, tx: %lu kbps",
+           data.rtt_ms, data.jitter_ms, data.loss_permille,
+           data.reorder_permille, data.rx_kbps, data.tx_kbps);
+  xiaozhi::EventBus::GetInstance().PublishNonBlocking<xiaozhi::LinkStatsEvent>(
+      data);
+}
+
+// Open the audio channel ahead of the wake word when wake is likely, and
+// close it again if it stays unused
+void Application::CheckChannelPrewarm() {
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+  if (!protocol_ || prewarm_opening_) {
+    return;
+  }
+  if (state_machine_.state() != kDeviceStateIdle) {
+    channel_prewarm_.OnReleased();
+    return;
+  }
+
+  if (protocol_->IsAudioChannelOpened()) {
+    if (channel_prewarm_.ShouldClose()) {
+      protocol_->CloseAudioChannel();
+    }
+    return;
+  }
+
+  if (channel_prewarm_.ShouldOpen(audio_service_.GetInputLevel(),
+                                  has_server_time_)) {
+    // The open blocks for the connect and hello round trip, keep it off the
+    // main loop and post the result back
+    prewarm_opening_ = true;
+    xTaskCreate(
+        [](void *arg) {
+          auto app = (Application *)arg;
+          app->prewarm_opened_ = app->protocol_->OpenAudioChannel();
+          xEventGroupSetBits(app->event_group_, MAIN_EVENT_PREWARM_OPEN_DONE);
+          app->Schedule(kTaskPriorityHigh, [app]() {
+            // Skip if a wake already joined it and a newer open is running
+            if (xEventGroupGetBits(app->event_group_) &
+                MAIN_EVENT_PREWARM_OPEN_DONE) {
+              app->JoinPrewarmOpen();
+            }
+          });
+          vTaskDelete(NULL);
+        },
+        // Same stack as the main loop, which ran the open before
+        "channel_prewarm", 2048 * 4, this, 2, nullptr);
+  }
+#endif
+}
+
+// Waits for a pre-warm open in flight and takes over its result. Every path
+// that opens the channel calls this first, so a wake during the pre-warm
+// joins it instead of starting a second open on the same protocol.
+void Application::JoinPrewarmOpen() {
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+  if (!prewarm_opening_) {
+    return;
+  }
+  xEventGroupWaitBits(event_group_, MAIN_EVENT_PREWARM_OPEN_DONE, pdTRUE,
+                      pdTRUE, portMAX_DELAY);
+  prewarm_opening_ = false;
+  if (!prewarm_opened_) {
+    channel_prewarm_.OnOpenFailed();
+  } else if (state_machine_.state() == kDeviceStateIdle) {
+    channel_prewarm_.OnOpened();
+  }
+#endif
+}
+
 void Application::AbortSpeaking(AbortReason reason) {
   ESP_LOGI(TAG, "Abort speaking");
-  aborted_ = true;
   if (protocol_) {
     protocol_->SendAbortSpeaking(reason);
   }
@@ -835,102 +989,181 @@ void Application::SetListeningMode(ListeningMode mode) {
   SetDeviceState(kDeviceStateListening);
 }
 
+void Application::FinishSpeaking() {
+  tts_stop_pending_ = false;
+  if (state_machine_.state() != kDeviceStateSpeaking) {
+    return;
+  }
+  ESP_LOGI(TAG, "音频播放完成，用时 %lld ms",
+           (esp_timer_get_time() - tts_stop_time_us_) / 1000);
+
+  // 🧠 记录对话（用于用户画像）
+  auto &profile = xiaozhi::UserProfile::GetInstance();
+  profile.RecordInteraction("chat", 5000); // 假设5秒对话
+
+  // 📡 发布对话结束事件（事件总线）
+  auto &event_bus = xiaozhi::EventBus::GetInstance();
+  event_bus.Publish<xiaozhi::ConversationEndEvent>();
+  ESP_LOGI(TAG, "📡 Event published: CONVERSATION_END");
+
+  // Ensure microphone is unmuted for the next turn
+  audio_service_.SetInputMute(false);
+
+  if (listening_mode_ == kListeningModeManualStop) {
+    SetDeviceState(kDeviceStateIdle);
+  } else {
+    SetDeviceState(kDeviceStateListening);
+  }
+}
+
+// Guards, entry and exit actions of every state, in DeviceState order. Which
+// transitions are legal at all is decided by kDeviceStateRules.
+constexpr Application::StateActions Application::kStateActions[DEVICE_STATE_COUNT] = {
+    {kDeviceStateUnknown, nullptr, &Application::EnterIdle, nullptr},
+    {kDeviceStateStarting, nullptr, nullptr, nullptr},
+    {kDeviceStateWifiConfiguring, nullptr, nullptr, nullptr},
+    {kDeviceStateIdle, nullptr, &Application::EnterIdle, nullptr},
+    {kDeviceStateConnecting, nullptr, &Application::EnterConnecting, nullptr},
+    {kDeviceStateListening, &Application::HasProtocol,
+     &Application::EnterListening, nullptr},
+    {kDeviceStateSpeaking, nullptr, &Application::EnterSpeaking,
+     &Application::ExitSpeaking},
+    {kDeviceStateUpgrading, nullptr, nullptr, nullptr},
+    {kDeviceStateActivating, nullptr, nullptr, nullptr},
+    {kDeviceStateAudioTesting, nullptr, nullptr, nullptr},
+    {kDeviceStateFatalError, nullptr, nullptr, nullptr},
+};
+
 void Application::SetDeviceState(DeviceState state) {
-  if (device_state_ == state) {
+  static_assert(
+      [] {
+        for (int i = 0; i < DEVICE_STATE_COUNT; i++) {
+          if (kStateActions[i].state != i) {
+            return false;
+          }
+        }
+        return true;
+      }(),
+      "kStateActions must list every state in enum order");
+
+  auto previous_state = state_machine_.state();
+  if (previous_state == state) {
+    return;
+  }
+  auto &actions = kStateActions[state];
+  if (actions.guard != nullptr && !(this->*actions.guard)()) {
+    ESP_LOGW(TAG, "Guard rejected %s -> %s", DeviceStateName(previous_state),
+             DeviceStateName(state));
+    return;
+  }
+  if (!state_machine_.Transition(state)) {
     return;
   }
 
+  int64_t start_time = esp_timer_get_time();
   clock_ticks_ = 0;
-  auto previous_state = device_state_;
-  device_state_ = state;
-  ESP_LOGI(TAG, "STATE: %s", STATE_STRINGS[device_state_]);
+  ESP_LOGI(TAG, "STATE: %s", DeviceStateName(state));
 
   // Send the state change event
   DeviceStateEventManager::GetInstance().PostStateChangeEvent(previous_state,
                                                               state);
 
-  auto &board = Board::GetInstance();
-  auto display = board.GetDisplay();
-  auto led = board.GetLed();
+  auto led = Board::GetInstance().GetLed();
   led->OnStateChanged();
-  switch (state) {
-  case kDeviceStateUnknown:
-  case kDeviceStateIdle:
-    display->SetStatus(Lang::Strings::STANDBY);
-    display->SetEmotion("neutral");
-    audio_service_.EnableVoiceProcessing(false);
-    audio_service_.EnableWakeWordDetection(true);
-
-    // 👆 延迟初始化触摸检测（使用定时器，避免阻塞主事件循环）
-    if (!touch_initialized_) {
-      touch_initialized_ = true;
-      ESP_LOGI(TAG, "Will initialize touch handler (GPIO13) in 2 seconds...");
-
-      // 创建一次性定时器来延迟初始化
-      esp_timer_create_args_t timer_args = {
-          .callback =
-              [](void *arg) {
-                Application *app = static_cast<Application *>(arg);
-                ESP_LOGI(TAG, "Initializing touch handler on GPIO13...");
-                esp_err_t ret = app->touch_handler_.Start([app]() {
-                  app->Schedule([app]() { app->OnTouchDetected(); });
-                });
-                if (ret != ESP_OK) {
-                  ESP_LOGW(TAG,
-                           "Touch handler initialization failed (%s), "
-                           "continuing without touch support",
-                           esp_err_to_name(ret));
-                }
-              },
-          .arg = this,
-          .dispatch_method = ESP_TIMER_TASK,
-          .name = "touch_init_timer"};
-
-      esp_timer_handle_t touch_init_timer;
-      if (esp_timer_create(&timer_args, &touch_init_timer) == ESP_OK) {
-        // 延迟2秒后初始化（确保音频系统完全稳定）
-        esp_timer_start_once(touch_init_timer, 2000000); // 2秒 = 2,000,000 微秒
-      } else {
-        ESP_LOGE(TAG, "Failed to create touch init timer");
-      }
-    }
-    break;
-  case kDeviceStateConnecting:
-    display->SetStatus(Lang::Strings::CONNECTING);
-    display->SetEmotion("neutral");
-    display->SetChatMessage("system", "");
-    break;
-  case kDeviceStateListening:
-    display->SetStatus(Lang::Strings::LISTENING);
-    display->SetEmotion("neutral");
+  if (kStateActions[previous_state].on_exit != nullptr) {
+    (this->*kStateActions[previous_state].on_exit)();
+  }
+  if (actions.on_enter != nullptr) {
+    (this->*actions.on_enter)();
+  }
+  state_machine_.SetLastActionTime(esp_timer_get_time() - start_time);
+}
 
-    // Send start listening if audio processor isn't running
-    if (!audio_service_.IsAudioProcessorRunning()) {
-      protocol_->SendStartListening(listening_mode_);
+void Application::EnterIdle() {
+  auto display = Board::GetInstance().GetDisplay();
+  display->SetStatus(Lang::Strings::STANDBY);
+  display->SetEmotion("neutral");
+  audio_service_.EnableVoiceProcessing(false);
+  audio_service_.EnableWakeWordDetection(true);
+
+  // 👆 延迟初始化触摸检测（使用定时器，避免阻塞主事件循环）
+  if (!touch_initialized_) {
+    touch_initialized_ = true;
+    ESP_LOGI(TAG, "Will initialize touch handler (GPIO13) in 2 seconds...");
+
+    // 创建一次性定时器来延迟初始化
+    esp_timer_create_args_t timer_args = {
+        .callback =
+            [](void *arg) {
+              Application *app = static_cast<Application *>(arg);
+              ESP_LOGI(TAG, "Initializing touch handler on GPIO13...");
+              esp_err_t ret = app->touch_handler_.Start([app]() {
+                app->Schedule([app]() { app->OnTouchDetected(); });
+              });
+              if (ret != ESP_OK) {
+                ESP_LOGW(TAG,
+                         "Touch handler initialization failed (%s), "
+                         "continuing without touch support",
+                         esp_err_to_name(ret));
+              }
+            },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "touch_init_timer"};
+
+    esp_timer_handle_t touch_init_timer;
+    if (esp_timer_create(&timer_args, &touch_init_timer) == ESP_OK) {
+      // 延迟2秒后初始化（确保音频系统完全稳定）
+      esp_timer_start_once(touch_init_timer, 2000000); // 2秒 = 2,000,000 微秒
+    } else {
+      ESP_LOGE(TAG, "Failed to create touch init timer");
     }
+  }
+}
 
-    // Always enable voice processing when entering Listening state
-    // This is critical for VAD to work after state transitions
-    audio_service_.EnableVoiceProcessing(true);
-    audio_service_.EnableWakeWordDetection(false);
-    break;
-  case kDeviceStateSpeaking:
-    display->SetStatus(Lang::Strings::SPEAKING);
-
-    //  ⚠️  Barge-in 暂时禁用：ESP-SR AFE 不支持 AEC + VAD 同时运行
-    // Speaking 状态下关闭音频处理，避免 CPU 过载和 Ringbuffer 溢出
-    // 用户仍可在 Listening 状态时打断（说话时机器人会停止说话并监听）
-    if (listening_mode_ != kListeningModeRealtime) {
-      audio_service_.EnableVoiceProcessing(false);
-      // Only AFE wake word can be detected in speaking mode
-      audio_service_.EnableWakeWordDetection(audio_service_.IsAfeWakeWord());
-    }
-    audio_service_.ResetDecoder();
-    break;
-  default:
-    // Do nothing
-    break;
+void Application::EnterConnecting() {
+  auto display = Board::GetInstance().GetDisplay();
+  display->SetStatus(Lang::Strings::CONNECTING);
+  display->SetEmotion("neutral");
+  display->SetChatMessage("system", "");
+}
+
+void Application::EnterListening() {
+  auto display = Board::GetInstance().GetDisplay();
+  display->SetStatus(Lang::Strings::LISTENING);
+  display->SetEmotion("neutral");
+
+  // Send start listening if audio processor isn't running
+  if (!audio_service_.IsAudioProcessorRunning()) {
+    protocol_->SendStartListening(listening_mode_);
   }
+
+  // Always enable voice processing when entering Listening state
+  // This is critical for VAD to work after state transitions
+  audio_service_.EnableVoiceProcessing(true);
+  audio_service_.EnableWakeWordDetection(false);
+}
+
+void Application::EnterSpeaking() {
+  auto display = Board::GetInstance().GetDisplay();
+  display->SetStatus(Lang::Strings::SPEAKING);
+
+  //  ⚠️  Barge-in 暂时禁用：ESP-SR AFE 不支持 AEC + VAD 同时运行
+  // Speaking 状态下关闭音频处理，避免 CPU 过载和 Ringbuffer 溢出
+  // 用户仍可在 Listening 状态时打断（说话时机器人会停止说话并监听）
+  if (listening_mode_ != kListeningModeRealtime) {
+    audio_service_.EnableVoiceProcessing(false);
+    // Only AFE wake word can be detected in speaking mode
+    audio_service_.EnableWakeWordDetection(audio_service_.IsAfeWakeWord());
+  }
+  audio_service_.ResetDecoder();
+}
+
+void Application::ExitSpeaking() {
+  // Leaving speaking by any other path cancels the pending tts stop
+  tts_stop_pending_ = false;
+  tts_stop_timer_.Cancel();
+  audio_service_.DisarmPlaybackDrained();
 }
 
 void Application::Reboot() {
@@ -1006,17 +1239,17 @@ bool Application::UpgradeFirmware(Ota &ota, const std::string &url) {
 }
 
 void Application::WakeWordInvoke(const std::string &wake_word) {
-  if (device_state_ == kDeviceStateIdle) {
+  if (state_machine_.state() == kDeviceStateIdle) {
     ToggleChatState();
-    Schedule([this, wake_word]() {
+    Schedule(kTaskPriorityHigh, [this, wake_word]() {
       if (protocol_) {
         protocol_->SendWakeWordDetected(wake_word);
       }
     });
-  } else if (device_state_ == kDeviceStateSpeaking) {
-    Schedule([this]() { AbortSpeaking(kAbortReasonNone); });
-  } else if (device_state_ == kDeviceStateListening) {
-    Schedule([this]() {
+  } else if (state_machine_.state() == kDeviceStateSpeaking) {
+    Schedule(kTaskPriorityHigh, [this]() { AbortSpeaking(kAbortReasonNone); });
+  } else if (state_machine_.state() == kDeviceStateListening) {
+    Schedule(kTaskPriorityHigh, [this]() {
       if (protocol_) {
         protocol_->CloseAudioChannel();
       }
@@ -1025,7 +1258,7 @@ void Application::WakeWordInvoke(const std::string &wake_word) {
 }
 
 bool Application::CanEnterSleepMode() {
-  if (device_state_ != kDeviceStateIdle) {
+  if (state_machine_.state() != kDeviceStateIdle) {
     return false;
   }
 
@@ -1123,8 +1356,9 @@ void Application::OnTouchDetected() {
       SendTouchStartSequence();
     };
 
+    JoinPrewarmOpen();
     if (protocol_->IsAudioChannelOpened()) {
-      if (device_state_ == kDeviceStateSpeaking) {
+      if (state_machine_.state() == kDeviceStateSpeaking) {
         ESP_LOGI(TAG, "Touch: aborting speech before starting touch sequence");
         AbortSpeaking(kAbortReasonNone);
       }
@@ -1132,7 +1366,7 @@ void Application::OnTouchDetected() {
       return;
     }
 
-    if (device_state_ != kDeviceStateIdle) {
+    if (state_machine_.state() != kDeviceStateIdle) {
       ESP_LOGW(TAG, "Cannot start touch interaction - device busy");
       touch_message_pending_ = false;
       return;
@@ -1153,7 +1387,7 @@ void Application::OnTouchDetected() {
     ESP_LOGI(TAG, "Touch: audio channel opened, starting sequence");
     start_touch_sequence();
 
-    if (device_state_ == kDeviceStateConnecting) {
+    if (state_machine_.state() == kDeviceStateConnecting) {
       // The state will be updated to Listening when the channel is fully open
       // and we send the start command But for now, we can leave it as
       // Connecting or set to Idle if we want to be safe Actually,
@@ -1162,7 +1396,7 @@ void Application::OnTouchDetected() {
       // connection happens in background? Let's check OpenAudioChannel
       // implementation if needed. Based on existing code, it seems we just wait
       // for OnAudioChannelOpened or just proceed. In the original code: if
-      // (device_state_ == kDeviceStateConnecting) {
+      // (state_machine_.state() == kDeviceStateConnecting) {
       //    SetDeviceState(kDeviceStateIdle);
       // }
       // But here we want to stay in a state that allows interaction.
@@ -1215,11 +1449,12 @@ void Application::SendTouchStartSequence() {
   ESP_LOGI(TAG, "Touch: starting sequence");
 
   // 1. If speaking, abort it
-  if (device_state_ == kDeviceStateSpeaking) {
+  if (state_machine_.state() == kDeviceStateSpeaking) {
     AbortSpeaking(kAbortReasonNone);
   }
 
   // 2. Ensure audio channel is open (for subsequent audio streaming)
+  JoinPrewarmOpen();
   if (!protocol_->IsAudioChannelOpened()) {
     SetDeviceState(kDeviceStateConnecting);
     if (!protocol_->OpenAudioChannel()) {
@@ -1247,7 +1482,6 @@ void Application::SendTouchStartSequence() {
   SendTouchEventViaMcp();
 
   touch_message_pending_ = false;
-  touch_waiting_start_ack_ = false;
   touch_start_request_time_us_ = 0;
 
   if (touch_channel_opened_for_touch_) {
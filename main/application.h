@@ -10,12 +10,22 @@
 #include <mutex>
 #include <deque>
 #include <memory>
+#include <atomic>
 
 #include "protocol.h"
+#include "message_dispatcher.h"
 #include "ota.h"
 #include "audio_service.h"
 #include "device_state_event.h"
+#include "device_state_machine.h"
 #include "touch_handler.h"
+#include "task_queue.h"
+#include "loop_profiler.h"
+#include "timer_service.h"
+#include "event_bus.h"
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+#include "channel_prewarm.h"
+#endif
 
 
 #define MAIN_EVENT_SCHEDULE (1 << 0)
@@ -25,6 +35,9 @@
 #define MAIN_EVENT_ERROR (1 << 4)
 #define MAIN_EVENT_CHECK_NEW_VERSION_DONE (1 << 5)
 #define MAIN_EVENT_CLOCK_TICK (1 << 6)
+#define MAIN_EVENT_PREWARM_OPEN_DONE (1 << 7)
+
+#define MAX_SCHEDULED_TASKS_PER_LOOP 16
 
 
 enum AecMode {
@@ -45,9 +58,20 @@ public:
 
     void Start();
     void MainEventLoop();
-    DeviceState GetDeviceState() const { return device_state_; }
+    DeviceState GetDeviceState() const { return state_machine_.state(); }
     bool IsVoiceDetected() const { return audio_service_.IsVoiceDetected(); }
-    void Schedule(std::function<void()> callback);
+    // Run the callback in the main event loop, UI work uses the normal lane.
+    // The caller's file and line tag the task in the loop profiler.
+    template<typename F>
+    void Schedule(F&& callback, const char* file = __builtin_FILE(), int line = __builtin_LINE()) {
+        Schedule(kTaskPriorityNormal, std::forward<F>(callback), file, line);
+    }
+    template<typename F>
+    void Schedule(TaskPriority priority, F&& callback, const char* file = __builtin_FILE(),
+                  int line = __builtin_LINE()) {
+        task_queue_.Push(ScheduledTask{SmallTask(std::forward<F>(callback)), file, line}, priority);
+        xEventGroupSetBits(event_group_, MAIN_EVENT_SCHEDULE);
+    }
     void SetDeviceState(DeviceState state);
     void Alert(const char* status, const char* message, const char* emotion = "", const std::string_view& sound = "");
     void DismissAlert();
@@ -65,36 +89,71 @@ public:
     void PlaySound(const std::string_view& sound);
     AudioService& GetAudioService() { return audio_service_; }
     void OnTouchDetected();
+    MessageDispatcher& GetMessageDispatcher() { return message_dispatcher_; }
+    LinkStatsSnapshot GetLinkStats();
+    LoopProfiler& GetLoopProfiler() { return loop_profiler_; }
+    DeviceStateMachine& GetStateMachine() { return state_machine_; }
 
 private:
+    struct StateActions {
+        DeviceState state;
+        bool (Application::*guard)() const;
+        void (Application::*on_enter)();
+        void (Application::*on_exit)();
+    };
+    static const StateActions kStateActions[DEVICE_STATE_COUNT];
+
     Application();
     ~Application();
 
-    std::mutex mutex_;
-    std::deque<std::function<void()>> main_tasks_;
+    TaskQueue task_queue_;
+    LoopProfiler loop_profiler_{CONFIG_MAIN_LOOP_STALL_THRESHOLD_MS};
     std::unique_ptr<Protocol> protocol_;
+    MessageDispatcher message_dispatcher_;
     EventGroupHandle_t event_group_ = nullptr;
-    esp_timer_handle_t clock_timer_handle_ = nullptr;
-    volatile DeviceState device_state_ = kDeviceStateUnknown;
+    TimerHandle clock_timer_;
+    xiaozhi::EventSubscription conversation_end_subscription_;
+    DeviceStateMachine state_machine_;
     ListeningMode listening_mode_ = kListeningModeAutoStop;
     AecMode aec_mode_ = kAecOff;
     std::string last_error_message_;
     AudioService audio_service_;
     TouchHandler touch_handler_;
     bool touch_message_pending_ = false;
-    bool touch_waiting_start_ack_ = false;
     bool touch_channel_opened_for_touch_ = false;
     int64_t touch_start_request_time_us_ = 0;
     int touch_mcp_request_id_ = 1;
 
     bool has_server_time_ = false;
-    bool aborted_ = false;
+    // tts stop received, waiting for the playback queue to drain
+    bool tts_stop_pending_ = false;
+    int64_t tts_stop_time_us_ = 0;
+    // Finishes the tts stop if the drain is never reported
+    TimerHandle tts_stop_timer_;
     bool touch_initialized_ = false;
     int clock_ticks_ = 0;
+    int64_t wake_detected_time_us_ = 0;
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+    ChannelPrewarm channel_prewarm_;
+    // A pre-warm open is running on its own task, cleared by JoinPrewarmOpen
+    std::atomic<bool> prewarm_opening_{false};
+    bool prewarm_opened_ = false;   // Result of that open, valid once MAIN_EVENT_PREWARM_OPEN_DONE is set
+#endif
     TaskHandle_t check_new_version_task_handle_ = nullptr;
     TaskHandle_t main_event_loop_task_handle_ = nullptr;
 
     void OnWakeWordDetected();
+    void FinishSpeaking();
+    bool HasProtocol() const { return protocol_ != nullptr; }
+    void EnterIdle();
+    void EnterConnecting();
+    void EnterListening();
+    void EnterSpeaking();
+    void ExitSpeaking();
+    void RegisterMessageHandlers();
+    void CheckChannelPrewarm();
+    void JoinPrewarmOpen();
+    void PublishLinkStats(bool session_end);
     void CheckNewVersion(Ota& ota);
     void CheckAssetsVersion();
     void ShowActivationCode(const std::string& code, const std::string& message);
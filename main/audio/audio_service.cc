@@ -61,18 +61,6 @@ void AudioService::Initialize(AudioCodec *codec) {
     }
   });
 
-  esp_timer_create_args_t audio_power_timer_args = {
-      .callback =
-          [](void *arg) {
-            AudioService *audio_service = (AudioService *)arg;
-            audio_service->CheckAndUpdateAudioPowerState();
-          },
-      .arg = this,
-      .dispatch_method = ESP_TIMER_TASK,
-      .name = "audio_power_timer",
-      .skip_unhandled_events = true,
-  };
-  esp_timer_create(&audio_power_timer_args, &audio_power_timer_);
 }
 
 void AudioService::Start() {
@@ -81,7 +69,7 @@ void AudioService::Start() {
                                          AS_EVENT_WAKE_WORD_RUNNING |
                                          AS_EVENT_AUDIO_PROCESSOR_RUNNING);
 
-  esp_timer_start_periodic(audio_power_timer_, 1000000);
+  RestartPowerTimer();
 
 #if CONFIG_USE_AUDIO_PROCESSOR
   /* Start the audio input task (increased stack size for noise reduction) */
@@ -134,7 +122,7 @@ void AudioService::Start() {
 }
 
 void AudioService::Stop() {
-  esp_timer_stop(audio_power_timer_);
+  StopPowerTimer();
   service_stopped_ = true;
   xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_TESTING_RUNNING |
                                        AS_EVENT_WAKE_WORD_RUNNING |
@@ -151,9 +139,7 @@ void AudioService::Stop() {
 bool AudioService::ReadAudioData(std::vector<int16_t> &data, int sample_rate,
                                  int samples) {
   if (!codec_->input_enabled()) {
-    esp_timer_stop(audio_power_timer_);
-    esp_timer_start_periodic(audio_power_timer_,
-                             AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+    RestartPowerTimer();
     codec_->EnableInput(true);
   }
 
@@ -265,6 +251,9 @@ void AudioService::AudioInputTask() {
       int samples = wake_word_->GetFeedSize();
       if (samples > 0) {
         if (ReadAudioData(data, 16000, samples)) {
+#if CONFIG_AUDIO_CHANNEL_PREWARM
+          UpdateInputLevel(data);
+#endif
           wake_word_->Feed(data);
           continue;
         }
@@ -306,9 +295,7 @@ void AudioService::AudioOutputTask() {
     lock.unlock();
 
     if (!codec_->output_enabled()) {
-      esp_timer_stop(audio_power_timer_);
-      esp_timer_start_periodic(audio_power_timer_,
-                               AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+      RestartPowerTimer();
       codec_->EnableOutput(true);
     }
     codec_->OutputData(task->pcm);
@@ -317,13 +304,18 @@ void AudioService::AudioOutputTask() {
     last_output_time_ = std::chrono::steady_clock::now();
     debug_statistics_.playback_count++;
 
+    lock.lock();
 #if CONFIG_USE_SERVER_AEC
     /* Record the timestamp for server AEC */
     if (task->timestamp > 0) {
-      lock.lock();
       timestamp_queue_.push_back(task->timestamp);
     }
 #endif
+    bool drained = PlaybackDrainedLocked();
+    lock.unlock();
+    if (drained) {
+      NotifyPlaybackDrained();
+    }
   }
 
   ESP_LOGW(TAG, "Audio output task stopped");
@@ -333,9 +325,7 @@ void AudioService::OpusCodecTask() {
   while (true) {
     std::unique_lock<std::mutex> lock(audio_queue_mutex_);
     audio_queue_cv_.wait(lock, [this]() {
-      return service_stopped_ ||
-             (!audio_encode_queue_.empty() &&
-              audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) ||
+      return service_stopped_ || !audio_encode_queue_.empty() ||
              (!audio_decode_queue_.empty() &&
               audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE);
     });
@@ -348,6 +338,7 @@ void AudioService::OpusCodecTask() {
         audio_playback_queue_.size() < MAX_PLAYBACK_TASKS_IN_QUEUE) {
       auto packet = std::move(audio_decode_queue_.front());
       audio_decode_queue_.pop_front();
+      decoding_packet_ = true;
       audio_queue_cv_.notify_all();
       lock.unlock();
 
@@ -390,23 +381,37 @@ void AudioService::OpusCodecTask() {
         }
 
         lock.lock();
+        decoding_packet_ = false;
         audio_playback_queue_.push_back(std::move(task));
         audio_queue_cv_.notify_all();
       } else {
         ESP_LOGE(TAG, "Failed to decode audio");
         lock.lock();
+        decoding_packet_ = false;
+        /* The output task will not see this packet, report the drain here */
+        if (PlaybackDrainedLocked()) {
+          lock.unlock();
+          NotifyPlaybackDrained();
+          lock.lock();
+        }
       }
       debug_statistics_.decode_count++;
     }
 
     /* Encode the audio to send queue */
-    if (!audio_encode_queue_.empty() &&
-        audio_send_queue_.size() < MAX_SEND_PACKETS_IN_QUEUE) {
+    if (!audio_encode_queue_.empty()) {
       auto task = std::move(audio_encode_queue_.front());
       audio_encode_queue_.pop_front();
+      /* Reduce the uplink rate while the send queue is building up */
+      bool dtx = send_congestion_.level() != kSendCongestionNone;
       audio_queue_cv_.notify_all();
       lock.unlock();
 
+      if (dtx != encoder_dtx_enabled_) {
+        opus_encoder_->SetDtx(dtx);
+        encoder_dtx_enabled_ = dtx;
+      }
+
       auto packet = std::make_unique<AudioStreamPacket>();
       packet->frame_duration = OPUS_FRAME_DURATION_MS;
       packet->sample_rate = 16000;
@@ -419,7 +424,15 @@ void AudioService::OpusCodecTask() {
       if (task->type == kAudioTaskTypeEncodeToSendQueue) {
         {
           std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+          send_congestion_.OnPacketQueued(packet->payload.size(),
+                                          audio_send_queue_.size() + 1);
           audio_send_queue_.push_back(std::move(packet));
+          /* Drop the oldest frames instead of stalling the capture pipeline */
+          while (audio_send_queue_.size() >
+                 send_congestion_.GetQueueLimit()) {
+            audio_send_queue_.pop_front();
+            send_congestion_.OnPacketDropped();
+          }
         }
         if (callbacks_.on_send_queue_available) {
           callbacks_.on_send_queue_available();
@@ -506,10 +519,34 @@ std::unique_ptr<AudioStreamPacket> AudioService::PopPacketFromSendQueue() {
   }
   auto packet = std::move(audio_send_queue_.front());
   audio_send_queue_.pop_front();
+  send_congestion_.OnPacketSent(packet->payload.size(),
+                                audio_send_queue_.size());
   audio_queue_cv_.notify_all();
   return packet;
 }
 
+void AudioService::UpdateInputLevel(const std::vector<int16_t> &data) {
+  if (data.empty()) {
+    return;
+  }
+  int64_t sum = 0;
+  for (auto sample : data) {
+    sum += sample < 0 ? -sample : sample;
+  }
+  int level = sum / data.size();
+  input_level_ = (input_level_ * 7 + level) / 8;
+}
+
+uint32_t AudioService::GetEstimatedUplinkBitrate() {
+  std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+  return send_congestion_.estimated_bitrate();
+}
+
+size_t AudioService::GetSendQueueSize() {
+  std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+  return audio_send_queue_.size();
+}
+
 void AudioService::EncodeWakeWord() {
   if (wake_word_) {
     wake_word_->EncodeWakeWordData();
@@ -569,6 +606,10 @@ void AudioService::EnableVoiceProcessing(bool enable) {
 
     /* We should make sure no audio is playing */
     ResetDecoder();
+    {
+      std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+      send_congestion_.Reset();
+    }
     audio_input_need_warmup_ = true;
     audio_processor_->Start();
     xEventGroupSetBits(event_group_, AS_EVENT_AUDIO_PROCESSOR_RUNNING);
@@ -607,9 +648,7 @@ void AudioService::SetCallbacks(AudioServiceCallbacks &callbacks) {
 
 void AudioService::PlaySound(const std::string_view &ogg) {
   if (!codec_->output_enabled()) {
-    esp_timer_stop(audio_power_timer_);
-    esp_timer_start_periodic(audio_power_timer_,
-                             AUDIO_POWER_CHECK_INTERVAL_MS * 1000);
+    RestartPowerTimer();
     codec_->EnableOutput(true);
   }
 
@@ -714,6 +753,35 @@ void AudioService::PlaySound(const std::string_view &ogg) {
   }
 }
 
+bool AudioService::IsPlaybackDrained() {
+  std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+  return PlaybackDrainedLocked();
+}
+
+bool AudioService::ArmPlaybackDrained() {
+  std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+  if (PlaybackDrainedLocked()) {
+    return true;
+  }
+  playback_drained_armed_ = true;
+  return false;
+}
+
+bool AudioService::PlaybackDrainedLocked() const {
+  return audio_decode_queue_.empty() && audio_playback_queue_.empty() &&
+         !decoding_packet_;
+}
+
+void AudioService::NotifyPlaybackDrained() {
+  // Only the first drain after arming is reported
+  if (!playback_drained_armed_.exchange(false)) {
+    return;
+  }
+  if (callbacks_.on_playback_drained) {
+    callbacks_.on_playback_drained();
+  }
+}
+
 bool AudioService::IsIdle() {
   std::lock_guard<std::mutex> lock(audio_queue_mutex_);
   return audio_encode_queue_.empty() && audio_decode_queue_.empty() &&
@@ -731,18 +799,29 @@ void AudioService::ResetDecoder() {
 }
 
 void AudioService::ClearPlaybackQueues() {
-  std::lock_guard<std::mutex> lock(audio_queue_mutex_);
+  bool drained;
+  {
+    std::lock_guard<std::mutex> lock(audio_queue_mutex_);
 
-  // 清空解码队列（服务器发来的待解码数据）
-  audio_decode_queue_.clear();
+    // 清空解码队列（服务器发来的待解码数据）
+    audio_decode_queue_.clear();
 
-  // 清空播放队列（已解码但未播放的数据）
-  audio_playback_queue_.clear();
+    // 清空播放队列（已解码但未播放的数据）
+    audio_playback_queue_.clear();
 
-  // 清空时间戳队列（用于 AEC）
-  timestamp_queue_.clear();
+    // 清空时间戳队列（用于 AEC）
+    timestamp_queue_.clear();
 
-  audio_queue_cv_.notify_all();
+    audio_queue_cv_.notify_all();
+
+    // 正在解码的包播放完后由输出任务通知
+    drained = !decoding_packet_;
+  }
+
+  // 在锁外通知，回调可以再调用 AudioService
+  if (drained) {
+    NotifyPlaybackDrained();
+  }
 }
 
 void AudioService::SetBargeInContextMode(bool in_conversation) {
@@ -765,10 +844,24 @@ void AudioService::CheckAndUpdateAudioPowerState() {
     codec_->EnableOutput(false);
   }
   if (!codec_->input_enabled() && !codec_->output_enabled()) {
-    esp_timer_stop(audio_power_timer_);
+    StopPowerTimer();
   }
 }
 
+void AudioService::RestartPowerTimer() {
+  std::lock_guard<std::mutex> lock(power_timer_mutex_);
+  // The power check is not urgent, let it share wakeups with other timers
+  power_timer_ = TimerService::GetInstance().StartPeriodic(
+      "audio_power", AUDIO_POWER_CHECK_INTERVAL_MS,
+      AUDIO_POWER_CHECK_INTERVAL_MS / 2,
+      [this]() { CheckAndUpdateAudioPowerState(); });
+}
+
+void AudioService::StopPowerTimer() {
+  std::lock_guard<std::mutex> lock(power_timer_mutex_);
+  power_timer_.Cancel();
+}
+
 void AudioService::SetModelsList(srmodel_list_t *models_list) {
   models_list_ = models_list;
 
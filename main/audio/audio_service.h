@@ -1,6 +1,7 @@
 #ifndef AUDIO_SERVICE_H
 #define AUDIO_SERVICE_H
 
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <deque>
@@ -21,6 +22,8 @@
 #include "audio_processor.h"
 #include "processors/audio_debugger.h"
 #include "protocol.h"
+#include "send_congestion_controller.h"
+#include "timer_service.h"
 #include "wake_word.h"
 
 /*
@@ -59,6 +62,9 @@ struct AudioServiceCallbacks {
   std::function<void(const std::string &)> on_wake_word_detected;
   std::function<void(bool)> on_vad_change;
   std::function<void(void)> on_audio_testing_queue_full;
+  // Called once, without locks held, when the last queued frame has been
+  // written after ArmPlaybackDrained()
+  std::function<void(void)> on_playback_drained;
 };
 
 enum AudioTaskType {
@@ -92,7 +98,15 @@ public:
   std::unique_ptr<AudioStreamPacket> PopWakeWordPacket();
   const std::string &GetLastWakeWord() const;
   bool IsVoiceDetected() const { return voice_detected_; }
+  // Smoothed mean absolute level of the wake word input
+  int GetInputLevel() const { return input_level_; }
   bool IsIdle();
+  // No downlink audio left to decode or play
+  bool IsPlaybackDrained();
+  // Requests one on_playback_drained call; returns true without arming if
+  // playback has already drained
+  bool ArmPlaybackDrained();
+  void DisarmPlaybackDrained() { playback_drained_armed_ = false; }
   bool IsWakeWordRunning() const {
     return xEventGroupGetBits(event_group_) & AS_EVENT_WAKE_WORD_RUNNING;
   }
@@ -111,6 +125,9 @@ public:
   bool PushPacketToDecodeQueue(std::unique_ptr<AudioStreamPacket> packet,
                                bool wait = false);
   std::unique_ptr<AudioStreamPacket> PopPacketFromSendQueue();
+  size_t GetSendQueueSize();
+  // Uplink bandwidth measured from the send queue drain rate, 0 if unknown
+  uint32_t GetEstimatedUplinkBitrate();
   void PlaySound(const std::string_view &sound);
   bool ReadAudioData(std::vector<int16_t> &data, int sample_rate, int samples);
   void ResetDecoder();
@@ -149,6 +166,12 @@ private:
   std::deque<std::unique_ptr<AudioTask>> audio_playback_queue_;
   // For server AEC
   std::deque<uint32_t> timestamp_queue_;
+  SendCongestionController send_congestion_{OPUS_FRAME_DURATION_MS,
+                                            MAX_SEND_PACKETS_IN_QUEUE};
+  bool encoder_dtx_enabled_ = false;
+  // A packet taken from the decode queue that has not reached playback yet
+  bool decoding_packet_ = false;
+  std::atomic<bool> playback_drained_armed_ = false;
 
   bool wake_word_initialized_ = false;
   bool audio_processor_initialized_ = false;
@@ -156,10 +179,12 @@ private:
   bool service_stopped_ = true;
   bool audio_input_need_warmup_ = false;
   bool input_muted_ = false;
+  int input_level_ = 0;
 
   // Barge-in 功能已禁用（移除相关变量以避免误触发问题）
 
-  esp_timer_handle_t audio_power_timer_ = nullptr;
+  std::mutex power_timer_mutex_;
+  TimerHandle power_timer_;
   std::chrono::steady_clock::time_point last_input_time_;
   std::chrono::steady_clock::time_point last_output_time_;
 
@@ -169,6 +194,11 @@ private:
   void PushTaskToEncodeQueue(AudioTaskType type, std::vector<int16_t> &&pcm);
   void SetDecodeSampleRate(int sample_rate, int frame_duration);
   void CheckAndUpdateAudioPowerState();
+  void RestartPowerTimer();
+  void StopPowerTimer();
+  bool PlaybackDrainedLocked() const;
+  void NotifyPlaybackDrained();
+  void UpdateInputLevel(const std::vector<int16_t> &data);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "send_congestion_controller.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "SendCongestion"
+
+#define CONGESTION_WINDOW_US 1000000
+// Queue delay that marks the uplink as congested / recovered
+#define CONGESTION_MILD_DELAY_MS 600
+#define CONGESTION_SEVERE_DELAY_MS 1200
+#define CONGESTION_CLEAR_DELAY_MS 240
+// Windows the queue delay must stay high before frames are dropped
+#define CONGESTION_SEVERE_WINDOWS 2
+
+SendCongestionController::SendCongestionController(int frame_duration_ms, size_t max_queued_packets)
+    : frame_duration_ms_(frame_duration_ms), max_queued_packets_(max_queued_packets) {
+}
+
+void SendCongestionController::Reset() {
+    level_ = kSendCongestionNone;
+    window_start_us_ = 0;
+    window_sent_bytes_ = 0;
+    window_queued_bytes_ = 0;
+    congested_windows_ = 0;
+}
+
+void SendCongestionController::OnPacketQueued(size_t bytes, size_t queue_size) {
+    window_queued_bytes_ += bytes;
+    UpdateWindow(queue_size);
+}
+
+void SendCongestionController::OnPacketSent(size_t bytes, size_t queue_size) {
+    window_sent_bytes_ += bytes;
+    UpdateWindow(queue_size);
+}
+
+size_t SendCongestionController::GetQueueLimit() const {
+    if (level_ == kSendCongestionSevere) {
+        return CONGESTION_MILD_DELAY_MS / frame_duration_ms_;
+    }
+    return max_queued_packets_;
+}
+
+void SendCongestionController::UpdateWindow(size_t queue_size) {
+    int64_t now = esp_timer_get_time();
+    if (window_start_us_ == 0) {
+        window_start_us_ = now;
+        return;
+    }
+    int64_t elapsed_us = now - window_start_us_;
+    if (elapsed_us < CONGESTION_WINDOW_US) {
+        return;
+    }
+
+    uint32_t sent_bitrate = window_sent_bytes_ * 8 * 1000000LL / elapsed_us;
+    uint32_t input_bitrate = window_queued_bytes_ * 8 * 1000000LL / elapsed_us;
+    int queue_delay_ms = queue_size * frame_duration_ms_;
+
+    // The drain rate only measures the link while there is a backlog,
+    // otherwise it is bounded by what the encoder produced
+    if (queue_delay_ms >= CONGESTION_CLEAR_DELAY_MS) {
+        estimated_bitrate_ = estimated_bitrate_ == 0 ? sent_bitrate : (estimated_bitrate_ * 3 + sent_bitrate) / 4;
+    } else if (sent_bitrate > estimated_bitrate_) {
+        estimated_bitrate_ = sent_bitrate;
+    }
+
+    if (queue_delay_ms >= CONGESTION_SEVERE_DELAY_MS) {
+        congested_windows_++;
+    } else {
+        congested_windows_ = 0;
+    }
+
+    auto level = level_;
+    if (congested_windows_ >= CONGESTION_SEVERE_WINDOWS) {
+        level = kSendCongestionSevere;
+    } else if (queue_delay_ms >= CONGESTION_MILD_DELAY_MS) {
+        level = kSendCongestionMild;
+    } else if (level == kSendCongestionSevere) {
+        level = kSendCongestionMild;
+    } else if (queue_delay_ms <= CONGESTION_CLEAR_DELAY_MS) {
+        level = kSendCongestionNone;
+    }
+    if (level != level_) {
+        ESP_LOGW(TAG, "Level %d -> %d, queue %d ms, input %lu bps, sent %lu bps, estimated %lu bps, dropped %lu",
+            level_, level, queue_delay_ms, input_bitrate, sent_bitrate, estimated_bitrate_, dropped_packets_);
+        level_ = level;
+    }
+
+    window_start_us_ = now;
+    window_sent_bytes_ = 0;
+    window_queued_bytes_ = 0;
+}
@@ -0,0 +1,49 @@
+#ifndef SEND_CONGESTION_CONTROLLER_H
+#define SEND_CONGESTION_CONTROLLER_H
+
+#include <cstddef>
+#include <cstdint>
+
+enum SendCongestionLevel {
+    kSendCongestionNone,
+    kSendCongestionMild,      // Queue is building up, reduce the uplink rate
+    kSendCongestionSevere,    // Uplink cannot keep up, drop the oldest frames
+};
+
+/*
+ * Watches the uplink send queue and estimates the available bandwidth from
+ * the rate the protocol drains it.
+ *
+ * All methods are called with the audio queue lock held.
+ */
+class SendCongestionController {
+public:
+    SendCongestionController(int frame_duration_ms, size_t max_queued_packets);
+
+    void Reset();
+    void OnPacketQueued(size_t bytes, size_t queue_size);
+    void OnPacketSent(size_t bytes, size_t queue_size);
+    void OnPacketDropped() { dropped_packets_++; }
+
+    // Packets allowed to stay in the send queue before the oldest is dropped
+    size_t GetQueueLimit() const;
+    SendCongestionLevel level() const { return level_; }
+    // Uplink bandwidth in bits per second, 0 before the link was saturated
+    uint32_t estimated_bitrate() const { return estimated_bitrate_; }
+    uint32_t dropped_packets() const { return dropped_packets_; }
+
+private:
+    int frame_duration_ms_;
+    size_t max_queued_packets_;
+    SendCongestionLevel level_ = kSendCongestionNone;
+    int64_t window_start_us_ = 0;
+    size_t window_sent_bytes_ = 0;
+    size_t window_queued_bytes_ = 0;
+    int congested_windows_ = 0;
+    uint32_t estimated_bitrate_ = 0;
+    uint32_t dropped_packets_ = 0;
+
+    void UpdateWindow(size_t queue_size);
+};
+
+#endif // SEND_CONGESTION_CONTROLLER_H
@@ -31,20 +31,14 @@ AdcBatteryMonitor::AdcBatteryMonitor(adc_unit_t adc_unit, adc_channel_t adc_chan
     adc_cfg.charging_detect_user_data = this;
     adc_battery_estimation_handle_ = adc_battery_estimation_create(&adc_cfg);
 
-    // Initialize timer
-    esp_timer_create_args_t timer_cfg = {
-        .callback = [](void *arg) {
-            AdcBatteryMonitor *self = (AdcBatteryMonitor *)arg;
-            self->CheckBatteryStatus();
-        },
-        .arg = this,
-        .name = "adc_battery_monitor",
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&timer_cfg, &timer_handle_));
-    ESP_ERROR_CHECK(esp_timer_start_periodic(timer_handle_, 1000000));
+    // Charging state changes are slow, the check may ride on other wakeups
+    timer_ = TimerService::GetInstance().StartPeriodic("adc_battery", 1000, 500, [this]() {
+        CheckBatteryStatus();
+    });
 }
 
 AdcBatteryMonitor::~AdcBatteryMonitor() {
+    timer_.Cancel();
     if (adc_battery_estimation_handle_) {
         ESP_ERROR_CHECK(adc_battery_estimation_destroy(adc_battery_estimation_handle_));
     }
@@ -6,6 +6,8 @@
 #include <adc_battery_estimation.h>
 #include <esp_timer.h>
 
+#include "timer_service.h"
+
 class AdcBatteryMonitor {
 public:
     AdcBatteryMonitor(adc_unit_t adc_unit, adc_channel_t adc_channel, float upper_resistor, float lower_resistor, gpio_num_t charging_pin = GPIO_NUM_NC);
@@ -20,7 +22,7 @@ public:
 private:
     gpio_num_t charging_pin_;
     adc_battery_estimation_handle_t adc_battery_estimation_handle_ = nullptr;
-    esp_timer_handle_t timer_handle_ = nullptr;
+    TimerHandle timer_;
     bool is_charging_ = false;
     std::function<void(bool)> on_charging_status_changed_;
 
@@ -8,25 +8,11 @@
 
 
 Backlight::Backlight() {
-    // 创建背光渐变定时器
-    const esp_timer_create_args_t timer_args = {
-        .callback = [](void* arg) {
-            auto self = static_cast<Backlight*>(arg);
-            self->OnTransitionTimer();
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "backlight_timer",
-        .skip_unhandled_events = true,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &transition_timer_));
 }
 
 Backlight::~Backlight() {
-    if (transition_timer_ != nullptr) {
-        esp_timer_stop(transition_timer_);
-        esp_timer_delete(transition_timer_);
-    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    transition_timer_.Cancel();
 }
 
 void Backlight::RestoreBrightness() {
@@ -48,28 +34,35 @@ void Backlight::SetBrightness(uint8_t brightness, bool permanent) {
         brightness = 100;
     }
 
-    if (brightness_ == brightness) {
-        return;
-    }
-
     if (permanent) {
         Settings settings("display", true);
         settings.SetInt("brightness", brightness);
     }
 
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (brightness_ == brightness) {
+        return;
+    }
+
     target_brightness_ = brightness;
     step_ = (target_brightness_ > brightness_) ? 1 : -1;
 
-    if (transition_timer_ != nullptr) {
-        // 启动定时器，每 5ms 更新一次
-        esp_timer_start_periodic(transition_timer_, 5 * 1000);
-    }
+    // 启动渐变定时器，每 5ms 更新一次，不允许延迟
+    uint32_t generation = ++transition_generation_;
+    transition_timer_ = TimerService::GetInstance().StartPeriodic("backlight", 5, 0, [this, generation]() {
+        OnTransitionTimer(generation);
+    });
     ESP_LOGI(TAG, "Set brightness to %d", brightness);
 }
 
-void Backlight::OnTransitionTimer() {
+void Backlight::OnTransitionTimer(uint32_t generation) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // A newer SetBrightness replaced this timer, don't cancel its successor
+    if (generation != transition_generation_) {
+        return;
+    }
     if (brightness_ == target_brightness_) {
-        esp_timer_stop(transition_timer_);
+        transition_timer_.Cancel();
         return;
     }
 
@@ -77,7 +70,7 @@ void Backlight::OnTransitionTimer() {
     SetBrightnessImpl(brightness_);
 
     if (brightness_ == target_brightness_) {
-        esp_timer_stop(transition_timer_);
+        transition_timer_.Cancel();
     }
 }
 
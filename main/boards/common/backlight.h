@@ -2,10 +2,13 @@
 
 #include <cstdint>
 #include <functional>
+#include <mutex>
 
 #include <driver/gpio.h>
 #include <esp_timer.h>
 
+#include "timer_service.h"
+
 
 class Backlight {
 public:
@@ -17,10 +20,14 @@ public:
     inline uint8_t brightness() const { return brightness_; }
 
 protected:
-    void OnTransitionTimer();
+    void OnTransitionTimer(uint32_t generation);
     virtual void SetBrightnessImpl(uint8_t brightness) = 0;
 
-    esp_timer_handle_t transition_timer_ = nullptr;
+    // SetBrightness runs on the caller's task and the transition on the timer task
+    std::mutex mutex_;
+    TimerHandle transition_timer_;
+    // Identifies the current transition, a replaced timer may still fire once
+    uint32_t transition_generation_ = 0;
     uint8_t brightness_ = 0;
     uint8_t target_brightness_ = 0;
     uint8_t step_ = 1;
@@ -187,6 +187,10 @@ std::string Ml307Board::GetDeviceStatusJson() {
     } else if (csq >= 25 && csq <= 31) {
         cJSON_AddStringToObject(network, "signal", "strong");
     }
+    auto link_stats = Application::GetInstance().GetLinkStats();
+    if (link_stats.duration_ms > 0) {
+        cJSON_AddItemToObject(network, "link", link_stats.ToJson());
+    }
     cJSON_AddItemToObject(root, "network", network);
 
     auto json_str = cJSON_PrintUnformatted(root);
@@ -1,6 +1,7 @@
 #include "power_save_timer.h"
 #include "application.h"
 #include "settings.h"
+#include "persistence_service.h"
 
 #include <esp_log.h>
 
@@ -9,22 +10,10 @@
 
 PowerSaveTimer::PowerSaveTimer(int cpu_max_freq, int seconds_to_sleep, int seconds_to_shutdown)
     : cpu_max_freq_(cpu_max_freq), seconds_to_sleep_(seconds_to_sleep), seconds_to_shutdown_(seconds_to_shutdown) {
-    esp_timer_create_args_t timer_args = {
-        .callback = [](void* arg) {
-            auto self = static_cast<PowerSaveTimer*>(arg);
-            self->PowerSaveCheck();
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "power_save_timer",
-        .skip_unhandled_events = true,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &power_save_timer_));
 }
 
 PowerSaveTimer::~PowerSaveTimer() {
-    esp_timer_stop(power_save_timer_);
-    esp_timer_delete(power_save_timer_);
+    power_save_timer_.Cancel();
 }
 
 void PowerSaveTimer::SetEnabled(bool enabled) {
@@ -37,10 +26,13 @@ void PowerSaveTimer::SetEnabled(bool enabled) {
 
         ticks_ = 0;
         enabled_ = enabled;
-        ESP_ERROR_CHECK(esp_timer_start_periodic(power_save_timer_, 1000000));
+        // Counts seconds of inactivity, a few hundred ms of drift does not matter
+        power_save_timer_ = TimerService::GetInstance().StartPeriodic("power_save", 1000, 500, [this]() {
+            PowerSaveCheck();
+        });
         ESP_LOGI(TAG, "Power save timer enabled");
     } else if (!enabled && enabled_) {
-        ESP_ERROR_CHECK(esp_timer_stop(power_save_timer_));
+        power_save_timer_.Cancel();
         enabled_ = enabled;
         WakeUp();
         ESP_LOGI(TAG, "Power save timer disabled");
@@ -99,6 +91,8 @@ void PowerSaveTimer::PowerSaveCheck() {
         }
     }
     if (seconds_to_shutdown_ != -1 && ticks_ >= seconds_to_shutdown_ && on_shutdown_request_) {
+        // Boards cut the power in the callback
+        PersistenceService::GetInstance().Flush();
         on_shutdown_request_();
     }
 }
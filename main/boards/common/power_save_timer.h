@@ -5,6 +5,8 @@
 #include <esp_timer.h>
 #include <esp_pm.h>
 
+#include "timer_service.h"
+
 class PowerSaveTimer {
 public:
     PowerSaveTimer(int cpu_max_freq, int seconds_to_sleep = 20, int seconds_to_shutdown = -1);
@@ -19,7 +21,7 @@ public:
 private:
     void PowerSaveCheck();
 
-    esp_timer_handle_t power_save_timer_ = nullptr;
+    TimerHandle power_save_timer_;
     bool enabled_ = false;
     bool in_sleep_mode_ = false;
     bool is_wake_word_running_ = false;
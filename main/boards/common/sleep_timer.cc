@@ -3,6 +3,7 @@
 #include "board.h"
 #include "display.h"
 #include "settings.h"
+#include "persistence_service.h"
 
 #include <esp_log.h>
 #include <esp_sleep.h>
@@ -118,6 +119,8 @@ void SleepTimer::CheckTimer() {
             on_enter_deep_sleep_mode_();
         }
 
+        // Deep sleep skips the shutdown handlers
+        PersistenceService::GetInstance().Flush();
         esp_deep_sleep_start();
     }
 }
@@ -250,6 +250,10 @@ std::string WifiBoard::GetDeviceStatusJson() {
     } else {
         cJSON_AddStringToObject(network, "signal", "weak");
     }
+    auto link_stats = Application::GetInstance().GetLinkStats();
+    if (link_stats.duration_ms > 0) {
+        cJSON_AddItemToObject(network, "link", link_stats.ToJson());
+    }
     cJSON_AddItemToObject(root, "network", network);
 
     // Chip
@@ -0,0 +1,81 @@
+#include "channel_prewarm.h"
+#include "board.h"
+#include "learning/user_profile.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "ChannelPrewarm"
+
+// An interaction within this window is a strong sign the user will talk again
+#define PREWARM_RECENT_INTERACTION_MS (5 * 60 * 1000)
+// After a failed or unused pre-warm, wait before trying again
+#define PREWARM_RETRY_INTERVAL_MS (CONFIG_AUDIO_CHANNEL_PREWARM_IDLE_TIMEOUT * 2 * 1000)
+
+bool ChannelPrewarm::ShouldOpen(int input_level, bool has_server_time) {
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (now_ms < retry_after_ms_ || !IsBatteryAllowed()) {
+        return false;
+    }
+
+    auto& profile = xiaozhi::UserProfile::GetInstance();
+    auto& data = profile.GetData();
+    int score = 0;
+
+    int64_t since_interaction_ms = now_ms - data.last_update_ms;
+    if (profile.GetInteractionCount7d() > 0 && since_interaction_ms >= 0 &&
+        since_interaction_ms < PREWARM_RECENT_INTERACTION_MS) {
+        score += 2;
+    }
+
+    if (has_server_time && profile.GetCurrentHourShare() >= 0.5f) {
+        score += 1;
+    }
+
+    if (input_level >= CONFIG_AUDIO_CHANNEL_PREWARM_INPUT_LEVEL) {
+        score += 1;
+    }
+
+    if (score >= 2) {
+        ESP_LOGI(TAG, "Wake is likely (score %d, input level %d), pre-warming channel", score, input_level);
+        return true;
+    }
+    return false;
+}
+
+bool ChannelPrewarm::ShouldClose() {
+    if (!IsWarm()) {
+        return false;
+    }
+    int64_t now_ms = esp_timer_get_time() / 1000;
+    if (now_ms - opened_time_ms_ < CONFIG_AUDIO_CHANNEL_PREWARM_IDLE_TIMEOUT * 1000 && IsBatteryAllowed()) {
+        return false;
+    }
+    ESP_LOGI(TAG, "Pre-warmed channel unused, closing");
+    opened_time_ms_ = 0;
+    retry_after_ms_ = now_ms + PREWARM_RETRY_INTERVAL_MS;
+    return true;
+}
+
+void ChannelPrewarm::OnOpened() {
+    opened_time_ms_ = esp_timer_get_time() / 1000;
+}
+
+void ChannelPrewarm::OnOpenFailed() {
+    opened_time_ms_ = 0;
+    retry_after_ms_ = esp_timer_get_time() / 1000 + PREWARM_RETRY_INTERVAL_MS;
+}
+
+void ChannelPrewarm::OnReleased() {
+    opened_time_ms_ = 0;
+}
+
+bool ChannelPrewarm::IsBatteryAllowed() {
+    int level = 0;
+    bool charging = false, discharging = false;
+    if (!Board::GetInstance().GetBatteryLevel(level, charging, discharging)) {
+        // No battery, always powered
+        return true;
+    }
+    return !discharging || level >= CONFIG_AUDIO_CHANNEL_PREWARM_MIN_BATTERY;
+}
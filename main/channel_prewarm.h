@@ -0,0 +1,37 @@
+#ifndef CHANNEL_PREWARM_H
+#define CHANNEL_PREWARM_H
+
+#include <cstdint>
+
+/*
+ * Decides when to open the audio channel before the wake word is heard,
+ * so the connection and hello round trip are already done on wake.
+ *
+ * Signals, checked once per second while idle:
+ *   - a recent interaction recorded in UserProfile (score 2)
+ *   - the current hour is one of the user's active hours (score 1)
+ *   - the microphone level fed to the wake word engine is high (score 1)
+ * A score of 2 or more opens the channel. Pre-warming is skipped while the
+ * battery is discharging below CONFIG_AUDIO_CHANNEL_PREWARM_MIN_BATTERY, and
+ * an unused channel is closed after CONFIG_AUDIO_CHANNEL_PREWARM_IDLE_TIMEOUT.
+ */
+class ChannelPrewarm {
+public:
+    bool ShouldOpen(int input_level, bool has_server_time);
+    bool ShouldClose();
+
+    void OnOpened();
+    void OnOpenFailed();
+    // The warm channel was taken over by a conversation or closed by the server
+    void OnReleased();
+
+    bool IsWarm() const { return opened_time_ms_ != 0; }
+
+private:
+    int64_t opened_time_ms_ = 0;
+    int64_t retry_after_ms_ = 0;
+
+    bool IsBatteryAllowed();
+};
+
+#endif // CHANNEL_PREWARM_H
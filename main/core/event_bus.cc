@@ -1,7 +1,13 @@
 #include "event_bus.h"
 #include <esp_log.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+#include <freertos/task.h>
 #include <cstring>
 
+#include "event_journal.h"
+#include "timer_service.h"
+
 namespace xiaozhi {
 
 static const char* TAG = "EventBus";
@@ -16,6 +22,150 @@ ESP_EVENT_DEFINE_BASE(LOGIC_EVENT);
 ESP_EVENT_DEFINE_BASE(CLOUD_EVENT);
 ESP_EVENT_DEFINE_BASE(LEARNING_EVENT);
 
+// 类型化事件在 esp_event 中只传递这个小消息，数据留在池中
+static esp_event_base_t const TYPED_EVENT = "TYPED_EVENT";
+
+struct TypedEventMessage {
+  esp_event_base_t base;
+  int32_t id;
+  EventPayloadBlock* block;        // 无数据事件为 nullptr
+  void* policy;                    // EventBus::PolicyEntry，没有配置策略时为 nullptr
+};
+
+// 基准测试用的私有事件域，不会被其他订阅者收到
+static esp_event_base_t const BENCHMARK_EVENT = "BENCHMARK_EVENT";
+
+// 有类型化描述符的事件只通过类型化接口发布，原始订阅收不到
+template <typename... Events>
+static bool IsTypedEvent(esp_event_base_t base, int32_t id) {
+  return ((base == *Events::kBase && id == Events::kId) || ...);
+}
+
+static void WarnIfTypedEvent(esp_event_base_t base, int32_t id) {
+  if (IsTypedEvent<PetStateChangedEvent, ConversationEndEvent, EmotionSetEvent,
+                   WakeChannelReadyEvent, LinkStatsEvent, TimeSyncedEvent,
+                   ProfileUpdatedEvent>(base, id)) {
+    ESP_LOGW(TAG, "%s:%ld is only published as a typed event, use Subscribe<Event>()",
+             base, (long)id);
+  }
+}
+
+// 日志中的事件编号：事件域序号 << 8 | 事件ID
+static uint16_t JournalKey(esp_event_base_t base, int32_t id) {
+  static const esp_event_base_t* const kBases[] = {
+      &PET_EVENT, &EMO_EVENT, &LOGIC_EVENT, &CLOUD_EVENT, &LEARNING_EVENT,
+  };
+  uint16_t index = 0;
+  for (size_t i = 0; i < sizeof(kBases) / sizeof(kBases[0]); i++) {
+    if (*kBases[i] == base) {
+      index = i + 1;
+      break;
+    }
+  }
+  return index << 8 | (id & 0xff);
+}
+
+// 单个事件一次最多投递的订阅者数量
+#define EVENT_MAX_SUBSCRIBERS_PER_EVENT 8
+
+// C++风格订阅的 wrapper，由总线持有，Destroy 时释放
+struct EventBus::RawHandler {
+  std::function<void(void*)> func;
+  esp_event_base_t base;
+  int32_t id;
+  esp_event_handler_instance_t instance;
+};
+
+// 订阅者独立投递队列中的条目
+struct DeliveryItem {
+  EventPayloadBlock* block;
+  bool stop;
+};
+
+// 正在执行处理函数的任务，退订时等它执行完
+struct HandlerGuard {
+  std::atomic<bool> active = true;
+  std::atomic<TaskHandle_t> running = nullptr;
+
+  // 先标记正在执行再检查 active，与 Deactivate 的顺序相反，两边不会错过对方
+  bool Enter() {
+    running.store(xTaskGetCurrentTaskHandle());
+    if (!active.load()) {
+      running.store(nullptr);
+      return false;
+    }
+    return true;
+  }
+
+  void Exit() { running.store(nullptr, std::memory_order_release); }
+
+  // 在处理函数自己的任务中退订时不等待，否则会等自己
+  void Deactivate() {
+    active.store(false);
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    for (;;) {
+      TaskHandle_t task = running.load();
+      if (task == nullptr || task == self) {
+        break;
+      }
+      vTaskDelay(1);
+    }
+  }
+};
+
+struct EventBus::DeliveryWorker {
+  QueueHandle_t queue = nullptr;
+  std::function<void(const void*)> handler;
+  HandlerGuard guard;
+  std::atomic<bool> stop = false;  // 退出条目放不进满队列时的退出标记
+};
+
+// 工作任务等待条目的最长时间，之后检查退出标记
+#define EVENT_WORKER_POLL_MS 1000
+
+struct EventBus::Subscriber {
+  uint32_t id;
+  esp_event_base_t base;
+  int32_t event_id;
+  std::function<void(const void*)> handler;  // 在 event_bus 任务中直接调用
+  DeliveryWorker* worker = nullptr;          // 独立队列，由其任务释放
+  HandlerGuard guard;
+
+  ~Subscriber() {
+    // 最后一个引用释放后不会再有投递，通知工作任务退出。
+    // 不能阻塞：释放最后一个引用的可能是 event_bus 任务。队列满时设置退出标记，
+    // 之后不再访问 worker（工作任务看到标记后会释放它）
+    if (worker != nullptr) {
+      DeliveryItem item = {nullptr, true};
+      if (xQueueSend(worker->queue, &item, 0) != pdTRUE) {
+        worker->stop.store(true, std::memory_order_release);
+      }
+    }
+  }
+};
+
+struct EventBus::PolicyEntry {
+  esp_event_base_t base;
+  int32_t id;
+  DeliveryPolicy policy;
+
+  // 以下字段由 policies_mutex_ 保护
+  size_t size = 0;
+  bool pending = false;                        // latest_wins：已投递、尚未分发
+  EventPayloadBlock* pending_block = nullptr;
+  int64_t last_post_us = 0;
+  bool trailing = false;                       // 最小间隔内暂存的最后一个值
+  uint8_t trailing_data[EVENT_PAYLOAD_MAX_SIZE];
+  TimerHandle trailing_timer;
+
+  uint32_t published = 0;
+  uint32_t posted = 0;
+  uint32_t coalesced = 0;
+  uint32_t debounced = 0;
+  std::atomic<uint32_t> dropped_oldest = 0;
+  uint32_t dropped = 0;
+};
+
 // ============================================================================
 // EventBus 实现
 // ============================================================================
@@ -25,6 +175,10 @@ EventBus& EventBus::GetInstance() {
   return instance;
 }
 
+EventBus::~EventBus() {
+  Destroy();
+}
+
 esp_err_t EventBus::Initialize() {
   if (initialized_) {
     ESP_LOGW(TAG, "EventBus already initialized");
@@ -46,8 +200,18 @@ esp_err_t EventBus::Initialize() {
     return ret;
   }
 
+  ret = esp_event_handler_instance_register_with(
+      event_loop_, TYPED_EVENT, ESP_EVENT_ANY_ID, DispatchTyped, this, nullptr);
+  if (ret != ESP_OK) {
+    ESP_LOGE(TAG, "Failed to register typed dispatcher: %s",
+             esp_err_to_name(ret));
+    esp_event_loop_delete(event_loop_);
+    event_loop_ = nullptr;
+    return ret;
+  }
+
   initialized_ = true;
-  stats_ = {0};
+  ResetStats();
   
   ESP_LOGI(TAG, "EventBus initialized successfully");
   ESP_LOGI(TAG, "  - Queue size: %d", loop_args.queue_size);
@@ -62,10 +226,28 @@ void EventBus::Destroy() {
     return;
   }
 
+  {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    for (auto& raw : raw_handlers_) {
+      esp_event_handler_instance_unregister_with(
+          event_loop_, raw->base, raw->id, raw->instance);
+    }
+    subscribers_.clear();
+  }
+  {
+    std::lock_guard<std::mutex> lock(policies_mutex_);
+    for (auto& entry : policies_) {
+      entry->trailing = false;
+      entry->trailing_timer.Cancel();
+    }
+  }
+
   if (event_loop_) {
     esp_event_loop_delete(event_loop_);
     event_loop_ = nullptr;
   }
+  // 事件循环已删除，之后不会再有回调使用这些 wrapper
+  raw_handlers_.clear();
 
   initialized_ = false;
   ESP_LOGI(TAG, "EventBus destroyed");
@@ -73,19 +255,6 @@ void EventBus::Destroy() {
 
 // ========== 订阅事件 ==========
 
-// C++风格订阅（使用lambda）
-struct HandlerWrapper {
-  std::function<void(void*)> func;
-};
-
-static void cpp_handler_wrapper(void* arg, esp_event_base_t base, 
-                                 int32_t id, void* event_data) {
-  auto* wrapper = static_cast<HandlerWrapper*>(arg);
-  if (wrapper && wrapper->func) {
-    wrapper->func(event_data);
-  }
-}
-
 esp_err_t EventBus::Subscribe(
     esp_event_base_t event_base,
     int32_t event_id,
@@ -95,24 +264,34 @@ esp_err_t EventBus::Subscribe(
     ESP_LOGE(TAG, "EventBus not initialized");
     return ESP_ERR_INVALID_STATE;
   }
+  WarnIfTypedEvent(event_base, event_id);
 
-  // 创建wrapper（注意：需要手动管理内存，或者使用智能指针）
-  auto* wrapper = new HandlerWrapper{handler};
+  auto wrapper = std::make_unique<RawHandler>();
+  wrapper->func = std::move(handler);
+  wrapper->base = event_base;
+  wrapper->id = event_id;
 
   esp_err_t ret = esp_event_handler_instance_register_with(
       event_loop_,
       event_base,
       event_id,
-      cpp_handler_wrapper,
-      wrapper,
-      nullptr
+      [](void* arg, esp_event_base_t, int32_t, void* event_data) {
+        auto* wrapper = static_cast<RawHandler*>(arg);
+        if (wrapper->func) {
+          wrapper->func(event_data);
+        }
+      },
+      wrapper.get(),
+      &wrapper->instance
   );
 
   if (ret != ESP_OK) {
-    delete wrapper;
     ESP_LOGE(TAG, "Failed to subscribe: %s", esp_err_to_name(ret));
+    return ret;
   }
 
+  std::lock_guard<std::mutex> lock(subscribers_mutex_);
+  raw_handlers_.push_back(std::move(wrapper));
   return ret;
 }
 
@@ -127,6 +306,7 @@ esp_err_t EventBus::Subscribe(
     ESP_LOGE(TAG, "EventBus not initialized");
     return ESP_ERR_INVALID_STATE;
   }
+  WarnIfTypedEvent(event_base, event_id);
 
   esp_err_t ret = esp_event_handler_instance_register_with(
       event_loop_,
@@ -166,13 +346,10 @@ esp_err_t EventBus::Publish(
       portMAX_DELAY  // 阻塞等待
   );
 
-  if (ret == ESP_OK) {
-    stats_.total_published++;
-  } else if (ret == ESP_ERR_TIMEOUT) {
-    stats_.queue_overflow_count++;
-    stats_.total_dropped++;
+  OnCounted(ret, event_base, event_id);
+  if (ret == ESP_ERR_TIMEOUT) {
     ESP_LOGW(TAG, "Event queue full, event dropped");
-  } else {
+  } else if (ret != ESP_OK) {
     ESP_LOGE(TAG, "Failed to publish event: %s", esp_err_to_name(ret));
   }
 
@@ -198,13 +375,7 @@ esp_err_t EventBus::PublishNonBlocking(
       0  // 非阻塞
   );
 
-  if (ret == ESP_OK) {
-    stats_.total_published++;
-  } else if (ret == ESP_ERR_TIMEOUT) {
-    stats_.queue_overflow_count++;
-    stats_.total_dropped++;
-  }
-
+  OnCounted(ret, event_base, event_id);
   return ret;
 }
 
@@ -229,19 +400,602 @@ esp_err_t EventBus::PublishFromISR(
   );
 
   if (ret == ESP_OK) {
-    stats_.total_published++;
+    total_published_.fetch_add(1, std::memory_order_relaxed);
     if (task_woken == pdTRUE) {
       portYIELD_FROM_ISR();
     }
   } else {
-    stats_.total_dropped++;
+    total_dropped_.fetch_add(1, std::memory_order_relaxed);
   }
 
   return ret;
 }
 
+void EventBus::OnCounted(esp_err_t ret, esp_event_base_t base, int32_t id) {
+  if (ret == ESP_OK) {
+    total_published_.fetch_add(1, std::memory_order_relaxed);
+  } else if (ret == ESP_ERR_TIMEOUT) {
+    queue_overflow_count_.fetch_add(1, std::memory_order_relaxed);
+    total_dropped_.fetch_add(1, std::memory_order_relaxed);
+    EventJournal::GetInstance().Record(kJournalQueueOverflow,
+                                       kJournalQueueEventLoop,
+                                       JournalKey(base, id));
+  }
+}
+
+void EventBus::OnPoolExhausted(esp_event_base_t base, int32_t id) {
+  pool_exhausted_.fetch_add(1, std::memory_order_relaxed);
+  total_dropped_.fetch_add(1, std::memory_order_relaxed);
+  EventJournal::GetInstance().Record(kJournalQueueOverflow,
+                                     kJournalQueuePayloadPool,
+                                     JournalKey(base, id));
+  ESP_LOGW(TAG, "Event payload pool exhausted, event dropped");
+}
+
+EventBus::EventStats EventBus::GetStats() const {
+  return {
+      .total_published = total_published_.load(std::memory_order_relaxed),
+      .total_dropped = total_dropped_.load(std::memory_order_relaxed),
+      .queue_overflow_count =
+          queue_overflow_count_.load(std::memory_order_relaxed),
+      .typed_delivered = typed_delivered_.load(std::memory_order_relaxed),
+      .pool_exhausted = pool_exhausted_.load(std::memory_order_relaxed),
+      .subscriber_dropped = subscriber_dropped_.load(std::memory_order_relaxed),
+  };
+}
+
 void EventBus::ResetStats() {
-  stats_ = {0};
+  total_published_ = 0;
+  total_dropped_ = 0;
+  queue_overflow_count_ = 0;
+  typed_delivered_ = 0;
+  pool_exhausted_ = 0;
+  subscriber_dropped_ = 0;
+}
+
+// ========== 类型化事件 ==========
+
+esp_err_t EventBus::PublishTyped(esp_event_base_t base, int32_t id,
+                                 const void* data, size_t size,
+                                 TickType_t timeout) {
+  if (!initialized_) {
+    return ESP_ERR_INVALID_STATE;
+  }
+
+  PolicyEntry* entry = FindPolicy(base, id);
+  if (entry != nullptr) {
+    return PublishWithPolicy(entry, data, size, false);
+  }
+
+  EventPayloadBlock* block = nullptr;
+  if (size > 0) {
+    block = pool_.Allocate();
+    if (block == nullptr) {
+      OnPoolExhausted(base, id);
+      return ESP_ERR_NO_MEM;
+    }
+    memcpy(block->data, data, size);
+  }
+  return PostTyped(base, id, block, nullptr, timeout);
+}
+
+esp_err_t EventBus::PostTyped(esp_event_base_t base, int32_t id,
+                              EventPayloadBlock* block, PolicyEntry* entry,
+                              TickType_t timeout) {
+  TypedEventMessage message = {base, id, block, entry};
+  esp_err_t ret = esp_event_post_to(event_loop_, TYPED_EVENT, 0, &message,
+                                    sizeof(message), timeout);
+  OnCounted(ret, base, id);
+  // 带策略的投递失败时由 PublishWithPolicy 在解除 pending 之后释放
+  if (ret != ESP_OK && entry == nullptr) {
+    pool_.Release(block);
+  }
+  return ret;
+}
+
+// ========== 投递策略 ==========
+
+void EventBus::SetDeliveryPolicy(esp_event_base_t base, int32_t id,
+                                 const DeliveryPolicy& policy) {
+  std::lock_guard<std::mutex> lock(policies_mutex_);
+  for (auto& entry : policies_) {
+    if (entry->base == base && entry->id == id) {
+      entry->policy = policy;
+      return;
+    }
+  }
+  auto entry = std::make_unique<PolicyEntry>();
+  entry->base = base;
+  entry->id = id;
+  entry->policy = policy;
+  policies_.push_back(std::move(entry));
+}
+
+EventBus::PolicyEntry* EventBus::FindPolicy(esp_event_base_t base,
+                                            int32_t id) {
+  std::lock_guard<std::mutex> lock(policies_mutex_);
+  for (auto& entry : policies_) {
+    if (entry->base == base && entry->id == id) {
+      return entry.get();
+    }
+  }
+  return nullptr;
+}
+
+esp_err_t EventBus::PublishWithPolicy(PolicyEntry* entry, const void* data,
+                                      size_t size, bool trailing_due) {
+  std::unique_lock<std::mutex> lock(policies_mutex_);
+  const auto& policy = entry->policy;
+  int64_t now_us = esp_timer_get_time();
+  entry->size = size;
+  if (!trailing_due) {
+    entry->published++;
+  }
+
+  // 上一条还在队列里：直接改写它的数据，订阅者只会看到最新值
+  if (policy.latest_wins && entry->pending) {
+    if (size > 0) {
+      memcpy(entry->pending_block->data, data, size);
+    }
+    entry->coalesced++;
+    return ESP_OK;
+  }
+
+  // 最小间隔内：只保留最后一个值，间隔到期时由定时器投递
+  if (!trailing_due && policy.min_interval_ms > 0 &&
+      entry->last_post_us != 0) {
+    int64_t next_us =
+        entry->last_post_us + (int64_t)policy.min_interval_ms * 1000;
+    if (now_us < next_us) {
+      if (size > 0) {
+        memcpy(entry->trailing_data, data, size);
+      }
+      if (entry->trailing) {
+        entry->debounced++;
+      } else {
+        entry->trailing = true;
+        uint32_t delay_ms = (next_us - now_us + 999) / 1000;
+        entry->trailing_timer = TimerService::GetInstance().StartOnce(
+            "event_debounce", delay_ms, 0,
+            [this, entry]() { FlushTrailing(entry); });
+      }
+      return ESP_OK;
+    }
+  }
+
+  EventPayloadBlock* block = nullptr;
+  if (size > 0) {
+    block = pool_.Allocate();
+    if (block == nullptr) {
+      entry->dropped++;
+      OnPoolExhausted(entry->base, entry->id);
+      return ESP_ERR_NO_MEM;
+    }
+    memcpy(block->data, data, size);
+  }
+  if (policy.latest_wins) {
+    entry->pending = true;
+    entry->pending_block = block;
+  }
+  // 这次直接投递的值比暂存的新：丢弃暂存值，否则定时器稍后会用旧值覆盖它
+  if (entry->trailing) {
+    entry->trailing = false;
+    entry->debounced++;
+  }
+  entry->trailing_timer.Cancel();
+  entry->last_post_us = now_us;
+  entry->posted++;
+  // 事件循环队列不支持撤回已投递的事件，kDropOldest 在这里等同于 kDropNewest
+  TickType_t timeout =
+      policy.overflow == EventOverflow::kBlock ? portMAX_DELAY : 0;
+  lock.unlock();
+
+  esp_err_t ret = PostTyped(entry->base, entry->id, block, entry, timeout);
+  if (ret != ESP_OK) {
+    // 先在锁内解除 pending，再释放数据块：否则并发的 latest_wins 发布会写入已释放的块
+    lock.lock();
+    if (entry->pending && entry->pending_block == block) {
+      entry->pending = false;
+      entry->pending_block = nullptr;
+    }
+    entry->posted--;
+    entry->dropped++;
+    lock.unlock();
+    pool_.Release(block);
+  }
+  return ret;
+}
+
+void EventBus::FlushTrailing(PolicyEntry* entry) {
+  uint8_t data[EVENT_PAYLOAD_MAX_SIZE];
+  size_t size;
+  {
+    std::lock_guard<std::mutex> lock(policies_mutex_);
+    if (!initialized_ || !entry->trailing) {
+      return;
+    }
+    entry->trailing = false;
+    size = entry->size;
+    memcpy(data, entry->trailing_data, size);
+  }
+  PublishWithPolicy(entry, data, size, true);
+}
+
+std::vector<DeliveryPolicyStats> EventBus::GetPolicyStats() {
+  std::lock_guard<std::mutex> lock(policies_mutex_);
+  std::vector<DeliveryPolicyStats> result;
+  result.reserve(policies_.size());
+  for (auto& entry : policies_) {
+    result.push_back({
+        .base = entry->base,
+        .id = entry->id,
+        .policy = entry->policy,
+        .published = entry->published,
+        .posted = entry->posted,
+        .coalesced = entry->coalesced,
+        .debounced = entry->debounced,
+        .dropped_oldest = entry->dropped_oldest.load(std::memory_order_relaxed),
+        .dropped = entry->dropped,
+    });
+  }
+  return result;
+}
+
+std::string EventBus::GetStatusJson() {
+  static const char* const kOverflowNames[] = {"drop_newest", "drop_oldest",
+                                               "block"};
+  auto stats = GetStats();
+  std::string json = "{\"published\":" + std::to_string(stats.total_published);
+  json += ",\"dropped\":" + std::to_string(stats.total_dropped);
+  json += ",\"queue_overflow\":" + std::to_string(stats.queue_overflow_count);
+  json += ",\"typed_delivered\":" + std::to_string(stats.typed_delivered);
+  json += ",\"pool_exhausted\":" + std::to_string(stats.pool_exhausted);
+  json += ",\"subscriber_dropped\":" +
+          std::to_string(stats.subscriber_dropped);
+  json += ",\"policies\":[";
+  bool first = true;
+  for (auto& policy : GetPolicyStats()) {
+    if (!first) {
+      json += ",";
+    }
+    first = false;
+    json += "{\"event\":\"" + std::string(policy.base) + ":" +
+            std::to_string(policy.id) + "\"";
+    json += ",\"latest_wins\":";
+    json += policy.policy.latest_wins ? "true" : "false";
+    json += ",\"min_interval_ms\":" +
+            std::to_string(policy.policy.min_interval_ms);
+    json += ",\"overflow\":\"";
+    json += kOverflowNames[(int)policy.policy.overflow];
+    json += "\",\"published\":" + std::to_string(policy.published);
+    json += ",\"posted\":" + std::to_string(policy.posted);
+    json += ",\"coalesced\":" + std::to_string(policy.coalesced);
+    json += ",\"debounced\":" + std::to_string(policy.debounced);
+    json += ",\"dropped_oldest\":" + std::to_string(policy.dropped_oldest);
+    json += ",\"dropped\":" + std::to_string(policy.dropped) + "}";
+  }
+  json += "]}";
+  return json;
+}
+
+// ========== 基准测试 ==========
+
+namespace {
+
+// 同时在途的事件数：只占用一半数据池和少量事件队列，不影响真实事件
+constexpr int kBenchmarkWindow = EVENT_PAYLOAD_POOL_SIZE / 2;
+
+struct BenchmarkPayload {
+  int64_t publish_us;
+  uint8_t padding[56];
+};
+
+struct BenchmarkResult {
+  SemaphoreHandle_t window;
+  std::atomic<uint32_t> received = 0;
+  std::atomic<int64_t> total_latency_us = 0;
+  std::atomic<int64_t> max_latency_us = 0;
+  int64_t elapsed_us = 0;
+  uint32_t failed = 0;
+
+  BenchmarkResult()
+      : window(xSemaphoreCreateCounting(kBenchmarkWindow, kBenchmarkWindow)) {}
+  ~BenchmarkResult() { vSemaphoreDelete(window); }
+
+  void OnReceived(const BenchmarkPayload& payload) {
+    int64_t latency = esp_timer_get_time() - payload.publish_us;
+    total_latency_us.fetch_add(latency, std::memory_order_relaxed);
+    int64_t max = max_latency_us.load(std::memory_order_relaxed);
+    while (latency > max &&
+           !max_latency_us.compare_exchange_weak(max, latency,
+                                                 std::memory_order_relaxed)) {
+    }
+    received.fetch_add(1, std::memory_order_relaxed);
+    xSemaphoreGive(window);
+  }
+
+  // 等待已发布的事件全部处理完，最多 1 秒
+  void WaitDelivered(uint32_t expected, int64_t start_us) {
+    for (int i = 0; i < 1000 && received.load() < expected; i++) {
+      vTaskDelay(pdMS_TO_TICKS(1));
+    }
+    elapsed_us = esp_timer_get_time() - start_us;
+  }
+
+  void AppendJson(std::string& json, const char* name) const {
+    uint32_t count = received.load();
+    json += "\"" + std::string(name) + "\":{\"received\":" +
+            std::to_string(count);
+    json += ",\"failed\":" + std::to_string(failed);
+    json += ",\"elapsed_us\":" + std::to_string(elapsed_us);
+    json += ",\"events_per_s\":" +
+            std::to_string(elapsed_us > 0 ? count * 1000000LL / elapsed_us : 0);
+    json += ",\"avg_latency_us\":" +
+            std::to_string(count > 0 ? total_latency_us.load() / count : 0);
+    json += ",\"max_latency_us\":" + std::to_string(max_latency_us.load());
+    json += "}";
+  }
+};
+
+}  // namespace
+
+std::string EventBus::RunBenchmarkJson(int count) {
+  if (!initialized_) {
+    return "{\"error\":\"EventBus not initialized\"}";
+  }
+  BenchmarkPayload payload = {};
+
+  // 原始发布：esp_event 在投递时拷贝整个数据
+  BenchmarkResult raw;
+  esp_event_handler_instance_t instance = nullptr;
+  esp_event_handler_instance_register_with(
+      event_loop_, BENCHMARK_EVENT, 0,
+      [](void* arg, esp_event_base_t, int32_t, void* data) {
+        static_cast<BenchmarkResult*>(arg)->OnReceived(
+            *static_cast<BenchmarkPayload*>(data));
+      },
+      &raw, &instance);
+  int64_t start_us = esp_timer_get_time();
+  for (int i = 0; i < count; i++) {
+    xSemaphoreTake(raw.window, portMAX_DELAY);
+    payload.publish_us = esp_timer_get_time();
+    if (esp_event_post_to(event_loop_, BENCHMARK_EVENT, 0, &payload,
+                          sizeof(payload), portMAX_DELAY) != ESP_OK) {
+      raw.failed++;
+      xSemaphoreGive(raw.window);
+    }
+  }
+  raw.WaitDelivered(count - raw.failed, start_us);
+  esp_event_handler_instance_unregister_with(event_loop_, BENCHMARK_EVENT, 0,
+                                             instance);
+
+  // 类型化发布：拷贝一次到数据池，只投递小消息
+  BenchmarkResult typed;
+  {
+    auto subscription = SubscribeTyped(
+        BENCHMARK_EVENT, 1,
+        [&typed](const void* data) {
+          typed.OnReceived(*static_cast<const BenchmarkPayload*>(data));
+        },
+        SubscribeOptions());
+    start_us = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+      xSemaphoreTake(typed.window, portMAX_DELAY);
+      payload.publish_us = esp_timer_get_time();
+      if (PublishTyped(BENCHMARK_EVENT, 1, &payload, sizeof(payload),
+                       portMAX_DELAY) != ESP_OK) {
+        typed.failed++;
+        xSemaphoreGive(typed.window);
+      }
+    }
+    typed.WaitDelivered(count - typed.failed, start_us);
+  }
+
+  std::string json = "{\"events\":" + std::to_string(count);
+  json += ",\"payload_bytes\":" + std::to_string(sizeof(BenchmarkPayload)) + ",";
+  raw.AppendJson(json, "raw");
+  json += ",";
+  typed.AppendJson(json, "typed");
+  json += "}";
+  return json;
+}
+
+void EventBus::DispatchTyped(void* arg, esp_event_base_t, int32_t,
+                             void* event_data) {
+  auto* bus = static_cast<EventBus*>(arg);
+  auto& message = *static_cast<TypedEventMessage*>(event_data);
+  auto* policy = static_cast<PolicyEntry*>(message.policy);
+  EventOverflow overflow = EventOverflow::kDropNewest;
+  if (policy != nullptr) {
+    // 开始分发后不能再改写数据，之后的发布重新入队
+    std::lock_guard<std::mutex> lock(bus->policies_mutex_);
+    if (policy->pending && policy->pending_block == message.block) {
+      policy->pending = false;
+      policy->pending_block = nullptr;
+    }
+    overflow = policy->policy.overflow;
+  }
+  // 认领之后数据不会再被 latest_wins 发布改写，这时才能读
+  uint32_t head = 0;
+  if (message.block != nullptr) {
+    memcpy(&head, message.block->data, sizeof(head));
+  }
+  if (message.base != BENCHMARK_EVENT) {
+    EventJournal::GetInstance().Record(
+        kJournalEvent, JournalKey(message.base, message.id), head);
+  }
+
+  std::shared_ptr<Subscriber> matches[EVENT_MAX_SUBSCRIBERS_PER_EVENT];
+  int count = 0;
+  {
+    std::lock_guard<std::mutex> lock(bus->subscribers_mutex_);
+    for (auto& subscriber : bus->subscribers_) {
+      if (subscriber->base != message.base ||
+          subscriber->event_id != message.id) {
+        continue;
+      }
+      if (count == EVENT_MAX_SUBSCRIBERS_PER_EVENT) {
+        ESP_LOGW(TAG, "Too many subscribers for %s:%ld", message.base,
+                 message.id);
+        break;
+      }
+      matches[count++] = subscriber;
+    }
+  }
+
+  const void* payload = message.block ? message.block->data : nullptr;
+  for (int i = 0; i < count; i++) {
+    auto& subscriber = matches[i];
+    if (subscriber->worker == nullptr) {
+      if (!subscriber->guard.Enter()) {
+        continue;
+      }
+      subscriber->handler(payload);
+      subscriber->guard.Exit();
+      bus->typed_delivered_.fetch_add(1, std::memory_order_relaxed);
+      continue;
+    }
+    if (!subscriber->guard.active.load(std::memory_order_acquire)) {
+      continue;
+    }
+    EventPayloadPool::Retain(message.block);
+    DeliveryItem item = {message.block, false};
+    QueueHandle_t queue = subscriber->worker->queue;
+    BaseType_t sent;
+    if (overflow == EventOverflow::kBlock) {
+      sent = xQueueSend(queue, &item, portMAX_DELAY);
+    } else {
+      sent = xQueueSend(queue, &item, 0);
+      DeliveryItem oldest;
+      if (sent != pdTRUE && overflow == EventOverflow::kDropOldest &&
+          xQueueReceive(queue, &oldest, 0) == pdTRUE) {
+        // 订阅者还持有引用，队列里不会有退出标记
+        bus->pool_.Release(oldest.block);
+        policy->dropped_oldest.fetch_add(1, std::memory_order_relaxed);
+        sent = xQueueSend(queue, &item, 0);
+      }
+    }
+    if (sent == pdTRUE) {
+      bus->typed_delivered_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      bus->subscriber_dropped_.fetch_add(1, std::memory_order_relaxed);
+      EventJournal::GetInstance().Record(kJournalQueueOverflow,
+                                         kJournalQueueSubscriber,
+                                         JournalKey(message.base, message.id));
+      bus->pool_.Release(message.block);
+    }
+  }
+
+  // 发布者持有的引用
+  bus->pool_.Release(message.block);
+}
+
+EventSubscription EventBus::SubscribeTyped(
+    esp_event_base_t base, int32_t id,
+    std::function<void(const void*)> handler,
+    const SubscribeOptions& options) {
+  if (!initialized_) {
+    ESP_LOGE(TAG, "EventBus not initialized");
+    return EventSubscription();
+  }
+
+  auto subscriber = std::make_shared<Subscriber>();
+  subscriber->base = base;
+  subscriber->event_id = id;
+  if (options.dedicated_queue) {
+    auto* worker = new DeliveryWorker();
+    worker->handler = std::move(handler);
+    worker->queue = xQueueCreate(options.queue_length, sizeof(DeliveryItem));
+    if (worker->queue == nullptr) {
+      delete worker;
+      ESP_LOGE(TAG, "Failed to create delivery queue");
+      return EventSubscription();
+    }
+    BaseType_t created = xTaskCreate(
+        [](void* arg) {
+          auto* worker = static_cast<DeliveryWorker*>(arg);
+          auto& bus = EventBus::GetInstance();
+          DeliveryItem item;
+          while (!worker->stop.load(std::memory_order_acquire)) {
+            if (xQueueReceive(worker->queue, &item,
+                              pdMS_TO_TICKS(EVENT_WORKER_POLL_MS)) != pdTRUE) {
+              continue;
+            }
+            if (item.stop) {
+              break;
+            }
+            if (worker->guard.Enter()) {
+              worker->handler(item.block ? item.block->data : nullptr);
+              worker->guard.Exit();
+            }
+            bus.pool_.Release(item.block);
+          }
+          // 按退出标记退出时队列里可能还有条目
+          while (xQueueReceive(worker->queue, &item, 0) == pdTRUE) {
+            if (!item.stop) {
+              bus.pool_.Release(item.block);
+            }
+          }
+          vQueueDelete(worker->queue);
+          delete worker;
+          vTaskDelete(NULL);
+        },
+        options.task_name, options.task_stack_size, worker,
+        options.task_priority, nullptr);
+    if (created != pdPASS) {
+      vQueueDelete(worker->queue);
+      delete worker;
+      ESP_LOGE(TAG, "Failed to create delivery task");
+      return EventSubscription();
+    }
+    subscriber->worker = worker;
+  } else {
+    subscriber->handler = std::move(handler);
+  }
+
+  std::lock_guard<std::mutex> lock(subscribers_mutex_);
+  subscriber->id = next_subscriber_id_++;
+  subscribers_.push_back(subscriber);
+  return EventSubscription(subscriber->id);
+}
+
+void EventBus::Unsubscribe(uint32_t id) {
+  std::shared_ptr<Subscriber> removed;
+  {
+    std::lock_guard<std::mutex> lock(subscribers_mutex_);
+    for (auto it = subscribers_.begin(); it != subscribers_.end(); ++it) {
+      if ((*it)->id == id) {
+        removed = std::move(*it);
+        subscribers_.erase(it);
+        break;
+      }
+    }
+  }
+  if (!removed) {
+    return;
+  }
+  // 返回后处理函数不会再被调用，它捕获的对象可以安全销毁
+  removed->guard.Deactivate();
+  if (removed->worker != nullptr) {
+    removed->worker->guard.Deactivate();
+  }
+}
+
+EventSubscription& EventSubscription::operator=(
+    EventSubscription&& other) noexcept {
+  if (this != &other) {
+    Unsubscribe();
+    id_ = other.id_;
+    other.id_ = 0;
+  }
+  return *this;
+}
+
+void EventSubscription::Unsubscribe() {
+  if (id_ != 0) {
+    EventBus::GetInstance().Unsubscribe(id_);
+    id_ = 0;
+  }
 }
 
 }  // namespace xiaozhi
@@ -2,8 +2,17 @@
 
 #include <esp_event.h>
 #include <esp_err.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <atomic>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <type_traits>
+#include <vector>
+
+#include "event_payload_pool.h"
 
 namespace xiaozhi {
 
@@ -58,6 +67,7 @@ enum LogicEventId {
   LOGIC_CONVERSATION_END,     // 对话结束
   LOGIC_INTENT_PARSED,        // 意图解析完成
   LOGIC_USER_FEEDBACK,        // 用户反馈（点赞/点踩）
+  LOGIC_WAKE_CHANNEL_READY,   // 唤醒后音频通道就绪（携带时延）
 };
 
 // 云端事件ID
@@ -67,6 +77,8 @@ enum CloudEventId {
   CLOUD_CMD_RECEIVED,         // 收到云端指令
   CLOUD_REPLY_SENT,           // 发送回复成功
   CLOUD_ERROR,                // 云端通讯错误
+  CLOUD_LINK_STATS,           // 链路质量统计（会话中每10秒及会话结束时）
+  CLOUD_TIME_SYNCED,          // 已按服务器时间校准系统时钟
 };
 
 // 学习事件ID
@@ -105,6 +117,122 @@ struct UserFeedbackData {
   char context[32];  // 反馈上下文
 };
 
+// 唤醒时延事件数据
+struct WakeLatencyEventData {
+  uint32_t latency_ms;  // 唤醒到收到服务器 hello 的时间（毫秒）
+  bool prewarmed;       // 唤醒时音频通道是否已预热
+};
+
+// 链路质量事件数据
+struct LinkStatsEventData {
+  uint32_t rtt_ms;            // hello 往返时延
+  uint32_t jitter_ms;         // 下行音频到达抖动（RFC 3550）
+  uint32_t loss_permille;     // 丢包率（千分比）
+  uint32_t reorder_permille;  // 乱序率（千分比）
+  uint32_t rx_kbps;           // 会话平均下行吞吐
+  uint32_t tx_kbps;           // 会话平均上行吞吐
+  bool session_end;           // 是否为会话结束时的汇总
+};
+
+// ============================================================================
+// 类型化事件描述符（编译期绑定 事件域 + 事件ID + 数据类型）
+// ============================================================================
+//
+// 下面这些事件只通过类型化接口发布，必须用 Subscribe<Event>() 订阅；
+// 原始的 Subscribe(base, id, ...) 收不到它们（订阅时会打印警告）。
+
+template <const esp_event_base_t* Base, int32_t Id, typename Payload = void>
+struct EventDescriptor {
+  using PayloadType = Payload;
+  static constexpr const esp_event_base_t* kBase = Base;
+  static constexpr int32_t kId = Id;
+};
+
+using PetStateChangedEvent =
+    EventDescriptor<&PET_EVENT, PET_STATE_CHANGED, PetStateEventData>;
+using ConversationEndEvent =
+    EventDescriptor<&LOGIC_EVENT, LOGIC_CONVERSATION_END>;
+using EmotionSetEvent = EventDescriptor<&EMO_EVENT, EMO_SET, EmoEventData>;
+using WakeChannelReadyEvent =
+    EventDescriptor<&LOGIC_EVENT, LOGIC_WAKE_CHANNEL_READY,
+                    WakeLatencyEventData>;
+using LinkStatsEvent =
+    EventDescriptor<&CLOUD_EVENT, CLOUD_LINK_STATS, LinkStatsEventData>;
+using TimeSyncedEvent = EventDescriptor<&CLOUD_EVENT, CLOUD_TIME_SYNCED>;
+using ProfileUpdatedEvent =
+    EventDescriptor<&LEARNING_EVENT, LEARNING_PROFILE_UPDATED>;
+
+template <typename T>
+struct EventHandlerOf {
+  using type = std::function<void(const T&)>;
+};
+
+template <>
+struct EventHandlerOf<void> {
+  using type = std::function<void()>;
+};
+
+// 订阅选项：dedicated_queue 为 true 时该订阅者拥有独立的投递队列和任务，
+// 处理慢也不会阻塞其他订阅者
+struct SubscribeOptions {
+  bool dedicated_queue = false;
+  uint32_t queue_length = 8;
+  const char* task_name = "event_sub";
+  uint32_t task_stack_size = 3072;
+  UBaseType_t task_priority = 3;
+};
+
+// 队列满时的处理方式
+enum class EventOverflow {
+  kDropNewest,  // 丢弃新事件
+  kDropOldest,  // 丢弃订阅者独立队列中最旧的一条（事件循环队列无法撤回，按 kDropNewest 处理）
+  kBlock,       // 等待队列空位
+};
+
+// 按事件ID配置的投递策略，只作用于类型化事件
+struct DeliveryPolicy {
+  bool latest_wins = false;      // 上一条尚未分发时，新值直接覆盖它，不再占用队列
+  uint32_t min_interval_ms = 0;  // 最小投递间隔，间隔内的事件合并为最后一个值，到期再投递
+  EventOverflow overflow = EventOverflow::kDropNewest;
+};
+
+// 策略统计
+struct DeliveryPolicyStats {
+  esp_event_base_t base;
+  int32_t id;
+  DeliveryPolicy policy;
+  uint32_t published;       // 发布次数
+  uint32_t posted;          // 实际进入事件循环的次数
+  uint32_t coalesced;       // latest_wins 覆盖掉的事件
+  uint32_t debounced;       // 最小间隔内被合并掉的事件
+  uint32_t dropped_oldest;  // 独立队列满时丢弃的旧事件
+  uint32_t dropped;         // 队列满或数据池耗尽丢弃的新事件
+};
+
+// 订阅句柄（RAII），析构或 Unsubscribe() 时取消订阅。
+// 处理函数正在其他任务中执行时会等它返回，之后可以安全销毁处理函数捕获的对象；
+// 不要在持有处理函数需要的锁时退订
+class EventSubscription {
+ public:
+  EventSubscription() = default;
+  EventSubscription(EventSubscription&& other) noexcept : id_(other.id_) {
+    other.id_ = 0;
+  }
+  EventSubscription& operator=(EventSubscription&& other) noexcept;
+  EventSubscription(const EventSubscription&) = delete;
+  EventSubscription& operator=(const EventSubscription&) = delete;
+  ~EventSubscription() { Unsubscribe(); }
+
+  void Unsubscribe();
+  bool active() const { return id_ != 0; }
+
+ private:
+  friend class EventBus;
+  explicit EventSubscription(uint32_t id) : id_(id) {}
+
+  uint32_t id_ = 0;
+};
+
 // ============================================================================
 // 事件总线类
 // ============================================================================
@@ -121,7 +249,7 @@ class EventBus {
 
   // ========== 订阅事件 ==========
   
-  // 订阅事件（C++风格，使用lambda）
+  // 订阅事件（C++风格，使用lambda）；有类型化描述符的事件请用 Subscribe<Event>()
   esp_err_t Subscribe(
       esp_event_base_t event_base,
       int32_t event_id,
@@ -162,6 +290,69 @@ class EventBus {
       size_t event_data_size = 0
   );
 
+  // ========== 类型化订阅/发布 ==========
+
+  // 订阅类型化事件，处理函数收到池中数据的只读引用
+  template <typename Event>
+  EventSubscription Subscribe(
+      typename EventHandlerOf<typename Event::PayloadType>::type handler,
+      const SubscribeOptions& options = SubscribeOptions()) {
+    using T = typename Event::PayloadType;
+    std::function<void(const void*)> erased;
+    if constexpr (std::is_void_v<T>) {
+      erased = [handler = std::move(handler)](const void*) { handler(); };
+    } else {
+      erased = [handler = std::move(handler)](const void* data) {
+        handler(*static_cast<const T*>(data));
+      };
+    }
+    return SubscribeTyped(*Event::kBase, Event::kId, std::move(erased),
+                          options);
+  }
+
+  // 发布类型化事件（队列满时阻塞等待）
+  template <typename Event, typename T = typename Event::PayloadType>
+  esp_err_t Publish(const std::enable_if_t<!std::is_void_v<T>, T>& data) {
+    return PublishTyped<Event>(&data, portMAX_DELAY);
+  }
+  template <typename Event>
+  esp_err_t Publish() {
+    static_assert(std::is_void_v<typename Event::PayloadType>,
+                  "This event carries data");
+    return PublishTyped<Event>(nullptr, portMAX_DELAY);
+  }
+
+  // 发布类型化事件（队列满时丢弃）
+  template <typename Event, typename T = typename Event::PayloadType>
+  esp_err_t PublishNonBlocking(
+      const std::enable_if_t<!std::is_void_v<T>, T>& data) {
+    return PublishTyped<Event>(&data, 0);
+  }
+  template <typename Event>
+  esp_err_t PublishNonBlocking() {
+    static_assert(std::is_void_v<typename Event::PayloadType>,
+                  "This event carries data");
+    return PublishTyped<Event>(nullptr, 0);
+  }
+
+  // ========== 投递策略 ==========
+
+  // 为某个事件设置投递策略，可重复调用更新
+  template <typename Event>
+  void SetDeliveryPolicy(const DeliveryPolicy& policy) {
+    SetDeliveryPolicy(*Event::kBase, Event::kId, policy);
+  }
+  void SetDeliveryPolicy(esp_event_base_t base, int32_t id,
+                         const DeliveryPolicy& policy);
+
+  std::vector<DeliveryPolicyStats> GetPolicyStats();
+  std::string GetStatusJson();
+
+  // 分别用原始 esp_event 发布（按值拷贝）和类型化发布（数据池）发送 count 个
+  // 64 字节事件，比较吞吐和发布到处理的时延。同时在途的事件有上限，不会挤占
+  // 真实事件；会阻塞调用者，不要在 event_bus 任务中调用
+  std::string RunBenchmarkJson(int count);
+
   // ========== 辅助工具 ==========
   
   // 获取事件循环句柄（供高级用户直接使用）
@@ -172,21 +363,80 @@ class EventBus {
     uint32_t total_published;
     uint32_t total_dropped;
     uint32_t queue_overflow_count;
+    uint32_t typed_delivered;       // 类型化事件投递到订阅者的次数
+    uint32_t pool_exhausted;        // 数据池耗尽导致的丢弃
+    uint32_t subscriber_dropped;    // 订阅者独立队列满导致的丢弃
   };
-  EventStats GetStats() const { return stats_; }
+  EventStats GetStats() const;
 
   // 重置统计
   void ResetStats();
 
  private:
   EventBus() = default;
-  ~EventBus() = default;
+  ~EventBus();
   EventBus(const EventBus&) = delete;
   EventBus& operator=(const EventBus&) = delete;
 
+  struct DeliveryWorker;
+  struct Subscriber;
+  struct RawHandler;
+  struct PolicyEntry;
+
+  template <typename Event>
+  esp_err_t PublishTyped(const void* data, TickType_t timeout) {
+    using T = typename Event::PayloadType;
+    if constexpr (!std::is_void_v<T>) {
+      static_assert(sizeof(T) <= EVENT_PAYLOAD_MAX_SIZE,
+                    "Event payload does not fit a pool block");
+      static_assert(std::is_trivially_copyable_v<T>,
+                    "Event payloads are copied into the pool with memcpy");
+      return PublishTyped(*Event::kBase, Event::kId, data, sizeof(T),
+                          timeout);
+    } else {
+      return PublishTyped(*Event::kBase, Event::kId, nullptr, 0, timeout);
+    }
+  }
+  esp_err_t PublishTyped(esp_event_base_t base, int32_t id, const void* data,
+                         size_t size, TickType_t timeout);
+  EventSubscription SubscribeTyped(esp_event_base_t base, int32_t id,
+                                   std::function<void(const void*)> handler,
+                                   const SubscribeOptions& options);
+  void Unsubscribe(uint32_t id);
+  PolicyEntry* FindPolicy(esp_event_base_t base, int32_t id);
+  esp_err_t PublishWithPolicy(PolicyEntry* entry, const void* data,
+                              size_t size, bool trailing_due);
+  esp_err_t PostTyped(esp_event_base_t base, int32_t id,
+                      EventPayloadBlock* block, PolicyEntry* entry,
+                      TickType_t timeout);
+  void FlushTrailing(PolicyEntry* entry);
+  void OnCounted(esp_err_t ret, esp_event_base_t base, int32_t id);
+  void OnPoolExhausted(esp_event_base_t base, int32_t id);
+  static void DispatchTyped(void* arg, esp_event_base_t base, int32_t id,
+                            void* event_data);
+
+  friend class EventSubscription;
+
   esp_event_loop_handle_t event_loop_ = nullptr;
   bool initialized_ = false;
-  EventStats stats_ = {0};
+
+  std::atomic<uint32_t> total_published_ = 0;
+  std::atomic<uint32_t> total_dropped_ = 0;
+  std::atomic<uint32_t> queue_overflow_count_ = 0;
+  std::atomic<uint32_t> typed_delivered_ = 0;
+  std::atomic<uint32_t> pool_exhausted_ = 0;
+  std::atomic<uint32_t> subscriber_dropped_ = 0;
+
+  EventPayloadPool pool_;
+
+  std::mutex subscribers_mutex_;
+  std::vector<std::shared_ptr<Subscriber>> subscribers_;
+  uint32_t next_subscriber_id_ = 1;
+  std::vector<std::unique_ptr<RawHandler>> raw_handlers_;
+
+  // 策略只增不删，PolicyEntry 指针在总线生命周期内有效
+  std::mutex policies_mutex_;
+  std::vector<std::unique_ptr<PolicyEntry>> policies_;
 };
 
 // ============================================================================
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace xiaozhi {
+
+// 事件数据池：固定大小的块，按引用计数共享给所有订阅者，发布时不再逐个拷贝
+#define EVENT_PAYLOAD_POOL_SIZE 16
+#define EVENT_PAYLOAD_MAX_SIZE 96
+
+struct EventPayloadBlock {
+  std::atomic<int> refs;
+  alignas(std::max_align_t) uint8_t data[EVENT_PAYLOAD_MAX_SIZE];
+};
+
+// 无锁数据池：空闲块记录在一个位图中，分配和释放各一次 CAS / fetch_or，
+// 可以在任意任务中调用
+class EventPayloadPool {
+  static_assert(EVENT_PAYLOAD_POOL_SIZE <= 32, "Free mask has 32 bits");
+
+ public:
+  // 取一个空闲块，引用计数为 1；池耗尽时返回 nullptr
+  EventPayloadBlock* Allocate() {
+    uint32_t mask = free_mask_.load(std::memory_order_acquire);
+    while (mask != 0) {
+      int index = __builtin_ctz(mask);
+      if (free_mask_.compare_exchange_weak(mask, mask & ~(1u << index),
+                                           std::memory_order_acq_rel)) {
+        auto* block = &blocks_[index];
+        block->refs.store(1, std::memory_order_relaxed);
+        return block;
+      }
+    }
+    return nullptr;
+  }
+
+  // 为另一个持有者增加引用，调用者必须已持有一个引用
+  static void Retain(EventPayloadBlock* block) {
+    if (block != nullptr) {
+      block->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  // 释放一个引用，最后一个引用释放时块回到池中
+  void Release(EventPayloadBlock* block) {
+    if (block == nullptr) {
+      return;
+    }
+    if (block->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      free_mask_.fetch_or(1u << (block - blocks_), std::memory_order_release);
+    }
+  }
+
+  int available() const {
+    return __builtin_popcount(free_mask_.load(std::memory_order_relaxed));
+  }
+
+ private:
+  EventPayloadBlock blocks_[EVENT_PAYLOAD_POOL_SIZE];
+  std::atomic<uint32_t> free_mask_ = (1ull << EVENT_PAYLOAD_POOL_SIZE) - 1;
+};
+
+}  // namespace xiaozhi
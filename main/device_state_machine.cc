@@ -0,0 +1,155 @@
+#include "device_state_machine.h"
+#include "event_journal.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+
+#define TAG "StateMachine"
+
+static_assert(DEVICE_STATE_COUNT <= 32, "State bitmasks are 32 bits wide");
+
+constexpr bool RulesAreIndexedByState() {
+    for (int i = 0; i < DEVICE_STATE_COUNT; i++) {
+        if (kDeviceStateRules[i].state != i) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(RulesAreIndexedByState(), "kDeviceStateRules must list every state in enum order");
+
+// Every state except the fatal one must lead back to idle, otherwise the device can get stuck
+constexpr bool IdleIsReachableFromEveryState() {
+    for (int i = 0; i < DEVICE_STATE_COUNT; i++) {
+        if (i == kDeviceStateFatalError) {
+            continue;
+        }
+        if ((DeviceStatesReachableFrom((DeviceState)i) & DeviceStateBit(kDeviceStateIdle)) == 0) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(IdleIsReachableFromEveryState(), "A state has no way back to idle");
+static_assert(DeviceStatesReachableFrom(kDeviceStateUnknown) == (1u << DEVICE_STATE_COUNT) - 1,
+    "Some states can never be entered");
+
+static const char* const kStateNames[DEVICE_STATE_COUNT] = {
+    "unknown", "starting", "configuring", "idle", "connecting", "listening",
+    "speaking", "upgrading", "activating", "audio_testing", "fatal_error",
+};
+
+const char* DeviceStateName(DeviceState state) {
+    if (state < 0 || state >= DEVICE_STATE_COUNT) {
+        return "invalid_state";
+    }
+    return kStateNames[state];
+}
+
+DeviceStateTraceEntry& DeviceStateMachine::AppendTraceLocked(DeviceState from, DeviceState to, int64_t now_us) {
+    auto& entry = trace_[trace_count_ % DEVICE_STATE_TRACE_SIZE];
+    trace_count_++;
+    entry.time_ms = now_us / 1000;
+    entry.dwell_ms = entered_time_us_ > 0 ? (now_us - entered_time_us_) / 1000 : 0;
+    entry.action_us = 0;
+    entry.from = from;
+    entry.to = to;
+    return entry;
+}
+
+bool DeviceStateMachine::Transition(DeviceState to) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    DeviceState from = state_;
+    int64_t now_us = esp_timer_get_time();
+    if (!IsDeviceStateTransitionAllowed(from, to)) {
+        rejected_++;
+        AppendTraceLocked(from, to, now_us).to |= DEVICE_STATE_TRACE_REJECTED;
+        EventJournal::GetInstance().Record(kJournalStateChange, from << 8 | to | DEVICE_STATE_TRACE_REJECTED, 0);
+        ESP_LOGE(TAG, "Illegal transition %s -> %s ignored", DeviceStateName(from), DeviceStateName(to));
+        return false;
+    }
+
+    auto& entry = AppendTraceLocked(from, to, now_us);
+    EventJournal::GetInstance().Record(kJournalStateChange, from << 8 | to, entry.dwell_ms);
+    if (entered_time_us_ > 0) {
+        total_time_us_[from] += now_us - entered_time_us_;
+    }
+    entries_[to]++;
+    entered_time_us_ = now_us;
+    state_ = to;
+    return true;
+}
+
+void DeviceStateMachine::SetLastActionTime(uint32_t action_us) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (trace_count_ > 0) {
+        trace_[(trace_count_ - 1) % DEVICE_STATE_TRACE_SIZE].action_us = std::min<uint32_t>(action_us, UINT16_MAX);
+    }
+}
+
+std::string DeviceStateMachine::GetStatusJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now_us = esp_timer_get_time();
+    std::string json = "{\"state\":\"";
+    json += DeviceStateName(state_);
+    json += "\",\"rejected\":" + std::to_string(rejected_);
+
+    json += ",\"states\":[";
+    bool first = true;
+    for (int i = 0; i < DEVICE_STATE_COUNT; i++) {
+        uint64_t total_us = total_time_us_[i];
+        if (i == state_ && entered_time_us_ > 0) {
+            total_us += now_us - entered_time_us_;
+        }
+        if (entries_[i] == 0 && total_us == 0) {
+            continue;
+        }
+        if (!first) {
+            json += ",";
+        }
+        first = false;
+        json += "{\"name\":\"";
+        json += DeviceStateName((DeviceState)i);
+        json += "\",\"entries\":" + std::to_string(entries_[i]);
+        json += ",\"total_ms\":" + std::to_string(total_us / 1000) + "}";
+    }
+
+    // Oldest first
+    json += "],\"trace\":[";
+    uint32_t count = std::min<uint32_t>(trace_count_, DEVICE_STATE_TRACE_SIZE);
+    for (uint32_t i = 0; i < count; i++) {
+        auto& entry = trace_[(trace_count_ - count + i) % DEVICE_STATE_TRACE_SIZE];
+        if (i > 0) {
+            json += ",";
+        }
+        json += "{\"t\":" + std::to_string(entry.time_ms);
+        json += ",\"from\":\"";
+        json += DeviceStateName((DeviceState)entry.from);
+        json += "\",\"to\":\"";
+        json += DeviceStateName((DeviceState)(entry.to & ~DEVICE_STATE_TRACE_REJECTED));
+        json += "\",\"dwell_ms\":" + std::to_string(entry.dwell_ms);
+        json += ",\"action_us\":" + std::to_string(entry.action_us);
+        if (entry.to & DEVICE_STATE_TRACE_REJECTED) {
+            json += ",\"rejected\":true";
+        }
+        json += "}";
+    }
+    json += "]}";
+    return json;
+}
+
+void DeviceStateMachine::DumpTrace() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t count = std::min<uint32_t>(trace_count_, DEVICE_STATE_TRACE_SIZE);
+    ESP_LOGI(TAG, "Last %lu of %lu transitions, %lu rejected", count, trace_count_, rejected_);
+    for (uint32_t i = 0; i < count; i++) {
+        auto& entry = trace_[(trace_count_ - count + i) % DEVICE_STATE_TRACE_SIZE];
+        ESP_LOGI(TAG, "%8lu ms %s -> %s%s, after %lu ms, actions %u us", entry.time_ms,
+            DeviceStateName((DeviceState)entry.from),
+            DeviceStateName((DeviceState)(entry.to & ~DEVICE_STATE_TRACE_REJECTED)),
+            (entry.to & DEVICE_STATE_TRACE_REJECTED) ? " (rejected)" : "",
+            entry.dwell_ms, entry.action_us);
+    }
+}
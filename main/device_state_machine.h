@@ -0,0 +1,112 @@
+#ifndef _DEVICE_STATE_MACHINE_H_
+#define _DEVICE_STATE_MACHINE_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "device_state.h"
+
+#define DEVICE_STATE_COUNT (kDeviceStateFatalError + 1)
+#define DEVICE_STATE_TRACE_SIZE 64
+
+constexpr uint32_t DeviceStateBit(DeviceState state) {
+    return 1u << state;
+}
+
+// The states a state may move to, indexed by the current state
+struct DeviceStateRule {
+    DeviceState state;
+    uint32_t next_states;
+};
+
+// Every live state may fall back to idle or fail
+constexpr uint32_t kDeviceStateAlwaysAllowed = DeviceStateBit(kDeviceStateIdle) | DeviceStateBit(kDeviceStateFatalError);
+
+constexpr DeviceStateRule kDeviceStateRules[DEVICE_STATE_COUNT] = {
+    { kDeviceStateUnknown, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateStarting) |
+        DeviceStateBit(kDeviceStateWifiConfiguring) },
+    { kDeviceStateStarting, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateWifiConfiguring) |
+        DeviceStateBit(kDeviceStateActivating) | DeviceStateBit(kDeviceStateUpgrading) },
+    { kDeviceStateWifiConfiguring, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateAudioTesting) |
+        DeviceStateBit(kDeviceStateActivating) },
+    { kDeviceStateIdle, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateConnecting) |
+        DeviceStateBit(kDeviceStateListening) | DeviceStateBit(kDeviceStateSpeaking) |
+        DeviceStateBit(kDeviceStateUpgrading) | DeviceStateBit(kDeviceStateActivating) |
+        DeviceStateBit(kDeviceStateWifiConfiguring) },
+    { kDeviceStateConnecting, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateListening) |
+        DeviceStateBit(kDeviceStateSpeaking) | DeviceStateBit(kDeviceStateUpgrading) |
+        DeviceStateBit(kDeviceStateWifiConfiguring) },
+    { kDeviceStateListening, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateConnecting) |
+        DeviceStateBit(kDeviceStateSpeaking) | DeviceStateBit(kDeviceStateUpgrading) |
+        DeviceStateBit(kDeviceStateWifiConfiguring) },
+    { kDeviceStateSpeaking, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateConnecting) |
+        DeviceStateBit(kDeviceStateListening) | DeviceStateBit(kDeviceStateUpgrading) |
+        DeviceStateBit(kDeviceStateWifiConfiguring) },
+    { kDeviceStateUpgrading, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateStarting) |
+        DeviceStateBit(kDeviceStateActivating) },
+    { kDeviceStateActivating, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateUpgrading) |
+        DeviceStateBit(kDeviceStateWifiConfiguring) | DeviceStateBit(kDeviceStateAudioTesting) },
+    { kDeviceStateAudioTesting, kDeviceStateAlwaysAllowed | DeviceStateBit(kDeviceStateWifiConfiguring) },
+    { kDeviceStateFatalError, 0 },
+};
+
+constexpr bool IsDeviceStateTransitionAllowed(DeviceState from, DeviceState to) {
+    return (kDeviceStateRules[from].next_states & DeviceStateBit(to)) != 0;
+}
+
+// Bitmask of the states reachable from `from` in any number of steps
+constexpr uint32_t DeviceStatesReachableFrom(DeviceState from) {
+    uint32_t reached = DeviceStateBit(from);
+    for (int round = 0; round < DEVICE_STATE_COUNT; round++) {
+        for (int i = 0; i < DEVICE_STATE_COUNT; i++) {
+            if (reached & (1u << i)) {
+                reached |= kDeviceStateRules[i].next_states;
+            }
+        }
+    }
+    return reached;
+}
+
+struct DeviceStateTraceEntry {
+    uint32_t time_ms;       // Uptime of the transition
+    uint32_t dwell_ms;      // Time spent in the previous state
+    uint16_t action_us;     // Exit and entry actions, saturated
+    uint8_t from;
+    uint8_t to;             // DEVICE_STATE_TRACE_REJECTED set if the table refused it
+};
+#define DEVICE_STATE_TRACE_REJECTED 0x80
+
+/*
+ * Checks device state changes against kDeviceStateRules and keeps a binary
+ * ring of the last transitions with per-state dwell times. The actions that
+ * run on a transition belong to the owner, Application.
+ */
+class DeviceStateMachine {
+public:
+    DeviceState state() const { return state_; }
+
+    // Moves to `to` if the table allows it, otherwise records the attempt and returns false
+    bool Transition(DeviceState to);
+    // Completes the trace entry of the last transition with the time its actions took
+    void SetLastActionTime(uint32_t action_us);
+
+    std::string GetStatusJson();
+    void DumpTrace();
+
+private:
+    std::mutex mutex_;
+    volatile DeviceState state_ = kDeviceStateUnknown;
+    int64_t entered_time_us_ = 0;
+    uint32_t entries_[DEVICE_STATE_COUNT] = {};
+    uint64_t total_time_us_[DEVICE_STATE_COUNT] = {};
+    uint32_t rejected_ = 0;
+    DeviceStateTraceEntry trace_[DEVICE_STATE_TRACE_SIZE] = {};
+    uint32_t trace_count_ = 0;
+
+    DeviceStateTraceEntry& AppendTraceLocked(DeviceState from, DeviceState to, int64_t now_us);
+};
+
+const char* DeviceStateName(DeviceState state);
+
+#endif // _DEVICE_STATE_MACHINE_H_
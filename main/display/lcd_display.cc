@@ -2,6 +2,7 @@
 #include "assets/lang_config.h"
 #include "gif/lvgl_gif.h"
 #include "lvgl_theme.h"
+#include "pet_catalog.h"
 #include "pet_icons.h"
 #include "settings.h"
 
@@ -12,7 +13,7 @@
 #include <esp_lvgl_port.h>
 #include <esp_psram.h>
 #include <font_awesome.h>
-#include <unordered_map>
+#include <string_view>
 #include <vector>
 
 #include "board.h"
@@ -23,16 +24,40 @@ LV_FONT_DECLARE(BUILTIN_TEXT_FONT);
 LV_FONT_DECLARE(BUILTIN_ICON_FONT);
 LV_FONT_DECLARE(font_awesome_30_4);
 
-// Emoji到宠物图标的映射表
-static const std::unordered_map<std::string, const lv_image_dsc_t *>
-    emoji_to_icon = {
-        {"🐱", &cat},          {"🐶", &dog},          {"🐹", &hamster},
-        {"🐰", &rabbit},       {"🦊", &fox_face},     {"🐻", &bear},
-        {"🐼", &panda_face},   {"🐨", &koala},        {"🐯", &tiger},
-        {"🦁", &lion_face},    {"🐧", &penguin},      {"🦜", &parrot},
-        {"🐉", &dragon},       {"🦄", &unicorn_face}, {"🐘", &elephant},
-        {"🦒", &giraffe_face}, {"🦏", &rhinoceros},   {"🦥", &sloth},
-        {"🐺", &wolf}};
+// Emoji到宠物图标的映射表（常量表，存放在 flash）
+struct PetIcon {
+  std::string_view emoji;
+  const lv_image_dsc_t *icon;
+};
+
+static constexpr PetIcon kPetIcons[] = {
+    {"🐱", &cat},          {"🐶", &dog},          {"🐹", &hamster},
+    {"🐰", &rabbit},       {"🦊", &fox_face},     {"🐻", &bear},
+    {"🐼", &panda_face},   {"🐨", &koala},        {"🐯", &tiger},
+    {"🦁", &lion_face},    {"🐧", &penguin},      {"🦜", &parrot},
+    {"🐉", &dragon},       {"🦄", &unicorn_face}, {"🐘", &elephant},
+    {"🦒", &giraffe_face}, {"🦏", &rhinoceros},   {"🦥", &sloth},
+    {"🐺", &wolf}};
+
+static constexpr const PetIcon *FindPetIcon(std::string_view emoji) {
+  for (const auto &entry : kPetIcons) {
+    if (entry.emoji == emoji) {
+      return &entry;
+    }
+  }
+  return nullptr;
+}
+
+static constexpr bool AllPetTypesHaveIcons() {
+  for (const auto &type : kPetTypes) {
+    if (FindPetIcon(type.emoji) == nullptr) {
+      return false;
+    }
+  }
+  return true;
+}
+static_assert(AllPetTypesHaveIcons(),
+              "Every pet type in pet_catalog.h needs an icon in kPetIcons");
 
 void LcdDisplay::InitializeLcdThemes() {
   auto text_font = std::make_shared<LvglBuiltInFont>(&BUILTIN_TEXT_FONT);
@@ -1070,15 +1095,15 @@ void LcdDisplay::SetPetEmoji(const char *emoji) {
   DisplayLockGuard lock(this);
 
   // 查找对应的宠物图标
-  std::string emoji_str(emoji);
+  std::string_view emoji_str(emoji);
   ESP_LOGI(TAG, "SetPetEmoji called with: '%s' (len=%d)", emoji,
            emoji_str.length());
 
-  auto it = emoji_to_icon.find(emoji_str);
+  const PetIcon *entry = FindPetIcon(emoji_str);
 
-  if (it != emoji_to_icon.end()) {
+  if (entry != nullptr) {
     // 找到对应的图标，设置它
-    lv_img_set_src(pet_emoji_img_, it->second);
+    lv_img_set_src(pet_emoji_img_, entry->icon);
     lv_obj_clear_flag(pet_emoji_img_, LV_OBJ_FLAG_HIDDEN);
     ESP_LOGI(TAG, "✅ Set pet icon for emoji: %s", emoji);
   } else {
@@ -7,7 +7,7 @@ extern "C" {
 #endif
 
 // 宠物图标资源声明 (20x20 像素)
-// 对应 pet_system.cc 中的 18 种宠物类型
+// 对应 pet_catalog.h 中的宠物类型，lcd_display.cc 在编译期检查是否齐全
 
 extern const lv_image_dsc_t cat;           // 🐱 猫
 extern const lv_image_dsc_t dog;           // 🐶 狗
@@ -0,0 +1,376 @@
+#include "event_journal.h"
+
+#include <esp_attr.h>
+#include <esp_heap_caps.h>
+#include <esp_log.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <mbedtls/base64.h>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "device_state_machine.h"
+
+#define TAG "EventJournal"
+
+// Raw bytes per dumped line, a multiple of 3 so lines decode independently
+#define DUMP_CHUNK_SIZE 768
+#define RECORD_SIZE sizeof(EventJournalRecord)
+#define RECORDS_PER_SECTOR (EVENT_JOURNAL_SECTOR_SIZE / RECORD_SIZE)
+
+// Not cleared by software resets, watchdog resets or panics. Holds the
+// records that were not written to flash yet, tagged with the magic once
+// Initialize() has taken ownership of it.
+struct JournalStaging {
+    uint32_t magic;
+    uint32_t count;
+    EventJournalRecord records[EVENT_JOURNAL_STAGING_SIZE];
+};
+static __NOINIT_ATTR JournalStaging s_staging;
+
+static uint8_t Crc8(const uint8_t* data, size_t size) {
+    uint8_t crc = 0xff;
+    for (size_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t RecordCrc(const EventJournalRecord& record) {
+    return Crc8((const uint8_t*)&record, offsetof(EventJournalRecord, crc));
+}
+
+static bool IsErased(const EventJournalRecord& record) {
+    auto bytes = (const uint8_t*)&record;
+    return std::all_of(bytes, bytes + RECORD_SIZE, [](uint8_t b) { return b == 0xff; });
+}
+
+// RAM is random after power-on, and may still hold the magic by chance,
+// so the staging buffer is only trusted if every record checks out too
+static bool StagingValid() {
+    if (esp_reset_reason() == ESP_RST_POWERON || s_staging.magic != EVENT_JOURNAL_MAGIC ||
+        s_staging.count > EVENT_JOURNAL_STAGING_SIZE) {
+        return false;
+    }
+    for (uint32_t i = 0; i < s_staging.count; i++) {
+        if (s_staging.records[i].crc != RecordCrc(s_staging.records[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool IsSectorHeader(const EventJournalRecord& record) {
+    return record.type == kJournalSectorHeader && record.value == EVENT_JOURNAL_MAGIC &&
+        record.crc == RecordCrc(record);
+}
+
+static const char* TypeName(uint8_t type) {
+    switch (type) {
+    case kJournalBoot: return "boot";
+    case kJournalStateChange: return "state";
+    case kJournalProtocolError: return "protocol_error";
+    case kJournalHeapLow: return "heap_low";
+    case kJournalQueueOverflow: return "queue_overflow";
+    case kJournalEvent: return "event";
+    default: return "unknown";
+    }
+}
+
+bool EventJournal::ReadRecord(uint32_t offset, EventJournalRecord& record) {
+    return esp_partition_read(partition_, offset, &record, RECORD_SIZE) == ESP_OK;
+}
+
+bool EventJournal::Initialize() {
+    if (ready_) {
+        return true;
+    }
+    partition_ = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, EVENT_JOURNAL_PARTITION);
+    if (partition_ == nullptr || partition_->size < 2 * EVENT_JOURNAL_SECTOR_SIZE) {
+        ESP_LOGW(TAG, "No '%s' partition, journal disabled", EVENT_JOURNAL_PARTITION);
+        return false;
+    }
+    sector_count_ = partition_->size / EVENT_JOURNAL_SECTOR_SIZE;
+
+    uint32_t recovered = 0;
+    {
+        std::lock_guard<std::mutex> flash_lock(flash_mutex_);
+        RestoreWritePosition();
+
+        // Records the previous boot staged but did not write, e.g. before a watchdog reset
+        if (StagingValid()) {
+            for (uint32_t i = 0; i < s_staging.count; i++) {
+                auto& record = s_staging.records[i];
+                // A crash in the middle of a flush may have written some of them already
+                if (record.seq < next_seq_) {
+                    continue;
+                }
+                WriteRecords(&record, 1);
+                next_seq_ = record.seq + 1;
+                recovered++;
+            }
+        }
+        s_staging.count = 0;
+        s_staging.magic = EVENT_JOURNAL_MAGIC;
+    }
+
+    ESP_LOGI(TAG, "Journal ready: %lu KB, next record %lu, %lu recovered from the previous boot",
+        partition_->size / 1024, next_seq_, recovered);
+    xTaskCreate([](void* arg) {
+        auto this_ = (EventJournal*)arg;
+        while (true) {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            this_->Flush();
+        }
+    }, "journal_flush", EVENT_JOURNAL_FLUSH_TASK_STACK_SIZE, this, EVENT_JOURNAL_FLUSH_TASK_PRIORITY, &flush_task_);
+    ready_ = true;
+    Record(kJournalBoot, esp_reset_reason(), recovered);
+    flush_timer_ = TimerService::GetInstance().StartPeriodic("journal_flush", EVENT_JOURNAL_FLUSH_INTERVAL_MS,
+        EVENT_JOURNAL_FLUSH_INTERVAL_MS / 2, [this]() { RequestFlush(); });
+    return true;
+}
+
+void EventJournal::RequestFlush() {
+    // Without the task the records stay staged and are saved on the next boot
+    if (flush_task_ != nullptr) {
+        xTaskNotifyGive(flush_task_);
+    }
+}
+
+void EventJournal::RestoreWritePosition() {
+    // The newest sector is the one whose header has the highest sequence number
+    int newest = -1;
+    uint32_t newest_seq = 0;
+    EventJournalRecord record;
+    for (uint32_t sector = 0; sector < sector_count_; sector++) {
+        if (ReadRecord(sector * EVENT_JOURNAL_SECTOR_SIZE, record) && IsSectorHeader(record) &&
+            (newest < 0 || record.seq > newest_seq)) {
+            newest = sector;
+            newest_seq = record.seq;
+        }
+    }
+    if (newest < 0) {
+        ESP_LOGI(TAG, "Empty journal");
+        write_offset_ = 0;
+        next_seq_ = 1;
+        return;
+    }
+
+    // Append after the last programmed slot, a torn record is skipped rather than overwritten
+    uint32_t sector_offset = newest * EVENT_JOURNAL_SECTOR_SIZE;
+    uint32_t used = 1;
+    next_seq_ = newest_seq;
+    for (uint32_t i = 1; i < RECORDS_PER_SECTOR; i++) {
+        if (!ReadRecord(sector_offset + i * RECORD_SIZE, record) || IsErased(record)) {
+            break;
+        }
+        used = i + 1;
+        if (record.crc == RecordCrc(record) && record.seq >= next_seq_) {
+            next_seq_ = record.seq + 1;
+        }
+    }
+    write_offset_ = (sector_offset + used * RECORD_SIZE) % (sector_count_ * EVENT_JOURNAL_SECTOR_SIZE);
+}
+
+void EventJournal::WriteRecords(const EventJournalRecord* records, size_t count) {
+    size_t written = 0;
+    while (written < count) {
+        if (write_offset_ % EVENT_JOURNAL_SECTOR_SIZE == 0) {
+            // Entering a sector drops its oldest records
+            esp_err_t err = esp_partition_erase_range(partition_, write_offset_, EVENT_JOURNAL_SECTOR_SIZE);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Failed to erase sector at 0x%lx: %s", write_offset_, esp_err_to_name(err));
+                return;
+            }
+            erases_++;
+            EventJournalRecord header = {
+                .seq = records[written].seq,
+                .time_ms = records[written].time_ms,
+                .value = EVENT_JOURNAL_MAGIC,
+                .code = 0,
+                .type = kJournalSectorHeader,
+                .crc = 0,
+            };
+            header.crc = RecordCrc(header);
+            esp_partition_write(partition_, write_offset_, &header, RECORD_SIZE);
+            write_offset_ += RECORD_SIZE;
+        }
+
+        size_t room = (EVENT_JOURNAL_SECTOR_SIZE - write_offset_ % EVENT_JOURNAL_SECTOR_SIZE) / RECORD_SIZE;
+        size_t batch = std::min(room, count - written);
+        esp_err_t err = esp_partition_write(partition_, write_offset_, records + written, batch * RECORD_SIZE);
+        if (err != ESP_OK) {
+            ESP_LOGE(TAG, "Failed to write at 0x%lx: %s", write_offset_, esp_err_to_name(err));
+        }
+        write_offset_ = (write_offset_ + batch * RECORD_SIZE) % (sector_count_ * EVENT_JOURNAL_SECTOR_SIZE);
+        written += batch;
+    }
+}
+
+void EventJournal::Record(EventJournalType type, uint16_t code, uint32_t value) {
+    if (!IsReady()) {
+        return;
+    }
+    EventJournalRecord record = {
+        .seq = 0,
+        .time_ms = (uint32_t)(esp_timer_get_time() / 1000),
+        .value = value,
+        .code = code,
+        .type = type,
+        .crc = 0,
+    };
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (s_staging.count == EVENT_JOURNAL_STAGING_SIZE) {
+        dropped_++;
+        return;
+    }
+    record.seq = next_seq_++;
+    record.crc = RecordCrc(record);
+    s_staging.records[s_staging.count++] = record;
+    if (s_staging.count == EVENT_JOURNAL_FLUSH_THRESHOLD) {
+        // Flash writes stall the caller, leave them to the flush task
+        RequestFlush();
+    }
+}
+
+void EventJournal::Flush() {
+    if (!IsReady()) {
+        return;
+    }
+    std::lock_guard<std::mutex> flash_lock(flash_mutex_);
+    size_t count;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        count = s_staging.count;
+        std::copy(s_staging.records, s_staging.records + count, flush_buffer_);
+    }
+    if (count == 0) {
+        return;
+    }
+
+    WriteRecords(flush_buffer_, count);
+
+    // Keep the records in the staging buffer until they are on flash
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::copy(s_staging.records + count, s_staging.records + s_staging.count, s_staging.records);
+    s_staging.count -= count;
+    flushed_ += count;
+}
+
+void EventJournal::CheckHeap() {
+    uint32_t free_bytes = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+    if (free_bytes >= EVENT_JOURNAL_HEAP_LOW_BYTES) {
+        heap_low_mark_ = EVENT_JOURNAL_HEAP_LOW_BYTES + 1024;
+        return;
+    }
+    // 1 KB steps, a slow leak should not fill the journal
+    if (free_bytes + 1024 <= heap_low_mark_) {
+        heap_low_mark_ = free_bytes;
+        uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+        Record(kJournalHeapLow, std::min<uint32_t>(largest / 1024, UINT16_MAX), free_bytes);
+    }
+}
+
+std::string EventJournal::GetStatusJson(int count) {
+    std::string json = "{\"ready\":";
+    json += IsReady() ? "true" : "false";
+    if (!IsReady()) {
+        return json + "}";
+    }
+
+    // Walk back from the write position until the sequence stops decreasing
+    std::lock_guard<std::mutex> flash_lock(flash_mutex_);
+    std::vector<EventJournalRecord> records;
+    uint32_t last_seq;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        records.assign(s_staging.records, s_staging.records + s_staging.count);
+        last_seq = records.empty() ? next_seq_ : records.front().seq;
+        json += ",\"next_seq\":" + std::to_string(next_seq_);
+        json += ",\"staged\":" + std::to_string(s_staging.count);
+        json += ",\"dropped\":" + std::to_string(dropped_);
+    }
+
+    json += ",\"partition_kb\":" + std::to_string(partition_->size / 1024);
+    json += ",\"flushed\":" + std::to_string(flushed_);
+    json += ",\"erases\":" + std::to_string(erases_);
+    uint32_t size = sector_count_ * EVENT_JOURNAL_SECTOR_SIZE;
+    uint32_t offset = write_offset_;
+    EventJournalRecord record;
+    for (uint32_t i = 0; i < size / RECORD_SIZE && (int)records.size() < count; i++) {
+        offset = (offset + size - RECORD_SIZE) % size;
+        if (!ReadRecord(offset, record) || IsErased(record)) {
+            break;
+        }
+        if (record.type == kJournalSectorHeader || record.crc != RecordCrc(record)) {
+            continue;
+        }
+        if (record.seq >= last_seq) {
+            break;
+        }
+        last_seq = record.seq;
+        records.insert(records.begin(), record);
+    }
+    if ((int)records.size() > count) {
+        records.erase(records.begin(), records.end() - count);
+    }
+
+    json += ",\"records\":[";
+    for (size_t i = 0; i < records.size(); i++) {
+        auto& record = records[i];
+        if (i > 0) {
+            json += ",";
+        }
+        json += "{\"seq\":" + std::to_string(record.seq);
+        json += ",\"t\":" + std::to_string(record.time_ms);
+        json += ",\"type\":\"";
+        json += TypeName(record.type);
+        json += "\"";
+        if (record.type == kJournalStateChange) {
+            json += ",\"from\":\"";
+            json += DeviceStateName((DeviceState)(record.code >> 8));
+            json += "\",\"to\":\"";
+            json += DeviceStateName((DeviceState)(record.code & 0x7f));
+            json += "\"";
+            if (record.code & DEVICE_STATE_TRACE_REJECTED) {
+                json += ",\"rejected\":true";
+            }
+        } else {
+            json += ",\"code\":" + std::to_string(record.code);
+        }
+        json += ",\"value\":" + std::to_string(record.value) + "}";
+    }
+    json += "]}";
+    return json;
+}
+
+void EventJournal::DumpToLog() {
+    if (!IsReady()) {
+        ESP_LOGW(TAG, "Journal disabled");
+        return;
+    }
+    Flush();
+
+    std::lock_guard<std::mutex> flash_lock(flash_mutex_);
+    uint32_t size = sector_count_ * EVENT_JOURNAL_SECTOR_SIZE;
+    // Lines look like "JRNL:<base64>", the host decoder ignores everything else
+    uint8_t chunk[DUMP_CHUNK_SIZE];
+    char line[DUMP_CHUNK_SIZE / 3 * 4 + 1];
+    ESP_LOGI(TAG, "JRNL-BEGIN %lu", size);
+    for (uint32_t offset = 0; offset < size; offset += DUMP_CHUNK_SIZE) {
+        size_t length = std::min<size_t>(DUMP_CHUNK_SIZE, size - offset);
+        if (esp_partition_read(partition_, offset, chunk, length) != ESP_OK) {
+            break;
+        }
+        size_t olen = 0;
+        mbedtls_base64_encode((unsigned char*)line, sizeof(line), &olen, chunk, length);
+        line[olen] = '\0';
+        ESP_LOGI(TAG, "JRNL:%s", line);
+    }
+    ESP_LOGI(TAG, "JRNL-END");
+}
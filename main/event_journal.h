@@ -0,0 +1,115 @@
+#ifndef EVENT_JOURNAL_H
+#define EVENT_JOURNAL_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <esp_partition.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#include "timer_service.h"
+
+#define EVENT_JOURNAL_MAGIC 0x4c4a5a58  // "XZJL"
+#define EVENT_JOURNAL_PARTITION "journal"
+#define EVENT_JOURNAL_SECTOR_SIZE 4096
+#define EVENT_JOURNAL_STAGING_SIZE 64
+#define EVENT_JOURNAL_FLUSH_THRESHOLD 32
+#define EVENT_JOURNAL_FLUSH_INTERVAL_MS 10000
+#define EVENT_JOURNAL_HEAP_LOW_BYTES (24 * 1024)
+#define EVENT_JOURNAL_FLUSH_TASK_PRIORITY 1
+#define EVENT_JOURNAL_FLUSH_TASK_STACK_SIZE 3072
+
+enum EventJournalType : uint8_t {
+    kJournalBoot = 1,               // code: esp_reset_reason_t, value: records recovered from the previous boot
+    kJournalStateChange = 2,        // code: from << 8 | to, to has 0x80 set if rejected, value: ms in the previous state
+    kJournalProtocolError = 3,      // value: FNV-1a hash of the error message
+    kJournalHeapLow = 4,            // code: largest free internal block in KB, value: free internal bytes
+    kJournalQueueOverflow = 5,      // code: EventJournalQueue, value: event key
+    kJournalEvent = 6,              // code: event key, value: first 4 payload bytes
+    kJournalSectorHeader = 0xfe,    // value: EVENT_JOURNAL_MAGIC, seq: first record of the sector
+};
+
+enum EventJournalQueue : uint16_t {
+    kJournalQueueEventLoop = 1,     // EventBus loop queue full
+    kJournalQueuePayloadPool = 2,   // EventBus payload pool exhausted
+    kJournalQueueSubscriber = 3,    // Dedicated subscriber queue full
+};
+
+// Little endian, every flash sector starts with a kJournalSectorHeader record
+struct EventJournalRecord {
+    uint32_t seq;               // Increases across boots, 0xffffffff on erased flash
+    uint32_t time_ms;           // Uptime
+    uint32_t value;
+    uint16_t code;
+    uint8_t type;
+    uint8_t crc;                // CRC-8 (poly 0x07, init 0xff) of the first 15 bytes
+} __attribute__((packed));
+static_assert(sizeof(EventJournalRecord) == 16, "Records must tile a flash sector");
+
+/*
+ * Append-only journal of fixed-size records in a circular flash partition,
+ * kept for post-mortem analysis after a watchdog or crash reboot.
+ *
+ * Records are staged in a RAM buffer that survives software resets and are
+ * written to flash in batches, so the last records before a crash are
+ * written on the next boot. Sectors are erased only when the write position
+ * enters them, which spreads erases evenly over the partition.
+ * scripts/journal_decode.py decodes a partition dump or a DumpToLog capture.
+ */
+class EventJournal {
+public:
+    static EventJournal& GetInstance() {
+        static EventJournal instance;
+        return instance;
+    }
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    // Finds the partition, restores the write position and saves what the previous boot staged
+    bool Initialize();
+    inline bool IsReady() const {
+        return ready_.load(std::memory_order_relaxed);
+    }
+
+    void Record(EventJournalType type, uint16_t code, uint32_t value);
+    // Writes the staged records to flash on the calling task
+    void Flush();
+    // Records each new low of free internal heap below EVENT_JOURNAL_HEAP_LOW_BYTES
+    void CheckHeap();
+
+    // The most recent records as a JSON string, oldest first
+    std::string GetStatusJson(int count);
+    // Write the whole partition to the console as base64 lines for the host decoder
+    void DumpToLog();
+
+private:
+    EventJournal() = default;
+
+    std::mutex mutex_;              // Staging buffer and sequence numbers
+    std::mutex flash_mutex_;        // Flash access and the write position
+    std::atomic<bool> ready_ = false;
+    const esp_partition_t* partition_ = nullptr;
+    uint32_t sector_count_ = 0;
+    uint32_t write_offset_ = 0;
+    uint32_t next_seq_ = 1;
+    uint32_t flushed_ = 0;
+    uint32_t dropped_ = 0;
+    uint32_t erases_ = 0;
+    uint32_t heap_low_mark_ = EVENT_JOURNAL_HEAP_LOW_BYTES + 1024;
+    EventJournalRecord flush_buffer_[EVENT_JOURNAL_STAGING_SIZE];
+    // Erases and writes take tens of ms, so they run on a low priority task
+    // woken by the flush timer and the staging threshold, not on the timer task
+    TaskHandle_t flush_task_ = nullptr;
+    TimerHandle flush_timer_;
+
+    void RequestFlush();
+    void RestoreWritePosition();
+    void WriteRecords(const EventJournalRecord* records, size_t count);
+    bool ReadRecord(uint32_t offset, EventJournalRecord& record);
+};
+
+#endif // EVENT_JOURNAL_H
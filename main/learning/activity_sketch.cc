@@ -0,0 +1,155 @@
+#include "activity_sketch.h"
+#include <esp_log.h>
+#include <cmath>
+#include <cstring>
+
+namespace xiaozhi {
+
+static const char* TAG = "ActivitySketch";
+
+// 放大系数超过此值时重定基准，float 精度仍有余量
+static constexpr float kMaxScale = 1e6f;
+
+static const char* const kTopicNames[kTopicCount] = {
+    "weather", "story", "pet", "smart_home", "chat", "other",
+};
+
+// ============================================================================
+// ActivitySketch 实现
+// ============================================================================
+
+void ActivitySketch::Reset(int64_t now_s) {
+  memset(this, 0, sizeof(*this));
+  landmark_s = now_s;
+  clock_s = now_s;
+  favorite_topic = kTopicChat;
+}
+
+float ActivitySketch::Scale(int64_t now_s, int64_t tau_s) const {
+  int64_t t = now_s > clock_s ? now_s : clock_s;
+  return expf((float)(t - landmark_s) / (float)tau_s);
+}
+
+void ActivitySketch::AdvanceClock(int64_t now_s) {
+  if (clock_s == 0) {
+    // 首次拿到真实时间：之前记录的都算作刚发生
+    landmark_s = now_s;
+    clock_s = now_s;
+    return;
+  }
+  if (now_s > clock_s) {
+    clock_s = now_s;
+  }
+  // 衰减最快的一组最先达到上限
+  if (Scale(clock_s, kInteractionTauS) > kMaxScale) {
+    Rebase();
+  }
+}
+
+void ActivitySketch::Rebase() {
+  float interaction_scale = Scale(clock_s, kInteractionTauS);
+  float hour_scale = Scale(clock_s, kHourTauS);
+  float topic_scale = Scale(clock_s, kTopicTauS);
+
+  interactions /= interaction_scale;
+  for (int i = 0; i < kHoursPerWeek; i++) {
+    hour_of_week[i] /= hour_scale;
+  }
+  for (int i = 0; i < kTopicCount; i++) {
+    topics[i] /= topic_scale;
+  }
+  landmark_s = clock_s;
+  ESP_LOGI(TAG, "Rebased decay landmark");
+}
+
+void ActivitySketch::Record(int64_t now_s, int hour, ActivityTopic topic) {
+  AddInteractions(now_s, 1.0f);
+  AddHour(now_s, hour, 1.0f);
+  AddTopic(now_s, topic, 1.0f);
+}
+
+void ActivitySketch::AddInteractions(int64_t now_s, float weight) {
+  AdvanceClock(now_s);
+  interactions += weight * Scale(clock_s, kInteractionTauS);
+}
+
+void ActivitySketch::AddHour(int64_t now_s, int hour, float weight) {
+  if (hour < 0 || hour >= kHoursPerWeek) {
+    return;
+  }
+  AdvanceClock(now_s);
+  hour_of_week[hour] += weight * Scale(clock_s, kHourTauS);
+  if (hour_of_week[hour] > hour_of_week[peak_hour_of_week]) {
+    peak_hour_of_week = hour;
+  }
+}
+
+void ActivitySketch::AddTopic(int64_t now_s, ActivityTopic topic,
+                              float weight) {
+  if (topic >= kTopicCount) {
+    return;
+  }
+  AdvanceClock(now_s);
+  topics[topic] += weight * Scale(clock_s, kTopicTauS);
+  // "other" 不作为推荐话题
+  if (topic != kTopicOther && topics[topic] > topics[favorite_topic]) {
+    favorite_topic = topic;
+  }
+}
+
+float ActivitySketch::GetInteractions(int64_t now_s) const {
+  return interactions / Scale(now_s, kInteractionTauS);
+}
+
+float ActivitySketch::GetHourActivity(int64_t now_s, int hour) const {
+  if (hour < 0 || hour >= kHoursPerWeek) {
+    return 0.0f;
+  }
+  return hour_of_week[hour] / Scale(now_s, kHourTauS);
+}
+
+float ActivitySketch::GetHourShare(int hour) const {
+  float peak = hour_of_week[peak_hour_of_week];
+  if (hour < 0 || hour >= kHoursPerWeek || peak <= 0.0f) {
+    return 0.0f;
+  }
+  return hour_of_week[hour] / peak;
+}
+
+float ActivitySketch::GetTopicCount(int64_t now_s, ActivityTopic topic) const {
+  if (topic >= kTopicCount) {
+    return 0.0f;
+  }
+  return topics[topic] / Scale(now_s, kTopicTauS);
+}
+
+// ============================================================================
+// 话题解析
+// ============================================================================
+
+const char* GetActivityTopicName(ActivityTopic topic) {
+  return topic < kTopicCount ? kTopicNames[topic] : "other";
+}
+
+ActivityTopic ParseActivityTopic(const char* topic) {
+  if (!topic) {
+    return kTopicOther;
+  }
+
+  // 简单字符串匹配
+  if (strstr(topic, "weather") || strstr(topic, "天气")) {
+    return kTopicWeather;
+  } else if (strstr(topic, "story") || strstr(topic, "故事")) {
+    return kTopicStory;
+  } else if (strstr(topic, "pet") || strstr(topic, "宠物")) {
+    return kTopicPet;
+  } else if (strstr(topic, "smart_home") || strstr(topic, "智能家居") ||
+             strstr(topic, "control") || strstr(topic, "控制")) {
+    return kTopicSmartHome;
+  } else if (strstr(topic, "chat") || strstr(topic, "聊天")) {
+    return kTopicChat;
+  }
+  return kTopicOther;
+}
+
+}  // namespace xiaozhi
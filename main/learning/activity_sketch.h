@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+
+namespace xiaozhi {
+
+// ============================================================================
+// 活跃度统计草图 - 指数时间衰减计数器
+// ============================================================================
+//
+// 每个计数器的值 = Σ exp(-(now - t_i) / τ)，t_i 为每次互动的时间。
+// 采用前向衰减：增量按 exp((t - landmark) / τ) 放大后累加，查询时再除以
+// 当前的放大系数，因此更新和查询都是 O(1)，不需要定时遍历衰减。
+// 同组计数器衰减速度相同，排序只在增量时改变，峰值随增量维护即可。
+// 放大系数过大时整体重定基准（约每三个月一次），内存大小固定。
+//
+// 时间使用虚拟时钟：只前进不后退，传入 0 表示时间未同步，此时不衰减。
+
+enum ActivityTopic : uint8_t {
+  kTopicWeather = 0,
+  kTopicStory,
+  kTopicPet,
+  kTopicSmartHome,
+  kTopicChat,
+  kTopicOther,
+  kTopicCount,
+};
+
+static constexpr int kHoursPerWeek = 7 * 24;
+
+// 时间常数：稳态下计数值 ≈ 频率 × τ
+static constexpr int64_t kInteractionTauS = 7 * 24 * 3600;   // 约等于 7 天内次数
+static constexpr int64_t kHourTauS = 28 * 24 * 3600;         // 最近 4 周的作息
+static constexpr int64_t kTopicTauS = 30 * 24 * 3600;        // 最近一个月的话题
+
+struct ActivitySketch {
+  int64_t landmark_s;                 // 前向衰减基准时间（epoch 秒）
+  int64_t clock_s;                    // 虚拟时钟（epoch 秒，单调）
+  float interactions;                 // 放大后的互动计数
+  float hour_of_week[kHoursPerWeek];  // 放大后的每周时段计数（周日 0 点为 0）
+  float topics[kTopicCount];          // 放大后的话题计数
+  uint8_t peak_hour_of_week;          // 最活跃时段
+  uint8_t favorite_topic;             // 最常聊的话题
+  uint8_t reserved[2];
+
+  // 清空并以 now_s 为基准
+  void Reset(int64_t now_s);
+
+  // 记录一次互动，hour_of_week < 0 表示时间未同步，不计入时段
+  void Record(int64_t now_s, int hour_of_week, ActivityTopic topic);
+
+  // 分别叠加权重（迁移旧数据用）
+  void AddInteractions(int64_t now_s, float weight);
+  void AddHour(int64_t now_s, int hour_of_week, float weight);
+  void AddTopic(int64_t now_s, ActivityTopic topic, float weight);
+
+  // ========== 查询（O(1)） ==========
+
+  // 衰减后的互动次数（约等于最近 7 天）
+  float GetInteractions(int64_t now_s) const;
+
+  // 衰减后的时段计数
+  float GetHourActivity(int64_t now_s, int hour_of_week) const;
+
+  // 时段活跃度相对峰值的比例 0.0-1.0（与时间无关，无需指数运算）
+  float GetHourShare(int hour_of_week) const;
+
+  // 衰减后的话题计数
+  float GetTopicCount(int64_t now_s, ActivityTopic topic) const;
+
+  uint8_t GetPeakHourOfWeek() const { return peak_hour_of_week; }
+  ActivityTopic GetFavoriteTopic() const {
+    return static_cast<ActivityTopic>(favorite_topic);
+  }
+  bool HasTopics() const { return topics[favorite_topic] > 0.0f; }
+
+ private:
+  void AdvanceClock(int64_t now_s);
+  void Rebase();
+  float Scale(int64_t now_s, int64_t tau_s) const;
+};
+
+// 话题名称（"weather"、"story"、"pet"、"smart_home"、"chat"、"other"）
+const char* GetActivityTopicName(ActivityTopic topic);
+
+// 解析话题字符串（支持中英文关键词）
+ActivityTopic ParseActivityTopic(const char* topic);
+
+}  // namespace xiaozhi
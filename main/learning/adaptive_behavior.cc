@@ -1,4 +1,6 @@
 #include "adaptive_behavior.h"
+#include "learning_state_lock.h"
+#include "utils/time_utils.h"
 #include <esp_log.h>
 #include <esp_random.h>
 #include <ctime>
@@ -17,10 +19,35 @@ AdaptiveBehavior& AdaptiveBehavior::GetInstance() {
   return instance;
 }
 
+AdaptiveBehavior::AdaptiveBehavior() {
+  // Initialize 之前的默认值
+  auto& snapshot = slots_[0].snapshot;
+  snapshot.hour = -1;
+  snapshot.frequency_level = 1;
+  snapshot.pet_decay_rate = 1.0f;
+  snapshot.current_hour_activity = 50;
+  snapshot.emotion_liveness = 50;
+  snapshot.pet_reminder_interval_min = 90;
+  snapshot.context = DecisionEngine::CONTEXT_WORK_TIME;
+  snapshot.greeting = "你好！";
+  snapshot.recommended_topic = "要不要聊聊天？";
+}
+
 bool AdaptiveBehavior::Initialize() {
   profile_ = &UserProfile::GetInstance();
   decision_ = &DecisionEngine::GetInstance();
   
+  RebuildSnapshot();
+  profile_subscription_ = EventBus::GetInstance().Subscribe<ProfileUpdatedEvent>(
+      [this]() { RebuildSnapshot(); });
+  // 同步前按 1970 年计时，小时和整点都不对，同步后重新计算
+  time_sync_subscription_ = EventBus::GetInstance().Subscribe<TimeSyncedEvent>(
+      [this]() {
+        RebuildSnapshot();
+        ScheduleHourTimer();
+      });
+  ScheduleHourTimer();
+  
   ESP_LOGI(TAG, "Adaptive behavior system initialized");
   ESP_LOGI(TAG, "  User frequency level: %d", GetUserFrequencyLevel());
   ESP_LOGI(TAG, "  Pet decay rate: %.2f", GetPetDecayRate());
@@ -33,10 +60,10 @@ bool AdaptiveBehavior::Initialize() {
 // ============================================================================
 
 float AdaptiveBehavior::GetPetDecayRate() {
-  if (!profile_) return 1.0f;
-  
-  uint32_t interactions = profile_->GetInteractionCount7d();
-  
+  return GetSnapshot().pet_decay_rate;
+}
+
+float AdaptiveBehavior::ComputePetDecayRate(uint32_t interactions) {
   // 🎯 自适应衰减速率
   if (interactions > 50) {
     // 高频用户（7天>50次）→ 衰减加快 30%
@@ -57,10 +84,10 @@ float AdaptiveBehavior::GetPetDecayRate() {
 }
 
 int AdaptiveBehavior::GetPetWarningThresholdOffset() {
-  if (!profile_) return 0;
-  
-  uint32_t interactions = profile_->GetInteractionCount7d();
-  
+  return GetSnapshot().pet_warning_threshold_offset;
+}
+
+int AdaptiveBehavior::ComputePetWarningThresholdOffset(uint32_t interactions) {
   // 高频用户：提前警告（阈值+5）
   if (interactions > 40) {
     return +5;
@@ -74,21 +101,20 @@ int AdaptiveBehavior::GetPetWarningThresholdOffset() {
 }
 
 bool AdaptiveBehavior::ShouldSuppressPetWarning() {
-  if (!profile_ || !decision_) return false;
-  
+  return GetSnapshot().suppress_pet_warning;
+}
+
+bool AdaptiveBehavior::ComputeSuppressPetWarning(int hour, float hour_share) {
   // 🌙 夜间时段（23:00 - 7:00）
-  if (IsNightTime()) {
+  if (IsNightTime(hour)) {
     ESP_LOGD(TAG, "Suppress warning: night time");
     return true;
   }
   
   // 🏢 工作时间 + 用户不活跃
-  if (IsWorkTime()) {
-    int hour = GetCurrentHour();
-    const auto& data = profile_->GetData();
-    
-    // 如果用户在这个时段活跃度很低（<5次），判断为不适合打扰
-    if (data.active_hours[hour] < 5) {
+  if (IsWorkTime(hour)) {
+    // 如果用户在这个时段活跃度很低（不到最活跃时段的 20%），判断为不适合打扰
+    if (hour_share < 0.2f) {
       ESP_LOGD(TAG, "Suppress warning: work time + low activity");
       return true;
     }
@@ -161,8 +187,7 @@ std::string AdaptiveBehavior::GetProbabilisticPetResponse(int mood, const char*
 // ============================================================================
 
 int AdaptiveBehavior::GetEmotionLiveness() {
-  if (!decision_) return 50;
-  return decision_->GetEmotionLiveness();  // 30-100
+  return GetSnapshot().emotion_liveness;  // 30-100
 }
 
 const char* AdaptiveBehavior::GetEmotionByMood(int mood) {
@@ -189,15 +214,11 @@ bool AdaptiveBehavior::ShouldUseAnimatedEmotion() {
 // ============================================================================
 
 const char* AdaptiveBehavior::GetGreeting() {
-  if (!decision_) return "你好！";
-  
-  auto ctx = decision_->GetCurrentContext();
-  return decision_->GetGreetingByContext(ctx);
+  return GetSnapshot().greeting;
 }
 
 const char* AdaptiveBehavior::GetRecommendedTopic() {
-  if (!decision_) return "要不要聊聊天？";
-  return decision_->RecommendTopic();
+  return GetSnapshot().recommended_topic;
 }
 
 bool AdaptiveBehavior::ShouldGreetProactively() {
@@ -206,8 +227,7 @@ bool AdaptiveBehavior::ShouldGreetProactively() {
 }
 
 int AdaptiveBehavior::GetPetReminderInterval() {
-  if (!decision_) return 90;  // 默认90分钟
-  return decision_->GetPetReminderInterval();
+  return GetSnapshot().pet_reminder_interval_min;
 }
 
 // ============================================================================
@@ -224,26 +244,89 @@ bool AdaptiveBehavior::RollProbability(float probability) {
 }
 
 void AdaptiveBehavior::PrintAdaptiveParams() {
+  const auto snapshot = GetSnapshot();
   ESP_LOGI(TAG, "========== Adaptive Parameters ==========");
-  ESP_LOGI(TAG, "User frequency: %d (0=low, 1=mid, 2=high)", GetUserFrequencyLevel());
-  ESP_LOGI(TAG, "Pet decay rate: %.2f", GetPetDecayRate());
-  ESP_LOGI(TAG, "Pet warning offset: %+d", GetPetWarningThresholdOffset());
-  ESP_LOGI(TAG, "Pet reminder interval: %d min", GetPetReminderInterval());
-  ESP_LOGI(TAG, "Current hour activity: %d%%", GetCurrentHourActivity());
-  ESP_LOGI(TAG, "Night time: %s", IsNightTime() ? "yes" : "no");
-  ESP_LOGI(TAG, "Work time: %s", IsWorkTime() ? "yes" : "no");
+  ESP_LOGI(TAG, "Snapshot: #%lu, hour %d", snapshot.generation, snapshot.hour);
+  ESP_LOGI(TAG, "User frequency: %d (0=low, 1=mid, 2=high)", snapshot.frequency_level);
+  ESP_LOGI(TAG, "Pet decay rate: %.2f", snapshot.pet_decay_rate);
+  ESP_LOGI(TAG, "Pet warning offset: %+d", snapshot.pet_warning_threshold_offset);
+  ESP_LOGI(TAG, "Pet reminder interval: %d min", snapshot.pet_reminder_interval_min);
+  ESP_LOGI(TAG, "Current hour activity: %d%%", snapshot.current_hour_activity);
+  ESP_LOGI(TAG, "Night time: %s", IsNightTime(snapshot.hour) ? "yes" : "no");
+  ESP_LOGI(TAG, "Work time: %s", IsWorkTime(snapshot.hour) ? "yes" : "no");
   ESP_LOGI(TAG, "========================================");
 }
 
 // ============================================================================
-// 📊 统计查询
+// 📸 决策快照
 // ============================================================================
 
-int AdaptiveBehavior::GetUserFrequencyLevel() {
-  if (!profile_) return 1;
+void AdaptiveBehavior::RebuildSnapshot() {
+  if (!profile_ || !decision_) return;
   
+  // 先取学习状态锁（与模拟器的加锁顺序一致），只有一个写者时槽位轮换才安全
+  LearningStateGuard state_lock(GetLearningStateMutex());
+  std::lock_guard<std::mutex> lock(rebuild_mutex_);
+  if (time_utils::IsVirtualTime()) {
+    BuildSnapshot(simulated_snapshot_, time_utils::IsTimeSynced() ? GetCurrentHour() : -1);
+    return;
+  }
+  generation_++;
+  auto& slot = slots_[generation_ % kSnapshotSlots];
+  uint32_t seq = slot.seq.load(std::memory_order_relaxed);
+  slot.seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  BuildSnapshot(slot.snapshot, time_utils::IsTimeSynced() ? GetCurrentHour() : -1);
+  slot.seq.store(seq + 2, std::memory_order_release);
+  snapshot_.store(&slot, std::memory_order_release);
+  ESP_LOGD(TAG, "Decision snapshot #%lu rebuilt", generation_);
+}
+
+void AdaptiveBehavior::BuildSnapshot(DecisionSnapshot& snapshot, int hour) {
   uint32_t interactions = profile_->GetInteractionCount7d();
+  // 时间未同步时没有当前时段的统计，按中等活跃处理
+  float hour_share = hour >= 0 ? profile_->GetCurrentHourShare() : 0.5f;
+  
+  snapshot.generation = generation_;
+  snapshot.hour = hour;
+  snapshot.frequency_level = ComputeUserFrequencyLevel(interactions);
+  snapshot.pet_decay_rate = ComputePetDecayRate(interactions);
+  snapshot.pet_warning_threshold_offset = ComputePetWarningThresholdOffset(interactions);
+  snapshot.suppress_pet_warning = ComputeSuppressPetWarning(hour, hour_share);
+  // 相对最活跃时段的比例 → 百分比
+  snapshot.current_hour_activity = (int)(hour_share * 100);
+  snapshot.emotion_liveness = decision_->GetEmotionLiveness();
+  snapshot.pet_reminder_interval_min = decision_->GetPetReminderInterval();
+  // 同步前与构造时的默认情境一致，不按 1970 年的 0 点当成深夜
+  snapshot.context = hour >= 0 ? decision_->GetCurrentContext() : DecisionEngine::CONTEXT_WORK_TIME;
+  snapshot.greeting = decision_->GetGreetingByContext(snapshot.context);
+  snapshot.recommended_topic = decision_->RecommendTopic();
+}
+
+void AdaptiveBehavior::ScheduleHourTimer() {
+  std::lock_guard<std::mutex> lock(hour_timer_mutex_);
+  struct tm timeinfo;
+  time_utils::GetLocalTime(&timeinfo);
+  uint32_t into_hour_s = timeinfo.tm_min * 60 + timeinfo.tm_sec;
   
+  // 整点后稍等一下，保证回调里读到的是新的小时
+  uint32_t delay_ms = (3600 - into_hour_s) * 1000 + 500;
+  hour_timer_ = TimerService::GetInstance().StartOnce("decision_hour", delay_ms, 5 * 1000,
+      [this]() {
+        RebuildSnapshot();
+        ScheduleHourTimer();
+      });
+}
+
+// ============================================================================
+// 📊 统计查询
+// ============================================================================
+
+int AdaptiveBehavior::GetUserFrequencyLevel() {
+  return GetSnapshot().frequency_level;
+}
+
+int AdaptiveBehavior::ComputeUserFrequencyLevel(uint32_t interactions) {
   if (interactions > 30) {
     return 2;  // 高频
   } else if (interactions > 10) {
@@ -254,13 +337,7 @@ int AdaptiveBehavior::GetUserFrequencyLevel() {
 }
 
 int AdaptiveBehavior::GetCurrentHourActivity() {
-  if (!profile_) return 50;
-  
-  int hour = GetCurrentHour();
-  const auto& data = profile_->GetData();
-  
-  // 活跃度 0-255 → 转换为百分比
-  return (data.active_hours[hour] * 100) / 255;
+  return GetSnapshot().current_hour_activity;
 }
 
 // ============================================================================
@@ -268,20 +345,15 @@ int AdaptiveBehavior::GetCurrentHourActivity() {
 // ============================================================================
 
 int AdaptiveBehavior::GetCurrentHour() {
-  time_t now;
-  time(&now);
-  struct tm timeinfo;
-  localtime_r(&now, &timeinfo);
-  return timeinfo.tm_hour;
+  return time_utils::GetCurrentHour();
 }
 
-bool AdaptiveBehavior::IsNightTime() {
-  int hour = GetCurrentHour();
-  return (hour >= 23 || hour < 7);
+bool AdaptiveBehavior::IsNightTime(int hour) {
+  // hour 为 -1 表示时间未同步，不算任何时段
+  return (hour >= 23 || (hour >= 0 && hour < 7));
 }
 
-bool AdaptiveBehavior::IsWorkTime() {
-  int hour = GetCurrentHour();
+bool AdaptiveBehavior::IsWorkTime(int hour) {
   return (hour >= 9 && hour < 18);
 }
 
@@ -2,11 +2,40 @@
 
 #include "user_profile.h"
 #include "decision_engine.h"
+#include "core/event_bus.h"
+#include "timer_service.h"
+#include "utils/time_utils.h"
+#include <atomic>
 #include <cstdint>
+#include <mutex>
 #include <string>
 
 namespace xiaozhi {
 
+// ============================================================================
+// 决策快照 - 由用户画像和当前小时推导出的全部自适应参数
+// ============================================================================
+//
+// 只在 LEARNING_PROFILE_UPDATED、整点或时间同步后重建，读者只做一次指针加载。
+// 时间同步前 hour 为 -1，不按时段抑制警告，活跃度取中间值。
+// GetSnapshot 返回副本，读者被抢占期间槽位被复用时会重读，不会读到拼接的数据。
+// 使用虚拟时钟的任务（学习模拟器）读写自己的快照，不发布给其他任务。
+
+struct DecisionSnapshot {
+  uint32_t generation;              // 第几次构建
+  int hour;                         // 构建时的小时（0-23）
+  int frequency_level;              // 0 = 低频，1 = 中频，2 = 高频
+  float pet_decay_rate;
+  int pet_warning_threshold_offset;
+  bool suppress_pet_warning;
+  int current_hour_activity;        // 0-100
+  int emotion_liveness;
+  int pet_reminder_interval_min;
+  DecisionEngine::Context context;
+  const char* greeting;
+  const char* recommended_topic;
+};
+
 // ============================================================================
 // 自适应行为类 - 整合用户画像和决策引擎，提供统一的自适应接口
 // ============================================================================
@@ -120,6 +149,34 @@ class AdaptiveBehavior {
    */
   void PrintAdaptiveParams();
 
+  // ========== 📸 决策快照 ==========
+  
+  /**
+   * @brief 获取当前决策快照的副本（无锁；复制期间槽位被重写时重读）
+   */
+  DecisionSnapshot GetSnapshot() const {
+    if (time_utils::IsVirtualTime()) {
+      return simulated_snapshot_;
+    }
+    for (;;) {
+      const SnapshotSlot* slot = snapshot_.load(std::memory_order_acquire);
+      uint32_t seq = slot->seq.load(std::memory_order_acquire);
+      if (seq & 1) {
+        continue;  // 正在重写，指针已经换到新槽位
+      }
+      DecisionSnapshot copy = slot->snapshot;
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot->seq.load(std::memory_order_relaxed) == seq) {
+        return copy;
+      }
+    }
+  }
+  
+  /**
+   * @brief 立即重建快照（画像更新事件、整点定时器和时间同步会自动调用）
+   */
+  void RebuildSnapshot();
+
   // ========== 📊 统计查询 ==========
   
   /**
@@ -135,7 +192,7 @@ class AdaptiveBehavior {
   int GetCurrentHourActivity();
 
  private:
-  AdaptiveBehavior() = default;
+  AdaptiveBehavior();
   ~AdaptiveBehavior() = default;
   AdaptiveBehavior(const AdaptiveBehavior&) = delete;
   AdaptiveBehavior& operator=(const AdaptiveBehavior&) = delete;
@@ -144,10 +201,36 @@ class AdaptiveBehavior {
   UserProfile* profile_ = nullptr;
   DecisionEngine* decision_ = nullptr;
   
+  // 快照轮换槽位：重建写入下一个槽位后再发布指针。
+  // seq 为奇数表示正在写入；读者复制前后 seq 不同说明槽位被复用，需要重读
+  struct SnapshotSlot {
+    std::atomic<uint32_t> seq{0};
+    DecisionSnapshot snapshot = {};
+  };
+  static constexpr int kSnapshotSlots = 4;
+  SnapshotSlot slots_[kSnapshotSlots];
+  std::atomic<const SnapshotSlot*> snapshot_{&slots_[0]};
+  DecisionSnapshot simulated_snapshot_ = {};  // 只由虚拟时钟的所有者任务访问
+  std::mutex rebuild_mutex_;
+  uint32_t generation_ = 0;
+  EventSubscription profile_subscription_;
+  EventSubscription time_sync_subscription_;
+  // 整点定时器会在主循环、esp_timer 任务和事件任务中重新预约
+  std::mutex hour_timer_mutex_;
+  TimerHandle hour_timer_;
+  
+  // 快照构建（按当前画像和时间重新计算）
+  void BuildSnapshot(DecisionSnapshot& snapshot, int hour);
+  float ComputePetDecayRate(uint32_t interactions);
+  int ComputePetWarningThresholdOffset(uint32_t interactions);
+  bool ComputeSuppressPetWarning(int hour, float hour_share);
+  int ComputeUserFrequencyLevel(uint32_t interactions);
+  void ScheduleHourTimer();
+  
   // 辅助函数
   int GetCurrentHour();
-  bool IsNightTime();
-  bool IsWorkTime();
+  bool IsNightTime(int hour);
+  bool IsWorkTime(int hour);
 };
 
 }  // namespace xiaozhi
@@ -1,6 +1,6 @@
 #include "decision_engine.h"
+#include "utils/time_utils.h"
 #include <esp_log.h>
-#include <esp_timer.h>
 #include <esp_random.h>
 #include <ctime>
 #include <cmath>
@@ -36,15 +36,15 @@ float DecisionEngine::GetProactiveProbability() {
   float prob = 0.1f;
   
   // 因素1：互动频率（高频用户 → 更主动）
-  if (data.interaction_count_7d > 50) {
+  uint32_t interactions = profile_->GetInteractionCount7d();
+  if (interactions > 50) {
     prob += 0.2f;  // +20%
-  } else if (data.interaction_count_7d > 20) {
+  } else if (interactions > 20) {
     prob += 0.1f;  // +10%
   }
   
-  // 因素2：活跃时段（当前是用户活跃时段 → 更主动）
-  int current_hour = GetCurrentHour();
-  if (data.active_hours[current_hour] > 10) {
+  // 因素2：活跃时段（当前时段达到最活跃时段一半以上 → 更主动）
+  if (profile_->GetCurrentHourShare() >= 0.5f) {
     prob += 0.15f;  // +15%
   }
   
@@ -71,14 +71,13 @@ float DecisionEngine::GetProactiveProbability() {
 int DecisionEngine::GetPetReminderInterval() {
   if (!profile_) return 120;  // 默认2小时
   
-  const auto& data = profile_->GetData();
-  
-  // 基于用户养宠频率调整
-  if (data.topic_pet > 100) {
+  // 基于用户近一个月的养宠频率调整
+  float topic_pet = profile_->GetTopicCount(kTopicPet);
+  if (topic_pet > 100) {
     return 30;   // 高频养宠用户：30分钟提醒一次
-  } else if (data.topic_pet > 50) {
+  } else if (topic_pet > 50) {
     return 60;   // 中频用户：1小时
-  } else if (data.topic_pet > 20) {
+  } else if (topic_pet > 20) {
     return 90;   // 低频用户：1.5小时
   } else {
     return 120;  // 很少养宠：2小时
@@ -164,7 +163,7 @@ const char* DecisionEngine::RecommendTopic() {
 }
 
 bool DecisionEngine::ShouldRemindPet() {
-  int64_t now_ms = esp_timer_get_time() / 1000;
+  int64_t now_ms = time_utils::GetUptimeMs();
   int interval_min = GetPetReminderInterval();
   int64_t interval_ms = interval_min * 60 * 1000;
   
@@ -178,7 +177,7 @@ bool DecisionEngine::ShouldRemindPet() {
 
 bool DecisionEngine::ShouldGreetProactively() {
   // 最小间隔：10分钟（防止太频繁）
-  int64_t now_ms = esp_timer_get_time() / 1000;
+  int64_t now_ms = time_utils::GetUptimeMs();
   if ((now_ms - last_proactive_greeting_ms_) < 10 * 60 * 1000) {
     return false;
   }
@@ -209,17 +208,13 @@ void DecisionEngine::PrintDecisionParams() {
 }
 
 int DecisionEngine::GetCurrentHour() {
-  time_t now;
-  time(&now);
-  struct tm timeinfo;
-  localtime_r(&now, &timeinfo);
-  return timeinfo.tm_hour;
+  return time_utils::GetCurrentHour();
 }
 
 int64_t DecisionEngine::GetSecondsSinceLastInteraction() {
   if (!profile_) return 0;
   
-  int64_t now_ms = esp_timer_get_time() / 1000;
+  int64_t now_ms = time_utils::GetUptimeMs();
   int64_t last_ms = profile_->GetData().last_update_ms;
   
   return (now_ms - last_ms) / 1000;
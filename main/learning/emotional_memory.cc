@@ -1,8 +1,7 @@
 #include "emotional_memory.h"
+#include "learning_state_lock.h"
+#include "utils/time_utils.h"
 #include <esp_log.h>
-#include <esp_timer.h>
-#include <nvs_flash.h>
-#include <nvs.h>
 #include <cmath>
 #include <cstring>
 
@@ -10,6 +9,10 @@ namespace xiaozhi {
 
 static const char* TAG = "EmotionalMemory";
 
+// EmotionalMemoryData 布局变化时递增
+static constexpr uint16_t kRecordVersion = 1;
+static constexpr uint32_t kCommitDelayMs = 60 * 1000;
+
 // ============================================================================
 // EmotionalMemoryData 辅助方法
 // ============================================================================
@@ -39,6 +42,11 @@ EmotionalMemory& EmotionalMemory::GetInstance() {
 }
 
 bool EmotionalMemory::Initialize() {
+  LearningStateGuard lock(GetLearningStateMutex());
+  record_id_ = PersistenceService::GetInstance().Register(
+      "emotional_memory", "emotional_mem", "data", kRecordVersion,
+      sizeof(data_), kCommitDelayMs);
+
   if (LoadFromNVS()) {
     ESP_LOGI(TAG, "Emotional memory loaded from NVS");
     ESP_LOGI(TAG, "  Loneliness: %d, Trust: %d, Happiness trend: %.2f",
@@ -72,6 +80,7 @@ void EmotionalMemory::InitializeDefaults() {
 // ========== 事件记录 ==========
 
 void EmotionalMemory::RecordPlay() {
+  LearningStateGuard lock(GetLearningStateMutex());
   data_.last_play_timestamp_ms = GetCurrentTimeMs();
   data_.total_play_count++;
   
@@ -82,14 +91,14 @@ void EmotionalMemory::RecordPlay() {
   // 减少孤独感
   data_.loneliness_level = Clamp(data_.loneliness_level - 20);
   
-  RecordInteraction();
-  needs_save_ = true;
+  RecordInteraction();  // 同时提交快照
   
   ESP_LOGI(TAG, "Recorded play: excitement=%d, loneliness=%d",
            data_.excitement_level, data_.loneliness_level);
 }
 
 void EmotionalMemory::RecordFeed() {
+  LearningStateGuard lock(GetLearningStateMutex());
   data_.last_feed_timestamp_ms = GetCurrentTimeMs();
   data_.total_feed_count++;
   
@@ -97,13 +106,13 @@ void EmotionalMemory::RecordFeed() {
   data_.happiness_trend = ClampF(data_.happiness_trend + 0.05f);
   data_.loneliness_level = Clamp(data_.loneliness_level - 10);
   
-  RecordInteraction();
-  needs_save_ = true;
+  RecordInteraction();  // 同时提交快照
   
   ESP_LOGI(TAG, "Recorded feed: happiness_trend=%.2f", data_.happiness_trend);
 }
 
 void EmotionalMemory::RecordHug() {
+  LearningStateGuard lock(GetLearningStateMutex());
   data_.total_hug_count++;
   
   // 拥抱大幅增加信任和快乐
@@ -111,48 +120,47 @@ void EmotionalMemory::RecordHug() {
   data_.happiness_trend = ClampF(data_.happiness_trend + 0.08f);
   data_.loneliness_level = Clamp(data_.loneliness_level - 15);
   
-  RecordInteraction();
-  needs_save_ = true;
+  RecordInteraction();  // 同时提交快照
   
   ESP_LOGI(TAG, "Recorded hug: trust=%d", data_.trust_level);
 }
 
 void EmotionalMemory::RecordInteraction() {
+  LearningStateGuard lock(GetLearningStateMutex());
   data_.last_interaction_timestamp_ms = GetCurrentTimeMs();
   
   // 任何互动都减少孤独感
   data_.loneliness_level = Clamp(data_.loneliness_level - 5);
   
-  needs_save_ = true;
+  SaveToNVS();
 }
 
 void EmotionalMemory::RecordPositiveEvent(int happiness_delta) {
+  LearningStateGuard lock(GetLearningStateMutex());
   data_.happiness_trend = ClampF(data_.happiness_trend + (happiness_delta / 100.0f));
-  needs_save_ = true;
+  SaveToNVS();
 }
 
 void EmotionalMemory::RecordNegativeEvent(int happiness_delta) {
+  LearningStateGuard lock(GetLearningStateMutex());
   data_.happiness_trend = ClampF(data_.happiness_trend + (happiness_delta / 100.0f));
-  needs_save_ = true;
+  SaveToNVS();
 }
 
 // ========== 情绪更新 ==========
 
 void EmotionalMemory::Update() {
+  LearningStateGuard lock(GetLearningStateMutex());
   UpdateLoneliness();
   UpdateHappinessTrend();
   UpdateTrust();
   
-  // 自动保存
-  int64_t now = GetCurrentTimeMs();
-  if (needs_save_ && (now - last_save_ms_) > (auto_save_interval_s_ * 1000)) {
-    SaveToNVS();
-    last_save_ms_ = now;
-    needs_save_ = false;
-  }
+  // 内容未变化时持久化服务不会写 flash
+  SaveToNVS();
 }
 
 void EmotionalMemory::UpdateLoneliness() {
+  LearningStateGuard lock(GetLearningStateMutex());
   int64_t now = GetCurrentTimeMs();
   int minutes_since_interaction = (now - data_.last_interaction_timestamp_ms) / (60 * 1000);
   
@@ -171,6 +179,7 @@ void EmotionalMemory::UpdateLoneliness() {
 }
 
 void EmotionalMemory::UpdateHappinessTrend() {
+  LearningStateGuard lock(GetLearningStateMutex());
   // 快乐趋势随时间缓慢回归中性（0）
   if (data_.happiness_trend > 0.01f) {
     data_.happiness_trend -= 0.001f;
@@ -184,6 +193,7 @@ void EmotionalMemory::UpdateHappinessTrend() {
 }
 
 void EmotionalMemory::UpdateTrust() {
+  LearningStateGuard lock(GetLearningStateMutex());
   // 信任度长期缓慢增长（如果经常互动）
   int64_t now = GetCurrentTimeMs();
   int days_since_interaction = data_.GetDaysSinceLastInteraction(now);
@@ -206,6 +216,7 @@ void EmotionalMemory::UpdateTrust() {
 // ========== 响应生成 ==========
 
 std::string EmotionalMemory::GetLongtermResponse() {
+  LearningStateGuard lock(GetLearningStateMutex());
   int64_t now = GetCurrentTimeMs();
   int days_since_play = data_.GetDaysSinceLastPlay(now);
   int days_since_interaction = data_.GetDaysSinceLastInteraction(now);
@@ -227,6 +238,7 @@ std::string EmotionalMemory::GetLongtermResponse() {
 }
 
 std::string EmotionalMemory::GetMissYouMessage() {
+  LearningStateGuard lock(GetLearningStateMutex());
   int64_t now = GetCurrentTimeMs();
   int days = data_.GetDaysSinceLastInteraction(now);
   
@@ -242,6 +254,7 @@ std::string EmotionalMemory::GetMissYouMessage() {
 }
 
 std::string EmotionalMemory::GetExcitedMessage() {
+  LearningStateGuard lock(GetLearningStateMutex());
   if (data_.excitement_level > 80) {
     return "耶！主人来了！好开心啊！";
   } else if (data_.excitement_level > 60) {
@@ -254,48 +267,23 @@ std::string EmotionalMemory::GetExcitedMessage() {
 // ========== 持久化（NVS） ==========
 
 bool EmotionalMemory::SaveToNVS() {
-  nvs_handle_t nvs;
-  esp_err_t err = nvs_open("emotional_mem", NVS_READWRITE, &nvs);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to open NVS: %s", esp_err_to_name(err));
-    return false;
-  }
-  
-  err = nvs_set_blob(nvs, "data", &data_, sizeof(data_));
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "Failed to write NVS: %s", esp_err_to_name(err));
-    nvs_close(nvs);
+  LearningStateGuard lock(GetLearningStateMutex());
+  if (record_id_ < 0) {
+    ESP_LOGE(TAG, "Emotional memory record not registered");
     return false;
   }
-  
-  err = nvs_commit(nvs);
-  nvs_close(nvs);
-  
-  if (err == ESP_OK) {
-    ESP_LOGI(TAG, "💾 Saved emotional memory to NVS (loneliness=%d, trust=%d)",
-             data_.loneliness_level, data_.trust_level);
-    return true;
-  }
-  
-  ESP_LOGE(TAG, "Failed to commit NVS: %s", esp_err_to_name(err));
-  return false;
+  PersistenceService::GetInstance().Update(record_id_, &data_, sizeof(data_));
+  return true;
 }
 
 bool EmotionalMemory::LoadFromNVS() {
-  nvs_handle_t nvs;
-  esp_err_t err = nvs_open("emotional_mem", NVS_READONLY, &nvs);
-  if (err != ESP_OK) {
-    return false;
-  }
-  
-  size_t required_size = sizeof(data_);
-  err = nvs_get_blob(nvs, "data", &data_, &required_size);
-  nvs_close(nvs);
-  
-  return (err == ESP_OK && required_size == sizeof(data_));
+  LearningStateGuard lock(GetLearningStateMutex());
+  return PersistenceService::GetInstance().Load(record_id_, &data_,
+                                                sizeof(data_));
 }
 
 void EmotionalMemory::Reset() {
+  LearningStateGuard lock(GetLearningStateMutex());
   InitializeDefaults();
   SaveToNVS();
   ESP_LOGI(TAG, "🔄 Emotional memory reset");
@@ -304,6 +292,7 @@ void EmotionalMemory::Reset() {
 // ========== 调试 ==========
 
 void EmotionalMemory::PrintStatus() const {
+  LearningStateGuard lock(GetLearningStateMutex());
   ESP_LOGI(TAG, "========== Emotional Memory ==========");
   ESP_LOGI(TAG, "Loneliness: %d", data_.loneliness_level);
   ESP_LOGI(TAG, "Excitement: %d", data_.excitement_level);
@@ -318,7 +307,7 @@ void EmotionalMemory::PrintStatus() const {
 // ========== 辅助函数 ==========
 
 int64_t EmotionalMemory::GetCurrentTimeMs() const {
-  return esp_timer_get_time() / 1000;
+  return time_utils::GetUptimeMs();
 }
 
 int EmotionalMemory::Clamp(int value, int min, int max) const {
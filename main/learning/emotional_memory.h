@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <string>
 
+#include "persistence_service.h"
+
 namespace xiaozhi {
 
 // ============================================================================
@@ -132,10 +134,10 @@ class EmotionalMemory {
 
   // ========== 持久化（NVS） ==========
   
-  // 保存到 NVS
+  // 提交快照给持久化服务，由后台任务合并写入 NVS（不阻塞调用方）
   bool SaveToNVS();
   
-  // 从 NVS 加载
+  // 从 NVS 加载（校验版本和 CRC）
   bool LoadFromNVS();
   
   // 重置所有数据
@@ -147,6 +149,9 @@ class EmotionalMemory {
   void PrintStatus() const;
 
  private:
+  // 模拟器换入/换出情绪数据
+  friend class LearningSimulator;
+
   EmotionalMemory() = default;
   ~EmotionalMemory() = default;
   EmotionalMemory(const EmotionalMemory&) = delete;
@@ -163,10 +168,8 @@ class EmotionalMemory {
   // 数据
   EmotionalMemoryData data_;
   
-  // 配置
-  uint32_t auto_save_interval_s_ = 300;  // 默认5分钟自动保存
-  int64_t last_save_ms_ = 0;
-  bool needs_save_ = false;
+  // 持久化记录
+  PersistentRecordId record_id_ = -1;
 };
 
 }  // namespace xiaozhi
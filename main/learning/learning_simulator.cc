@@ -0,0 +1,437 @@
+#include "learning_simulator.h"
+#include "adaptive_behavior.h"
+#include "emotional_memory.h"
+#include "user_profile.h"
+#include "pet_system.h"
+#include "persistence_service.h"
+#include "learning_state_lock.h"
+#include "utils/time_utils.h"
+#include <esp_log.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace xiaozhi {
+
+static const char* TAG = "LearningSim";
+
+static constexpr int kMinutesPerDay = 24 * 60;
+static constexpr int64_t kMinuteMs = 60 * 1000;
+static constexpr int64_t kHourMs = 60 * kMinuteMs;
+static constexpr int64_t kDayMs = kMinutesPerDay * kMinuteMs;
+static constexpr int kMaxSamples = 60;        // 轨迹最多保留的天数
+static constexpr int64_t kSliceUs = 20 * 1000; // 连续运行超过此时间就让出 CPU
+static constexpr uint32_t kChatDurationMs = 5000;  // 与 FinishSpeaking 的假设一致
+
+// 每日五次对话，正好完成宠物的聊天任务
+static const char* const kDefaultSchedule =
+    "07:30 chat,08:00 feed,12:30 weather,18:00 feed,19:00 play,"
+    "19:30 story,20:30 clean,21:00 chat,21:10 pet,21:20 hug";
+
+// 模拟期间这些模块的日志很密集，只保留警告
+static const char* const kQuietTags[] = {
+    "Pet", "UserProfile", "EmotionalMemory", "AdaptiveBehavior",
+    "DecisionEngine", "ActivitySketch",
+};
+static constexpr size_t kQuietTagCount = sizeof(kQuietTags) / sizeof(kQuietTags[0]);
+
+struct LearningSimulator::SimulatedState {
+  UserProfileData profile = {};
+  EmotionalMemoryData emotional = {};
+  PetSystem::State pet;
+  int64_t pet_cooldowns[4] = {};
+  int pet_chat_count = 0;
+  int64_t pet_next_wake_ms = 0;
+};
+
+// ============================================================================
+// 单例和启动
+// ============================================================================
+
+LearningSimulator& LearningSimulator::GetInstance() {
+  static LearningSimulator instance;
+  return instance;
+}
+
+LearningSimulator::~LearningSimulator() = default;
+
+bool LearningSimulator::Start(const SimulationConfig& config,
+                              std::string* error) {
+  if (running_.exchange(true)) {
+    *error = "Simulation already running";
+    return false;
+  }
+  config_ = config;
+  if (!ParseSchedule(config.schedule.empty() ? kDefaultSchedule : config.schedule,
+                     error)) {
+    running_ = false;
+    return false;
+  }
+  rng_state_ = config.seed != 0 ? config.seed : 1;
+  current_day_ = 0;
+
+  ESP_LOGI(TAG, "Simulating %d days (%d absent), %u actions per day",
+           config_.days, config_.absent_days, schedule_.size());
+  xTaskCreate([](void* arg) {
+    static_cast<LearningSimulator*>(arg)->Run();
+    vTaskDelete(NULL);
+  }, "learning_sim", 6144, this, 1, nullptr);
+  return true;
+}
+
+bool LearningSimulator::ParseSchedule(const std::string& schedule,
+                                      std::string* error) {
+  schedule_.clear();
+  size_t begin = 0;
+  while (begin < schedule.size()) {
+    size_t end = schedule.find(',', begin);
+    if (end == std::string::npos) {
+      end = schedule.size();
+    }
+    std::string entry = schedule.substr(begin, end - begin);
+    begin = end + 1;
+
+    int hour, minute;
+    char name[16];
+    if (sscanf(entry.c_str(), " %d:%d %15s", &hour, &minute, name) != 3 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59) {
+      *error = "Invalid schedule entry: " + entry;
+      return false;
+    }
+
+    ScheduledAction action = {hour * 60 + minute, kActionChat, nullptr};
+    if (strcmp(name, "feed") == 0) {
+      action.type = kActionFeed;
+    } else if (strcmp(name, "clean") == 0) {
+      action.type = kActionClean;
+    } else if (strcmp(name, "play") == 0) {
+      action.type = kActionPlay;
+    } else if (strcmp(name, "hug") == 0) {
+      action.type = kActionHug;
+    } else if (strcmp(name, "like") == 0) {
+      action.type = kActionLike;
+    } else if (strcmp(name, "dislike") == 0) {
+      action.type = kActionDislike;
+    } else {
+      ActivityTopic topic = ParseActivityTopic(name);
+      if (topic == kTopicOther && strcmp(name, "other") != 0) {
+        *error = std::string("Unknown action: ") + name;
+        return false;
+      }
+      action.topic = GetActivityTopicName(topic);
+    }
+    schedule_.push_back(action);
+  }
+  return true;
+}
+
+// ============================================================================
+// 模拟
+// ============================================================================
+
+// 从明天 0 点开始；时间未同步时从固定的周日开始，保证时段统计有效
+static int64_t GetStartTimeMs() {
+  if (time_utils::IsTimeSynced()) {
+    return time_utils::GetMidnightTimeMs() + kDayMs;
+  }
+  struct tm start = {};
+  start.tm_year = 2025 - 1900;
+  start.tm_mday = 5;
+  start.tm_isdst = -1;
+  return (int64_t)mktime(&start) * 1000LL;
+}
+
+void LearningSimulator::Run() {
+  auto& persistence = PersistenceService::GetInstance();
+
+  // 真实状态一直留在各模块中，模拟状态只在每一步内换入；模拟的提交全部丢弃
+  simulated_ = std::make_unique<SimulatedState>();
+  persistence.IgnoreUpdatesFrom(xTaskGetCurrentTaskHandle());
+
+  esp_log_level_t log_levels[kQuietTagCount];
+  for (size_t i = 0; i < kQuietTagCount; i++) {
+    log_levels[i] = esp_log_level_get(kQuietTags[i]);
+    esp_log_level_set(kQuietTags[i], ESP_LOG_WARN);
+  }
+
+  Report report;
+  int64_t wall_start_us = time_utils::GetTimerUs();
+  Simulate(report);
+  report.wall_ms = (time_utils::GetTimerUs() - wall_start_us) / 1000;
+
+  time_utils::ClearVirtualTime();
+  persistence.IgnoreUpdatesFrom(nullptr);
+  simulated_.reset();
+
+  for (size_t i = 0; i < kQuietTagCount; i++) {
+    esp_log_level_set(kQuietTags[i], log_levels[i]);
+  }
+
+  ESP_LOGI(TAG, "Simulated %d days in %lld ms, %lld pet wakes, %lld us each",
+           report.days, report.wall_ms, report.wakes,
+           report.wakes > 0 ? report.wake_us / report.wakes : 0);
+  {
+    std::lock_guard<std::mutex> lock(report_mutex_);
+    report_ = std::move(report);
+    has_report_ = true;
+  }
+  running_ = false;
+}
+
+template <typename F>
+void LearningSimulator::Step(F&& step) {
+  LearningStateGuard lock(GetLearningStateMutex());
+  auto& pet = PetSystem::GetInstance();
+  // started_ 为 false 时 ScheduleNextWake 只计算唤醒时间，不动真实定时器
+  bool started = pet.started_;
+  pet.started_ = false;
+  SwapState();
+  step();
+  SwapState();
+  pet.started_ = started;
+}
+
+void LearningSimulator::SwapState() {
+  auto& profile = UserProfile::GetInstance();
+  auto& emotional = EmotionalMemory::GetInstance();
+  auto& pet = PetSystem::GetInstance();
+  auto& simulated = *simulated_;
+
+  std::swap(profile.data_, simulated.profile);
+  std::swap(emotional.data_, simulated.emotional);
+  std::swap(pet.state_, simulated.pet);
+  std::swap(pet.lastFeedMs_, simulated.pet_cooldowns[0]);
+  std::swap(pet.lastCleanMs_, simulated.pet_cooldowns[1]);
+  std::swap(pet.lastPlayMs_, simulated.pet_cooldowns[2]);
+  std::swap(pet.lastHugMs_, simulated.pet_cooldowns[3]);
+  std::swap(pet.chatCountToday_, simulated.pet_chat_count);
+  std::swap(pet.next_wake_ms_, simulated.pet_next_wake_ms);
+  // 序列化缓存属于换出的一方
+  pet.MarkChanged();
+}
+
+void LearningSimulator::Simulate(Report& report) {
+  auto& profile = UserProfile::GetInstance();
+  auto& emotional = EmotionalMemory::GetInstance();
+  auto& pet = PetSystem::GetInstance();
+  auto& adaptive = AdaptiveBehavior::GetInstance();
+
+  int64_t start_ms = GetStartTimeMs();
+  time_utils::SetVirtualTimeMs(start_ms);
+
+  // 从默认状态开始，只保留宠物类型
+  simulated_->pet.petType = pet.GetState().petType;
+  Step([&]() {
+    profile.InitializeDefaults();
+    emotional.InitializeDefaults();
+    pet.state_.lastUpdateMs = start_ms;
+    pet.state_.lastInteractionMs = start_ms;
+    pet.state_.lastResetDayMs = start_ms;
+    adaptive.RebuildSnapshot();
+    pet.ScheduleNextWake();
+  });
+  // 两步之间读取模拟中的下一次唤醒时间
+  const int64_t& next_wake_ms = simulated_->pet_next_wake_ms;
+
+  int days = config_.days;
+  int stride = (days + kMaxSamples - 1) / kMaxSamples;
+  int64_t next_hour_ms = start_ms;
+  std::vector<ScheduledAction> actions;
+  int64_t slice_start_us = time_utils::GetTimerUs();
+
+  for (int day = 0; day < days; day++) {
+    current_day_ = day + 1;
+    actions.clear();
+    if (day < days - config_.absent_days) {
+      BuildDay(actions);
+    }
+
+    // 直接跳到下一个事件，同一时刻依次处理整点、唤醒、动作
+    int64_t day_start_ms = start_ms + day * kDayMs;
+    int64_t day_end_ms = day_start_ms + kDayMs;
+    size_t next = 0;
+    while (true) {
+      int64_t action_ms = next < actions.size()
+                              ? day_start_ms + actions[next].minute * kMinuteMs
+                              : day_end_ms;
+      int64_t now_ms = std::min({action_ms, next_wake_ms, next_hour_ms});
+      if (now_ms >= day_end_ms) {
+        break;
+      }
+      time_utils::SetVirtualTimeMs(now_ms);
+
+      Step([&]() {
+        // 整点重建决策快照，与 decision_hour 定时器相同
+        if (now_ms == next_hour_ms) {
+          adaptive.RebuildSnapshot();
+          next_hour_ms += kHourMs;
+        }
+
+        if (now_ms == pet.next_wake_ms_) {
+          int64_t begin_us = time_utils::GetTimerUs();
+          pet.OnWake();
+          int64_t elapsed_us = time_utils::GetTimerUs() - begin_us;
+          report.wakes++;
+          report.wake_us += elapsed_us;
+          report.max_wake_us = std::max(report.max_wake_us, elapsed_us);
+        }
+
+        if (now_ms == action_ms && next < actions.size()) {
+          int64_t begin_us = time_utils::GetTimerUs();
+          bool applied = Apply(actions[next++]);
+          int64_t elapsed_us = time_utils::GetTimerUs() - begin_us;
+          report.actions++;
+          if (!applied) {
+            report.rejected_actions++;
+          }
+          report.action_us += elapsed_us;
+          report.max_action_us = std::max(report.max_action_us, elapsed_us);
+        }
+      });
+
+      // 低优先级任务长时间占用 CPU 会触发空闲任务看门狗
+      if (time_utils::GetTimerUs() - slice_start_us > kSliceUs) {
+        vTaskDelay(1);
+        slice_start_us = time_utils::GetTimerUs();
+      }
+    }
+
+    // 采样前结算到当天结束
+    time_utils::SetVirtualTimeMs(day_end_ms - 1);
+    if ((day + 1) % stride == 0 || day == days - 1) {
+      Step([&]() { report.samples.push_back(TakeSample(day + 1)); });
+    }
+  }
+  report.days = days;
+}
+
+bool LearningSimulator::Apply(const ScheduledAction& action) {
+  auto& profile = UserProfile::GetInstance();
+  auto& pet = PetSystem::GetInstance();
+  auto& adaptive = AdaptiveBehavior::GetInstance();
+
+  // 与真实入口相同；画像变化后同步重建快照，不等事件总线
+  switch (action.type) {
+    case kActionChat:
+      profile.RecordInteraction(action.topic, kChatDurationMs);
+      pet.RecordChat();
+      adaptive.RebuildSnapshot();
+      return true;
+    case kActionFeed:
+      return pet.Feed();
+    case kActionClean:
+      return pet.Clean();
+    case kActionPlay:
+      return pet.Play();
+    case kActionHug:
+      return pet.Hug();
+    case kActionLike:
+    case kActionDislike:
+      profile.RecordFeedback(action.type == kActionLike);
+      adaptive.RebuildSnapshot();
+      return true;
+  }
+  return false;
+}
+
+void LearningSimulator::BuildDay(std::vector<ScheduledAction>& actions) {
+  for (const auto& action : schedule_) {
+    ScheduledAction jittered = action;
+    if (config_.jitter_min > 0) {
+      int range = config_.jitter_min * 2 + 1;
+      jittered.minute += (int)(NextRandom() % range) - config_.jitter_min;
+      jittered.minute = std::max(0, std::min(kMinutesPerDay - 1, jittered.minute));
+    }
+    actions.push_back(jittered);
+  }
+  std::stable_sort(actions.begin(), actions.end(),
+                   [](const ScheduledAction& a, const ScheduledAction& b) {
+                     return a.minute < b.minute;
+                   });
+}
+
+uint32_t LearningSimulator::NextRandom() {
+  // xorshift32，同样的种子得到同样的作息
+  uint32_t x = rng_state_;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  rng_state_ = x;
+  return x;
+}
+
+LearningSimulator::Sample LearningSimulator::TakeSample(int day) {
+  auto& profile = UserProfile::GetInstance();
+  auto& emotional = EmotionalMemory::GetInstance();
+  auto state = PetSystem::GetInstance().GetState();
+
+  Sample sample;
+  sample.day = day;
+  sample.mood = state.mood;
+  sample.satiety = state.satiety;
+  sample.cleanliness = state.cleanliness;
+  sample.active = state.active;
+  sample.level = state.level;
+  sample.login_streak = state.loginStreak;
+  sample.interactions_7d = profile.GetInteractionCount7d();
+  sample.peak_hour = profile.GetMostActiveHour();
+  sample.favorite_topic = profile.GetFavoriteTopic();
+  sample.pet_decay_rate = AdaptiveBehavior::GetInstance().GetSnapshot().pet_decay_rate;
+  sample.loneliness = emotional.GetLonelinessLevel();
+  sample.trust = emotional.GetTrustLevel();
+  return sample;
+}
+
+// ============================================================================
+// 报告
+// ============================================================================
+
+std::string LearningSimulator::GetReportJson() {
+  if (running_) {
+    return "{\"running\":true,\"day\":" + std::to_string(current_day_.load()) +
+           ",\"days\":" + std::to_string(config_.days) + "}";
+  }
+
+  std::lock_guard<std::mutex> lock(report_mutex_);
+  if (!has_report_) {
+    return "{\"running\":false}";
+  }
+
+  const auto& report = report_;
+  int64_t wall_ms = std::max<int64_t>(report.wall_ms, 1);
+  std::string json = "{\"running\":false,\"days\":" + std::to_string(report.days);
+  json += ",\"wall_ms\":" + std::to_string(report.wall_ms);
+  json += ",\"days_per_s\":" + std::to_string(report.days * 1000LL / wall_ms);
+  json += ",\"wakes\":" + std::to_string(report.wakes);
+  json += ",\"wake_us\":{\"avg\":" +
+          std::to_string(report.wakes > 0 ? report.wake_us / report.wakes : 0) +
+          ",\"max\":" + std::to_string(report.max_wake_us) + "}";
+  json += ",\"actions\":" + std::to_string(report.actions);
+  json += ",\"rejected_actions\":" + std::to_string(report.rejected_actions);
+  json += ",\"action_us\":{\"avg\":" +
+          std::to_string(report.actions > 0 ? report.action_us / report.actions : 0) +
+          ",\"max\":" + std::to_string(report.max_action_us) + "}";
+
+  json += ",\"trajectory\":[";
+  char buffer[256];
+  for (size_t i = 0; i < report.samples.size(); i++) {
+    const auto& s = report.samples[i];
+    snprintf(buffer, sizeof(buffer),
+             "%s{\"day\":%d,\"mood\":%d,\"satiety\":%d,\"clean\":%d,"
+             "\"active\":%d,\"level\":%d,\"streak\":%d,\"interactions_7d\":%lu,"
+             "\"peak_hour\":%d,\"topic\":\"%s\",\"decay_rate\":%.2f,"
+             "\"loneliness\":%d,\"trust\":%d}",
+             i > 0 ? "," : "", s.day, s.mood, s.satiety, s.cleanliness,
+             s.active, s.level, s.login_streak, (unsigned long)s.interactions_7d,
+             s.peak_hour, s.favorite_topic, s.pet_decay_rate, s.loneliness,
+             s.trust);
+    json += buffer;
+  }
+  json += "]}";
+  return json;
+}
+
+}  // namespace xiaozhi
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace xiaozhi {
+
+// ============================================================================
+// 学习模拟器 - 用虚拟时钟快速回放作息，观察宠物和学习系统的长期表现
+// ============================================================================
+//
+// 后台任务推进虚拟时钟（time_utils，只对模拟任务生效），直接跳到下一个事件：
+// 作息中的动作、PetSystem 预约的唤醒或整点。动作调用与真实对话相同的入口
+// （UserProfile、PetSystem、EmotionalMemory、AdaptiveBehavior）。模拟从默认状态开始，
+// 同样的配置得到同样的结果。
+// 模拟状态由模拟器持有，每一步在学习状态锁内换入各模块、执行、再换回真实状态，
+// 其他任务最多等待一步；模拟任务的 NVS 提交被丢弃，决策快照只对模拟任务可见。
+//
+// 作息格式："HH:MM 动作,HH:MM 动作,..."，动作为 feed、clean、play、hug、
+// like、dislike，或话题（chat、weather、story、pet、smart_home，计为一次对话）。
+
+struct SimulationConfig {
+  int days = 30;          // 模拟天数
+  int absent_days = 0;    // 最后若干天没有任何互动
+  int jitter_min = 20;    // 每个动作时间的随机偏移（±分钟）
+  uint32_t seed = 1;      // 随机种子
+  std::string schedule;   // 每日作息，空则使用默认作息
+};
+
+class LearningSimulator {
+ public:
+  static LearningSimulator& GetInstance();
+
+  // 在后台启动模拟；正在运行或作息无效时返回 false 并填写 error
+  bool Start(const SimulationConfig& config, std::string* error);
+
+  bool IsRunning() const { return running_.load(); }
+
+  // 运行中返回进度，结束后返回最近一次报告
+  std::string GetReportJson();
+
+ private:
+  LearningSimulator() = default;
+  ~LearningSimulator();
+  LearningSimulator(const LearningSimulator&) = delete;
+  LearningSimulator& operator=(const LearningSimulator&) = delete;
+
+  enum ActionType : uint8_t {
+    kActionChat,
+    kActionFeed,
+    kActionClean,
+    kActionPlay,
+    kActionHug,
+    kActionLike,
+    kActionDislike,
+  };
+
+  struct ScheduledAction {
+    int minute;           // 当天第几分钟
+    ActionType type;
+    const char* topic;    // kActionChat 的话题
+  };
+
+  // 每天结束时的状态
+  struct Sample {
+    int day;
+    int mood;
+    int satiety;
+    int cleanliness;
+    int active;
+    int level;
+    int login_streak;
+    uint32_t interactions_7d;
+    int peak_hour;
+    const char* favorite_topic;
+    float pet_decay_rate;
+    int loneliness;
+    int trust;
+  };
+
+  struct Report {
+    int days = 0;
+    int64_t wakes = 0;            // 宠物唤醒次数
+    int64_t wake_us = 0;          // 宠物唤醒总耗时
+    int64_t max_wake_us = 0;
+    int64_t actions = 0;
+    int64_t rejected_actions = 0; // 冷却中或状态已满
+    int64_t action_us = 0;
+    int64_t max_action_us = 0;
+    int64_t wall_ms = 0;
+    std::vector<Sample> samples;
+  };
+
+  // 模拟中的学习状态，只在 Step 期间换入各模块
+  struct SimulatedState;
+
+  bool ParseSchedule(const std::string& schedule, std::string* error);
+  void Run();
+  // 持有学习状态锁，换入模拟状态执行 step，再换回真实状态
+  template <typename F>
+  void Step(F&& step);
+  void SwapState();
+  void Simulate(Report& report);
+  bool Apply(const ScheduledAction& action);
+  void BuildDay(std::vector<ScheduledAction>& actions);
+  uint32_t NextRandom();
+  Sample TakeSample(int day);
+
+  SimulationConfig config_;
+  std::vector<ScheduledAction> schedule_;
+  std::unique_ptr<SimulatedState> simulated_;
+  uint32_t rng_state_ = 1;
+
+  std::atomic<bool> running_{false};
+  std::atomic<int> current_day_{0};
+  std::mutex report_mutex_;
+  Report report_;
+  bool has_report_ = false;
+};
+
+}  // namespace xiaozhi
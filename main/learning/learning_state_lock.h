@@ -0,0 +1,23 @@
+#pragma once
+
+#include <mutex>
+
+namespace xiaozhi {
+
+// ============================================================================
+// 学习状态锁 - UserProfile、EmotionalMemory、PetSystem 共用
+// ============================================================================
+//
+// 三个模块的公开接口都持有这把锁，可重入（模块之间会互相调用）。平时只有主循环
+// 和事件总线访问，几乎没有竞争；学习模拟器每一步持有它换入模拟状态，其他任务的
+// 调用最多等待一步。
+// 加锁顺序：先本锁，再 AdaptiveBehavior 的 rebuild_mutex_。
+
+inline std::recursive_mutex& GetLearningStateMutex() {
+  static std::recursive_mutex mutex;
+  return mutex;
+}
+
+using LearningStateGuard = std::lock_guard<std::recursive_mutex>;
+
+}  // namespace xiaozhi
@@ -1,8 +1,9 @@
 #include "user_profile.h"
+#include "learning_state_lock.h"
+#include "core/event_bus.h"
+#include "utils/time_utils.h"
 #include <esp_log.h>
-#include <esp_timer.h>
-#include <nvs_flash.h>
-#include <nvs.h>
+#include <cmath>
 #include <cstring>
 #include <ctime>
 
@@ -10,6 +11,34 @@ namespace xiaozhi {
 
 static const char* TAG = "UserProfile";
 
+// UserProfileData 布局变化时递增
+// v2: 饱和计数器换成指数衰减的 ActivitySketch
+static constexpr uint16_t kRecordVersion = 2;
+// 合并窗口：一次对话内的多次更新只写一次 flash
+static constexpr uint32_t kCommitDelayMs = 30 * 1000;
+
+// v1 布局，仅用于迁移
+struct UserProfileDataV1 {
+  uint32_t interaction_count_7d;
+  uint32_t avg_session_duration_s;
+  uint8_t active_hours[24];
+  uint16_t topic_weather;
+  uint16_t topic_story;
+  uint16_t topic_pet;
+  uint16_t topic_smart_home;
+  uint16_t topic_chat;
+  uint16_t topic_other;
+  uint16_t positive_feedback_count;
+  uint16_t negative_feedback_count;
+  int64_t last_update_ms;
+  int64_t created_ms;
+};
+
+// 衰减统计的虚拟时钟输入，时间未同步时为 0
+static int64_t GetActivityClockS() {
+  return time_utils::IsTimeSynced() ? (int64_t)time_utils::GetTime() : 0;
+}
+
 // ============================================================================
 // UserProfile 实现
 // ============================================================================
@@ -20,6 +49,11 @@ UserProfile& UserProfile::GetInstance() {
 }
 
 bool UserProfile::Initialize() {
+  LearningStateGuard lock(GetLearningStateMutex());
+  record_id_ = PersistenceService::GetInstance().Register(
+      "user_profile", "user_profile", "profile_data", kRecordVersion,
+      sizeof(data_), kCommitDelayMs);
+
   // 尝试从 NVS 加载
   if (LoadFromNVS()) {
     ESP_LOGI(TAG, "✅ Loaded user profile from NVS");
@@ -27,6 +61,13 @@ bool UserProfile::Initialize() {
     return true;
   }
 
+  if (MigrateFromV1()) {
+    ESP_LOGI(TAG, "✅ Migrated user profile from v1");
+    SaveToNVS();
+    PrintStats();
+    return true;
+  }
+
   // 加载失败，使用默认值
   ESP_LOGW(TAG, "⚠️  Failed to load profile, using defaults");
   InitializeDefaults();
@@ -38,19 +79,49 @@ void UserProfile::InitializeDefaults() {
   memset(&data_, 0, sizeof(data_));
   
   // 设置默认值
-  data_.interaction_count_7d = 0;
   data_.avg_session_duration_s = 30;  // 默认30秒
-  data_.created_ms = esp_timer_get_time() / 1000;
+  data_.created_ms = time_utils::GetUptimeMs();
   data_.last_update_ms = data_.created_ms;
-  
-  needs_save_ = true;
+  data_.activity.Reset(GetActivityClockS());
+}
+
+bool UserProfile::MigrateFromV1() {
+  UserProfileDataV1 old;
+  if (!PersistenceService::GetInstance().LoadVersion(record_id_, 1, &old,
+                                                     sizeof(old))) {
+    return false;
+  }
+
+  InitializeDefaults();
+  data_.avg_session_duration_s = old.avg_session_duration_s;
+  data_.positive_feedback_count = old.positive_feedback_count;
+  data_.negative_feedback_count = old.negative_feedback_count;
+  data_.created_ms = old.created_ms;
+  data_.last_update_ms = old.last_update_ms;
+
+  // 旧计数没有时间信息，全部视为现在发生；每小时计数平均分到一周七天
+  auto& activity = data_.activity;
+  int64_t now_s = GetActivityClockS();
+  activity.AddInteractions(now_s, old.interaction_count_7d);
+  for (int hour = 0; hour < 24; hour++) {
+    for (int day = 0; day < 7; day++) {
+      activity.AddHour(now_s, day * 24 + hour, old.active_hours[hour] / 7.0f);
+    }
+  }
+  activity.AddTopic(now_s, kTopicWeather, old.topic_weather);
+  activity.AddTopic(now_s, kTopicStory, old.topic_story);
+  activity.AddTopic(now_s, kTopicPet, old.topic_pet);
+  activity.AddTopic(now_s, kTopicSmartHome, old.topic_smart_home);
+  activity.AddTopic(now_s, kTopicChat, old.topic_chat);
+  activity.AddTopic(now_s, kTopicOther, old.topic_other);
+  return true;
 }
 
 // ========== 数据记录 ==========
 
 void UserProfile::RecordInteraction(const char* topic, uint32_t duration_ms) {
-  // 增加互动计数
-  data_.interaction_count_7d++;
+  LearningStateGuard lock(GetLearningStateMutex());
+  uint32_t old_count = GetInteractionCount7d();
   
   // 更新平均会话时长（简单移动平均）
   uint32_t duration_s = duration_ms / 1000;
@@ -63,38 +134,37 @@ void UserProfile::RecordInteraction(const char* topic, uint32_t duration_ms) {
         (data_.avg_session_duration_s * 4 + duration_s) / 5;
   }
   
-  // 增加话题计数
-  IncrementTopicCount(topic);
-  
-  // 更新时间活跃度
-  UpdateTimeActivity();
+  // 互动次数、当前时段、话题计数（O(1)）
+  data_.activity.Record(GetActivityClockS(), time_utils::GetHourOfWeek(),
+                        ParseActivityTopic(topic));
   
   // 更新时间戳
-  data_.last_update_ms = esp_timer_get_time() / 1000;
+  data_.last_update_ms = time_utils::GetUptimeMs();
   
-  // 🎯 关键修复：立即保存到 NVS（不再等待5分钟）
-  SaveToNVS();
+  // 交给持久化服务（写入在后台完成），并通知决策快照重建
+  OnDataChanged();
   
   // 🎯 详细日志展示学习过程
   ESP_LOGI(TAG, "🧠 Learning: topic=%s, duration=%us", 
            topic ? topic : "unknown", duration_s);
-  ESP_LOGI(TAG, "  📈 Total interactions: %u → %u", 
-           data_.interaction_count_7d - 1, data_.interaction_count_7d);
+  ESP_LOGI(TAG, "  📈 Interactions (7d): %lu → %lu", 
+           old_count, GetInteractionCount7d());
   ESP_LOGI(TAG, "  ⏱️  Avg session: %us → %us", 
            old_avg, data_.avg_session_duration_s);
   ESP_LOGI(TAG, "  ⭐ Favorite topic: %s", GetFavoriteTopic());
-  ESP_LOGI(TAG, "  💾 Immediately saved to NVS");
+  ESP_LOGI(TAG, "  💾 Queued for NVS");
 }
 
 void UserProfile::RecordFeedback(bool is_positive) {
+  LearningStateGuard lock(GetLearningStateMutex());
   if (is_positive) {
     data_.positive_feedback_count++;
   } else {
     data_.negative_feedback_count++;
   }
   
-  data_.last_update_ms = esp_timer_get_time() / 1000;
-  needs_save_ = true;
+  data_.last_update_ms = time_utils::GetUptimeMs();
+  OnDataChanged();
   
   ESP_LOGI(TAG, "Recorded feedback: %s (total: +%u / -%u, ratio: %u%%)",
            is_positive ? "positive" : "negative",
@@ -103,165 +173,83 @@ void UserProfile::RecordFeedback(bool is_positive) {
            data_.GetPositiveRatio());
 }
 
-void UserProfile::UpdateTimeActivity() {
-  // 获取当前小时
-  time_t now;
-  time(&now);
-  struct tm timeinfo;
-  localtime_r(&now, &timeinfo);
-  int hour = timeinfo.tm_hour;
-  
-  // 增加该小时的活跃度（上限255）
-  if (data_.active_hours[hour] < 255) {
-    data_.active_hours[hour]++;
-  }
+// ========== 数据查询 ==========
+
+uint32_t UserProfile::GetInteractionCount7d() const {
+  LearningStateGuard lock(GetLearningStateMutex());
+  return lroundf(data_.activity.GetInteractions(GetActivityClockS()));
 }
 
-void UserProfile::IncrementTopicCount(const char* topic) {
-  if (!topic) {
-    data_.topic_other++;
-    return;
-  }
-  
-  // 简单字符串匹配
-  if (strstr(topic, "weather") || strstr(topic, "天气")) {
-    data_.topic_weather++;
-  } else if (strstr(topic, "story") || strstr(topic, "故事")) {
-    data_.topic_story++;
-  } else if (strstr(topic, "pet") || strstr(topic, "宠物")) {
-    data_.topic_pet++;
-  } else if (strstr(topic, "smart_home") || strstr(topic, "智能家居") || 
-             strstr(topic, "control") || strstr(topic, "控制")) {
-    data_.topic_smart_home++;
-  } else if (strstr(topic, "chat") || strstr(topic, "聊天")) {
-    data_.topic_chat++;
-  } else {
-    data_.topic_other++;
-  }
+float UserProfile::GetCurrentHourShare() const {
+  LearningStateGuard lock(GetLearningStateMutex());
+  return data_.activity.GetHourShare(time_utils::GetHourOfWeek());
+}
+
+float UserProfile::GetTopicCount(ActivityTopic topic) const {
+  LearningStateGuard lock(GetLearningStateMutex());
+  return data_.activity.GetTopicCount(GetActivityClockS(), topic);
 }
 
 const char* UserProfile::GetFavoriteTopic() const {
-  uint16_t max_count = 0;
-  const char* favorite = "chat";
-  
-  if (data_.topic_weather > max_count) {
-    max_count = data_.topic_weather;
-    favorite = "weather";
-  }
-  if (data_.topic_story > max_count) {
-    max_count = data_.topic_story;
-    favorite = "story";
-  }
-  if (data_.topic_pet > max_count) {
-    max_count = data_.topic_pet;
-    favorite = "pet";
+  LearningStateGuard lock(GetLearningStateMutex());
+  // 没有任何话题记录时默认闲聊
+  if (!data_.activity.HasTopics()) {
+    return "chat";
   }
-  if (data_.topic_smart_home > max_count) {
-    max_count = data_.topic_smart_home;
-    favorite = "smart_home";
-  }
-  if (data_.topic_chat > max_count) {
-    favorite = "chat";
-  }
-  
-  return favorite;
+  return GetActivityTopicName(data_.activity.GetFavoriteTopic());
 }
 
 // ========== 持久化（NVS） ==========
 
+void UserProfile::OnDataChanged() {
+  SaveToNVS();
+  EventBus::GetInstance().PublishNonBlocking<ProfileUpdatedEvent>();
+}
+
 bool UserProfile::SaveToNVS() {
-  nvs_handle_t nvs;
-  esp_err_t err = nvs_open("user_profile", NVS_READWRITE, &nvs);
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "❌ Failed to open NVS: %s", esp_err_to_name(err));
+  LearningStateGuard lock(GetLearningStateMutex());
+  if (record_id_ < 0) {
+    ESP_LOGE(TAG, "❌ Profile record not registered");
     return false;
   }
-  
-  // 保存所有字段（使用二进制 blob 存储整个结构体，更高效）
-  err = nvs_set_blob(nvs, "profile_data", &data_, sizeof(data_));
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "❌ Failed to write profile data: %s", esp_err_to_name(err));
-    nvs_close(nvs);
-    return false;
-  }
-  
-  err = nvs_commit(nvs);
-  nvs_close(nvs);
-  
-  if (err != ESP_OK) {
-    ESP_LOGE(TAG, "❌ Failed to commit NVS: %s", esp_err_to_name(err));
-    return false;
-  }
-  
-  last_save_ms_ = esp_timer_get_time() / 1000;
-  needs_save_ = false;
-  
-  ESP_LOGI(TAG, "💾 Saved user profile to NVS (size: %u bytes, 7d互动: %u次)", 
-           sizeof(data_), data_.interaction_count_7d);
+  PersistenceService::GetInstance().Update(record_id_, &data_, sizeof(data_));
   return true;
 }
 
 bool UserProfile::LoadFromNVS() {
-  nvs_handle_t nvs;
-  esp_err_t err = nvs_open("user_profile", NVS_READONLY, &nvs);
-  if (err != ESP_OK) {
-    ESP_LOGD(TAG, "Profile not found in NVS (first run): %s", esp_err_to_name(err));
+  LearningStateGuard lock(GetLearningStateMutex());
+  if (!PersistenceService::GetInstance().Load(record_id_, &data_,
+                                              sizeof(data_))) {
+    ESP_LOGD(TAG, "Profile not found in NVS (first run)");
     return false;
   }
-  
-  // 读取二进制 blob
-  size_t required_size = sizeof(data_);
-  err = nvs_get_blob(nvs, "profile_data", &data_, &required_size);
-  nvs_close(nvs);
-  
-  if (err != ESP_OK || required_size != sizeof(data_)) {
-    ESP_LOGW(TAG, "Failed to read profile data: %s", esp_err_to_name(err));
-    return false;
-  }
-  
   return true;
 }
 
 void UserProfile::Reset() {
+  LearningStateGuard lock(GetLearningStateMutex());
   InitializeDefaults();
-  SaveToNVS();
+  OnDataChanged();
   ESP_LOGI(TAG, "🔄 User profile reset");
 }
 
 // ========== 辅助功能 ==========
 
 void UserProfile::PrintStats() const {
+  LearningStateGuard lock(GetLearningStateMutex());
   ESP_LOGI(TAG, "========== User Profile Stats ==========");
-  ESP_LOGI(TAG, "Interactions (7d): %lu", data_.interaction_count_7d);
+  ESP_LOGI(TAG, "Interactions (7d): %lu", GetInteractionCount7d());
   ESP_LOGI(TAG, "Avg session: %lus", data_.avg_session_duration_s);
-  ESP_LOGI(TAG, "Most active hour: %u:00", data_.GetMostActiveHour());
+  ESP_LOGI(TAG, "Most active hour: %u:00", GetMostActiveHour());
   ESP_LOGI(TAG, "Favorite topic: %s", GetFavoriteTopic());
   ESP_LOGI(TAG, "Positive ratio: %u%%", data_.GetPositiveRatio());
-  ESP_LOGI(TAG, "Topics: weather=%u story=%u pet=%u home=%u chat=%u other=%u",
-           data_.topic_weather, data_.topic_story, data_.topic_pet,
-           data_.topic_smart_home, data_.topic_chat, data_.topic_other);
+  ESP_LOGI(TAG, "Topics (30d): weather=%.1f story=%.1f pet=%.1f home=%.1f chat=%.1f other=%.1f",
+           GetTopicCount(kTopicWeather), GetTopicCount(kTopicStory),
+           GetTopicCount(kTopicPet), GetTopicCount(kTopicSmartHome),
+           GetTopicCount(kTopicChat), GetTopicCount(kTopicOther));
   ESP_LOGI(TAG, "========================================");
 }
 
-void UserProfile::SetAutoSaveInterval(uint32_t seconds) {
-  auto_save_interval_s_ = seconds;
-  ESP_LOGI(TAG, "Auto-save interval set to %lus", seconds);
-}
-
-void UserProfile::CheckAutoSave() {
-  if (!needs_save_) {
-    return;
-  }
-  
-  int64_t now_ms = esp_timer_get_time() / 1000;
-  int64_t elapsed_s = (now_ms - last_save_ms_) / 1000;
-  
-  if (elapsed_s >= auto_save_interval_s_) {
-    SaveToNVS();
-    ESP_LOGD(TAG, "💾 Auto-saved user profile");
-  }
-}
-
 }  // namespace xiaozhi
 
 
@@ -23,25 +23,10 @@ CircularStrip::CircularStrip(gpio_num_t gpio, uint8_t max_leds) : max_leds_(max_
 
     ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip_));
     led_strip_clear(led_strip_);
-
-    esp_timer_create_args_t strip_timer_args = {
-        .callback = [](void *arg) {
-            auto strip = static_cast<CircularStrip*>(arg);
-            std::lock_guard<std::mutex> lock(strip->mutex_);
-            if (strip->strip_callback_ != nullptr) {
-                strip->strip_callback_();
-            }
-        },
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "strip_timer",
-        .skip_unhandled_events = false,
-    };
-    ESP_ERROR_CHECK(esp_timer_create(&strip_timer_args, &strip_timer_));
 }
 
 CircularStrip::~CircularStrip() {
-    esp_timer_stop(strip_timer_);
+    strip_timer_.Cancel();
     if (led_strip_ != nullptr) {
         led_strip_del(led_strip_);
     }
@@ -50,7 +35,7 @@ CircularStrip::~CircularStrip() {
 
 void CircularStrip::SetAllColor(StripColor color) {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
+    strip_timer_.Cancel();
     for (int i = 0; i < max_leds_; i++) {
         colors_[i] = color;
         led_strip_set_pixel(led_strip_, i, color.red, color.green, color.blue);
@@ -60,7 +45,7 @@ void CircularStrip::SetAllColor(StripColor color) {
 
 void CircularStrip::SetSingleColor(uint8_t index, StripColor color) {
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
+    strip_timer_.Cancel();
     colors_[index] = color;
     led_strip_set_pixel(led_strip_, index, color.red, color.green, color.blue);
     led_strip_refresh(led_strip_);
@@ -98,7 +83,7 @@ void CircularStrip::FadeOut(int interval_ms) {
         }
         if (all_off) {
             led_strip_clear(led_strip_);
-            esp_timer_stop(strip_timer_);
+            strip_timer_.Cancel();
         } else {
             led_strip_refresh(led_strip_);
         }
@@ -170,10 +155,14 @@ void CircularStrip::StartStripTask(int interval_ms, std::function<void()> cb) {
     }
 
     std::lock_guard<std::mutex> lock(mutex_);
-    esp_timer_stop(strip_timer_);
-    
     strip_callback_ = cb;
-    esp_timer_start_periodic(strip_timer_, interval_ms * 1000);
+    // Animations must keep their pace, no slack
+    strip_timer_ = TimerService::GetInstance().StartPeriodic("strip", interval_ms, 0, [this]() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (strip_callback_ != nullptr) {
+            strip_callback_();
+        }
+    });
 }
 
 void CircularStrip::SetBrightness(uint8_t default_brightness, uint8_t low_brightness) {
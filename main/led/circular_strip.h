@@ -2,6 +2,7 @@
 #define _CIRCULAR_STRIP_H_
 
 #include "led.h"
+#include "timer_service.h"
 #include <driver/gpio.h>
 #include <led_strip.h>
 #include <esp_timer.h>
@@ -37,7 +38,7 @@ private:
     std::vector<StripColor> colors_;
     int blink_counter_ = 0;
     int blink_interval_ms_ = 0;
-    esp_timer_handle_t strip_timer_ = nullptr;
+    TimerHandle strip_timer_;
     std::function<void()> strip_callback_ = nullptr;
 
     uint8_t default_brightness_ = DEFAULT_BRIGHTNESS;
@@ -0,0 +1,174 @@
+#include "loop_profiler.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "LoopProfiler"
+
+static const char* BaseName(const char* path) {
+    if (path == nullptr) {
+        return "?";
+    }
+    const char* slash = strrchr(path, '/');
+    return slash != nullptr ? slash + 1 : path;
+}
+
+void LoopProfiler::Window::Add(uint32_t elapsed_us, bool slow) {
+    samples[next] = elapsed_us;
+    next = (next + 1) % LOOP_PROFILER_WINDOW_SIZE;
+    stats.count++;
+    if (slow) {
+        stats.slow++;
+    }
+    if (elapsed_us > stats.max_us) {
+        stats.max_us = elapsed_us;
+    }
+}
+
+LoopTimingStats LoopProfiler::Window::Snapshot() const {
+    LoopTimingStats result = stats;
+    size_t size = std::min<size_t>(stats.count, LOOP_PROFILER_WINDOW_SIZE);
+    if (size == 0) {
+        return result;
+    }
+    // Only sorted on request, the window is small
+    uint32_t sorted[LOOP_PROFILER_WINDOW_SIZE];
+    std::copy(samples, samples + size, sorted);
+    std::sort(sorted, sorted + size);
+    result.p50_us = sorted[size / 2];
+    result.p99_us = sorted[std::min(size - 1, size * 99 / 100)];
+    return result;
+}
+
+LoopProfiler::LoopProfiler(uint32_t stall_threshold_ms) : stall_threshold_us_(stall_threshold_ms * 1000) {
+}
+
+void LoopProfiler::BeginIteration() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    iteration_start_us_ = esp_timer_get_time();
+    iteration_worst_ = LoopSlowEntry();
+}
+
+void LoopProfiler::EndIteration() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    uint32_t elapsed_us = esp_timer_get_time() - iteration_start_us_;
+    bool slow = elapsed_us > stall_threshold_us_;
+    iterations_.Add(elapsed_us, slow);
+    if (slow) {
+        if (iteration_worst_.line > 0) {
+            ESP_LOGW(TAG, "Main loop stalled for %lu ms, slowest: task from %s:%d (%lu ms)",
+                elapsed_us / 1000, BaseName(iteration_worst_.name), iteration_worst_.line,
+                iteration_worst_.elapsed_us / 1000);
+        } else if (iteration_worst_.name != nullptr) {
+            ESP_LOGW(TAG, "Main loop stalled for %lu ms, slowest: %s (%lu ms)",
+                elapsed_us / 1000, iteration_worst_.name, iteration_worst_.elapsed_us / 1000);
+        } else {
+            ESP_LOGW(TAG, "Main loop stalled for %lu ms", elapsed_us / 1000);
+        }
+    }
+}
+
+void LoopProfiler::RecordSection(const char* name, uint32_t elapsed_us) {
+    Record(name, 0, elapsed_us, false);
+}
+
+void LoopProfiler::RecordTask(const char* file, int line, uint32_t elapsed_us) {
+    Record(file, line, elapsed_us, true);
+}
+
+void LoopProfiler::Record(const char* name, int line, uint32_t elapsed_us, bool is_task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t uptime_ms = esp_timer_get_time() / 1000;
+    if (is_task) {
+        bool slow = elapsed_us > stall_threshold_us_;
+        tasks_.Add(elapsed_us, slow);
+        if (slow) {
+            ESP_LOGW(TAG, "Slow task from %s:%d took %lu ms", BaseName(name), line, elapsed_us / 1000);
+        }
+    }
+
+    // The schedule section contains its tasks, prefer naming the task
+    if (elapsed_us > iteration_worst_.elapsed_us && (is_task || iteration_worst_.line == 0)) {
+        iteration_worst_ = LoopSlowEntry{name, line, elapsed_us, uptime_ms};
+    }
+
+    // Replace the fastest of the slowest entries
+    auto fastest = std::min_element(std::begin(slowest_), std::end(slowest_),
+        [](const LoopSlowEntry& a, const LoopSlowEntry& b) { return a.elapsed_us < b.elapsed_us; });
+    if (elapsed_us > fastest->elapsed_us) {
+        *fastest = LoopSlowEntry{name, line, elapsed_us, uptime_ms};
+    }
+}
+
+LoopTimingStats LoopProfiler::GetIterationStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return iterations_.Snapshot();
+}
+
+LoopTimingStats LoopProfiler::GetTaskStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return tasks_.Snapshot();
+}
+
+std::string LoopProfiler::GetStatusJson() {
+    LoopSlowEntry slowest[LOOP_PROFILER_SLOWEST_COUNT];
+    LoopTimingStats iterations;
+    LoopTimingStats tasks;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        iterations = iterations_.Snapshot();
+        tasks = tasks_.Snapshot();
+        std::copy(std::begin(slowest_), std::end(slowest_), slowest);
+    }
+    std::sort(std::begin(slowest), std::end(slowest),
+        [](const LoopSlowEntry& a, const LoopSlowEntry& b) { return a.elapsed_us > b.elapsed_us; });
+
+    auto timing_json = [](const LoopTimingStats& stats) {
+        return "{\"count\":" + std::to_string(stats.count) +
+            ",\"slow\":" + std::to_string(stats.slow) +
+            ",\"p50_us\":" + std::to_string(stats.p50_us) +
+            ",\"p99_us\":" + std::to_string(stats.p99_us) +
+            ",\"max_us\":" + std::to_string(stats.max_us) + "}";
+    };
+
+    std::string json = "{\"stall_threshold_ms\":" + std::to_string(stall_threshold_us_ / 1000);
+    json += ",\"iterations\":" + timing_json(iterations);
+    json += ",\"tasks\":" + timing_json(tasks);
+    json += ",\"slowest\":[";
+    bool first = true;
+    for (auto& entry : slowest) {
+        if (entry.name == nullptr) {
+            continue;
+        }
+        if (!first) {
+            json += ",";
+        }
+        first = false;
+        std::string site = BaseName(entry.name);
+        if (entry.line > 0) {
+            site += ":" + std::to_string(entry.line);
+        }
+        json += "{\"site\":\"" + site + "\",\"us\":" + std::to_string(entry.elapsed_us) +
+            ",\"uptime_ms\":" + std::to_string(entry.uptime_ms) + "}";
+    }
+    json += "]}";
+    return json;
+}
+
+void LoopProfiler::LogStats() {
+    auto iterations = GetIterationStats();
+    auto tasks = GetTaskStats();
+    ESP_LOGI(TAG, "iterations: %lu, p50 %lu us, p99 %lu us, max %lu us, stalls %lu",
+        iterations.count, iterations.p50_us, iterations.p99_us, iterations.max_us, iterations.slow);
+    ESP_LOGI(TAG, "tasks: %lu, p50 %lu us, p99 %lu us, max %lu us, slow %lu",
+        tasks.count, tasks.p50_us, tasks.p99_us, tasks.max_us, tasks.slow);
+}
+
+void LoopProfiler::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    iterations_ = Window();
+    tasks_ = Window();
+    std::fill(std::begin(slowest_), std::end(slowest_), LoopSlowEntry());
+}
@@ -0,0 +1,87 @@
+#ifndef _LOOP_PROFILER_H_
+#define _LOOP_PROFILER_H_
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include <esp_timer.h>
+
+// Samples kept for the rolling percentiles
+#define LOOP_PROFILER_WINDOW_SIZE 256
+#define LOOP_PROFILER_SLOWEST_COUNT 8
+
+struct LoopTimingStats {
+    uint32_t count = 0;     // Samples since the last reset
+    uint32_t slow = 0;      // Samples above the stall threshold
+    uint32_t p50_us = 0;    // Over the last LOOP_PROFILER_WINDOW_SIZE samples
+    uint32_t p99_us = 0;
+    uint32_t max_us = 0;    // Since the last reset
+};
+
+struct LoopSlowEntry {
+    const char* name = nullptr;     // Section name, or source file of a scheduled task
+    int line = 0;                   // 0 for event loop sections
+    uint32_t elapsed_us = 0;
+    int64_t uptime_ms = 0;
+};
+
+/*
+ * Timing of the main event loop: whole iterations, the event branches and
+ * every scheduled task tagged with the place it was scheduled from. Keeps a
+ * rolling window for p50/p99 and the slowest tasks seen, and logs anything
+ * above the stall threshold as it happens.
+ */
+class LoopProfiler {
+public:
+    // Times one event branch of the loop
+    class Section {
+    public:
+        Section(LoopProfiler& profiler, const char* name)
+            : profiler_(profiler), name_(name), start_time_(esp_timer_get_time()) {}
+        ~Section() {
+            profiler_.RecordSection(name_, esp_timer_get_time() - start_time_);
+        }
+
+    private:
+        LoopProfiler& profiler_;
+        const char* name_;
+        int64_t start_time_;
+    };
+
+    explicit LoopProfiler(uint32_t stall_threshold_ms);
+
+    void BeginIteration();
+    void EndIteration();
+    void RecordSection(const char* name, uint32_t elapsed_us);
+    void RecordTask(const char* file, int line, uint32_t elapsed_us);
+
+    LoopTimingStats GetIterationStats();
+    LoopTimingStats GetTaskStats();
+    std::string GetStatusJson();
+    void LogStats();
+    void Reset();
+
+private:
+    struct Window {
+        uint32_t samples[LOOP_PROFILER_WINDOW_SIZE] = {};
+        size_t next = 0;
+        LoopTimingStats stats;
+
+        void Add(uint32_t elapsed_us, bool slow);
+        LoopTimingStats Snapshot() const;
+    };
+
+    std::mutex mutex_;
+    uint32_t stall_threshold_us_;
+    int64_t iteration_start_us_ = 0;
+    // Slowest section or task of the running iteration, named in the stall log
+    LoopSlowEntry iteration_worst_;
+    Window iterations_;
+    Window tasks_;
+    LoopSlowEntry slowest_[LOOP_PROFILER_SLOWEST_COUNT];
+
+    void Record(const char* name, int line, uint32_t elapsed_us, bool is_task);
+};
+
+#endif // _LOOP_PROFILER_H_
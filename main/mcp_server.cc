@@ -9,6 +9,8 @@
 #include <algorithm>
 #include <cstring>
 #include <esp_pthread.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
 
 #include "application.h"
 #include "display.h"
@@ -18,9 +20,15 @@
 #include "lvgl_theme.h"
 #include "lvgl_display.h"
 #include "pet_system.h"
+#include "protocol_recorder.h"
+#include "timer_service.h"
+#include "event_journal.h"
+#include "persistence_service.h"
+#include "core/event_bus.h"
 #include "learning/user_profile.h"
 #include "learning/adaptive_behavior.h"
 #include "learning/emotional_memory.h"
+#include "learning/learning_simulator.h"
 
 #define TAG "MCP"
 
@@ -144,7 +152,7 @@ void McpServer::AddCommonTools() {
             int freq_level = adaptive.GetUserFrequencyLevel();
             const char* freq_desc[] = {"低频用户", "中频用户", "高频用户"};
             cJSON_AddStringToObject(root, "frequency_level", freq_desc[freq_level]);
-            cJSON_AddNumberToObject(root, "interactions_7d", user_profile.GetData().interaction_count_7d);
+            cJSON_AddNumberToObject(root, "interactions_7d", user_profile.GetInteractionCount7d());
             
             // Emotional state
             cJSON* emotions = cJSON_CreateObject();
@@ -167,7 +175,7 @@ void McpServer::AddCommonTools() {
             if (emotional.GetTrustLevel() > 70) {
                 cJSON_AddItemToArray(suggestions, cJSON_CreateString("用户信任度高，可以分享更深入的话题"));
             }
-            if (user_profile.GetData().interaction_count_7d > 15) {
+            if (user_profile.GetInteractionCount7d() > 15) {
                 cJSON_AddItemToArray(suggestions, cJSON_CreateString("高频用户，宠物衰减速度已加快"));
             }
             cJSON_AddItemToObject(root, "ai_suggestions", suggestions);
@@ -238,6 +246,134 @@ void McpServer::AddUserOnlyTools() {
             return true;
         });
 
+    // Protocol recorder, the dump is decoded by scripts/protocol_replay.py
+    AddUserOnlyTool("self.protocol_recorder.start", "Start recording every protocol message into PSRAM, discarding the previous recording",
+        PropertyList({
+            Property("size_kb", kPropertyTypeInteger, PROTOCOL_RECORDER_DEFAULT_CAPACITY / 1024, 16, 4096)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& recorder = ProtocolRecorder::GetInstance();
+            if (!recorder.Start(properties["size_kb"].value<int>() * 1024)) {
+                throw std::runtime_error("Failed to allocate the recording buffer");
+            }
+            return recorder.GetStatusJson();
+        });
+
+    AddUserOnlyTool("self.protocol_recorder.stop", "Stop recording protocol messages",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& recorder = ProtocolRecorder::GetInstance();
+            recorder.Stop();
+            return recorder.GetStatusJson();
+        });
+
+    AddUserOnlyTool("self.protocol_recorder.dump", "Print the recorded protocol log to the serial console",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& recorder = ProtocolRecorder::GetInstance();
+            recorder.Stop();
+            recorder.DumpToLog();
+            return recorder.GetStatusJson();
+        });
+
+    AddUserOnlyTool("self.diagnostics.main_loop", "Main event loop timing: p50/p99/max of loop iterations and scheduled tasks, stall counts and the slowest tasks with where they were scheduled from",
+        PropertyList({
+            Property("reset", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& profiler = Application::GetInstance().GetLoopProfiler();
+            auto json = profiler.GetStatusJson();
+            if (properties["reset"].value<bool>()) {
+                profiler.Reset();
+            }
+            return json;
+        });
+
+    AddUserOnlyTool("self.diagnostics.state_trace", "Device state machine trace: time spent in each state, the last transitions with their timing, and transitions the state table rejected",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return Application::GetInstance().GetStateMachine().GetStatusJson();
+        });
+
+    AddUserOnlyTool("self.diagnostics.timers", "Software timer statistics: total wakeups and, per timer, how often it fired, how often it caused the wakeup and how often it shared another timer's wakeup",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return TimerService::GetInstance().GetStatusJson();
+        });
+
+    AddUserOnlyTool("self.diagnostics.event_bus", "Event bus statistics: published, dropped and delivered events, payload pool exhaustion, and per delivery policy how many events were coalesced, debounced or dropped",
+        PropertyList(),
+        [](const PropertyList& properties) -> ReturnValue {
+            return xiaozhi::EventBus::GetInstance().GetStatusJson();
+        });
+
+    AddUserOnlyTool("self.diagnostics.event_bus_benchmark", "Publishes the given number of 64-byte events through raw esp_event posts (payload copied per post) and through the typed pooled path, and reports throughput and publish-to-handler latency for each",
+        PropertyList({
+            Property("count", kPropertyTypeInteger, 200, 10, 2000)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            return xiaozhi::EventBus::GetInstance().RunBenchmarkJson(properties["count"].value<int>());
+        });
+
+    AddUserOnlyTool("self.diagnostics.journal", "Flash event journal kept across reboots: the most recent records (boots with reset reason, state changes, protocol errors, heap lows, queue overflows, bus events). Set dump to also print the whole journal to the console for scripts/journal_decode.py",
+        PropertyList({
+            Property("count", kPropertyTypeInteger, 32, 1, 128),
+            Property("dump", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& journal = EventJournal::GetInstance();
+            if (properties["dump"].value<bool>()) {
+                journal.DumpToLog();
+            }
+            return journal.GetStatusJson(properties["count"].value<int>());
+        });
+
+    AddUserOnlyTool("self.diagnostics.persistence", "Write-behind NVS records (user profile, emotional memory, pet state): updates, updates coalesced into one write, commits skipped as unchanged, flash writes and failures per record. Set flush to write dirty records now",
+        PropertyList({
+            Property("flush", kPropertyTypeBoolean, false)
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& persistence = PersistenceService::GetInstance();
+            if (properties["flush"].value<bool>()) {
+                persistence.Flush();
+            }
+            return persistence.GetStatusJson();
+        });
+
+    AddUserOnlyTool("self.diagnostics.simulate_learning", "Replays a daily schedule on a virtual clock through the pet, user profile, emotional memory and adaptive behavior, starting from default state, and reports the end-of-day trajectory and CPU time per pet wake-up and per action. The real state is left untouched and flash is not written; the simulated state is swapped in one step at a time, so the device keeps working while it runs. Runs in the background: call with days > 0 to start, then with days = 0 to get progress or the last report. Schedule is \"HH:MM action,...\" with actions feed, clean, play, hug, like, dislike or a chat topic (chat, weather, story, pet, smart_home); empty uses a default day",
+        PropertyList({
+            Property("days", kPropertyTypeInteger, 0, 0, 365),
+            Property("absent_days", kPropertyTypeInteger, 0, 0, 365),
+            Property("jitter_min", kPropertyTypeInteger, 20, 0, 120),
+            Property("seed", kPropertyTypeInteger, 1, 0, 1000000),
+            Property("schedule", kPropertyTypeString, "")
+        }),
+        [](const PropertyList& properties) -> ReturnValue {
+            auto& simulator = xiaozhi::LearningSimulator::GetInstance();
+            int days = properties["days"].value<int>();
+            if (days > 0) {
+                xiaozhi::SimulationConfig config;
+                config.days = days;
+                config.absent_days = std::min(properties["absent_days"].value<int>(), days);
+                config.jitter_min = properties["jitter_min"].value<int>();
+                config.seed = properties["seed"].value<int>();
+                config.schedule = properties["schedule"].value<std::string>();
+                std::string error;
+                if (!simulator.Start(config, &error)) {
+                    throw std::runtime_error(error);
+                }
+            }
+            return simulator.GetReportJson();
+        });
+
+    AddUserOnlyTool("self.diagnostics.mcp_serialization", "Serializes the schemas of all registered tools (as tools/list does, without paging) the given number of times and reports the output size, time per pass and heap used by the writer buffer",
+        PropertyList({
+            Property("iterations", kPropertyTypeInteger, 10, 1, 100)
+        }),
+        [this](const PropertyList& properties) -> ReturnValue {
+            return GetSerializationBenchmarkJson(properties["iterations"].value<int>());
+        });
+
     // Firmware upgrade
     AddUserOnlyTool("self.upgrade_firmware", "Upgrade firmware from a specific URL. This will download and install the firmware, then reboot the device.",
         PropertyList({
@@ -546,6 +682,15 @@ void McpServer::ParseMessage(const std::string& message) {
     cJSON_Delete(json);
 }
 
+void McpServer::RegisterMessageHandlers(MessageDispatcher& dispatcher) {
+    dispatcher.Register("mcp", [this](const IncomingMessage& message) {
+        auto payload = cJSON_GetObjectItem(message.root(), "payload");
+        if (cJSON_IsObject(payload)) {
+            ParseMessage(payload);
+        }
+    });
+}
+
 void McpServer::ParseCapabilities(const cJSON* capabilities) {
     auto vision = cJSON_GetObjectItem(capabilities, "vision");
     if (cJSON_IsObject(vision)) {
@@ -607,10 +752,17 @@ void McpServer::ParseMessage(const cJSON* json) {
             }
         }
         auto app_desc = esp_app_get_description();
-        std::string message = "{\"protocolVersion\":\"2024-11-05\",\"capabilities\":{\"tools\":{}},\"serverInfo\":{\"name\":\"" BOARD_NAME "\",\"version\":\"";
-        message += app_desc->version;
-        message += "\"}}";
-        ReplyResult(id_int, message);
+        Reply(id_int, "result", [app_desc](xiaozhi::JsonWriter& json) {
+            json.BeginObject()
+                .Key("protocolVersion").String("2024-11-05")
+                .Key("capabilities").Raw("{\"tools\":{}}")
+                .Key("serverInfo").BeginObject()
+                    .Key("name").String(BOARD_NAME)
+                    .Key("version").String(app_desc->version)
+                    .EndObject()
+                .EndObject();
+            return true;
+        });
     } else if (method_str == "tools/list") {
         std::string cursor_str = "";
         bool list_user_only_tools = false;
@@ -650,77 +802,130 @@ void McpServer::ParseMessage(const cJSON* json) {
     }
 }
 
-void McpServer::ReplyResult(int id, const std::string& result) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id) + ",\"result\":";
-    payload += result;
-    payload += "}";
-    Application::GetInstance().SendMcpMessage(payload);
+template <typename WriteValue>
+bool McpServer::Reply(int id, const char* member, WriteValue&& write_value) {
+    // 网络任务和主循环都会回复：共享缓冲区被占用时改用临时缓冲区，不等待
+    std::unique_lock<std::mutex> lock(reply_mutex_, std::try_to_lock);
+    std::string local_buffer;
+    std::string& buffer = lock.owns_lock() ? reply_buffer_ : local_buffer;
+    
+    buffer.clear();
+    xiaozhi::JsonWriter json(buffer);
+    json.BeginObject()
+        .Key("jsonrpc").String("2.0")
+        .Key("id").Int(id)
+        .Key(member);
+    bool ok = write_value(json);
+    if (ok) {
+        json.EndObject();
+        Application::GetInstance().SendMcpMessage(buffer);
+    }
+    
+    if (buffer.capacity() > MAX_RETAINED_REPLY_SIZE) {
+        std::string().swap(buffer);
+    }
+    return ok;
 }
 
 void McpServer::ReplyError(int id, const std::string& message) {
-    std::string payload = "{\"jsonrpc\":\"2.0\",\"id\":";
-    payload += std::to_string(id);
-    payload += ",\"error\":{\"message\":\"";
-    payload += message;
-    payload += "\"}}";
-    Application::GetInstance().SendMcpMessage(payload);
+    Reply(id, "error", [&message](xiaozhi::JsonWriter& json) {
+        json.BeginObject().Key("message").String(message).EndObject();
+        return true;
+    });
 }
 
 void McpServer::GetToolsList(int id, const std::string& cursor, bool list_user_only_tools) {
-    const int max_payload_size = 8000;
-    std::string json = "{\"tools\":[";
+    const size_t max_payload_size = 8000;
     
-    bool found_cursor = cursor.empty();
+    // 从 cursor 指定的工具开始，找不到时不返回任何工具
     auto it = tools_.begin();
+    if (!cursor.empty()) {
+        it = std::find_if(tools_.begin(), tools_.end(),
+                          [&cursor](const McpTool* tool) { return tool->name() == cursor; });
+    }
     std::string next_cursor = "";
     
-    while (it != tools_.end()) {
-        // 如果我们还没有找到起始位置，继续搜索
-        if (!found_cursor) {
-            if ((*it)->name() == cursor) {
-                found_cursor = true;
-            } else {
-                ++it;
+    bool sent = Reply(id, "result", [&](xiaozhi::JsonWriter& json) {
+        size_t result_start = json.buffer().size();
+        int count = 0;
+        json.BeginObject().Key("tools").BeginArray();
+        
+        for (; it != tools_.end(); ++it) {
+            if (!list_user_only_tools && (*it)->user_only()) {
                 continue;
             }
-        }
-
-        if (!list_user_only_tools && (*it)->user_only()) {
-            ++it;
-            continue;
+            
+            // 写入后超出大小限制则撤回，设置next_cursor并退出循环
+            auto checkpoint = json.GetCheckpoint();
+            (*it)->WriteJson(json);
+            if (json.buffer().size() - result_start + 30 > max_payload_size) {
+                json.Rollback(checkpoint);
+                next_cursor = (*it)->name();
+                break;
+            }
+            count++;
         }
         
-        // 添加tool前检查大小
-        std::string tool_json = (*it)->to_json() + ",";
-        if (json.length() + tool_json.length() + 30 > max_payload_size) {
-            // 如果添加这个tool会超出大小限制，设置next_cursor并退出循环
-            next_cursor = (*it)->name();
-            break;
+        if (count == 0 && !tools_.empty()) {
+            return false;
         }
         
-        json += tool_json;
-        ++it;
-    }
-    
-    if (json.back() == ',') {
-        json.pop_back();
-    }
+        json.EndArray();
+        if (!next_cursor.empty()) {
+            json.Key("nextCursor").String(next_cursor);
+        }
+        json.EndObject();
+        return true;
+    });
     
-    if (json.back() == '[' && !tools_.empty()) {
+    if (!sent) {
         // 如果没有添加任何tool，返回错误
         ESP_LOGE(TAG, "tools/list: Failed to add tool %s because of payload size limit", next_cursor.c_str());
         ReplyError(id, "Failed to add tool " + next_cursor + " because of payload size limit");
-        return;
     }
+}
 
-    if (next_cursor.empty()) {
-        json += "]}";
-    } else {
-        json += "],\"nextCursor\":\"" + next_cursor + "\"}";
+std::string McpServer::GetSerializationBenchmarkJson(int iterations) {
+    // 与 tools/list 相同的序列化路径，一次写出全部工具（不分页）
+    size_t free_before = heap_caps_get_free_size(MALLOC_CAP_8BIT);
+    size_t min_free = free_before;
+    int64_t first_us = 0;
+    int64_t total_us = 0;
+    int64_t max_us = 0;
+    std::string buffer;
+    
+    for (int i = 0; i < iterations; i++) {
+        int64_t start = esp_timer_get_time();
+        buffer.clear();
+        xiaozhi::JsonWriter json(buffer);
+        json.BeginObject().Key("tools").BeginArray();
+        for (auto tool : tools_) {
+            tool->WriteJson(json);
+        }
+        json.EndArray().EndObject();
+        int64_t us = esp_timer_get_time() - start;
+        
+        if (i == 0) {
+            first_us = us;  // 包含缓冲区增长
+        }
+        total_us += us;
+        max_us = std::max(max_us, us);
+        min_free = std::min(min_free, heap_caps_get_free_size(MALLOC_CAP_8BIT));
     }
     
-    ReplyResult(id, json);
+    std::string result;
+    xiaozhi::JsonWriter json(result);
+    json.BeginObject()
+        .Key("tools").Int(tools_.size())
+        .Key("bytes").Int(buffer.size())
+        .Key("iterations").Int(iterations)
+        .Key("first_us").Int(first_us)
+        .Key("avg_us").Int(iterations > 0 ? total_us / iterations : 0)
+        .Key("max_us").Int(max_us)
+        .Key("buffer_capacity").Int(buffer.capacity())
+        .Key("peak_heap_bytes").Int(free_before - min_free)
+        .EndObject();
+    return result;
 }
 
 void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments) {
@@ -769,7 +974,10 @@ void McpServer::DoToolCall(int id, const std::string& tool_name, const cJSON* to
     auto& app = Application::GetInstance();
     app.Schedule([this, id, tool_iter, arguments = std::move(arguments)]() {
         try {
-            ReplyResult(id, (*tool_iter)->Call(arguments));
+            Reply(id, "result", [&](xiaozhi::JsonWriter& json) {
+                (*tool_iter)->Call(arguments, json);
+                return true;
+            });
         } catch (const std::exception& e) {
             ESP_LOGE(TAG, "tools/call: %s", e.what());
             ReplyError(id, e.what());
@@ -9,10 +9,14 @@
 #include <optional>
 #include <stdexcept>
 #include <thread>
+#include <mutex>
 #include <mbedtls/base64.h>
 
 #include <cJSON.h>
 
+#include "message_dispatcher.h"
+#include "utils/json_writer.h"
+
 class ImageContent {
 private:
     std::string encoded_data_;
@@ -34,14 +38,14 @@ public:
     }
 
     std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "type", "image");
-        cJSON_AddStringToObject(json, "mimeType", mime_type_.c_str());
-        cJSON_AddStringToObject(json, "data", encoded_data_.c_str());
-        char* json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
+        std::string result;
+        result.reserve(encoded_data_.size() + mime_type_.size() + 48);
+        xiaozhi::JsonWriter json(result);
+        json.BeginObject()
+            .Key("type").String("image")
+            .Key("mimeType").String(mime_type_)
+            .Key("data").String(encoded_data_)
+            .EndObject();
         return result;
     }
 };
@@ -120,38 +124,33 @@ public:
         value_ = value;
     }
 
-    std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
+    void WriteJson(xiaozhi::JsonWriter& json) const {
+        json.BeginObject();
         
         if (type_ == kPropertyTypeBoolean) {
-            cJSON_AddStringToObject(json, "type", "boolean");
+            json.Key("type").String("boolean");
             if (has_default_value_) {
-                cJSON_AddBoolToObject(json, "default", value<bool>());
+                json.Key("default").Bool(value<bool>());
             }
         } else if (type_ == kPropertyTypeInteger) {
-            cJSON_AddStringToObject(json, "type", "integer");
+            json.Key("type").String("integer");
             if (has_default_value_) {
-                cJSON_AddNumberToObject(json, "default", value<int>());
+                json.Key("default").Int(value<int>());
             }
             if (min_value_.has_value()) {
-                cJSON_AddNumberToObject(json, "minimum", min_value_.value());
+                json.Key("minimum").Int(min_value_.value());
             }
             if (max_value_.has_value()) {
-                cJSON_AddNumberToObject(json, "maximum", max_value_.value());
+                json.Key("maximum").Int(max_value_.value());
             }
         } else if (type_ == kPropertyTypeString) {
-            cJSON_AddStringToObject(json, "type", "string");
+            json.Key("type").String("string");
             if (has_default_value_) {
-                cJSON_AddStringToObject(json, "default", value<std::string>().c_str());
+                json.Key("default").String(std::get<std::string>(value_));
             }
         }
         
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
-        return result;
+        json.EndObject();
     }
 };
 
@@ -188,20 +187,31 @@ public:
         return required;
     }
 
-    std::string to_json() const {
-        cJSON *json = cJSON_CreateObject();
-        
+    void WriteJson(xiaozhi::JsonWriter& json) const {
+        json.BeginObject();
         for (const auto& property : properties_) {
-            cJSON *prop_json = cJSON_Parse(property.to_json().c_str());
-            cJSON_AddItemToObject(json, property.name().c_str(), prop_json);
+            json.Key(property.name());
+            property.WriteJson(json);
+        }
+        json.EndObject();
+    }
+
+    // 写入 inputSchema 的 required 数组，没有必填参数时不写入
+    void WriteRequired(xiaozhi::JsonWriter& json) const {
+        bool any = false;
+        for (const auto& property : properties_) {
+            if (property.has_default_value()) {
+                continue;
+            }
+            if (!any) {
+                json.Key("required").BeginArray();
+                any = true;
+            }
+            json.String(property.name());
+        }
+        if (any) {
+            json.EndArray();
         }
-        
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
-        return result;
     }
 };
 
@@ -229,85 +239,59 @@ public:
     inline const PropertyList& properties() const { return properties_; }
     inline bool user_only() const { return user_only_; }
 
-    std::string to_json() const {
-        std::vector<std::string> required = properties_.GetRequired();
-        
-        cJSON *json = cJSON_CreateObject();
-        cJSON_AddStringToObject(json, "name", name_.c_str());
-        cJSON_AddStringToObject(json, "description", description_.c_str());
-        
-        cJSON *input_schema = cJSON_CreateObject();
-        cJSON_AddStringToObject(input_schema, "type", "object");
-        
-        cJSON *properties = cJSON_Parse(properties_.to_json().c_str());
-        cJSON_AddItemToObject(input_schema, "properties", properties);
-        
-        if (!required.empty()) {
-            cJSON *required_array = cJSON_CreateArray();
-            for (const auto& property : required) {
-                cJSON_AddItemToArray(required_array, cJSON_CreateString(property.c_str()));
-            }
-            cJSON_AddItemToObject(input_schema, "required", required_array);
-        }
+    // 单次写出工具描述，不经过 cJSON 树和中间字符串
+    void WriteJson(xiaozhi::JsonWriter& json) const {
+        json.BeginObject()
+            .Key("name").String(name_)
+            .Key("description").String(description_);
         
-        cJSON_AddItemToObject(json, "inputSchema", input_schema);
+        json.Key("inputSchema").BeginObject()
+            .Key("type").String("object")
+            .Key("properties");
+        properties_.WriteJson(json);
+        properties_.WriteRequired(json);
+        json.EndObject();
 
         // Add audience annotation if the tool is user only (invisible to AI)
         if (user_only_) {
-            cJSON *annotations = cJSON_CreateObject();
-            cJSON *audience = cJSON_CreateArray();
-            cJSON_AddItemToArray(audience, cJSON_CreateString("user"));
-            cJSON_AddItemToObject(annotations, "audience", audience);
-            cJSON_AddItemToObject(json, "annotations", annotations);
+            json.Key("annotations").BeginObject()
+                .Key("audience").BeginArray().String("user").EndArray()
+                .EndObject();
         }
         
-        char *json_str = cJSON_PrintUnformatted(json);
-        std::string result(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(json);
-        
-        return result;
+        json.EndObject();
     }
 
-    std::string Call(const PropertyList& properties) {
+    // 调用工具并把结果直接写入回复
+    void Call(const PropertyList& properties, xiaozhi::JsonWriter& json) {
         ReturnValue return_value = callback_(properties);
-        // 返回结果
-        cJSON* result = cJSON_CreateObject();
-        cJSON* content = cJSON_CreateArray();
+        json.BeginObject().Key("content").BeginArray().BeginObject();
 
         if (std::holds_alternative<ImageContent*>(return_value)) {
             auto image_content = std::get<ImageContent*>(return_value);
-            cJSON* image = cJSON_CreateObject();
-            cJSON_AddStringToObject(image, "type", "image");
-            cJSON_AddStringToObject(image, "image", image_content->to_json().c_str());
-            cJSON_AddItemToArray(content, image);
+            json.Key("type").String("image");
+            json.Key("image").String(image_content->to_json());
             delete image_content;
         } else {
-            cJSON* text = cJSON_CreateObject();
-            cJSON_AddStringToObject(text, "type", "text");
+            json.Key("type").String("text");
             if (std::holds_alternative<std::string>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<std::string>(return_value).c_str());
+                json.Key("text").String(std::get<std::string>(return_value));
             } else if (std::holds_alternative<bool>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::get<bool>(return_value) ? "true" : "false");
+                json.Key("text").String(std::get<bool>(return_value) ? "true" : "false");
             } else if (std::holds_alternative<int>(return_value)) {
-                cJSON_AddStringToObject(text, "text", std::to_string(std::get<int>(return_value)).c_str());
+                json.Key("text").String(std::to_string(std::get<int>(return_value)));
             } else if (std::holds_alternative<cJSON*>(return_value)) {
-                cJSON* json = std::get<cJSON*>(return_value);
-                char* json_str = cJSON_PrintUnformatted(json);
-                cJSON_AddStringToObject(text, "text", json_str);
+                cJSON* value = std::get<cJSON*>(return_value);
+                char* json_str = cJSON_PrintUnformatted(value);
+                json.Key("text").String(json_str);
                 cJSON_free(json_str);
-                cJSON_Delete(json);
+                cJSON_Delete(value);
             }
-            cJSON_AddItemToArray(content, text);
         }
-        cJSON_AddItemToObject(result, "content", content);
-        cJSON_AddBoolToObject(result, "isError", false);
-
-        auto json_str = cJSON_PrintUnformatted(result);
-        std::string result_str(json_str);
-        cJSON_free(json_str);
-        cJSON_Delete(result);
-        return result_str;
+
+        json.EndObject().EndArray();
+        json.Key("isError").Bool(false);
+        json.EndObject();
     }
 };
 
@@ -325,6 +309,7 @@ public:
     void AddUserOnlyTool(const std::string& name, const std::string& description, const PropertyList& properties, std::function<ReturnValue(const PropertyList&)> callback);
     void ParseMessage(const cJSON* json);
     void ParseMessage(const std::string& message);
+    void RegisterMessageHandlers(MessageDispatcher& dispatcher);
 
 private:
     McpServer();
@@ -332,13 +317,22 @@ private:
 
     void ParseCapabilities(const cJSON* capabilities);
 
-    void ReplyResult(int id, const std::string& result);
+    // 把 JSON-RPC 回复写入可复用的缓冲区后发送；write_value 写入 member 的值，返回 false 时不发送
+    template <typename WriteValue>
+    bool Reply(int id, const char* member, WriteValue&& write_value);
     void ReplyError(int id, const std::string& message);
 
     void GetToolsList(int id, const std::string& cursor, bool list_user_only_tools);
     void DoToolCall(int id, const std::string& tool_name, const cJSON* tool_arguments);
 
+    std::string GetSerializationBenchmarkJson(int iterations);
+
     std::vector<McpTool*> tools_;
+
+    // 回复缓冲区，超过 MAX_RETAINED_REPLY_SIZE 的（图片、工具列表）发送后释放
+    std::mutex reply_mutex_;
+    std::string reply_buffer_;
+    static constexpr size_t MAX_RETAINED_REPLY_SIZE = 4096;
 };
 
 #endif // MCP_SERVER_H
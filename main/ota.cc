@@ -2,6 +2,7 @@
 #include "system_info.h"
 #include "settings.h"
 #include "assets/lang_config.h"
+#include "core/event_bus.h"
 
 #include <cJSON.h>
 #include <esp_log.h>
@@ -201,6 +202,8 @@ bool Ota::CheckVersion() {
             tv.tv_usec = (suseconds_t)((long long)ts % 1000) * 1000;  // 剩余的毫秒转换为微秒
             settimeofday(&tv, NULL);
             has_server_time_ = true;
+            // 按小时计算的参数（作息、整点定时器）需要按新时间重新计算
+            xiaozhi::EventBus::GetInstance().Publish<xiaozhi::TimeSyncedEvent>();
         }
     } else {
         ESP_LOGW(TAG, "No server_time section found!");
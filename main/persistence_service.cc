@@ -0,0 +1,329 @@
+#include "persistence_service.h"
+
+#include <esp_log.h>
+#include <esp_rom_crc.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+#include <nvs.h>
+#include <nvs_flash.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "Persistence"
+
+static uint32_t PayloadCrc(const void* data, size_t size) {
+    return esp_rom_crc32_le(0, (const uint8_t*)data, size);
+}
+
+PersistenceService::PersistenceService() {
+    // esp_restart() runs the shutdown handlers before it stops the other tasks
+    esp_register_shutdown_handler([]() {
+        PersistenceService::GetInstance().Flush();
+    });
+}
+
+PersistentRecordId PersistenceService::Register(const char* name, const char* ns, const char* key,
+                                                uint16_t version, size_t size, uint32_t commit_delay_ms) {
+    if (size == 0 || size > PERSISTENCE_MAX_RECORD_SIZE) {
+        ESP_LOGE(TAG, "Record %s has invalid size %u", name, size);
+        return -1;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (size_t i = 0; i < records_.size(); i++) {
+        if (strcmp(records_[i].ns, ns) == 0 && strcmp(records_[i].key, key) == 0) {
+            return i;
+        }
+    }
+
+    Record record;
+    record.name = name;
+    record.ns = ns;
+    record.key = key;
+    record.version = version;
+    record.commit_delay_ms = commit_delay_ms;
+    record.staged.resize(size);
+    records_.push_back(std::move(record));
+    if (task_handle_ == nullptr) {
+        StartTask();
+    }
+    return records_.size() - 1;
+}
+
+bool PersistenceService::Load(PersistentRecordId id, void* data, size_t size) {
+    uint16_t version;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (id < 0 || id >= (int)records_.size() || records_[id].staged.size() != size) {
+            ESP_LOGE(TAG, "Load of unknown record %d", id);
+            return false;
+        }
+        version = records_[id].version;
+    }
+    return Read(id, version, data, size, true);
+}
+
+bool PersistenceService::LoadVersion(PersistentRecordId id, uint16_t version, void* data, size_t size) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (id < 0 || id >= (int)records_.size()) {
+            ESP_LOGE(TAG, "Load of unknown record %d", id);
+            return false;
+        }
+    }
+    return Read(id, version, data, size, false);
+}
+
+bool PersistenceService::Read(PersistentRecordId id, uint16_t version, void* data, size_t size, bool current) {
+    const char* ns;
+    const char* key;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ns = records_[id].ns;
+        key = records_[id].key;
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(ns, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t length = 0;
+    std::vector<uint8_t> blob;
+    esp_err_t err = nvs_get_blob(nvs, key, nullptr, &length);
+    if (err == ESP_OK && (length == size || length == sizeof(PersistentRecordHeader) + size)) {
+        blob.resize(length);
+        err = nvs_get_blob(nvs, key, blob.data(), &length);
+    }
+    nvs_close(nvs);
+    if (err != ESP_OK || blob.empty()) {
+        if (err == ESP_OK) {
+            ESP_LOGW(TAG, "%s/%s has unexpected size %u", ns, key, length);
+        }
+        return false;
+    }
+
+    if (length == size) {
+        // Stored before records had a header, the next commit upgrades it
+        memcpy(data, blob.data(), size);
+        ESP_LOGI(TAG, "%s/%s has no header, migrating", ns, key);
+        if (current) {
+            Update(id, data, size);
+        }
+        return true;
+    }
+
+    PersistentRecordHeader header;
+    memcpy(&header, blob.data(), sizeof(header));
+    const uint8_t* payload = blob.data() + sizeof(header);
+    if (header.magic != PERSISTENT_RECORD_MAGIC || header.size != size) {
+        ESP_LOGW(TAG, "%s/%s has a bad header", ns, key);
+        return false;
+    }
+    if (header.crc != PayloadCrc(payload, size)) {
+        ESP_LOGW(TAG, "%s/%s failed the CRC check", ns, key);
+        return false;
+    }
+    if (header.version != version) {
+        ESP_LOGW(TAG, "%s/%s is version %u, expected %u", ns, key, header.version, version);
+        return false;
+    }
+
+    memcpy(data, payload, size);
+    if (current) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        records_[id].stored.assign(payload, payload + size);
+    }
+    return true;
+}
+
+void PersistenceService::Update(PersistentRecordId id, const void* data, size_t size) {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (id < 0 || id >= (int)records_.size() || records_[id].staged.size() != size) {
+            ESP_LOGE(TAG, "Update of unknown record %d", id);
+            return;
+        }
+        if (ignored_task_ != nullptr && ignored_task_ == xTaskGetCurrentTaskHandle()) {
+            return;
+        }
+        auto& record = records_[id];
+        record.stats.updates++;
+        if (record.dirty) {
+            record.stats.coalesced++;
+        } else {
+            record.dirty = true;
+            record.dirty_since_us = esp_timer_get_time();
+            wake = true;
+        }
+        memcpy(record.staged.data(), data, size);
+    }
+    // The task only has to recompute its deadline when a clean record turns dirty
+    if (wake && task_handle_ != nullptr) {
+        xTaskNotifyGive(task_handle_);
+    }
+}
+
+bool PersistenceService::Flush() {
+    return Commit(true);
+}
+
+void PersistenceService::IgnoreUpdatesFrom(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ignored_task_ = task;
+}
+
+void PersistenceService::StartTask() {
+    xTaskCreate([](void* arg) {
+        static_cast<PersistenceService*>(arg)->Run();
+        vTaskDelete(NULL);
+    }, "persistence", 4096, this, 1, &task_handle_);
+}
+
+void PersistenceService::Run() {
+    while (true) {
+        TickType_t wait = portMAX_DELAY;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            int64_t now_us = esp_timer_get_time();
+            for (auto& record : records_) {
+                if (!record.dirty) {
+                    continue;
+                }
+                int64_t due_us = record.dirty_since_us + (int64_t)record.commit_delay_ms * 1000;
+                // Round up to whole ticks: pdMS_TO_TICKS truncates, which woke the task
+                // early and spun on a record that was not due yet
+                int64_t remaining_us = std::max<int64_t>(0, due_us - now_us);
+                int64_t ticks = (remaining_us * configTICK_RATE_HZ + 999999) / 1000000;
+                wait = std::min<TickType_t>(wait, (TickType_t)std::max<int64_t>(1, ticks));
+            }
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+        Commit(false);
+    }
+}
+
+bool PersistenceService::Commit(bool force) {
+    struct Pending {
+        size_t index;
+        std::vector<uint8_t> blob;
+    };
+
+    // Held until the blobs are written, so a forced flush waits for a commit in progress
+    std::lock_guard<std::mutex> flash_lock(flash_mutex_);
+    std::vector<Pending> pending;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        int64_t now_us = esp_timer_get_time();
+        for (size_t i = 0; i < records_.size(); i++) {
+            auto& record = records_[i];
+            if (!record.dirty) {
+                continue;
+            }
+            if (!force && now_us - record.dirty_since_us < (int64_t)record.commit_delay_ms * 1000) {
+                continue;
+            }
+            record.dirty = false;
+            if (record.staged == record.stored) {
+                record.stats.unchanged++;
+                continue;
+            }
+
+            PersistentRecordHeader header = {
+                .magic = PERSISTENT_RECORD_MAGIC,
+                .version = record.version,
+                .size = (uint16_t)record.staged.size(),
+                .crc = PayloadCrc(record.staged.data(), record.staged.size()),
+            };
+            Pending item;
+            item.index = i;
+            item.blob.resize(sizeof(header) + record.staged.size());
+            memcpy(item.blob.data(), &header, sizeof(header));
+            memcpy(item.blob.data() + sizeof(header), record.staged.data(), record.staged.size());
+            pending.push_back(std::move(item));
+        }
+    }
+
+    bool all_written = true;
+    for (auto& item : pending) {
+        // Records are only appended, the pointers stay valid without the lock
+        const char* ns;
+        const char* key;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ns = records_[item.index].ns;
+            key = records_[item.index].key;
+        }
+        bool ok = WriteBlob(ns, key, item.blob);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto& record = records_[item.index];
+        if (ok) {
+            record.stored.assign(item.blob.begin() + sizeof(PersistentRecordHeader), item.blob.end());
+            record.stats.writes++;
+            record.stats.last_write_ms = esp_timer_get_time() / 1000;
+        } else {
+            all_written = false;
+            record.stats.failures++;
+            // Retry after another commit delay unless a newer snapshot is already waiting
+            if (!record.dirty) {
+                record.dirty = true;
+                record.dirty_since_us = esp_timer_get_time();
+            }
+        }
+    }
+    return all_written;
+}
+
+bool PersistenceService::WriteBlob(const char* ns, const char* key, const std::vector<uint8_t>& blob) {
+    nvs_handle_t nvs;
+    esp_err_t err = nvs_open(ns, NVS_READWRITE, &nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to open %s: %s", ns, esp_err_to_name(err));
+        return false;
+    }
+    err = nvs_set_blob(nvs, key, blob.data(), blob.size());
+    if (err == ESP_OK) {
+        err = nvs_commit(nvs);
+    }
+    nvs_close(nvs);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to write %s/%s: %s", ns, key, esp_err_to_name(err));
+        return false;
+    }
+    ESP_LOGD(TAG, "Wrote %s/%s, %u bytes", ns, key, blob.size());
+    return true;
+}
+
+std::string PersistenceService::GetStatusJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    int64_t now_us = esp_timer_get_time();
+    std::string json = "{\"records\":[";
+    for (size_t i = 0; i < records_.size(); i++) {
+        auto& record = records_[i];
+        if (i > 0) {
+            json += ",";
+        }
+        json += "{\"name\":\"";
+        json += record.name;
+        json += "\",\"size\":" + std::to_string(record.staged.size());
+        json += ",\"version\":" + std::to_string(record.version);
+        json += ",\"commit_delay_ms\":" + std::to_string(record.commit_delay_ms);
+        json += ",\"updates\":" + std::to_string(record.stats.updates);
+        json += ",\"coalesced\":" + std::to_string(record.stats.coalesced);
+        json += ",\"unchanged\":" + std::to_string(record.stats.unchanged);
+        json += ",\"writes\":" + std::to_string(record.stats.writes);
+        json += ",\"failures\":" + std::to_string(record.stats.failures);
+        json += ",\"last_write_ms\":" + std::to_string(record.stats.last_write_ms);
+        if (record.dirty) {
+            json += ",\"dirty_ms\":" + std::to_string((now_us - record.dirty_since_us) / 1000);
+        }
+        json += "}";
+    }
+    json += "]";
+    if (ignored_task_ != nullptr) {
+        json += ",\"ignoring_updates\":true";
+    }
+    json += "}";
+    return json;
+}
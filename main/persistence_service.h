@@ -0,0 +1,107 @@
+#ifndef _PERSISTENCE_SERVICE_H_
+#define _PERSISTENCE_SERVICE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define PERSISTENT_RECORD_MAGIC 0x52505a58  // "XZPR"
+#define PERSISTENCE_MAX_RECORD_SIZE 1024
+
+// Stored in front of every record blob
+struct PersistentRecordHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;              // Payload bytes after the header
+    uint32_t crc;               // CRC-32 of the payload
+} __attribute__((packed));
+
+struct PersistentRecordStats {
+    uint32_t updates = 0;       // Update() calls
+    uint32_t coalesced = 0;     // Updates that replaced a snapshot not written yet
+    uint32_t unchanged = 0;     // Commits skipped because flash already held the bytes
+    uint32_t writes = 0;        // Blobs written to flash
+    uint32_t failures = 0;
+    uint32_t last_write_ms = 0; // Uptime of the last write
+};
+
+typedef int PersistentRecordId;
+
+/*
+ * Write-behind store for state records kept in NVS.
+ *
+ * Owners register a record once, then hand over a snapshot with Update()
+ * whenever it changes. Update() only copies the bytes and marks the record
+ * dirty; a background task writes dirty records once they have been dirty
+ * for their commit delay, so bursts of changes cost one flash write, and
+ * records whose bytes match what flash holds are not written at all.
+ * Records are stored as a header with version and CRC followed by the
+ * payload. Flush() writes everything at once and runs before restarts,
+ * deep sleep and power off.
+ */
+class PersistenceService {
+public:
+    static PersistenceService& GetInstance() {
+        static PersistenceService instance;
+        return instance;
+    }
+    PersistenceService(const PersistenceService&) = delete;
+    PersistenceService& operator=(const PersistenceService&) = delete;
+
+    // name, ns and key must be string literals
+    PersistentRecordId Register(const char* name, const char* ns, const char* key, uint16_t version,
+                                size_t size, uint32_t commit_delay_ms);
+
+    // Reads the record into data. Fails if it is missing, corrupt, or of another version or size.
+    // A headerless blob of exactly `size` bytes, as stored before this service, is accepted
+    // and rewritten in the new format.
+    bool Load(PersistentRecordId id, void* data, size_t size);
+    // Reads a record written with an older version and layout, for migrations. The next
+    // Update() replaces it. A headerless blob of `size` bytes is accepted as well.
+    bool LoadVersion(PersistentRecordId id, uint16_t version, void* data, size_t size);
+    // Stages a snapshot of the record, returns at once
+    void Update(PersistentRecordId id, const void* data, size_t size);
+    // Writes every dirty record now, from the calling task. Returns false if a write
+    // failed; the failed records stay dirty.
+    bool Flush();
+    // Drops the Update() calls made by task, nullptr stops dropping. Used by the learning
+    // simulator, which runs the owners' code on simulated data between the real updates.
+    void IgnoreUpdatesFrom(TaskHandle_t task);
+
+    std::string GetStatusJson();
+
+private:
+    PersistenceService();
+
+    struct Record {
+        const char* name;
+        const char* ns;
+        const char* key;
+        uint16_t version;
+        uint32_t commit_delay_ms;
+        std::vector<uint8_t> staged;
+        std::vector<uint8_t> stored;    // What flash holds, empty if unknown
+        bool dirty = false;
+        int64_t dirty_since_us = 0;
+        PersistentRecordStats stats;
+    };
+
+    std::mutex mutex_;          // Records and their snapshots
+    std::mutex flash_mutex_;    // Serializes writers, held across NVS writes
+    std::vector<Record> records_;
+    TaskHandle_t task_handle_ = nullptr;
+    TaskHandle_t ignored_task_ = nullptr;
+
+    bool Read(PersistentRecordId id, uint16_t version, void* data, size_t size, bool current);
+    void StartTask();
+    void Run();
+    bool Commit(bool force);
+    bool WriteBlob(const char* ns, const char* key, const std::vector<uint8_t>& blob);
+};
+
+#endif // _PERSISTENCE_SERVICE_H_
@@ -0,0 +1,162 @@
+#ifndef _PET_CATALOG_H_
+#define _PET_CATALOG_H_
+
+#include <cstddef>
+#include <string_view>
+
+/**
+ * @brief 宠物类型目录（编译期常量，存放在 flash）
+ *
+ * 所有字段都指向字符串字面量，data() 以 '\0' 结尾，可直接传给 C 接口。
+ * 表按 id 排序，FindPetType 二分查找；排序和 id 唯一性在编译期检查，
+ * 每种宠物都有图标由 display/lcd_display.cc 在编译期检查。
+ */
+struct PetTypeInfo {
+    std::string_view id;            // 类型 ID（如 "cat"）
+    std::string_view name;          // 名称（中文）
+    std::string_view name_en;       // 英文名称
+    std::string_view emoji;         // 表情符号
+    std::string_view category;      // 分类：domestic(家养)/wild(野生)/exotic(奇异)
+    float hunger_rate;              // 饥饿速度倍率（1.0=正常）
+    float clean_rate;               // 脏污速度倍率（1.0=正常）
+    float mood_decay_rate;          // 心情衰减倍率（1.0=正常）
+    std::string_view personality;   // 性格描述
+    std::string_view special_trait; // 特殊能力
+    bool is_available;              // 是否可用（预留）
+};
+
+// 新增类型时按 id 字母顺序插入
+inline constexpr PetTypeInfo kPetTypes[] = {
+    {"bear", "熊", "Bear", "🐻", "wild",
+     1.8f, 0.9f, 1.1f,
+     "强壮、贪吃、冬眠",
+     "饱腹度>80时活跃度+10",
+     true},
+    {"cat", "猫咪", "Cat", "🐱", "domestic",
+     0.8f, 1.2f, 0.9f,
+     "独立、优雅、偶尔高冷",
+     "夜间活跃度+20%",
+     true},
+    {"dog", "小狗", "Dog", "🐶", "domestic",
+     1.2f, 1.5f, 1.3f,
+     "忠诚、活泼、需要陪伴",
+     "每次互动心情+2额外加成",
+     true},
+    {"dragon", "龙", "Dragon", "🐉", "exotic",
+     1.8f, 1.0f, 1.5f,
+     "神秘、强大、传说生物",
+     "等级提升速度x2",
+     true},
+    {"elephant", "大象", "Elephant", "🐘", "exotic",
+     2.5f, 1.8f, 0.6f,
+     "温和、记性好、群居",
+     "不会忘记互动，心情永不低于40",
+     true},
+    {"fox", "狐狸", "Fox", "🦊", "wild",
+     1.0f, 1.1f, 1.0f,
+     "聪明、狡猾、灵活",
+     "玩耍效果+50%",
+     true},
+    {"giraffe", "长颈鹿", "Giraffe", "🦒", "exotic",
+     1.2f, 1.0f, 0.8f,
+     "温顺、高大、挑食",
+     "饱腹度>60才会增加心情",
+     true},
+    {"hamster", "仓鼠", "Hamster", "🐹", "domestic",
+     0.9f, 1.0f, 0.8f,
+     "小巧、可爱、储存狂",
+     "喂食冷却-30秒",
+     true},
+    {"koala", "考拉", "Koala", "🐨", "exotic",
+     0.6f, 0.7f, 0.5f,
+     "懒惰、嗜睡、吃货",
+     "所有衰减速度-40%",
+     true},
+    {"lion", "狮子", "Lion", "🦁", "wild",
+     1.5f, 0.7f, 1.2f,
+     "威武、霸气、百兽之王",
+     "饱腹度<30时攻击性+50%",
+     true},
+    {"panda", "熊猫", "Panda", "🐼", "wild",
+     2.0f, 0.6f, 0.7f,
+     "慵懒、可爱、吃货",
+     "喂食效果x1.5",
+     true},
+    {"parrot", "鹦鹉", "Parrot", "🦜", "domestic",
+     0.7f, 0.9f, 1.1f,
+     "聪明、话痨、喜欢学舌",
+     "聊天任务完成速度x2",
+     true},
+    {"penguin", "企鹅", "Penguin", "🐧", "exotic",
+     1.1f, 0.5f, 0.9f,
+     "憨厚、怕热、游泳健将",
+     "清洁效果x1.8（爱洗澡）",
+     true},
+    {"rabbit", "兔子", "Rabbit", "🐰", "domestic",
+     1.1f, 0.8f, 1.0f,
+     "温顺、胆小、喜欢安静",
+     "清洁度>80时心情+5",
+     true},
+    {"rhino", "犀牛", "Rhino", "🦏", "exotic",
+     1.3f, 2.0f, 0.8f,
+     "笨重、脾气暴躁、皮厚",
+     "清洁度衰减x2但心情稳定",
+     true},
+    {"sloth", "树懒", "Sloth", "🦥", "exotic",
+     0.5f, 0.6f, 0.4f,
+     "超级慵懒、行动缓慢",
+     "所有状态衰减最慢！",
+     true},
+    {"tiger", "老虎", "Tiger", "🐯", "wild",
+     1.6f, 0.8f, 1.3f,
+     "凶猛、强壮、独居",
+     "每日首次互动心情+10",
+     true},
+    {"unicorn", "独角兽", "Unicorn", "🦄", "exotic",
+     0.8f, 0.5f, 0.6f,
+     "纯洁、优雅、魔法生物",
+     "心情永不低于50",
+     true},
+    {"wolf", "狼", "Wolf", "🐺", "wild",
+     1.4f, 0.8f, 1.4f,
+     "忠诚、团结、野性",
+     "连续登录奖励x2",
+     true},
+};
+
+inline constexpr size_t kPetTypeCount = sizeof(kPetTypes) / sizeof(kPetTypes[0]);
+
+constexpr bool IsPetCatalogSorted() {
+    for (size_t i = 1; i < kPetTypeCount; i++) {
+        if (!(kPetTypes[i - 1].id < kPetTypes[i].id)) {
+            return false;
+        }
+    }
+    return true;
+}
+static_assert(IsPetCatalogSorted(), "kPetTypes must be sorted by id without duplicates");
+
+/**
+ * @brief 按 id 查找宠物类型（二分查找）
+ * @return 找不到时返回 nullptr
+ */
+constexpr const PetTypeInfo* FindPetType(std::string_view id) {
+    size_t low = 0;
+    size_t high = kPetTypeCount;
+    while (low < high) {
+        size_t mid = (low + high) / 2;
+        if (kPetTypes[mid].id < id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    if (low < kPetTypeCount && kPetTypes[low].id == id) {
+        return &kPetTypes[low];
+    }
+    return nullptr;
+}
+
+static_assert(FindPetType("cat") != nullptr, "The default pet type must exist");
+
+#endif // _PET_CATALOG_H_
@@ -1,188 +1,58 @@
 #include "pet_system.h"
 #include "settings.h"
+#include "persistence_service.h"
 #include "board.h"
+#include "application.h"
 #include "display/display.h"
 #include "core/event_bus.h"
 #include "learning/adaptive_behavior.h"
 #include "learning/emotional_memory.h"
+#include "utils/time_utils.h"
+#include "utils/json_writer.h"
 
 #include <esp_log.h>
-#include <esp_timer.h>
-#include <sys/time.h>
 #include <cmath>
 #include <algorithm>
-#include <cJSON.h>
+#include <cstring>
 
 #define TAG "Pet"
 
+// Bump when PetStateRecord changes
+#define PET_RECORD_VERSION 1
+// State changes after every action and wake, write at most this often
+#define PET_COMMIT_DELAY_MS (30 * 1000)
+// 2025-01-01 UTC, earlier timestamps were taken before the clock was synced
+#define TIME_SYNCED_MS 1735689600000LL
+
+// NVS image of PetSystem::State, replaces the per-field keys of older firmware
+struct PetStateRecord {
+    char pet_type[16];
+    int32_t mood;
+    int32_t satiety;
+    int32_t cleanliness;
+    int32_t active;
+    int32_t level;
+    uint32_t daily_done_mask;
+    int32_t login_streak;
+    int64_t last_update_ms;
+    int64_t last_interaction_ms;
+    int64_t last_reset_day_ms;
+};
+
+static const char* const kLegacyStateKeys[] = {
+    "pet_type", "mood", "satiety", "cleanliness", "active", "level",
+    "last_ts", "last_interact", "daily_done", "login_streak", "last_reset_day",
+};
+
 PetSystem::PetSystem() {
-    InitializePetTypes();
 }
 
 PetSystem::~PetSystem() {
     Stop();
 }
 
-void PetSystem::InitializePetTypes() {
-    // 家养宠物（domestic）
-    pet_types_["cat"] = {
-        "猫咪", "Cat", "🐱", "domestic",
-        0.8f, 1.2f, 0.9f,
-        "独立、优雅、偶尔高冷",
-        "夜间活跃度+20%",
-        true
-    };
-    
-    pet_types_["dog"] = {
-        "小狗", "Dog", "🐶", "domestic",
-        1.2f, 1.5f, 1.3f,
-        "忠诚、活泼、需要陪伴",
-        "每次互动心情+2额外加成",
-        true
-    };
-    
-    pet_types_["rabbit"] = {
-        "兔子", "Rabbit", "🐰", "domestic",
-        1.1f, 0.8f, 1.0f,
-        "温顺、胆小、喜欢安静",
-        "清洁度>80时心情+5",
-        true
-    };
-    
-    pet_types_["hamster"] = {
-        "仓鼠", "Hamster", "🐹", "domestic",
-        0.9f, 1.0f, 0.8f,
-        "小巧、可爱、储存狂",
-        "喂食冷却-30秒",
-        true
-    };
-    
-    pet_types_["parrot"] = {
-        "鹦鹉", "Parrot", "🦜", "domestic",
-        0.7f, 0.9f, 1.1f,
-        "聪明、话痨、喜欢学舌",
-        "聊天任务完成速度x2",
-        true
-    };
-    
-    // 野生动物（wild）
-    pet_types_["lion"] = {
-        "狮子", "Lion", "🦁", "wild",
-        1.5f, 0.7f, 1.2f,
-        "威武、霸气、百兽之王",
-        "饱腹度<30时攻击性+50%",
-        true
-    };
-    
-    pet_types_["tiger"] = {
-        "老虎", "Tiger", "🐯", "wild",
-        1.6f, 0.8f, 1.3f,
-        "凶猛、强壮、独居",
-        "每日首次互动心情+10",
-        true
-    };
-    
-    pet_types_["panda"] = {
-        "熊猫", "Panda", "🐼", "wild",
-        2.0f, 0.6f, 0.7f,
-        "慵懒、可爱、吃货",
-        "喂食效果x1.5",
-        true
-    };
-    
-    pet_types_["bear"] = {
-        "熊", "Bear", "🐻", "wild",
-        1.8f, 0.9f, 1.1f,
-        "强壮、贪吃、冬眠",
-        "饱腹度>80时活跃度+10",
-        true
-    };
-    
-    pet_types_["wolf"] = {
-        "狼", "Wolf", "🐺", "wild",
-        1.4f, 0.8f, 1.4f,
-        "忠诚、团结、野性",
-        "连续登录奖励x2",
-        true
-    };
-    
-    pet_types_["fox"] = {
-        "狐狸", "Fox", "🦊", "wild",
-        1.0f, 1.1f, 1.0f,
-        "聪明、狡猾、灵活",
-        "玩耍效果+50%",
-        true
-    };
-    
-    // 奇异动物（exotic）
-    pet_types_["penguin"] = {
-        "企鹅", "Penguin", "🐧", "exotic",
-        1.1f, 0.5f, 0.9f,
-        "憨厚、怕热、游泳健将",
-        "清洁效果x1.8（爱洗澡）",
-        true
-    };
-    
-    pet_types_["rhino"] = {
-        "犀牛", "Rhino", "🦏", "exotic",
-        1.3f, 2.0f, 0.8f,
-        "笨重、脾气暴躁、皮厚",
-        "清洁度衰减x2但心情稳定",
-        true
-    };
-    
-    pet_types_["elephant"] = {
-        "大象", "Elephant", "🐘", "exotic",
-        2.5f, 1.8f, 0.6f,
-        "温和、记性好、群居",
-        "不会忘记互动，心情永不低于40",
-        true
-    };
-    
-    pet_types_["giraffe"] = {
-        "长颈鹿", "Giraffe", "🦒", "exotic",
-        1.2f, 1.0f, 0.8f,
-        "温顺、高大、挑食",
-        "饱腹度>60才会增加心情",
-        true
-    };
-    
-    pet_types_["koala"] = {
-        "考拉", "Koala", "🐨", "exotic",
-        0.6f, 0.7f, 0.5f,
-        "懒惰、嗜睡、吃货",
-        "所有衰减速度-40%",
-        true
-    };
-    
-    pet_types_["sloth"] = {
-        "树懒", "Sloth", "🦥", "exotic",
-        0.5f, 0.6f, 0.4f,
-        "超级慵懒、行动缓慢",
-        "所有状态衰减最慢！",
-        true
-    };
-    
-    pet_types_["dragon"] = {
-        "龙", "Dragon", "🐉", "exotic",
-        1.8f, 1.0f, 1.5f,
-        "神秘、强大、传说生物",
-        "等级提升速度x2",
-        true
-    };
-    
-    pet_types_["unicorn"] = {
-        "独角兽", "Unicorn", "🦄", "exotic",
-        0.8f, 0.5f, 0.6f,
-        "纯洁、优雅、魔法生物",
-        "心情永不低于50",
-        true
-    };
-    
-    ESP_LOGI(TAG, "✨ Initialized %d pet types", pet_types_.size());
-}
-
 void PetSystem::Start() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
     if (started_) {
         ESP_LOGW(TAG, "Pet system already started");
         return;
@@ -196,37 +66,15 @@ void PetSystem::Start() {
     // 检查每日重置
     CheckDailyReset();
     
-    // 创建定时器（1分钟tick）
-    esp_timer_create_args_t timer_args = {
-        .callback = TimerCallback,
-        .arg = this,
-        .dispatch_method = ESP_TIMER_TASK,
-        .name = "pet_timer",
-        .skip_unhandled_events = true
-    };
-    
-    esp_err_t err = esp_timer_create(&timer_args, &timer_handle_);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to create pet timer: %d", err);
-        return;
-    }
-    
-    // 启动定时器（60秒周期）
-    err = esp_timer_start_periodic(timer_handle_, 60 * 1000000ULL);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start pet timer: %d", err);
-        esp_timer_delete(timer_handle_);
-        timer_handle_ = nullptr;
-        return;
-    }
-    
+    // 预约第一次唤醒
     started_ = true;
+    ScheduleNextWake();
     
     auto pet_type = GetCurrentPetType();
     ESP_LOGI(TAG, "✅ Pet system started successfully");
     ESP_LOGI(TAG, "   Pet: %s %s, Mood: %d, Satiety: %d, Clean: %d, Level: %d", 
-             pet_type ? pet_type->emoji.c_str() : "?",
-             pet_type ? pet_type->name.c_str() : "Unknown",
+             pet_type ? pet_type->emoji.data() : "?",
+             pet_type ? pet_type->name.data() : "Unknown",
              state_.mood, state_.satiety, state_.cleanliness, state_.level);
     
     // 初始化显示当前宠物图标
@@ -234,8 +82,8 @@ void PetSystem::Start() {
         auto& board = Board::GetInstance();
         auto display = board.GetDisplay();
         if (display) {
-            display->SetPetEmoji(pet_type->emoji.c_str());
-            ESP_LOGI(TAG, "Initialized pet icon: %s", pet_type->emoji.c_str());
+            display->SetPetEmoji(pet_type->emoji.data());
+            ESP_LOGI(TAG, "Initialized pet icon: %s", pet_type->emoji.data());
         }
     } else {
         ESP_LOGW(TAG, "⚠️  Pet type not found, using default 'cat'");
@@ -245,71 +93,99 @@ void PetSystem::Start() {
 }
 
 void PetSystem::Stop() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
     if (!started_) {
         return;
     }
     
-    if (timer_handle_) {
-        esp_timer_stop(timer_handle_);
-        esp_timer_delete(timer_handle_);
-        timer_handle_ = nullptr;
-    }
+    wake_timer_.Cancel();
     
+    Settle();
     SaveState();
     started_ = false;
     
     ESP_LOGI(TAG, "🐾 Pet system stopped");
 }
 
-void PetSystem::TimerCallback(void* arg) {
-    PetSystem* pet = static_cast<PetSystem*>(arg);
-    pet->OnTick();
-}
-
-void PetSystem::OnTick() {
-    int64_t now = GetCurrentTimeMs();
-    
-    // 更新衰减
-    UpdateDecay();
-    
-    // 检查每日重置
-    CheckDailyReset();
+void PetSystem::OnWake() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    // 结算衰减，跨过午夜时同时完成每日重置
+    Settle();
     
     // 检查是否需要发出警告
     CheckAndNotifyWarnings();
     
-    // 每5分钟保存一次
-    static int tick_count = 0;
-    tick_count++;
-    if (tick_count >= 5) {
-        SaveState();
-        tick_count = 0;
-    }
+    SaveState();
     
-    state_.lastUpdateMs = now;
+    int overall = GetOverallState();
+    ESP_LOGI(TAG, "📊 Status: Mood=%d, Satiety=%d, Clean=%d, Overall=%d", 
+             state_.mood, state_.satiety, state_.cleanliness, overall);
     
-    // 输出状态（调试用，每10分钟一次）
-    static int log_count = 0;
-    log_count++;
-    if (log_count >= 10) {
-        int overall = GetOverallState();
-        ESP_LOGI(TAG, "📊 Status: Mood=%d, Satiety=%d, Clean=%d, Overall=%d", 
-                 state_.mood, state_.satiety, state_.cleanliness, overall);
-        log_count = 0;
-    }
+    ScheduleNextWake();
 }
 
-void PetSystem::UpdateDecay() {
-    int64_t now = GetCurrentTimeMs();
+void PetSystem::Settle() {
+    UpdateDecay();
+    CheckDailyReset();
+}
+
+void PetSystem::ScheduleNextWake() {
+    next_wake_ms_ = PredictNextWakeMs();
+    if (!started_) {
+        return;  // 未启动（或模拟器接管）时不预约定时器
+    }
     
-    // 🛡️ 防止时钟回退导致的异常值
-    if (now < state_.lastInteractionMs) {
-        ESP_LOGW(TAG, "⚠️  Time went backwards! Resetting interaction time.");
-        state_.lastInteractionMs = now;
+    int64_t delay_ms = std::max<int64_t>(0, next_wake_ms_ - GetCurrentTimeMs());
+    // 状态和 wake_timer_ 只在主循环中访问，定时器回调只负责转交
+    wake_timer_ = TimerService::GetInstance().StartOnce("pet_wake", (uint32_t)delay_ms, WAKE_SLACK_MS,
+        [this]() { Application::GetInstance().Schedule([this]() { OnWake(); }); });
+    ESP_LOGD(TAG, "Next wake in %lld s", delay_ms / 1000);
+}
+
+// 按当前速率，value 从 value 降到 threshold 及以下需要的分钟数，不会降到时返回 -1
+static int64_t MinutesUntilThreshold(int value, int threshold, int step) {
+    if (value <= threshold || step <= 0) {
+        return -1;
     }
+    return (value - threshold + step - 1) / step;
+}
+
+int64_t PetSystem::PredictNextWakeMs() {
+    // 每日重置在 UTC 日期变化时（与 GetDaysSince1970 一致）
+    int64_t next_wake = (int64_t)(GetDaysSince1970(GetCurrentTimeMs()) + 1) * 86400 * 1000;
+    
+    // 警告阈值与 CheckWarning 相同
+    int offset = xiaozhi::AdaptiveBehavior::GetInstance().GetSnapshot().pet_warning_threshold_offset;
+    DecaySteps steps = GetDecaySteps();
+    int64_t crossings[] = {
+        MinutesUntilThreshold(state_.satiety, WARNING_SATIETY_THRESHOLD + offset, steps.satiety),
+        MinutesUntilThreshold(state_.cleanliness, WARNING_CLEAN_THRESHOLD + offset, steps.cleanliness),
+        -1,
+    };
     
-    int64_t sinceLastInteraction = (now - state_.lastInteractionMs) / 1000 / 60; // 分钟
+    // 心情先按正常速度衰减，无互动超过 NO_INTERACTION_MIN 分钟后加倍
+    int mood_threshold = WARNING_MOOD_THRESHOLD + offset;
+    int64_t calm = GetCalmMinutes(state_.lastUpdateMs);
+    int64_t calm_crossing = MinutesUntilThreshold(state_.mood, mood_threshold, steps.mood);
+    if (calm_crossing >= 0 && calm_crossing <= calm) {
+        crossings[2] = calm_crossing;
+    } else {
+        int64_t mood_after_calm = std::max<int64_t>(0, state_.mood - calm * steps.mood);
+        int64_t lonely_crossing = MinutesUntilThreshold(mood_after_calm, mood_threshold, steps.lonely_mood);
+        if (lonely_crossing >= 0) {
+            crossings[2] = calm + lonely_crossing;
+        }
+    }
     
+    for (int64_t minutes : crossings) {
+        if (minutes >= 0) {
+            next_wake = std::min(next_wake, state_.lastUpdateMs + minutes * MINUTE_MS);
+        }
+    }
+    return next_wake;
+}
+
+PetSystem::DecaySteps PetSystem::GetDecaySteps() const {
     // 🧠 获取自适应衰减速率（基于用户互动频率）
     auto& adaptive = xiaozhi::AdaptiveBehavior::GetInstance();
     float adaptive_rate = adaptive.GetPetDecayRate();
@@ -323,31 +199,60 @@ void PetSystem::UpdateDecay() {
     // 🎯 应用双重倍率：宠物类型 × 自适应速率
     // 高频用户：衰减更快（更需要照顾）
     // 低频用户：衰减更慢（减少打扰）
-    float final_hunger_rate = hunger_rate * adaptive_rate;
-    float final_clean_rate = clean_rate * adaptive_rate;
-    float final_mood_rate = mood_rate * adaptive_rate;
+    DecaySteps steps;
+    steps.satiety = static_cast<int>(DECAY_SATIETY_PER_MIN * hunger_rate * adaptive_rate);
+    steps.cleanliness = static_cast<int>(DECAY_CLEAN_PER_MIN * clean_rate * adaptive_rate);
+    steps.mood = static_cast<int>(DECAY_MOOD_PER_MIN * mood_rate * adaptive_rate);
+    steps.lonely_mood = static_cast<int>(DECAY_MOOD_PER_MIN * 2 * mood_rate * adaptive_rate);
+    return steps;
+}
+
+int64_t PetSystem::GetCalmMinutes(int64_t fromMs) const {
+    // 第 k 分钟（时间 fromMs + k 分钟）距上次互动不超过 NO_INTERACTION_MIN 分钟时正常衰减
+    int64_t calm_until = state_.lastInteractionMs + (NO_INTERACTION_MIN + 1) * MINUTE_MS;
+    if (calm_until <= fromMs) {
+        return 0;
+    }
+    return (calm_until - fromMs - 1) / MINUTE_MS;
+}
+
+void PetSystem::UpdateDecay() {
+    int64_t now = GetCurrentTimeMs();
     
-    // 饱腹度衰减
-    state_.satiety = Clamp(state_.satiety - static_cast<int>(DECAY_SATIETY_PER_MIN * final_hunger_rate));
+    // 🛡️ 防止时钟回退导致的异常值
+    if (now < state_.lastInteractionMs) {
+        ESP_LOGW(TAG, "⚠️  Time went backwards! Resetting interaction time.");
+        state_.lastInteractionMs = now;
+    }
     
-    // 清洁度衰减
-    state_.cleanliness = Clamp(state_.cleanliness - static_cast<int>(DECAY_CLEAN_PER_MIN * final_clean_rate));
+    // 时钟回退，或对时前记录的时间戳（1970 年起）：从现在开始计算，不补算
+    if (now < state_.lastUpdateMs ||
+        (state_.lastUpdateMs < TIME_SYNCED_MS && now >= TIME_SYNCED_MS)) {
+        state_.lastUpdateMs = now;
+        return;
+    }
     
-    // 心情衰减（无互动时额外衰减）
-    if (sinceLastInteraction > NO_INTERACTION_MIN) {
-        state_.mood = Clamp(state_.mood - static_cast<int>(DECAY_MOOD_PER_MIN * 2 * final_mood_rate));
-    } else {
-        state_.mood = Clamp(state_.mood - static_cast<int>(DECAY_MOOD_PER_MIN * final_mood_rate));
+    int64_t minutes = (now - state_.lastUpdateMs) / MINUTE_MS;
+    if (minutes <= 0) {
+        return;
     }
     
+    // 逐分钟衰减的闭式结果：每分钟减固定整数，心情在无互动后加倍
+    DecaySteps steps = GetDecaySteps();
+    int64_t calm = std::min(minutes, GetCalmMinutes(state_.lastUpdateMs));
+    int old_mood = state_.mood;
+    state_.satiety = Clamp((int)std::max<int64_t>(0, state_.satiety - minutes * steps.satiety));
+    state_.cleanliness = Clamp((int)std::max<int64_t>(0, state_.cleanliness - minutes * steps.cleanliness));
+    state_.mood = Clamp((int)std::max<int64_t>(0,
+        state_.mood - calm * steps.mood - (minutes - calm) * steps.lonely_mood));
+    state_.lastUpdateMs += minutes * MINUTE_MS;
+    
     ClampState();
+    MarkChanged();
     
-    // 📊 自适应衰减日志（每次都显示，让用户看到学习效果）
-    ESP_LOGI(TAG, "🔄 Decay: adaptive_rate=%.2fx (7d互动=%u次), mood=%d→%d, satiety=%d, clean=%d",
-             adaptive_rate,
-             xiaozhi::UserProfile::GetInstance().GetInteractionCount7d(),
-             state_.mood + static_cast<int>(DECAY_MOOD_PER_MIN * final_mood_rate * (sinceLastInteraction > NO_INTERACTION_MIN ? 2 : 1)),
-             state_.mood, state_.satiety, state_.cleanliness);
+    ESP_LOGD(TAG, "🔄 Decay %lld min: adaptive_rate=%.2fx, mood=%d→%d, satiety=%d, clean=%d",
+             minutes, xiaozhi::AdaptiveBehavior::GetInstance().GetPetDecayRate(),
+             old_mood, state_.mood, state_.satiety, state_.cleanliness);
 }
 
 void PetSystem::CheckDailyReset() {
@@ -376,6 +281,7 @@ void PetSystem::CheckDailyReset() {
         state_.dailyDoneMask = 0;
         state_.lastResetDayMs = now;
         chatCountToday_ = 0;
+        MarkChanged();
         SaveState();
     }
 }
@@ -389,6 +295,9 @@ void PetSystem::ClampState() {
 }
 
 bool PetSystem::Feed(int amount) {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     if (!CheckCooldown(lastFeedMs_, FEED_COOLDOWN_SEC)) {
         ESP_LOGW(TAG, "Feed on cooldown");
         return false;
@@ -427,11 +336,16 @@ bool PetSystem::Feed(int amount) {
     ESP_LOGI(TAG, "🍔 Fed pet +%d, Satiety: %d -> %d", amount * 2, 
              state_.satiety - amount * 2, state_.satiety);
     
+    MarkChanged();
     SaveState();
+    ScheduleNextWake();
     return true;
 }
 
 bool PetSystem::Clean() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     if (!CheckCooldown(lastCleanMs_, CLEAN_COOLDOWN_SEC)) {
         ESP_LOGW(TAG, "Clean on cooldown");
         return false;
@@ -458,11 +372,16 @@ bool PetSystem::Clean() {
     ESP_LOGI(TAG, "🛁 Cleaned pet, Cleanliness: %d, Mood: %d", 
              state_.cleanliness, state_.mood);
     
+    MarkChanged();
     SaveState();
+    ScheduleNextWake();
     return true;
 }
 
 bool PetSystem::Play(const std::string& kind) {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     if (!CheckCooldown(lastPlayMs_, PLAY_COOLDOWN_SEC)) {
         ESP_LOGW(TAG, "Play on cooldown");
         return false;
@@ -489,11 +408,16 @@ bool PetSystem::Play(const std::string& kind) {
     ESP_LOGI(TAG, "🎾 Played with pet (%s), Mood: %d, Active: %d", 
              kind.empty() ? "default" : kind.c_str(), state_.mood, state_.active);
     
+    MarkChanged();
     SaveState();
+    ScheduleNextWake();
     return true;
 }
 
 bool PetSystem::Hug() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     if (!CheckCooldown(lastHugMs_, HUG_COOLDOWN_SEC)) {
         return false;
     }
@@ -506,11 +430,16 @@ bool PetSystem::Hug() {
     auto& emotional_memory = xiaozhi::EmotionalMemory::GetInstance();
     emotional_memory.RecordHug();
     
+    MarkChanged();
     ESP_LOGI(TAG, "🤗 Hugged pet, Mood: %d", state_.mood);
+    ScheduleNextWake();
     return true;
 }
 
 void PetSystem::RecordChat() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     chatCountToday_++;
     state_.lastInteractionMs = GetCurrentTimeMs();
     
@@ -520,15 +449,22 @@ void PetSystem::RecordChat() {
         state_.mood = Clamp(state_.mood + 5);
         state_.active = Clamp(state_.active + 5);
         ESP_LOGI(TAG, "✅ Daily task: Chat completed! +5 mood, +5 active");
+        MarkChanged();
         SaveState();
     }
+    
+    // 互动推迟了心情加速衰减的时间
+    ScheduleNextWake();
 }
 
 int PetSystem::GetOverallState() const {
     return static_cast<int>(0.5f * state_.mood + 0.3f * state_.satiety + 0.2f * state_.cleanliness);
 }
 
-std::string PetSystem::GetRecommendedEmotion() const {
+std::string PetSystem::GetRecommendedEmotion() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     // 优先判断特殊状态
     if (state_.satiety < 20) {
         return "sad";  // 饿了
@@ -552,50 +488,69 @@ std::string PetSystem::GetRecommendedEmotion() const {
     }
 }
 
-std::string PetSystem::GetStatusDescription() const {
-    cJSON* root = cJSON_CreateObject();
+std::string PetSystem::GetStatusDescription() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
+    uint32_t version = state_version_;
+    if (status_view_.version == version) {
+        return status_view_.text;
+    }
+    
+    status_view_.text.clear();
+    status_view_.text.reserve(512);
+    xiaozhi::JsonWriter json(status_view_.text);
+    json.BeginObject();
     
     // 宠物类型信息
     auto pet_type = GetCurrentPetType();
     if (pet_type) {
-        cJSON* petInfo = cJSON_CreateObject();
-        cJSON_AddStringToObject(petInfo, "id", state_.petType.c_str());
-        cJSON_AddStringToObject(petInfo, "name", pet_type->name.c_str());
-        cJSON_AddStringToObject(petInfo, "emoji", pet_type->emoji.c_str());
-        cJSON_AddStringToObject(petInfo, "category", pet_type->category.c_str());
-        cJSON_AddStringToObject(petInfo, "personality", pet_type->personality.c_str());
-        cJSON_AddStringToObject(petInfo, "special_trait", pet_type->special_trait.c_str());
-        cJSON_AddItemToObject(root, "pet_type", petInfo);
-    }
-    
-    cJSON_AddNumberToObject(root, "mood", state_.mood);
-    cJSON_AddNumberToObject(root, "satiety", state_.satiety);
-    cJSON_AddNumberToObject(root, "cleanliness", state_.cleanliness);
-    cJSON_AddNumberToObject(root, "active", state_.active);
-    cJSON_AddNumberToObject(root, "level", state_.level);
-    cJSON_AddNumberToObject(root, "overall", GetOverallState());
-    cJSON_AddStringToObject(root, "pet_emotion", GetRecommendedEmotion().c_str());
+        json.Key("pet_type").BeginObject()
+            .Key("id").String(state_.petType)
+            .Key("name").String(pet_type->name)
+            .Key("emoji").String(pet_type->emoji)
+            .Key("category").String(pet_type->category)
+            .Key("personality").String(pet_type->personality)
+            .Key("special_trait").String(pet_type->special_trait)
+            .EndObject();
+    }
+    
+    json.Key("mood").Int(state_.mood)
+        .Key("satiety").Int(state_.satiety)
+        .Key("cleanliness").Int(state_.cleanliness)
+        .Key("active").Int(state_.active)
+        .Key("level").Int(state_.level)
+        .Key("overall").Int(GetOverallState())
+        .Key("pet_emotion").String(GetRecommendedEmotion());
     
     // 每日任务状态
-    cJSON* dailyTasks = cJSON_CreateObject();
-    cJSON_AddBoolToObject(dailyTasks, "feed", state_.dailyDoneMask & (1 << TASK_FEED));
-    cJSON_AddBoolToObject(dailyTasks, "clean", state_.dailyDoneMask & (1 << TASK_CLEAN));
-    cJSON_AddBoolToObject(dailyTasks, "play", state_.dailyDoneMask & (1 << TASK_PLAY));
-    cJSON_AddBoolToObject(dailyTasks, "chat", state_.dailyDoneMask & (1 << TASK_CHAT));
-    cJSON_AddItemToObject(root, "daily_tasks", dailyTasks);
+    json.Key("daily_tasks").BeginObject()
+        .Key("feed").Bool(state_.dailyDoneMask & (1 << TASK_FEED))
+        .Key("clean").Bool(state_.dailyDoneMask & (1 << TASK_CLEAN))
+        .Key("play").Bool(state_.dailyDoneMask & (1 << TASK_PLAY))
+        .Key("chat").Bool(state_.dailyDoneMask & (1 << TASK_CHAT))
+        .EndObject();
     
-    cJSON_AddNumberToObject(root, "login_streak", state_.loginStreak);
+    json.Key("login_streak").Int(state_.loginStreak);
+    json.EndObject();
     
-    char* json_str = cJSON_PrintUnformatted(root);
-    std::string result(json_str);
-    free(json_str);
-    cJSON_Delete(root);
-    
-    return result;
+    status_view_.version = version;
+    return status_view_.text;
 }
 
-std::string PetSystem::GetSuggestions() const {
-    std::string suggestions;
+std::string PetSystem::GetSuggestions() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
+    // 除状态外只有“好久没互动”与时间有关，作为缓存的区分条件
+    int64_t sinceInteraction = (GetCurrentTimeMs() - state_.lastInteractionMs) / 1000 / 60;
+    uint32_t lonely = sinceInteraction > 60 ? 1 : 0;
+    if (suggestions_view_.version == state_version_ && suggestions_view_.key == lonely) {
+        return suggestions_view_.text;
+    }
+    
+    std::string& suggestions = suggestions_view_.text;
+    suggestions.clear();
     
     if (state_.satiety < 30) {
         suggestions += "宠物饿了，该喂食了！ ";
@@ -607,8 +562,7 @@ std::string PetSystem::GetSuggestions() const {
         suggestions += "宠物心情不好，陪它玩一会儿吧！ ";
     }
     
-    int64_t sinceInteraction = (GetCurrentTimeMs() - state_.lastInteractionMs) / 1000 / 60;
-    if (sinceInteraction > 60) {
+    if (lonely) {
         suggestions += "好久没互动了，宠物想你了！ ";
     }
     
@@ -630,27 +584,81 @@ std::string PetSystem::GetSuggestions() const {
         suggestions = "宠物状态良好，继续保持！";
     }
     
+    suggestions_view_.version = state_version_;
+    suggestions_view_.key = lonely;
     return suggestions;
 }
 
 void PetSystem::ResetDaily() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     state_.dailyDoneMask = 0;
     chatCountToday_ = 0;
     state_.lastResetDayMs = GetCurrentTimeMs();
+    MarkChanged();
     SaveState();
+    ScheduleNextWake();
     ESP_LOGI(TAG, "🔄 Daily tasks reset manually");
 }
 
 void PetSystem::DebugSet(int mood, int satiety, int cleanliness) {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     state_.mood = Clamp(mood);
     state_.satiety = Clamp(satiety);
     state_.cleanliness = Clamp(cleanliness);
+    MarkChanged();
     SaveState();
+    ScheduleNextWake();
     ESP_LOGI(TAG, "🔧 Debug set: Mood=%d, Satiety=%d, Clean=%d", 
              state_.mood, state_.satiety, state_.cleanliness);
 }
 
 void PetSystem::LoadState() {
+    auto& persistence = PersistenceService::GetInstance();
+    record_id_ = persistence.Register("pet_state", "pet", "state", PET_RECORD_VERSION,
+        sizeof(PetStateRecord), PET_COMMIT_DELAY_MS);
+
+    PetStateRecord record;
+    if (persistence.Load(record_id_, &record, sizeof(record))) {
+        record.pet_type[sizeof(record.pet_type) - 1] = '\0';
+        state_.petType = record.pet_type;
+        state_.mood = record.mood;
+        state_.satiety = record.satiety;
+        state_.cleanliness = record.cleanliness;
+        state_.active = record.active;
+        state_.level = record.level;
+        state_.lastUpdateMs = record.last_update_ms;
+        state_.lastInteractionMs = record.last_interaction_ms;
+        state_.dailyDoneMask = record.daily_done_mask;
+        state_.loginStreak = record.login_streak;
+        state_.lastResetDayMs = record.last_reset_day_ms;
+    } else {
+        LoadLegacyState();
+    }
+    
+    // 验证宠物类型是否存在，不存在则使用默认猫咪
+    if (!FindPetType(state_.petType)) {
+        ESP_LOGW(TAG, "Invalid pet type '%s', reset to 'cat'", state_.petType.c_str());
+        state_.petType = "cat";
+    }
+    
+    ClampState();
+    
+    // 关机期间不衰减，从现在开始结算
+    state_.lastUpdateMs = GetCurrentTimeMs();
+    MarkChanged();
+    
+    auto pet_type = GetCurrentPetType();
+    ESP_LOGI(TAG, "📥 Loaded pet state from NVS: %s %s", 
+             pet_type ? pet_type->emoji.data() : "",
+             pet_type ? pet_type->name.data() : "");
+}
+
+// Reads the per-field keys older firmware wrote, moves them into the record and drops them
+void PetSystem::LoadLegacyState() {
     Settings settings("pet", true);
     
     state_.petType = settings.GetString("pet_type", "cat");
@@ -665,34 +673,36 @@ void PetSystem::LoadState() {
     state_.loginStreak = settings.GetInt("login_streak", 0);
     state_.lastResetDayMs = settings.GetInt64("last_reset_day", GetCurrentTimeMs());
     
-    // 验证宠物类型是否存在，不存在则使用默认猫咪
-    if (pet_types_.find(state_.petType) == pet_types_.end()) {
-        ESP_LOGW(TAG, "Invalid pet type '%s', reset to 'cat'", state_.petType.c_str());
-        state_.petType = "cat";
+    if (settings.GetString("pet_type", "").empty()) {
+        return;
+    }
+    ESP_LOGI(TAG, "Migrating pet state to a single record");
+    SaveState();
+    // The old keys are the only copy until the record is on flash
+    if (!PersistenceService::GetInstance().Flush()) {
+        ESP_LOGW(TAG, "Pet record not written, keeping the legacy keys");
+        return;
+    }
+    for (auto key : kLegacyStateKeys) {
+        settings.EraseKey(key);
     }
-    
-    ClampState();
-    
-    auto pet_type = GetCurrentPetType();
-    ESP_LOGI(TAG, "📥 Loaded pet state from NVS: %s %s", 
-             pet_type ? pet_type->emoji.c_str() : "",
-             pet_type ? pet_type->name.c_str() : "");
 }
 
 void PetSystem::SaveState() {
-    Settings settings("pet", true);
-    
-    settings.SetString("pet_type", state_.petType);
-    settings.SetInt("mood", state_.mood);
-    settings.SetInt("satiety", state_.satiety);
-    settings.SetInt("cleanliness", state_.cleanliness);
-    settings.SetInt("active", state_.active);
-    settings.SetInt("level", state_.level);
-    settings.SetInt64("last_ts", GetCurrentTimeMs());
-    settings.SetInt64("last_interact", state_.lastInteractionMs);
-    settings.SetInt("daily_done", state_.dailyDoneMask);
-    settings.SetInt("login_streak", state_.loginStreak);
-    settings.SetInt64("last_reset_day", state_.lastResetDayMs);
+    // Only stages the snapshot, PersistenceService writes it in the background
+    PetStateRecord record = {};
+    strncpy(record.pet_type, state_.petType.c_str(), sizeof(record.pet_type) - 1);
+    record.mood = state_.mood;
+    record.satiety = state_.satiety;
+    record.cleanliness = state_.cleanliness;
+    record.active = state_.active;
+    record.level = state_.level;
+    record.daily_done_mask = state_.dailyDoneMask;
+    record.login_streak = state_.loginStreak;
+    record.last_update_ms = state_.lastUpdateMs;
+    record.last_interaction_ms = state_.lastInteractionMs;
+    record.last_reset_day_ms = state_.lastResetDayMs;
+    PersistenceService::GetInstance().Update(record_id_, &record, sizeof(record));
     
     // 🧠 发布宠物状态变化事件（供学习系统使用）
     xiaozhi::PetStateEventData event_data = {
@@ -701,12 +711,7 @@ void PetSystem::SaveState() {
         .cleanliness = state_.cleanliness,
         .overall = GetOverallState()
     };
-    xiaozhi::EventBus::GetInstance().PublishNonBlocking(
-        xiaozhi::PET_EVENT,
-        xiaozhi::PET_STATE_CHANGED,
-        &event_data,
-        sizeof(event_data)
-    );
+    xiaozhi::EventBus::GetInstance().PublishNonBlocking<xiaozhi::PetStateChangedEvent>(event_data);
     
     // ESP_LOGI(TAG, "💾 Saved pet state to NVS");
 }
@@ -727,9 +732,7 @@ bool PetSystem::CheckCooldown(int64_t& lastActionMs, int cooldownSeconds) const
 }
 
 int64_t PetSystem::GetCurrentTimeMs() const {
-    struct timeval tv;
-    gettimeofday(&tv, nullptr);
-    int64_t time_ms = (int64_t)tv.tv_sec * 1000LL + tv.tv_usec / 1000LL;
+    int64_t time_ms = xiaozhi::time_utils::GetEpochTimeMs();
     
     // 🛡️ 基本合理性检查（时间不应该是负数或明显错误）
     if (time_ms < 0) {
@@ -745,6 +748,7 @@ int PetSystem::GetDaysSince1970(int64_t timestampMs) const {
 }
 
 bool PetSystem::SelectPetType(const std::string& type_name) {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
     // 🛡️ 输入验证：检查字符串格式
     if (type_name.empty() || type_name.length() > 32) {
         ESP_LOGE(TAG, "❌ Invalid pet type name length: %zu", type_name.length());
@@ -759,117 +763,128 @@ bool PetSystem::SelectPetType(const std::string& type_name) {
         }
     }
     
-    auto it = pet_types_.find(type_name);
-    if (it == pet_types_.end()) {
+    const PetType* type = FindPetType(type_name);
+    if (!type) {
         ESP_LOGW(TAG, "Pet type not found: %s", type_name.c_str());
         return false;
     }
     
-    if (!it->second.is_available) {
+    if (!type->is_available) {
         ESP_LOGW(TAG, "Pet type not available: %s", type_name.c_str());
         return false;
     }
     
+    // 衰减倍率随类型改变，先按旧类型结算
+    Settle();
     std::string old_type = state_.petType;
     state_.petType = type_name;
+    MarkChanged();
     SaveState();
+    ScheduleNextWake();
     
     ESP_LOGI(TAG, "🔄 Changed pet type: %s -> %s %s", 
              old_type.c_str(), 
-             it->second.emoji.c_str(),
-             it->second.name.c_str());
+             type->emoji.data(),
+             type->name.data());
     
     // 更新显示的宠物图标
     auto& board = Board::GetInstance();
     auto display = board.GetDisplay();
     if (display) {
-        display->SetPetEmoji(it->second.emoji.c_str());
-        ESP_LOGI(TAG, "Updated pet icon to %s", it->second.emoji.c_str());
+        display->SetPetEmoji(type->emoji.data());
+        ESP_LOGI(TAG, "Updated pet icon to %s", type->emoji.data());
     }
     
     return true;
 }
 
 const PetSystem::PetType* PetSystem::GetCurrentPetType() const {
-    auto it = pet_types_.find(state_.petType);
-    if (it != pet_types_.end()) {
-        return &it->second;
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    return FindPetType(state_.petType);
+}
+
+// ListPetTypes 中的分组：domestic、wild，其余归入 exotic
+static std::string_view GetPetTypeGroup(const PetTypeInfo& pet) {
+    if (pet.category == "domestic" || pet.category == "wild") {
+        return pet.category;
     }
-    return nullptr;
+    return "exotic";
 }
 
-std::string PetSystem::ListPetTypes() const {
-    cJSON* root = cJSON_CreateObject();
-    
-    // 按分类组织
-    cJSON* domestic = cJSON_CreateArray();
-    cJSON* wild = cJSON_CreateArray();
-    cJSON* exotic = cJSON_CreateArray();
-    
-    for (const auto& pair : pet_types_) {
-        if (!pair.second.is_available) continue;
+static void WritePetTypeGroup(xiaozhi::JsonWriter& json, std::string_view group) {
+    json.Key(group).BeginArray();
+    for (const auto& pet : kPetTypes) {
+        if (!pet.is_available || GetPetTypeGroup(pet) != group) continue;
         
-        cJSON* type = cJSON_CreateObject();
-        cJSON_AddStringToObject(type, "id", pair.first.c_str());
-        cJSON_AddStringToObject(type, "name", pair.second.name.c_str());
-        cJSON_AddStringToObject(type, "name_en", pair.second.name_en.c_str());
-        cJSON_AddStringToObject(type, "emoji", pair.second.emoji.c_str());
-        cJSON_AddStringToObject(type, "category", pair.second.category.c_str());
-        cJSON_AddNumberToObject(type, "hunger_rate", pair.second.hunger_rate);
-        cJSON_AddNumberToObject(type, "clean_rate", pair.second.clean_rate);
-        cJSON_AddNumberToObject(type, "mood_decay_rate", pair.second.mood_decay_rate);
-        cJSON_AddStringToObject(type, "personality", pair.second.personality.c_str());
-        cJSON_AddStringToObject(type, "special_trait", pair.second.special_trait.c_str());
-        
-        if (pair.second.category == "domestic") {
-            cJSON_AddItemToArray(domestic, type);
-        } else if (pair.second.category == "wild") {
-            cJSON_AddItemToArray(wild, type);
-        } else {
-            cJSON_AddItemToArray(exotic, type);
-        }
+        json.BeginObject()
+            .Key("id").String(pet.id)
+            .Key("name").String(pet.name)
+            .Key("name_en").String(pet.name_en)
+            .Key("emoji").String(pet.emoji)
+            .Key("category").String(pet.category)
+            .Key("hunger_rate").Double(pet.hunger_rate)
+            .Key("clean_rate").Double(pet.clean_rate)
+            .Key("mood_decay_rate").Double(pet.mood_decay_rate)
+            .Key("personality").String(pet.personality)
+            .Key("special_trait").String(pet.special_trait)
+            .EndObject();
+    }
+    json.EndArray();
+}
+
+std::string PetSystem::ListPetTypes() const {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    // 只有 current 随状态变化
+    if (types_view_.version == state_version_) {
+        return types_view_.text;
     }
     
-    cJSON_AddItemToObject(root, "domestic", domestic);
-    cJSON_AddItemToObject(root, "wild", wild);
-    cJSON_AddItemToObject(root, "exotic", exotic);
-    cJSON_AddStringToObject(root, "current", state_.petType.c_str());
+    types_view_.text.clear();
+    xiaozhi::JsonWriter json(types_view_.text);
+    json.BeginObject();
+    WritePetTypeGroup(json, "domestic");
+    WritePetTypeGroup(json, "wild");
+    WritePetTypeGroup(json, "exotic");
+    json.Key("current").String(state_.petType);
+    json.EndObject();
     
-    char* json_str = cJSON_PrintUnformatted(root);
-    std::string result(json_str);
-    free(json_str);
-    cJSON_Delete(root);
-    
-    return result;
+    types_view_.version = state_version_;
+    return types_view_.text;
 }
 
 std::string PetSystem::GetPetTypeInfo(const std::string& type_name) const {
-    auto it = pet_types_.find(type_name);
-    if (it == pet_types_.end()) {
-        return "{\"error\":\"Pet type not found\"}";
-    }
-    
-    const auto& pet = it->second;
-    cJSON* root = cJSON_CreateObject();
-    cJSON_AddStringToObject(root, "id", type_name.c_str());
-    cJSON_AddStringToObject(root, "name", pet.name.c_str());
-    cJSON_AddStringToObject(root, "name_en", pet.name_en.c_str());
-    cJSON_AddStringToObject(root, "emoji", pet.emoji.c_str());
-    cJSON_AddStringToObject(root, "category", pet.category.c_str());
-    cJSON_AddNumberToObject(root, "hunger_rate", pet.hunger_rate);
-    cJSON_AddNumberToObject(root, "clean_rate", pet.clean_rate);
-    cJSON_AddNumberToObject(root, "mood_decay_rate", pet.mood_decay_rate);
-    cJSON_AddStringToObject(root, "personality", pet.personality.c_str());
-    cJSON_AddStringToObject(root, "special_trait", pet.special_trait.c_str());
-    cJSON_AddBoolToObject(root, "is_available", pet.is_available);
-    cJSON_AddBoolToObject(root, "is_current", type_name == state_.petType);
-    
-    char* json_str = cJSON_PrintUnformatted(root);
-    std::string result(json_str);
-    free(json_str);
-    cJSON_Delete(root);
-    
-    return result;
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    static const std::string kNotFound = "{\"error\":\"Pet type not found\"}";
+    const PetType* pet = FindPetType(type_name);
+    if (!pet) {
+        return kNotFound;
+    }
+    
+    uint32_t index = (uint32_t)(pet - kPetTypes);
+    if (type_info_view_.version == state_version_ && type_info_view_.key == index) {
+        return type_info_view_.text;
+    }
+    
+    type_info_view_.text.clear();
+    xiaozhi::JsonWriter json(type_info_view_.text);
+    json.BeginObject()
+        .Key("id").String(pet->id)
+        .Key("name").String(pet->name)
+        .Key("name_en").String(pet->name_en)
+        .Key("emoji").String(pet->emoji)
+        .Key("category").String(pet->category)
+        .Key("hunger_rate").Double(pet->hunger_rate)
+        .Key("clean_rate").Double(pet->clean_rate)
+        .Key("mood_decay_rate").Double(pet->mood_decay_rate)
+        .Key("personality").String(pet->personality)
+        .Key("special_trait").String(pet->special_trait)
+        .Key("is_available").Bool(pet->is_available)
+        .Key("is_current").Bool(type_name == state_.petType)
+        .EndObject();
+    
+    type_info_view_.version = state_version_;
+    type_info_view_.key = index;
+    return type_info_view_.text;
 }
 
 void PetSystem::SetWarningCallback(std::function<void(const std::string&)> callback) {
@@ -900,14 +915,18 @@ void PetSystem::EnableAutoAnnouncement(bool enable, int interval_min) {
 }
 
 std::string PetSystem::CheckWarning() {
+    xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+    Settle();
+    
     auto pet_type = GetCurrentPetType();
     if (!pet_type) {
         return "";
     }
     
-    // 🧠 时段感知：判断是否应该抑制警告
+    // 🧠 时段感知：判断是否应该抑制警告（读取一次决策快照）
     auto& adaptive = xiaozhi::AdaptiveBehavior::GetInstance();
-    if (adaptive.ShouldSuppressPetWarning()) {
+    const auto decision = adaptive.GetSnapshot();
+    if (decision.suppress_pet_warning) {
         ESP_LOGD(TAG, "🔕 Pet warning suppressed by context (night/work time)");
         return "";
     }
@@ -916,7 +935,7 @@ std::string PetSystem::CheckWarning() {
     std::string message;
     
     // 🎯 获取自适应警告阈值偏移
-    int threshold_offset = adaptive.GetPetWarningThresholdOffset();
+    int threshold_offset = decision.pet_warning_threshold_offset;
     int adjusted_satiety_threshold = WARNING_SATIETY_THRESHOLD + threshold_offset;
     int adjusted_clean_threshold = WARNING_CLEAN_THRESHOLD + threshold_offset;
     int adjusted_mood_threshold = WARNING_MOOD_THRESHOLD + threshold_offset;
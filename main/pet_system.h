@@ -3,37 +3,37 @@
 
 #include <cstdint>
 #include <string>
-#include <map>
 #include <functional>
 #include <esp_timer.h>
 
+#include "persistence_service.h"
+#include "pet_catalog.h"
+#include "timer_service.h"
+#include "learning/learning_state_lock.h"
+
+namespace xiaozhi {
+class LearningSimulator;
+}
+
 /**
  * @brief 电子宠物系统 - 轻量级实现
  * 
  * 特性：
  * - 三维状态：心情(mood)、饱腹(satiety)、清洁(cleanliness)
- * - 自动衰减：久未互动会降低状态
+ * - 自动衰减：久未互动会降低状态（读取时按经过的分钟数一次算出）
  * - 每日任务：喂食、洗澡、玩耍、聊天
  * - 表情联动：自动根据状态切换表情
  * - NVS 持久化：断电不丢失
- * - CPU 友好：1分钟 tick，简单计算
+ * - CPU 友好：只在预计触发警告阈值或每日重置时唤醒
+ *
+ * 只在主循环中调用（定时器唤醒也转交给主循环）；公开接口持有学习状态锁，
+ * 与在后台运行的学习模拟器互斥。
  */
 
 class PetSystem {
 public:
-    // 宠物类型配置
-    struct PetType {
-        std::string name;           // 名称（中文）
-        std::string name_en;        // 英文名称
-        std::string emoji;          // 表情符号
-        std::string category;       // 分类：domestic(家养)/wild(野生)/exotic(奇异)
-        float hunger_rate;          // 饥饿速度倍率（1.0=正常）
-        float clean_rate;           // 脏污速度倍率（1.0=正常）
-        float mood_decay_rate;      // 心情衰减倍率（1.0=正常）
-        std::string personality;    // 性格描述
-        std::string special_trait;  // 特殊能力
-        bool is_available;          // 是否可用（预留）
-    };
+    // 宠物类型配置（见 pet_catalog.h，编译期常量表）
+    using PetType = PetTypeInfo;
 
     // 宠物状态结构
     struct State {
@@ -78,9 +78,15 @@ public:
     void Stop();
 
     /**
-     * @brief 获取当前状态
+     * @brief 获取当前状态（先结算到当前时间的衰减）
+     *
+     * 返回副本：锁在返回时已释放，引用可能读到模拟器或其他任务写到一半的状态
      */
-    const State& GetState() const { return state_; }
+    State GetState() {
+        xiaozhi::LearningStateGuard lock(xiaozhi::GetLearningStateMutex());
+        Settle();
+        return state_;
+    }
 
     /**
      * @brief 选择宠物类型
@@ -96,12 +102,12 @@ public:
 
     /**
      * @brief 列出所有可用的宠物类型
-     * @return JSON 格式的宠物类型列表
+     * @return JSON 格式的宠物类型列表（缓存，状态变化后重建）
      */
     std::string ListPetTypes() const;
 
     /**
-     * @brief 获取指定宠物类型的详细信息
+     * @brief 获取指定宠物类型的详细信息（缓存最近一次查询）
      */
     std::string GetPetTypeInfo(const std::string& type_name) const;
 
@@ -145,19 +151,19 @@ public:
      * @brief 获取建议的表情
      * @return 表情名称：happy, sad, neutral, thinking, embarrassed等
      */
-    std::string GetRecommendedEmotion() const;
+    std::string GetRecommendedEmotion();
 
     /**
      * @brief 获取状态描述
-     * @return JSON 格式的状态描述
+     * @return JSON 格式的状态描述（缓存，状态变化后重建）
      */
-    std::string GetStatusDescription() const;
+    std::string GetStatusDescription();
 
     /**
      * @brief 获取建议事项
-     * @return 字符串列表，如"该喂食了"、"需要洗澡"
+     * @return 字符串列表，如"该喂食了"、"需要洗澡"（缓存，状态变化后重建）
      */
-    std::string GetSuggestions() const;
+    std::string GetSuggestions();
 
     /**
      * @brief 重置每日任务（测试用，正常由定时器触发）
@@ -198,22 +204,46 @@ public:
     std::string CheckWarning();
 
 private:
+    // 模拟器换入/换出状态并直接驱动唤醒
+    friend class xiaozhi::LearningSimulator;
+
     PetSystem();
     ~PetSystem();
 
-    // 定时器回调（1分钟tick）
-    static void TimerCallback(void* arg);
-    void OnTick();
+    // 序列化结果缓存：version 与 state_version_ 相同且 key 相同时直接返回
+    struct CachedView {
+        uint32_t version = 0;
+        uint32_t key = 0;       // 额外的区分条件（如查询的类型）
+        std::string text;
+    };
+
+    // 每分钟的衰减量（取整方式与原先逐分钟 tick 相同）
+    struct DecaySteps {
+        int satiety;
+        int cleanliness;
+        int mood;           // 最近有互动
+        int lonely_mood;    // 超过 NO_INTERACTION_MIN 分钟无互动
+    };
+
+    // 唤醒（在主循环中运行）：结算状态、检查警告、保存，并预约下一次唤醒
+    void OnWake();
+    // 结算从 lastUpdateMs 到现在的衰减和每日重置
+    void Settle();
+    // 预约下一次唤醒：最近的警告阈值穿越或每日重置
+    void ScheduleNextWake();
+    int64_t PredictNextWakeMs();
     
     // 状态检查和警告
     void CheckAndNotifyWarnings();
 
     // 加载和保存状态
     void LoadState();
+    void LoadLegacyState();
     void SaveState();
 
     // 状态更新
-    void UpdateDecay();      // 衰减计算
+    void MarkChanged() { state_version_++; }  // 对外可见的状态变化后调用，使缓存失效
+    void UpdateDecay();      // 衰减计算（闭式，按经过的整分钟数）
     void CheckDailyReset();  // 检查每日重置
     void ClampState();       // 限制状态范围
 
@@ -228,17 +258,24 @@ private:
     bool CheckCooldown(int64_t& lastActionMs, int cooldownSeconds) const;
     int64_t GetCurrentTimeMs() const;
     int GetDaysSince1970(int64_t timestampMs) const;
+    DecaySteps GetDecaySteps() const;
+    int64_t GetCalmMinutes(int64_t fromMs) const;  // fromMs 之后心情仍按正常速度衰减的分钟数
     
     // 🛡️ 安全的消息构建（防止字符串拼接异常）
     std::string BuildWarningMessage(const PetType* pet_type, const std::string& base_message);
 
     State state_;
-    esp_timer_handle_t timer_handle_ = nullptr;
+    PersistentRecordId record_id_ = -1;
+    TimerHandle wake_timer_;
+    int64_t next_wake_ms_ = 0;
     bool started_ = false;
 
-    // 宠物类型数据库
-    std::map<std::string, PetType> pet_types_;
-    void InitializePetTypes();  // 初始化宠物类型数据
+    // 状态版本和序列化缓存
+    uint32_t state_version_ = 1;
+    mutable CachedView status_view_;
+    mutable CachedView suggestions_view_;
+    mutable CachedView types_view_;
+    mutable CachedView type_info_view_;
 
     // 冷却时间戳
     int64_t lastFeedMs_ = 0;
@@ -268,6 +305,8 @@ private:
     static constexpr int DECAY_MOOD_PER_MIN = 1;       // 每分钟心情衰减（无互动时）
     
     static constexpr int NO_INTERACTION_MIN = 10;      // 10分钟无互动判定
+    static constexpr int64_t MINUTE_MS = 60 * 1000;
+    static constexpr int WAKE_SLACK_MS = 10 * 1000;    // 允许延后10秒与其他定时器合并唤醒
     
     // 警告阈值
     static constexpr int WARNING_SATIETY_THRESHOLD = 30;     // 饱腹度低于30%警告
@@ -0,0 +1,279 @@
+#include "incoming_message.h"
+
+#include <esp_log.h>
+#include <cstring>
+
+#define TAG "IncomingMessage"
+
+static inline const char* SkipWhitespace(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+        p++;
+    }
+    return p;
+}
+
+// p points after the opening quote, returns the position of the closing quote
+static const char* ScanString(const char* p, const char* end) {
+    while (p < end) {
+        if (*p == '\\') {
+            p += 2;
+            continue;
+        }
+        if (*p == '"') {
+            return p;
+        }
+        p++;
+    }
+    return nullptr;
+}
+
+// p points at '{' or '[', returns the position after the matching bracket
+static const char* SkipContainer(const char* p, const char* end) {
+    int depth = 0;
+    while (p < end) {
+        char c = *p;
+        if (c == '"') {
+            p = ScanString(p + 1, end);
+            if (p == nullptr) {
+                return nullptr;
+            }
+        } else if (c == '{' || c == '[') {
+            depth++;
+        } else if (c == '}' || c == ']') {
+            if (--depth == 0) {
+                return p + 1;
+            }
+        }
+        p++;
+    }
+    return nullptr;
+}
+
+static inline int HexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+static bool ReadHex4(const char* p, const char* end, uint32_t& value) {
+    if (end - p < 4) {
+        return false;
+    }
+    value = 0;
+    for (int i = 0; i < 4; i++) {
+        int v = HexValue(p[i]);
+        if (v < 0) {
+            return false;
+        }
+        value = (value << 4) | v;
+    }
+    return true;
+}
+
+static void AppendUtf8(std::string& out, uint32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(cp);
+    } else if (cp < 0x800) {
+        out.push_back(0xC0 | (cp >> 6));
+        out.push_back(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        out.push_back(0xE0 | (cp >> 12));
+        out.push_back(0x80 | ((cp >> 6) & 0x3F));
+        out.push_back(0x80 | (cp & 0x3F));
+    } else {
+        out.push_back(0xF0 | (cp >> 18));
+        out.push_back(0x80 | ((cp >> 12) & 0x3F));
+        out.push_back(0x80 | ((cp >> 6) & 0x3F));
+        out.push_back(0x80 | (cp & 0x3F));
+    }
+}
+
+static bool Unescape(std::string_view raw, std::string& out) {
+    out.clear();
+    out.reserve(raw.size());
+    const char* p = raw.data();
+    const char* end = p + raw.size();
+    while (p < end) {
+        if (*p != '\\') {
+            out.push_back(*p++);
+            continue;
+        }
+        if (++p >= end) {
+            return false;
+        }
+        char c = *p++;
+        switch (c) {
+            case '"': out.push_back('"'); break;
+            case '\\': out.push_back('\\'); break;
+            case '/': out.push_back('/'); break;
+            case 'b': out.push_back('\b'); break;
+            case 'f': out.push_back('\f'); break;
+            case 'n': out.push_back('\n'); break;
+            case 'r': out.push_back('\r'); break;
+            case 't': out.push_back('\t'); break;
+            case 'u': {
+                uint32_t cp;
+                if (!ReadHex4(p, end, cp)) {
+                    return false;
+                }
+                p += 4;
+                // Surrogate pair
+                if (cp >= 0xD800 && cp <= 0xDBFF) {
+                    uint32_t low;
+                    if (end - p < 6 || p[0] != '\\' || p[1] != 'u' || !ReadHex4(p + 2, end, low) ||
+                        low < 0xDC00 || low > 0xDFFF) {
+                        return false;
+                    }
+                    p += 6;
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                }
+                AppendUtf8(out, cp);
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+IncomingMessage::IncomingMessage(const char* data, size_t len) : data_(data), len_(len) {
+    tokenized_ = Tokenize();
+}
+
+IncomingMessage::~IncomingMessage() {
+    if (root_ != nullptr) {
+        cJSON_Delete(root_);
+    }
+}
+
+bool IncomingMessage::Tokenize() {
+    const char* p = data_;
+    const char* end = data_ + len_;
+    p = SkipWhitespace(p, end);
+    if (p >= end || *p != '{') {
+        return false;
+    }
+    p = SkipWhitespace(p + 1, end);
+    if (p < end && *p == '}') {
+        return true;
+    }
+
+    while (p < end) {
+        // Key
+        if (*p != '"') {
+            return false;
+        }
+        const char* key_end = ScanString(p + 1, end);
+        if (key_end == nullptr) {
+            return false;
+        }
+        std::string_view key(p + 1, key_end - p - 1);
+        p = SkipWhitespace(key_end + 1, end);
+        if (p >= end || *p != ':') {
+            return false;
+        }
+        p = SkipWhitespace(p + 1, end);
+        if (p >= end) {
+            return false;
+        }
+
+        // Value
+        Field field = { key, {}, false };
+        if (*p == '"') {
+            const char* value_end = ScanString(p + 1, end);
+            if (value_end == nullptr) {
+                return false;
+            }
+            field.value = std::string_view(p + 1, value_end - p - 1);
+            field.is_string = true;
+            p = value_end + 1;
+        } else if (*p == '{' || *p == '[') {
+            const char* value_end = SkipContainer(p, end);
+            if (value_end == nullptr) {
+                return false;
+            }
+            field.value = std::string_view(p, value_end - p);
+            p = value_end;
+        } else {
+            const char* value_start = p;
+            while (p < end && *p != ',' && *p != '}' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r') {
+                p++;
+            }
+            field.value = std::string_view(value_start, p - value_start);
+        }
+
+        // Messages with more fields than we track are left to cJSON
+        if (field_count_ >= kMaxFields) {
+            return false;
+        }
+        fields_[field_count_++] = field;
+
+        p = SkipWhitespace(p, end);
+        if (p < end && *p == ',') {
+            p = SkipWhitespace(p + 1, end);
+            continue;
+        }
+        return p < end && *p == '}';
+    }
+    return false;
+}
+
+const IncomingMessage::Field* IncomingMessage::FindField(std::string_view key) const {
+    for (int i = 0; i < field_count_; i++) {
+        if (fields_[i].key == key) {
+            return &fields_[i];
+        }
+    }
+    return nullptr;
+}
+
+std::string_view IncomingMessage::type() const {
+    if (tokenized_) {
+        auto field = FindField("type");
+        return (field != nullptr && field->is_string) ? field->value : std::string_view();
+    }
+    auto type = cJSON_GetObjectItem(root(), "type");
+    return cJSON_IsString(type) ? std::string_view(type->valuestring) : std::string_view();
+}
+
+bool IncomingMessage::GetString(std::string_view key, std::string& value) const {
+    if (tokenized_) {
+        auto field = FindField(key);
+        if (field == nullptr || !field->is_string) {
+            return false;
+        }
+        if (field->value.find('\\') == std::string_view::npos) {
+            value.assign(field->value.data(), field->value.size());
+            return true;
+        }
+        return Unescape(field->value, value);
+    }
+    auto item = cJSON_GetObjectItem(root(), std::string(key).c_str());
+    if (!cJSON_IsString(item)) {
+        return false;
+    }
+    value = item->valuestring;
+    return true;
+}
+
+bool IncomingMessage::Equals(std::string_view key, std::string_view value) const {
+    if (tokenized_) {
+        auto field = FindField(key);
+        return field != nullptr && field->is_string && field->value == value;
+    }
+    auto item = cJSON_GetObjectItem(root(), std::string(key).c_str());
+    return cJSON_IsString(item) && value == item->valuestring;
+}
+
+const cJSON* IncomingMessage::root() const {
+    if (root_ == nullptr && !parse_failed_) {
+        root_ = cJSON_ParseWithLength(data_, len_);
+        if (root_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to parse json message: %.*s", (int)len_, data_);
+            parse_failed_ = true;
+        }
+    }
+    return root_;
+}
@@ -0,0 +1,63 @@
+#ifndef INCOMING_MESSAGE_H
+#define INCOMING_MESSAGE_H
+
+#include <cJSON.h>
+#include <string>
+#include <string_view>
+
+/*
+ * A JSON text message received from the server.
+ *
+ * The top level object is split into key / value views in place, without
+ * allocating. Hot messages (tts, stt, llm) only need a few flat string
+ * fields and never build a cJSON tree. Handlers that need nested values
+ * call root(), which parses the message with cJSON on first use.
+ */
+class IncomingMessage {
+public:
+    IncomingMessage(const char* data, size_t len);
+    ~IncomingMessage();
+
+    IncomingMessage(const IncomingMessage&) = delete;
+    IncomingMessage& operator=(const IncomingMessage&) = delete;
+
+    inline const char* data() const {
+        return data_;
+    }
+    inline size_t size() const {
+        return len_;
+    }
+    inline bool HasTree() const {
+        return root_ != nullptr;
+    }
+
+    // Value of the "type" field, empty if missing
+    std::string_view type() const;
+    // Read a top level string field, JSON escapes are decoded
+    bool GetString(std::string_view key, std::string& value) const;
+    // Compare a top level string field with a value that contains no escapes
+    bool Equals(std::string_view key, std::string_view value) const;
+    // Full cJSON tree, parsed on first use and owned by this message
+    const cJSON* root() const;
+
+private:
+    struct Field {
+        std::string_view key;
+        std::string_view value;     // Raw value, quotes stripped for strings
+        bool is_string;
+    };
+    static constexpr int kMaxFields = 12;
+
+    const char* data_;
+    size_t len_;
+    Field fields_[kMaxFields];
+    int field_count_ = 0;
+    bool tokenized_ = false;
+    mutable cJSON* root_ = nullptr;
+    mutable bool parse_failed_ = false;
+
+    bool Tokenize();
+    const Field* FindField(std::string_view key) const;
+};
+
+#endif // INCOMING_MESSAGE_H
@@ -0,0 +1,107 @@
+#include "link_stats.h"
+
+#include <esp_timer.h>
+
+// Without sender timestamps a longer pause is a new utterance, not jitter
+#define LINK_STATS_MAX_UNTIMED_GAP_US 500000
+// Larger transit changes come from a timestamp reset on the server
+#define LINK_STATS_MAX_TRANSIT_CHANGE_US 10000000
+
+uint32_t LinkStatsSnapshot::loss_permille() const {
+    uint32_t expected = packets_received + packets_lost;
+    return expected > 0 ? packets_lost * 1000 / expected : 0;
+}
+
+uint32_t LinkStatsSnapshot::reorder_permille() const {
+    return packets_received > 0 ? packets_reordered * 1000 / packets_received : 0;
+}
+
+cJSON* LinkStatsSnapshot::ToJson() const {
+    auto json = cJSON_CreateObject();
+    cJSON_AddNumberToObject(json, "duration_ms", duration_ms);
+    cJSON_AddNumberToObject(json, "rtt_ms", rtt_ms);
+    cJSON_AddNumberToObject(json, "jitter_ms", jitter_ms);
+    cJSON_AddNumberToObject(json, "packets", packets_received);
+    cJSON_AddNumberToObject(json, "loss_permille", loss_permille());
+    cJSON_AddNumberToObject(json, "reorder_permille", reorder_permille());
+    cJSON_AddNumberToObject(json, "rx_kbps", rx_kbps);
+    cJSON_AddNumberToObject(json, "tx_kbps", tx_kbps);
+    return json;
+}
+
+void LinkStats::Reset() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    start_time_us_ = esp_timer_get_time();
+    rtt_ms_ = 0;
+    packets_received_ = 0;
+    bytes_received_ = 0;
+    bytes_sent_ = 0;
+    last_arrival_us_ = 0;
+    last_send_time_us_ = 0;
+    jitter_us_x16_ = 0;
+}
+
+void LinkStats::OnRttMeasured(uint32_t rtt_ms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rtt_ms_ = rtt_ms;
+}
+
+void LinkStats::OnAudioReceived(uint32_t timestamp_ms, int frame_duration_ms) {
+    int64_t arrival_us = esp_timer_get_time();
+    std::lock_guard<std::mutex> lock(mutex_);
+    packets_received_++;
+
+    int64_t send_time_us;
+    if (timestamp_ms != 0) {
+        send_time_us = (int64_t)timestamp_ms * 1000;
+    } else if (last_arrival_us_ == 0 || arrival_us - last_arrival_us_ > LINK_STATS_MAX_UNTIMED_GAP_US) {
+        // Start a new reference, there is nothing to compare this frame with
+        last_arrival_us_ = arrival_us;
+        last_send_time_us_ = 0;
+        return;
+    } else {
+        send_time_us = last_send_time_us_ + frame_duration_ms * 1000;
+    }
+
+    if (last_arrival_us_ != 0) {
+        // D(i-1, i) = (Rj - Ri) - (Sj - Si), J += (|D| - J) / 16
+        int64_t d = (arrival_us - last_arrival_us_) - (send_time_us - last_send_time_us_);
+        if (d < 0) {
+            d = -d;
+        }
+        if (d < LINK_STATS_MAX_TRANSIT_CHANGE_US) {
+            jitter_us_x16_ += d - ((jitter_us_x16_ + 8) >> 4);
+        }
+    }
+    last_arrival_us_ = arrival_us;
+    last_send_time_us_ = send_time_us;
+}
+
+void LinkStats::OnBytesReceived(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytes_received_ += bytes;
+}
+
+void LinkStats::OnBytesSent(size_t bytes) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bytes_sent_ += bytes;
+}
+
+LinkStatsSnapshot LinkStats::GetSnapshot() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    LinkStatsSnapshot snapshot;
+    if (start_time_us_ == 0) {
+        return snapshot;
+    }
+    snapshot.duration_ms = (esp_timer_get_time() - start_time_us_) / 1000;
+    snapshot.rtt_ms = rtt_ms_;
+    snapshot.jitter_ms = (jitter_us_x16_ >> 4) / 1000;
+    snapshot.packets_received = packets_received_;
+    snapshot.bytes_received = bytes_received_;
+    snapshot.bytes_sent = bytes_sent_;
+    if (snapshot.duration_ms > 0) {
+        snapshot.rx_kbps = (uint64_t)bytes_received_ * 8 / snapshot.duration_ms;
+        snapshot.tx_kbps = (uint64_t)bytes_sent_ * 8 / snapshot.duration_ms;
+    }
+    return snapshot;
+}
@@ -0,0 +1,54 @@
+#ifndef LINK_STATS_H
+#define LINK_STATS_H
+
+#include <cJSON.h>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+struct LinkStatsSnapshot {
+    uint32_t duration_ms = 0;
+    uint32_t rtt_ms = 0;            // Hello round trip, 0 if not measured yet
+    uint32_t jitter_ms = 0;         // RFC 3550 interarrival jitter of the downlink audio
+    uint32_t packets_received = 0;
+    uint32_t packets_lost = 0;
+    uint32_t packets_reordered = 0;
+    uint32_t bytes_received = 0;
+    uint32_t bytes_sent = 0;
+    uint32_t rx_kbps = 0;           // Average over the session
+    uint32_t tx_kbps = 0;
+
+    // Rates in per mille of the expected packets
+    uint32_t loss_permille() const;
+    uint32_t reorder_permille() const;
+    cJSON* ToJson() const;
+};
+
+/*
+ * Link quality of one audio session, fed by the protocol receive and send
+ * paths. Transports without timestamps (websocket version 1 and 3) are
+ * assumed to send frames one frame duration apart.
+ */
+class LinkStats {
+public:
+    void Reset();
+    void OnRttMeasured(uint32_t rtt_ms);
+    // timestamp_ms is the sender timestamp of the frame, 0 if the transport has none
+    void OnAudioReceived(uint32_t timestamp_ms, int frame_duration_ms);
+    void OnBytesReceived(size_t bytes);
+    void OnBytesSent(size_t bytes);
+    LinkStatsSnapshot GetSnapshot() const;
+
+private:
+    mutable std::mutex mutex_;
+    int64_t start_time_us_ = 0;
+    uint32_t rtt_ms_ = 0;
+    uint32_t packets_received_ = 0;
+    uint32_t bytes_received_ = 0;
+    uint32_t bytes_sent_ = 0;
+    int64_t last_arrival_us_ = 0;
+    int64_t last_send_time_us_ = 0;
+    uint32_t jitter_us_x16_ = 0;    // Scaled by 16 like the RFC 3550 reference code
+};
+
+#endif // LINK_STATS_H
@@ -0,0 +1,54 @@
+#include "message_dispatcher.h"
+
+#include <esp_log.h>
+#include <algorithm>
+
+#define TAG "MessageDispatcher"
+
+void MessageDispatcher::Register(std::string_view type, Handler handler) {
+    uint32_t hash = HashMessageType(type);
+    auto it = std::lower_bound(handlers_.begin(), handlers_.end(), hash,
+        [](const Entry& entry, uint32_t hash) { return entry.hash < hash; });
+    if (it != handlers_.end() && it->hash == hash) {
+        if (it->type != type) {
+            ESP_LOGE(TAG, "Message type hash collision: %s and %.*s", it->type.c_str(), (int)type.size(), type.data());
+            return;
+        }
+        ESP_LOGW(TAG, "Replace handler for message type: %s", it->type.c_str());
+        it->handler = std::move(handler);
+        return;
+    }
+    handlers_.insert(it, Entry(hash, std::string(type), std::move(handler)));
+}
+
+bool MessageDispatcher::Dispatch(const IncomingMessage& message) {
+    auto type = message.type();
+    uint32_t hash = HashMessageType(type);
+    auto it = std::lower_bound(handlers_.begin(), handlers_.end(), hash,
+        [](const Entry& entry, uint32_t hash) { return entry.hash < hash; });
+    if (it == handlers_.end() || it->hash != hash || it->type != type) {
+        unknown_count_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    it->count.fetch_add(1, std::memory_order_relaxed);
+    it->handler(message);
+    if (message.HasTree()) {
+        tree_parsed_count_.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void MessageDispatcher::LogStats() const {
+    uint32_t unknown = unknown_count_.load(std::memory_order_relaxed);
+    uint32_t total = unknown;
+    for (auto& entry : handlers_) {
+        uint32_t count = entry.count.load(std::memory_order_relaxed);
+        total += count;
+        if (count > 0) {
+            ESP_LOGI(TAG, "  %s: %lu", entry.type.c_str(), count);
+        }
+    }
+    ESP_LOGI(TAG, "Messages: %lu, parsed with cJSON: %lu, unknown: %lu", total,
+        tree_parsed_count_.load(std::memory_order_relaxed), unknown);
+}
@@ -0,0 +1,62 @@
+#ifndef MESSAGE_DISPATCHER_H
+#define MESSAGE_DISPATCHER_H
+
+#include "incoming_message.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// FNV-1a hash of a message type, usable at compile time
+constexpr uint32_t HashMessageType(std::string_view type) {
+    uint32_t hash = 2166136261u;
+    for (char c : type) {
+        hash = (hash ^ (uint8_t)c) * 16777619u;
+    }
+    return hash;
+}
+
+/*
+ * Routes incoming server messages to the handler registered for their "type".
+ * Handlers are registered by the owning subsystems during startup, before the
+ * protocol is started, and are called from the protocol's network task.
+ */
+class MessageDispatcher {
+public:
+    using Handler = std::function<void(const IncomingMessage& message)>;
+
+    void Register(std::string_view type, Handler handler);
+    // Returns false if no handler is registered for the message type
+    bool Dispatch(const IncomingMessage& message);
+    void LogStats() const;
+
+private:
+    struct Entry {
+        uint32_t hash;
+        std::string type;
+        Handler handler;
+        std::atomic<uint32_t> count = 0;
+
+        Entry(uint32_t hash, std::string type, Handler handler)
+            : hash(hash), type(std::move(type)), handler(std::move(handler)) {}
+        // Entries only move while handlers are registered, before any dispatch
+        Entry(Entry&& other) noexcept { *this = std::move(other); }
+        Entry& operator=(Entry&& other) noexcept {
+            hash = other.hash;
+            type = std::move(other.type);
+            handler = std::move(other.handler);
+            count.store(other.count.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            return *this;
+        }
+    };
+
+    // Sorted by hash for binary search
+    std::vector<Entry> handlers_;
+    // Counted on the network task, read by LogStats on the main task
+    std::atomic<uint32_t> unknown_count_ = 0;
+    std::atomic<uint32_t> tree_parsed_count_ = 0;
+};
+
+#endif // MESSAGE_DISPATCHER_H
@@ -2,6 +2,7 @@
 #include "board.h"
 #include "application.h"
 #include "settings.h"
+#include "protocol_recorder.h"
 
 #include <esp_log.h>
 #include <cstring>
@@ -10,35 +11,19 @@
 
 #define TAG "MQTT"
 
-MqttProtocol::MqttProtocol() {
+MqttProtocol::MqttProtocol()
+    : reorder_window_([this](std::unique_ptr<AudioStreamPacket> packet) { DeliverAudioPacket(std::move(packet)); }) {
     event_group_handle_ = xEventGroupCreate();
-
-    // Initialize reconnect timer
-    esp_timer_create_args_t reconnect_timer_args = {
-        .callback = [](void* arg) {
-            MqttProtocol* protocol = (MqttProtocol*)arg;
-            auto& app = Application::GetInstance();
-            if (app.GetDeviceState() == kDeviceStateIdle) {
-                ESP_LOGI(TAG, "Reconnecting to MQTT server");
-                app.Schedule([protocol]() {
-                    protocol->StartMqttClient(false);
-                });
-            }
-        },
-        .arg = this,
-    };
-    esp_timer_create(&reconnect_timer_args, &reconnect_timer_);
+    mbedtls_aes_init(&aes_ctx_);
 }
 
 MqttProtocol::~MqttProtocol() {
     ESP_LOGI(TAG, "MqttProtocol deinit");
-    if (reconnect_timer_ != nullptr) {
-        esp_timer_stop(reconnect_timer_);
-        esp_timer_delete(reconnect_timer_);
-    }
+    reconnect_timer_.Cancel();
 
     udp_.reset();
     mqtt_.reset();
+    mbedtls_aes_free(&aes_ctx_);
     
     if (event_group_handle_ != nullptr) {
         vEventGroupDelete(event_group_handle_);
@@ -80,43 +65,58 @@ bool MqttProtocol::StartMqttClient(bool report_error) {
             on_disconnected_();
         }
         ESP_LOGI(TAG, "MQTT disconnected, schedule reconnect in %d seconds", MQTT_RECONNECT_INTERVAL_MS / 1000);
-        esp_timer_start_once(reconnect_timer_, MQTT_RECONNECT_INTERVAL_MS * 1000);
+        // The exact moment does not matter, a late reconnect may share a wakeup
+        reconnect_timer_ = TimerService::GetInstance().StartOnce("mqtt_reconnect", MQTT_RECONNECT_INTERVAL_MS,
+            MQTT_RECONNECT_INTERVAL_MS / 10, [this]() {
+                auto& app = Application::GetInstance();
+                if (app.GetDeviceState() == kDeviceStateIdle) {
+                    ESP_LOGI(TAG, "Reconnecting to MQTT server");
+                    app.Schedule([this]() {
+                        StartMqttClient(false);
+                    });
+                }
+            });
     });
 
     mqtt_->OnConnected([this]() {
         if (on_connected_ != nullptr) {
             on_connected_();
         }
-        esp_timer_stop(reconnect_timer_);
+        reconnect_timer_.Cancel();
     });
 
     mqtt_->OnMessage([this](const std::string& topic, const std::string& payload) {
-        cJSON* root = cJSON_Parse(payload.c_str());
-        if (root == nullptr) {
-            ESP_LOGE(TAG, "Failed to parse json message %s", payload.c_str());
-            return;
-        }
-        cJSON* type = cJSON_GetObjectItem(root, "type");
-        if (!cJSON_IsString(type)) {
-            ESP_LOGE(TAG, "Message type is invalid");
-            cJSON_Delete(root);
+        ProtocolRecorder::GetInstance().Record(kProtocolRecordTextIn, payload);
+        link_stats_.OnBytesReceived(payload.size());
+        IncomingMessage message(payload.data(), payload.size());
+        auto type = message.type();
+        if (type.empty()) {
+            ESP_LOGE(TAG, "Message type is invalid: %s", payload.c_str());
             return;
         }
 
-        if (strcmp(type->valuestring, "hello") == 0) {
-            ParseServerHello(root);
-        } else if (strcmp(type->valuestring, "goodbye") == 0) {
-            auto session_id = cJSON_GetObjectItem(root, "session_id");
-            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", session_id ? session_id->valuestring : "null");
-            if (session_id == nullptr || session_id_ == session_id->valuestring) {
-                Application::GetInstance().Schedule([this]() {
+        if (type == "hello") {
+            if (message.root() != nullptr) {
+                ParseServerHello(message.root());
+            }
+        } else if (type == "goodbye") {
+            std::string session_id;
+            bool has_session_id = message.GetString("session_id", session_id);
+            ESP_LOGI(TAG, "Received goodbye message, session_id: %s", has_session_id ? session_id.c_str() : "null");
+            if (!has_session_id || session_id_ == session_id) {
+                Application::GetInstance().Schedule(kTaskPriorityHigh, [this]() {
                     CloseAudioChannel();
                 });
             }
-        } else if (on_incoming_json_ != nullptr) {
-            on_incoming_json_(root);
+        } else {
+            // Audio held back for a missing packet must not outlive the speech
+            if (type == "tts" && message.Equals("state", "stop")) {
+                FlushReorderWindow();
+            }
+            if (on_incoming_message_ != nullptr) {
+                on_incoming_message_(message);
+            }
         }
-        cJSON_Delete(root);
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
@@ -144,6 +144,8 @@ bool MqttProtocol::SendText(const std::string& text) {
     if (publish_topic_.empty()) {
         return false;
     }
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordTextOut, text);
+    link_stats_.OnBytesSent(text.size());
     if (!mqtt_->Publish(publish_topic_, text)) {
         ESP_LOGE(TAG, "Failed to publish message: %s", text.c_str());
         SetError(Lang::Strings::SERVER_ERROR);
@@ -158,31 +160,40 @@ bool MqttProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         return false;
     }
 
-    std::string nonce(aes_nonce_);
+    // Build the nonce on the stack and reuse the send buffer, so no allocation per packet
+    uint8_t nonce[16];
+    memcpy(nonce, aes_nonce_.data(), sizeof(nonce));
     *(uint16_t*)&nonce[2] = htons(packet->payload.size());
     *(uint32_t*)&nonce[8] = htonl(packet->timestamp);
     *(uint32_t*)&nonce[12] = htonl(++local_sequence_);
 
-    std::string encrypted;
-    encrypted.resize(aes_nonce_.size() + packet->payload.size());
-    memcpy(encrypted.data(), nonce.data(), nonce.size());
+    send_buffer_.resize(sizeof(nonce) + packet->payload.size());
+    memcpy(send_buffer_.data(), nonce, sizeof(nonce));
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordUdpOut, nonce, sizeof(nonce),
+        packet->payload.data(), packet->payload.size());
 
     size_t nc_off = 0;
     uint8_t stream_block[16] = {0};
-    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, (uint8_t*)nonce.c_str(), stream_block,
-        (uint8_t*)packet->payload.data(), (uint8_t*)&encrypted[nonce.size()]) != 0) {
+    if (mbedtls_aes_crypt_ctr(&aes_ctx_, packet->payload.size(), &nc_off, nonce, stream_block,
+        (uint8_t*)packet->payload.data(), (uint8_t*)&send_buffer_[sizeof(nonce)]) != 0) {
         ESP_LOGE(TAG, "Failed to encrypt audio data");
         return false;
     }
 
-    return udp_->Send(encrypted) > 0;
+    link_stats_.OnBytesSent(send_buffer_.size());
+    return udp_->Send(send_buffer_) > 0;
 }
 
 void MqttProtocol::CloseAudioChannel() {
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordEvent, std::string("close"));
     {
         std::lock_guard<std::mutex> lock(channel_mutex_);
         udp_.reset();
     }
+    FlushReorderWindow();
+    auto stats = GetReceiveStats();
+    ESP_LOGI(TAG, "UDP audio received: %lu, lost: %lu, reordered: %lu, duplicated: %lu, late: %lu",
+        stats.received, stats.lost, stats.reordered, stats.duplicated, stats.late);
 
     std::string message = "{";
     message += "\"session_id\":\"" + session_id_ + "\",";
@@ -196,6 +207,7 @@ void MqttProtocol::CloseAudioChannel() {
 }
 
 bool MqttProtocol::OpenAudioChannel() {
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordEvent, std::string("open"));
     if (mqtt_ == nullptr || !mqtt_->IsConnected()) {
         ESP_LOGI(TAG, "MQTT is not connected, try to connect now");
         if (!StartMqttClient(true)) {
@@ -205,9 +217,11 @@ bool MqttProtocol::OpenAudioChannel() {
 
     error_occurred_ = false;
     session_id_ = "";
+    link_stats_.Reset();
     xEventGroupClearBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 
     auto message = GetHelloMessage();
+    hello_sent_time_us_ = esp_timer_get_time();
     if (!SendText(message)) {
         return false;
     }
@@ -224,49 +238,7 @@ bool MqttProtocol::OpenAudioChannel() {
     auto network = Board::GetInstance().GetNetwork();
     udp_ = network->CreateUdp(2);
     udp_->OnMessage([this](const std::string& data) {
-        /*
-         * UDP Encrypted OPUS Packet Format:
-         * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
-         * |payload payload_len|
-         */
-        if (data.size() < sizeof(aes_nonce_)) {
-            ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
-            return;
-        }
-        if (data[0] != 0x01) {
-            ESP_LOGE(TAG, "Invalid audio packet type: %x", data[0]);
-            return;
-        }
-        uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
-        uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
-        if (sequence < remote_sequence_) {
-            ESP_LOGW(TAG, "Received audio packet with old sequence: %lu, expected: %lu", sequence, remote_sequence_);
-            return;
-        }
-        if (sequence != remote_sequence_ + 1) {
-            ESP_LOGW(TAG, "Received audio packet with wrong sequence: %lu, expected: %lu", sequence, remote_sequence_ + 1);
-        }
-
-        size_t decrypted_size = data.size() - aes_nonce_.size();
-        size_t nc_off = 0;
-        uint8_t stream_block[16] = {0};
-        auto nonce = (uint8_t*)data.data();
-        auto encrypted = (uint8_t*)data.data() + aes_nonce_.size();
-        auto packet = std::make_unique<AudioStreamPacket>();
-        packet->sample_rate = server_sample_rate_;
-        packet->frame_duration = server_frame_duration_;
-        packet->timestamp = timestamp;
-        packet->payload.resize(decrypted_size);
-        int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, decrypted_size, &nc_off, nonce, stream_block, encrypted, (uint8_t*)packet->payload.data());
-        if (ret != 0) {
-            ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
-            return;
-        }
-        if (on_incoming_audio_ != nullptr) {
-            on_incoming_audio_(std::move(packet));
-        }
-        remote_sequence_ = sequence;
-        last_incoming_time_ = std::chrono::steady_clock::now();
+        OnUdpMessage(data);
     });
 
     udp_->Connect(udp_server_, udp_port_);
@@ -277,6 +249,89 @@ bool MqttProtocol::OpenAudioChannel() {
     return true;
 }
 
+void MqttProtocol::OnUdpMessage(const std::string& data) {
+    /*
+     * UDP Encrypted OPUS Packet Format:
+     * |type 1u|flags 1u|payload_len 2u|ssrc 4u|timestamp 4u|sequence 4u|
+     * |payload payload_len|
+     */
+    const size_t header_size = aes_nonce_.size();
+    if (header_size != 16 || data.size() < header_size) {
+        ESP_LOGE(TAG, "Invalid audio packet size: %u", data.size());
+        return;
+    }
+    if (data[0] != 0x01) {
+        ESP_LOGE(TAG, "Invalid audio packet type: %x", data[0]);
+        return;
+    }
+    uint32_t timestamp = ntohl(*(uint32_t*)&data[8]);
+    uint32_t sequence = ntohl(*(uint32_t*)&data[12]);
+    // Jitter is measured on arrival, before the reorder window evens it out
+    link_stats_.OnBytesReceived(data.size());
+    link_stats_.OnAudioReceived(timestamp, server_frame_duration_);
+
+    std::lock_guard<std::mutex> lock(receive_mutex_);
+    uint32_t lost = reorder_window_.stats().lost;
+    bool accepted = reorder_window_.Accept(sequence);
+    if (reorder_window_.stats().lost != lost) {
+        ESP_LOGW(TAG, "Audio packets lost: %lu, sequence: %lu", reorder_window_.stats().lost - lost, sequence);
+    }
+    if (!accepted) {
+        return;
+    }
+
+    // Decrypt in place in the payload buffer, the nonce is copied because CTR mode advances it
+    size_t payload_size = data.size() - header_size;
+    uint8_t nonce[16];
+    memcpy(nonce, data.data(), sizeof(nonce));
+    auto packet = std::make_unique<AudioStreamPacket>();
+    packet->sample_rate = server_sample_rate_;
+    packet->frame_duration = server_frame_duration_;
+    packet->timestamp = timestamp;
+    packet->payload.assign((const uint8_t*)data.data() + header_size, (const uint8_t*)data.data() + data.size());
+    size_t nc_off = 0;
+    uint8_t stream_block[16] = {0};
+    int ret = mbedtls_aes_crypt_ctr(&aes_ctx_, payload_size, &nc_off, nonce, stream_block,
+        packet->payload.data(), packet->payload.data());
+    if (ret != 0) {
+        ESP_LOGE(TAG, "Failed to decrypt audio data, ret: %d", ret);
+        return;
+    }
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordUdpIn, data.data(), header_size,
+        packet->payload.data(), packet->payload.size());
+    last_incoming_time_ = std::chrono::steady_clock::now();
+    reorder_window_.Insert(sequence, std::move(packet));
+}
+
+void MqttProtocol::DeliverAudioPacket(std::unique_ptr<AudioStreamPacket> packet) {
+    if (on_incoming_audio_ != nullptr) {
+        on_incoming_audio_(std::move(packet));
+    }
+}
+
+void MqttProtocol::FlushReorderWindow() {
+    std::lock_guard<std::mutex> lock(receive_mutex_);
+    reorder_window_.Flush();
+}
+
+void MqttProtocol::ResetReorderWindow() {
+    std::lock_guard<std::mutex> lock(receive_mutex_);
+    reorder_window_.Reset();
+}
+
+LinkStatsSnapshot MqttProtocol::GetLinkStats() const {
+    auto snapshot = Protocol::GetLinkStats();
+    std::lock_guard<std::mutex> lock(receive_mutex_);
+    snapshot.packets_lost = reorder_window_.stats().lost;
+    snapshot.packets_reordered = reorder_window_.stats().reordered;
+    return snapshot;
+}
+
+UdpReceiveStats MqttProtocol::GetReceiveStats() {
+    std::lock_guard<std::mutex> lock(receive_mutex_);
+    return reorder_window_.stats();
+}
+
 std::string MqttProtocol::GetHelloMessage() {
     // 发送 hello 消息申请 UDP 通道
     cJSON* root = cJSON_CreateObject();
@@ -314,6 +369,10 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
         session_id_ = session_id->valuestring;
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
+    if (hello_sent_time_us_ != 0) {
+        link_stats_.OnRttMeasured((esp_timer_get_time() - hello_sent_time_us_) / 1000);
+        hello_sent_time_us_ = 0;
+    }
 
     // Get sample rate from hello message
     auto audio_params = cJSON_GetObjectItem(root, "audio_params");
@@ -341,10 +400,9 @@ void MqttProtocol::ParseServerHello(const cJSON* root) {
     // auto encryption = cJSON_GetObjectItem(udp, "encryption")->valuestring;
     // ESP_LOGI(TAG, "UDP server: %s, port: %d, encryption: %s", udp_server_.c_str(), udp_port_, encryption);
     aes_nonce_ = DecodeHexString(nonce);
-    mbedtls_aes_init(&aes_ctx_);
     mbedtls_aes_setkey_enc(&aes_ctx_, (const unsigned char*)DecodeHexString(key).c_str(), 128);
     local_sequence_ = 0;
-    remote_sequence_ = 0;
+    ResetReorderWindow();
     xEventGroupSetBits(event_group_handle_, MQTT_PROTOCOL_SERVER_HELLO_EVENT);
 }
 
@@ -3,6 +3,8 @@
 
 
 #include "protocol.h"
+#include "timer_service.h"
+#include "udp_reorder_window.h"
 #include <mqtt.h>
 #include <udp.h>
 #include <cJSON.h>
@@ -21,6 +23,9 @@
 
 #define MQTT_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
+// Number of UDP audio packets that may be held back while waiting for a missing sequence
+#define MQTT_UDP_REORDER_WINDOW 4
+
 class MqttProtocol : public Protocol {
 public:
     MqttProtocol();
@@ -31,6 +36,8 @@ public:
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
+    UdpReceiveStats GetReceiveStats();
+    LinkStatsSnapshot GetLinkStats() const override;
 
 private:
     EventGroupHandle_t event_group_handle_;
@@ -45,12 +52,21 @@ private:
     std::string udp_server_;
     int udp_port_;
     uint32_t local_sequence_;
-    uint32_t remote_sequence_;
-    esp_timer_handle_t reconnect_timer_;
+    TimerHandle reconnect_timer_;
+    std::string send_buffer_;
+    int64_t hello_sent_time_us_ = 0;
+
+    // Receive side reorder window, guarded by receive_mutex_
+    mutable std::mutex receive_mutex_;
+    UdpReorderWindow<AudioStreamPacket, MQTT_UDP_REORDER_WINDOW> reorder_window_;
 
     bool StartMqttClient(bool report_error=false);
     void ParseServerHello(const cJSON* root);
     std::string DecodeHexString(const std::string& hex_string);
+    void OnUdpMessage(const std::string& data);
+    void DeliverAudioPacket(std::unique_ptr<AudioStreamPacket> packet);
+    void FlushReorderWindow();
+    void ResetReorderWindow();
 
     bool SendText(const std::string& text) override;
     std::string GetHelloMessage();
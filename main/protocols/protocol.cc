@@ -1,11 +1,12 @@
 #include "protocol.h"
+#include "event_journal.h"
 
 #include <esp_log.h>
 
 #define TAG "Protocol"
 
-void Protocol::OnIncomingJson(std::function<void(const cJSON* root)> callback) {
-    on_incoming_json_ = callback;
+void Protocol::OnIncomingMessage(std::function<void(const IncomingMessage& message)> callback) {
+    on_incoming_message_ = callback;
 }
 
 void Protocol::OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback) {
@@ -34,11 +35,31 @@ void Protocol::OnDisconnected(std::function<void()> callback) {
 
 void Protocol::SetError(const std::string& message) {
     error_occurred_ = true;
+    // The journal keeps records fixed-size, log the hash next to the message to match them up
+    uint32_t hash = 2166136261u;
+    for (char c : message) {
+        hash = (hash ^ (uint8_t)c) * 16777619u;
+    }
+    ESP_LOGW(TAG, "Protocol error %08lx: %s", hash, message.c_str());
+    EventJournal::GetInstance().Record(kJournalProtocolError, 0, hash);
     if (on_network_error_ != nullptr) {
         on_network_error_(message);
     }
 }
 
+LinkStatsSnapshot Protocol::GetLinkStats() const {
+    return link_stats_.GetSnapshot();
+}
+
+bool Protocol::SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets) {
+    for (auto& packet : packets) {
+        if (!SendAudio(std::move(packet))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 void Protocol::SendAbortSpeaking(AbortReason reason) {
     std::string message = "{\"session_id\":\"" + session_id_ + "\",\"type\":\"abort\"";
     if (reason == kAbortReasonWakeWordDetected) {
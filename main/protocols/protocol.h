@@ -1,11 +1,15 @@
 #ifndef PROTOCOL_H
 #define PROTOCOL_H
 
+#include "incoming_message.h"
+#include "link_stats.h"
+
 #include <cJSON.h>
 #include <string>
 #include <functional>
 #include <chrono>
 #include <vector>
+#include <memory>
 
 struct AudioStreamPacket {
     int sample_rate = 0;
@@ -30,6 +34,20 @@ struct BinaryProtocol3 {
     uint8_t payload[];
 } __attribute__((packed));
 
+// Version 4 packs several Opus frames into one message:
+// | header | frame_count x BinaryProtocol4Frame | frame data ... |
+struct BinaryProtocol4 {
+    uint8_t type;           // Message type (0: OPUS)
+    uint8_t frame_count;    // Number of frames in this message
+    uint16_t payload_size;  // Size of frame table plus frame data in bytes
+    uint8_t payload[];
+} __attribute__((packed));
+
+struct BinaryProtocol4Frame {
+    uint32_t timestamp;     // Timestamp in milliseconds (used for server-side AEC)
+    uint16_t size;          // Frame size in bytes
+} __attribute__((packed));
+
 enum AbortReason {
     kAbortReasonNone,
     kAbortReasonWakeWordDetected
@@ -56,7 +74,7 @@ public:
     }
 
     void OnIncomingAudio(std::function<void(std::unique_ptr<AudioStreamPacket> packet)> callback);
-    void OnIncomingJson(std::function<void(const cJSON* root)> callback);
+    void OnIncomingMessage(std::function<void(const IncomingMessage& message)> callback);
     void OnAudioChannelOpened(std::function<void()> callback);
     void OnAudioChannelClosed(std::function<void()> callback);
     void OnNetworkError(std::function<void(const std::string& message)> callback);
@@ -68,15 +86,20 @@ public:
     virtual void CloseAudioChannel() = 0;
     virtual bool IsAudioChannelOpened() const = 0;
     virtual bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) = 0;
+    virtual bool SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets);
+    // How many queued packets should be handed to SendAudioBatch at once
+    virtual size_t GetAudioBatchSize(size_t queued_packets) const { return 1; }
     virtual void SendWakeWordDetected(const std::string& wake_word);
     virtual void SendStartListening(ListeningMode mode);
     virtual void SendStopListening();
     virtual void SendStopListeningWithText(const std::string& text);
     virtual void SendAbortSpeaking(AbortReason reason);
     virtual void SendMcpMessage(const std::string& message);
+    // Link quality of the current audio session
+    virtual LinkStatsSnapshot GetLinkStats() const;
 
 protected:
-    std::function<void(const cJSON* root)> on_incoming_json_;
+    std::function<void(const IncomingMessage& message)> on_incoming_message_;
     std::function<void(std::unique_ptr<AudioStreamPacket> packet)> on_incoming_audio_;
     std::function<void()> on_audio_channel_opened_;
     std::function<void()> on_audio_channel_closed_;
@@ -89,6 +112,7 @@ protected:
     bool error_occurred_ = false;
     std::string session_id_;
     std::chrono::time_point<std::chrono::steady_clock> last_incoming_time_;
+    LinkStats link_stats_;
 
     virtual bool SendText(const std::string& text) = 0;
     virtual void SetError(const std::string& message);
@@ -0,0 +1,125 @@
+#include "protocol_recorder.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+#include <esp_heap_caps.h>
+#include <mbedtls/base64.h>
+#include <algorithm>
+#include <cstring>
+
+#define TAG "ProtocolRecorder"
+
+// Raw bytes per dumped line, a multiple of 3 so lines decode independently
+#define DUMP_CHUNK_SIZE 768
+
+ProtocolRecorder::~ProtocolRecorder() {
+    if (buffer_ != nullptr) {
+        heap_caps_free(buffer_);
+    }
+}
+
+bool ProtocolRecorder::Start(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffer_ == nullptr || capacity_ != capacity) {
+        if (buffer_ != nullptr) {
+            heap_caps_free(buffer_);
+        }
+        buffer_ = (uint8_t*)heap_caps_malloc(capacity, MALLOC_CAP_SPIRAM);
+        if (buffer_ == nullptr) {
+            ESP_LOGE(TAG, "Failed to allocate %u bytes in PSRAM", (unsigned)capacity);
+            capacity_ = 0;
+            return false;
+        }
+        capacity_ = capacity;
+    }
+
+    start_time_us_ = esp_timer_get_time();
+    ProtocolRecorderHeader header = {
+        .magic = PROTOCOL_RECORDER_MAGIC,
+        .version = PROTOCOL_RECORDER_VERSION,
+        .reserved = 0,
+        .start_time_us = start_time_us_,
+    };
+    memcpy(buffer_, &header, sizeof(header));
+    size_ = sizeof(header);
+    record_count_ = 0;
+    dropped_count_ = 0;
+    recording_ = true;
+    ESP_LOGI(TAG, "Recording started, capacity %u bytes", (unsigned)capacity_);
+    return true;
+}
+
+void ProtocolRecorder::Stop() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (recording_) {
+        recording_ = false;
+        ESP_LOGI(TAG, "Recording stopped, %lu records, %u bytes, %lu dropped",
+            record_count_, (unsigned)size_, dropped_count_);
+    }
+}
+
+void ProtocolRecorder::Append(ProtocolRecordType type, const void* head, size_t head_size, const void* body, size_t body_size) {
+    uint32_t time_ms = (esp_timer_get_time() - start_time_us_) / 1000;
+    uint8_t flags = 0;
+    if (head_size + body_size > UINT16_MAX) {
+        body_size = UINT16_MAX - head_size;
+        flags |= 1;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!recording_) {
+        return;
+    }
+    size_t record_size = sizeof(ProtocolRecord) + head_size + body_size;
+    if (size_ + record_size > capacity_) {
+        // Keep the log contiguous, a replay needs every message from the start
+        dropped_count_++;
+        recording_ = false;
+        ESP_LOGW(TAG, "Buffer full after %lu records, recording stopped", record_count_);
+        return;
+    }
+
+    auto record = (ProtocolRecord*)(buffer_ + size_);
+    record->time_ms = time_ms;
+    record->type = type;
+    record->flags = flags;
+    record->size = head_size + body_size;
+    memcpy(record->payload, head, head_size);
+    if (body_size > 0) {
+        memcpy(record->payload + head_size, body, body_size);
+    }
+    size_ += record_size;
+    record_count_++;
+}
+
+std::string ProtocolRecorder::GetStatusJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string json = "{\"recording\":";
+    json += recording_ ? "true" : "false";
+    json += ",\"records\":" + std::to_string(record_count_);
+    json += ",\"bytes\":" + std::to_string(size_);
+    json += ",\"capacity\":" + std::to_string(capacity_);
+    json += ",\"dropped\":" + std::to_string(dropped_count_);
+    json += "}";
+    return json;
+}
+
+void ProtocolRecorder::DumpToLog() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (buffer_ == nullptr) {
+        ESP_LOGW(TAG, "Nothing recorded");
+        return;
+    }
+
+    // Lines look like "PREC:<base64>", the host decoder ignores everything else
+    char line[DUMP_CHUNK_SIZE / 3 * 4 + 1];
+    ESP_LOGI(TAG, "PREC-BEGIN %u", (unsigned)size_);
+    for (size_t offset = 0; offset < size_; offset += DUMP_CHUNK_SIZE) {
+        size_t chunk = std::min<size_t>(DUMP_CHUNK_SIZE, size_ - offset);
+        size_t olen = 0;
+        mbedtls_base64_encode((unsigned char*)line, sizeof(line), &olen, buffer_ + offset, chunk);
+        line[olen] = '\0';
+        ESP_LOGI(TAG, "PREC:%s", line);
+    }
+    ESP_LOGI(TAG, "PREC-END");
+}
@@ -0,0 +1,99 @@
+#ifndef PROTOCOL_RECORDER_H
+#define PROTOCOL_RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#define PROTOCOL_RECORDER_MAGIC 0x52505a58  // "XZPR"
+#define PROTOCOL_RECORDER_VERSION 1
+#define PROTOCOL_RECORDER_DEFAULT_CAPACITY (512 * 1024)
+
+enum ProtocolRecordType : uint8_t {
+    kProtocolRecordTextIn = 1,      // JSON text from the server
+    kProtocolRecordTextOut = 2,     // JSON text to the server
+    kProtocolRecordBinaryIn = 3,    // Websocket binary frame from the server, as received
+    kProtocolRecordBinaryOut = 4,   // Websocket binary frame to the server, as sent
+    kProtocolRecordUdpIn = 5,       // UDP audio: 16 byte header in clear + decrypted opus
+    kProtocolRecordUdpOut = 6,      // UDP audio: 16 byte header in clear + opus before encryption
+    kProtocolRecordEvent = 7,       // Channel events, e.g. "open", "close"
+};
+
+// Little endian, followed by records until the end of the log
+struct ProtocolRecorderHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    int64_t start_time_us;      // esp_timer time when recording started
+} __attribute__((packed));
+
+struct ProtocolRecord {
+    uint32_t time_ms;           // Milliseconds since recording started
+    uint8_t type;
+    uint8_t flags;              // Bit 0: payload was truncated
+    uint16_t size;              // Payload size in bytes
+    uint8_t payload[];
+} __attribute__((packed));
+
+/*
+ * Captures every message crossing the Protocol boundary into a PSRAM buffer,
+ * so a field session can be replayed with its original timing by
+ * scripts/protocol_replay.py.
+ *
+ * Recording stops when the buffer is full. Record() is a single atomic load
+ * when the recorder is idle.
+ */
+class ProtocolRecorder {
+public:
+    static ProtocolRecorder& GetInstance() {
+        static ProtocolRecorder instance;
+        return instance;
+    }
+    ProtocolRecorder(const ProtocolRecorder&) = delete;
+    ProtocolRecorder& operator=(const ProtocolRecorder&) = delete;
+
+    bool Start(size_t capacity = PROTOCOL_RECORDER_DEFAULT_CAPACITY);
+    void Stop();
+    inline bool IsRecording() const {
+        return recording_.load(std::memory_order_relaxed);
+    }
+
+    inline void Record(ProtocolRecordType type, const void* data, size_t size) {
+        if (IsRecording()) {
+            Append(type, data, size, nullptr, 0);
+        }
+    }
+    inline void Record(ProtocolRecordType type, const std::string& text) {
+        Record(type, text.data(), text.size());
+    }
+    // Record a header and a payload that live in separate buffers as one record
+    inline void Record(ProtocolRecordType type, const void* head, size_t head_size, const void* body, size_t body_size) {
+        if (IsRecording()) {
+            Append(type, head, head_size, body, body_size);
+        }
+    }
+
+    // Summary of the current log as a JSON string
+    std::string GetStatusJson();
+    // Write the log to the console as base64 lines for the host decoder
+    void DumpToLog();
+
+private:
+    ProtocolRecorder() = default;
+    ~ProtocolRecorder();
+
+    std::mutex mutex_;
+    std::atomic<bool> recording_ = false;
+    uint8_t* buffer_ = nullptr;
+    size_t capacity_ = 0;
+    size_t size_ = 0;
+    int64_t start_time_us_ = 0;
+    uint32_t record_count_ = 0;
+    uint32_t dropped_count_ = 0;
+
+    void Append(ProtocolRecordType type, const void* head, size_t head_size, const void* body, size_t body_size);
+};
+
+#endif // PROTOCOL_RECORDER_H
@@ -0,0 +1,136 @@
+#ifndef UDP_REORDER_WINDOW_H
+#define UDP_REORDER_WINDOW_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+struct UdpReceiveStats {
+    uint32_t received = 0;
+    uint32_t lost = 0;          // Sequences skipped because they did not arrive within the window
+    uint32_t reordered = 0;     // Packets that arrived ahead of an earlier sequence
+    uint32_t duplicated = 0;    // Packets whose sequence was already received
+    uint32_t late = 0;          // Packets that arrived after their sequence had been skipped
+};
+
+/*
+ * Receive side reorder window for sequenced UDP packets. A packet with
+ * sequence s is held in slots_[s % Window] until remote_sequence_ + 1 == s,
+ * then delivered together with everything held behind it. A packet more than
+ * Window ahead slides the window, delivering what is held and counting the
+ * gaps as lost. Not thread safe, the owner serializes the calls.
+ */
+template <typename Packet, uint32_t Window>
+class UdpReorderWindow {
+public:
+    explicit UdpReorderWindow(std::function<void(std::unique_ptr<Packet>)> deliver)
+        : deliver_(std::move(deliver)) {}
+
+    // Checks a sequence before its payload is decoded and slides the window if the
+    // sequence is too far ahead. Returns false for duplicate and late packets.
+    bool Accept(uint32_t sequence) {
+        if (stats_.received++ == 0) {
+            // The sender may start counting from any sequence
+            remote_sequence_ = sequence - 1;
+        }
+
+        if ((int32_t)(sequence - remote_sequence_) <= 0) {
+            uint32_t age = remote_sequence_ - sequence;
+            if (age < 32 && (delivered_mask_ & (1u << age))) {
+                stats_.duplicated++;
+            } else {
+                stats_.late++;
+            }
+            return false;
+        }
+
+        // Slide the window so that the new sequence fits, releasing what we hold in order
+        if (sequence - remote_sequence_ > Window) {
+            uint32_t target = sequence - Window;
+            while (pending_ > 0 && remote_sequence_ != target) {
+                Advance();
+            }
+            uint32_t skipped = target - remote_sequence_;
+            if (skipped > 0) {
+                stats_.lost += skipped;
+                delivered_mask_ = skipped < 32 ? delivered_mask_ << skipped : 0;
+                remote_sequence_ = target;
+            }
+            // Packets held just past the gap are in order now, a burst after a loss
+            // must not wait for the next slide
+            DrainInOrder();
+        }
+
+        if (slots_[sequence % Window] != nullptr) {
+            stats_.duplicated++;
+            return false;
+        }
+        return true;
+    }
+
+    // Delivers an accepted packet, or holds it until the sequences before it arrive
+    void Insert(uint32_t sequence, std::unique_ptr<Packet> packet) {
+        if (sequence != remote_sequence_ + 1) {
+            stats_.reordered++;
+            slots_[sequence % Window] = std::move(packet);
+            pending_++;
+            return;
+        }
+
+        remote_sequence_ = sequence;
+        delivered_mask_ = (delivered_mask_ << 1) | 1;
+        deliver_(std::move(packet));
+        DrainInOrder();
+    }
+
+    // Delivers everything held, counting the gaps as lost
+    void Flush() {
+        while (pending_ > 0) {
+            Advance();
+        }
+    }
+
+    void Reset() {
+        for (auto& slot : slots_) {
+            slot.reset();
+        }
+        pending_ = 0;
+        delivered_mask_ = 0;
+        remote_sequence_ = 0;
+        stats_ = UdpReceiveStats();
+    }
+
+    const UdpReceiveStats& stats() const { return stats_; }
+    int pending() const { return pending_; }
+
+private:
+    std::function<void(std::unique_ptr<Packet>)> deliver_;
+    std::unique_ptr<Packet> slots_[Window];
+    int pending_ = 0;
+    uint32_t remote_sequence_ = 0;
+    uint32_t delivered_mask_ = 0;   // Bit n set if remote_sequence_ - n was delivered
+    UdpReceiveStats stats_;
+
+    void DrainInOrder() {
+        while (slots_[(remote_sequence_ + 1) % Window] != nullptr) {
+            Advance();
+        }
+    }
+
+    // Move the window forward by one sequence, delivering its packet or counting it as lost
+    void Advance() {
+        uint32_t sequence = remote_sequence_ + 1;
+        auto& slot = slots_[sequence % Window];
+        remote_sequence_ = sequence;
+        delivered_mask_ <<= 1;
+        if (slot == nullptr) {
+            stats_.lost++;
+            return;
+        }
+        delivered_mask_ |= 1;
+        pending_--;
+        deliver_(std::move(slot));
+    }
+};
+
+#endif // UDP_REORDER_WINDOW_H
@@ -3,10 +3,13 @@
 #include "system_info.h"
 #include "application.h"
 #include "settings.h"
+#include "protocol_recorder.h"
 
 #include <cstring>
+#include <algorithm>
 #include <cJSON.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <arpa/inet.h>
 #include "assets/lang_config.h"
 
@@ -41,7 +44,7 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         bp2->payload_size = htonl(packet->payload.size());
         memcpy(bp2->payload, packet->payload.data(), packet->payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        return SendBinary(serialized.data(), serialized.size());
     } else if (version_ == 3) {
         std::string serialized;
         serialized.resize(sizeof(BinaryProtocol3) + packet->payload.size());
@@ -51,16 +54,130 @@ bool WebsocketProtocol::SendAudio(std::unique_ptr<AudioStreamPacket> packet) {
         bp3->payload_size = htons(packet->payload.size());
         memcpy(bp3->payload, packet->payload.data(), packet->payload.size());
 
-        return websocket_->Send(serialized.data(), serialized.size(), true);
+        return SendBinary(serialized.data(), serialized.size());
+    } else if (version_ == 4) {
+        return SendAudioFrames(&packet, 1);
     } else {
-        return websocket_->Send(packet->payload.data(), packet->payload.size(), true);
+        return SendBinary(packet->payload.data(), packet->payload.size());
     }
 }
 
+bool WebsocketProtocol::SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets) {
+    if (version_ != 4) {
+        return Protocol::SendAudioBatch(packets);
+    }
+    if (websocket_ == nullptr || !websocket_->IsConnected()) {
+        return false;
+    }
+
+    size_t offset = 0;
+    while (offset < packets.size()) {
+        // Keep each message within the frame count and the 16-bit payload size
+        size_t count = 0;
+        size_t payload_size = 0;
+        while (offset + count < packets.size() && count < WEBSOCKET_PROTOCOL_MAX_FRAMES_PER_MESSAGE) {
+            size_t frame_size = sizeof(BinaryProtocol4Frame) + packets[offset + count]->payload.size();
+            if (count > 0 && payload_size + frame_size > UINT16_MAX) {
+                break;
+            }
+            payload_size += frame_size;
+            count++;
+        }
+        if (!SendAudioFrames(&packets[offset], count)) {
+            return false;
+        }
+        offset += count;
+    }
+    return true;
+}
+
+size_t WebsocketProtocol::GetAudioBatchSize(size_t queued_packets) const {
+    if (version_ != 4 || queued_packets <= 1) {
+        return 1;
+    }
+    // Only frames that are already waiting in the send queue get packed, so batching
+    // never delays audio. A longer round trip lets the backlog drain in bigger messages.
+    size_t limit = 2 + rtt_ms_ / OPUS_FRAME_DURATION_MS;
+    limit = std::min<size_t>(limit, WEBSOCKET_PROTOCOL_MAX_FRAMES_PER_MESSAGE);
+    return std::min(queued_packets, limit);
+}
+
+bool WebsocketProtocol::SendAudioFrames(std::unique_ptr<AudioStreamPacket>* packets, size_t count) {
+    size_t table_size = count * sizeof(BinaryProtocol4Frame);
+    size_t data_size = 0;
+    for (size_t i = 0; i < count; i++) {
+        data_size += packets[i]->payload.size();
+    }
+    if (table_size + data_size > UINT16_MAX) {
+        ESP_LOGE(TAG, "Audio frames too large: %u bytes", (unsigned)(table_size + data_size));
+        return false;
+    }
+
+    std::string serialized;
+    serialized.resize(sizeof(BinaryProtocol4) + table_size + data_size);
+    auto bp4 = (BinaryProtocol4*)serialized.data();
+    bp4->type = 0;
+    bp4->frame_count = count;
+    bp4->payload_size = htons(table_size + data_size);
+    auto frames = (BinaryProtocol4Frame*)bp4->payload;
+    auto frame_data = bp4->payload + table_size;
+    for (size_t i = 0; i < count; i++) {
+        auto& payload = packets[i]->payload;
+        frames[i].timestamp = htonl(packets[i]->timestamp);
+        frames[i].size = htons(payload.size());
+        memcpy(frame_data, payload.data(), payload.size());
+        frame_data += payload.size();
+    }
+
+    return SendBinary(serialized.data(), serialized.size());
+}
+
+void WebsocketProtocol::ParseAudioFrames(const char* data, size_t len) {
+    if (len < sizeof(BinaryProtocol4)) {
+        ESP_LOGE(TAG, "Audio message too short: %u", (unsigned)len);
+        return;
+    }
+    auto bp4 = (const BinaryProtocol4*)data;
+    size_t payload_size = ntohs(bp4->payload_size);
+    size_t table_size = bp4->frame_count * sizeof(BinaryProtocol4Frame);
+    if (sizeof(BinaryProtocol4) + payload_size > len || table_size > payload_size) {
+        ESP_LOGE(TAG, "Invalid audio message, frames: %u, payload: %u, len: %u",
+            bp4->frame_count, (unsigned)payload_size, (unsigned)len);
+        return;
+    }
+
+    auto frames = (const BinaryProtocol4Frame*)bp4->payload;
+    auto frame_data = bp4->payload + table_size;
+    auto frame_data_end = bp4->payload + payload_size;
+    for (int i = 0; i < bp4->frame_count; i++) {
+        size_t size = ntohs(frames[i].size);
+        if (frame_data + size > frame_data_end) {
+            ESP_LOGE(TAG, "Audio frame %d exceeds message bounds", i);
+            return;
+        }
+        link_stats_.OnAudioReceived(ntohl(frames[i].timestamp), server_frame_duration_);
+        on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
+            .sample_rate = server_sample_rate_,
+            .frame_duration = server_frame_duration_,
+            .timestamp = ntohl(frames[i].timestamp),
+            .payload = std::vector<uint8_t>(frame_data, frame_data + size)
+        }));
+        frame_data += size;
+    }
+}
+
+bool WebsocketProtocol::SendBinary(const void* data, size_t size) {
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordBinaryOut, data, size);
+    link_stats_.OnBytesSent(size);
+    return websocket_->Send(data, size, true);
+}
+
 bool WebsocketProtocol::SendText(const std::string& text) {
     if (websocket_ == nullptr || !websocket_->IsConnected()) {
         return false;
     }
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordTextOut, text);
+    link_stats_.OnBytesSent(text.size());
 
     if (!websocket_->Send(text)) {
         ESP_LOGE(TAG, "Failed to send text: %s", text.c_str());
@@ -76,6 +193,7 @@ bool WebsocketProtocol::IsAudioChannelOpened() const {
 }
 
 void WebsocketProtocol::CloseAudioChannel() {
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordEvent, std::string("close"));
     websocket_.reset();
 }
 
@@ -84,11 +202,29 @@ bool WebsocketProtocol::OpenAudioChannel() {
     std::string url = settings.GetString("url");
     std::string token = settings.GetString("token");
     int version = settings.GetInt("version");
-    if (version != 0) {
-        version_ = version;
-    }
+    // The previous session may have negotiated a lower version
+    version_ = version != 0 ? version : 1;
 
     error_occurred_ = false;
+    url_ = url;
+    link_stats_.Reset();
+    ProtocolRecorder::GetInstance().Record(kProtocolRecordEvent, std::string("open"));
+    // Work on a copy, the server hello may replace the cache at any time after ours is sent
+    HelloCache resume;
+    {
+        std::lock_guard<std::mutex> lock(hello_cache_mutex_);
+        resuming_ = CanResume(url);
+        if (resuming_) {
+            resume = hello_cache_;
+        }
+    }
+    if (resuming_) {
+        version_ = resume.version;
+        // Set before the hello is sent so a rejecting server hello can overwrite them
+        session_id_ = resume.session_id;
+        server_sample_rate_ = resume.sample_rate;
+        server_frame_duration_ = resume.frame_duration;
+    }
 
     auto network = Board::GetInstance().GetNetwork();
     websocket_ = network->CreateWebSocket(1);
@@ -109,6 +245,9 @@ bool WebsocketProtocol::OpenAudioChannel() {
     websocket_->SetHeader("Client-Id", Board::GetInstance().GetUuid().c_str());
 
     websocket_->OnData([this](const char* data, size_t len, bool binary) {
+        // Record before parsing, version 2 headers are converted in place
+        ProtocolRecorder::GetInstance().Record(binary ? kProtocolRecordBinaryIn : kProtocolRecordTextIn, data, len);
+        link_stats_.OnBytesReceived(len);
         if (binary) {
             if (on_incoming_audio_ != nullptr) {
                 if (version_ == 2) {
@@ -117,6 +256,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
                     bp2->type = ntohs(bp2->type);
                     bp2->timestamp = ntohl(bp2->timestamp);
                     bp2->payload_size = ntohl(bp2->payload_size);
+                    link_stats_.OnAudioReceived(bp2->timestamp, server_frame_duration_);
                     auto payload = (uint8_t*)bp2->payload;
                     on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
                         .sample_rate = server_sample_rate_,
@@ -128,6 +268,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
                     BinaryProtocol3* bp3 = (BinaryProtocol3*)data;
                     bp3->type = bp3->type;
                     bp3->payload_size = ntohs(bp3->payload_size);
+                    link_stats_.OnAudioReceived(0, server_frame_duration_);
                     auto payload = (uint8_t*)bp3->payload;
                     on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
                         .sample_rate = server_sample_rate_,
@@ -135,7 +276,10 @@ bool WebsocketProtocol::OpenAudioChannel() {
                         .timestamp = 0,
                         .payload = std::vector<uint8_t>(payload, payload + bp3->payload_size)
                     }));
+                } else if (version_ == 4) {
+                    ParseAudioFrames(data, len);
                 } else {
+                    link_stats_.OnAudioReceived(0, server_frame_duration_);
                     on_incoming_audio_(std::make_unique<AudioStreamPacket>(AudioStreamPacket{
                         .sample_rate = server_sample_rate_,
                         .frame_duration = server_frame_duration_,
@@ -145,27 +289,24 @@ bool WebsocketProtocol::OpenAudioChannel() {
                 }
             }
         } else {
-            // Parse JSON data
-            auto root = cJSON_Parse(data);
-            auto type = cJSON_GetObjectItem(root, "type");
-            if (cJSON_IsString(type)) {
-                if (strcmp(type->valuestring, "hello") == 0) {
-                    ParseServerHello(root);
-                } else {
-                    if (on_incoming_json_ != nullptr) {
-                        on_incoming_json_(root);
-                    }
+            IncomingMessage message(data, len);
+            auto type = message.type();
+            if (type.empty()) {
+                ESP_LOGE(TAG, "Missing message type, data: %.*s", (int)len, data);
+            } else if (type == "hello") {
+                if (message.root() != nullptr) {
+                    ParseServerHello(message.root());
                 }
-            } else {
-                ESP_LOGE(TAG, "Missing message type, data: %s", data);
+            } else if (on_incoming_message_ != nullptr) {
+                on_incoming_message_(message);
             }
-            cJSON_Delete(root);
         }
         last_incoming_time_ = std::chrono::steady_clock::now();
     });
 
     websocket_->OnDisconnected([this]() {
         ESP_LOGI(TAG, "Websocket disconnected");
+        ProtocolRecorder::GetInstance().Record(kProtocolRecordEvent, std::string("disconnected"));
         if (on_audio_channel_closed_ != nullptr) {
             on_audio_channel_closed_();
         }
@@ -174,22 +315,35 @@ bool WebsocketProtocol::OpenAudioChannel() {
     ESP_LOGI(TAG, "Connecting to websocket server: %s with version: %d", url.c_str(), version_);
     if (!websocket_->Connect(url.c_str())) {
         ESP_LOGE(TAG, "Failed to connect to websocket server");
+        ConsumeResumeToken(resume.resume_token);
         SetError(Lang::Strings::SERVER_NOT_CONNECTED);
         return false;
     }
 
     // Send hello message to describe the client
-    auto message = GetHelloMessage();
+    xEventGroupClearBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
+    auto message = GetHelloMessage(resuming_ ? &resume : nullptr);
+    hello_sent_time_us_ = esp_timer_get_time();
     if (!SendText(message)) {
+        ConsumeResumeToken(resume.resume_token);
         return false;
     }
 
-    // Wait for server hello
-    EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
-    if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
-        ESP_LOGE(TAG, "Failed to receive server hello");
-        SetError(Lang::Strings::SERVER_TIMEOUT);
-        return false;
+    if (resuming_) {
+        // The server accepted this token before, so audio can flow with the cached
+        // parameters while its hello is still on the way
+        last_incoming_time_ = std::chrono::steady_clock::now();
+        // Tokens are single use, keep the next one if the server hello already granted it
+        ConsumeResumeToken(resume.resume_token);
+        ESP_LOGI(TAG, "Resuming session %s without waiting for server hello", session_id_.c_str());
+    } else {
+        // Wait for server hello
+        EventBits_t bits = xEventGroupWaitBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT, pdTRUE, pdFALSE, pdMS_TO_TICKS(10000));
+        if (!(bits & WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT)) {
+            ESP_LOGE(TAG, "Failed to receive server hello");
+            SetError(Lang::Strings::SERVER_TIMEOUT);
+            return false;
+        }
     }
 
     if (on_audio_channel_opened_ != nullptr) {
@@ -199,7 +353,7 @@ bool WebsocketProtocol::OpenAudioChannel() {
     return true;
 }
 
-std::string WebsocketProtocol::GetHelloMessage() {
+std::string WebsocketProtocol::GetHelloMessage(const HelloCache* resume) {
     // keys: message type, version, audio_params (format, sample_rate, channels)
     cJSON* root = cJSON_CreateObject();
     cJSON_AddStringToObject(root, "type", "hello");
@@ -217,6 +371,12 @@ std::string WebsocketProtocol::GetHelloMessage() {
     cJSON_AddNumberToObject(audio_params, "channels", 1);
     cJSON_AddNumberToObject(audio_params, "frame_duration", OPUS_FRAME_DURATION_MS);
     cJSON_AddItemToObject(root, "audio_params", audio_params);
+    if (resume != nullptr) {
+        cJSON* resume_json = cJSON_CreateObject();
+        cJSON_AddStringToObject(resume_json, "token", resume->resume_token.c_str());
+        cJSON_AddStringToObject(resume_json, "session_id", resume->session_id.c_str());
+        cJSON_AddItemToObject(root, "resume", resume_json);
+    }
     auto json_str = cJSON_PrintUnformatted(root);
     std::string message(json_str);
     cJSON_free(json_str);
@@ -237,6 +397,20 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         ESP_LOGI(TAG, "Session ID: %s", session_id_.c_str());
     }
 
+    // Multi-frame messages are only used when the server confirms version 4,
+    // otherwise fall back to the single frame layout of version 3
+    if (version_ == 4) {
+        auto version = cJSON_GetObjectItem(root, "version");
+        if (!cJSON_IsNumber(version) || version->valueint != 4) {
+            ESP_LOGW(TAG, "Server does not support protocol version 4, fallback to version 3");
+            version_ = 3;
+        }
+    }
+
+    rtt_ms_ = (esp_timer_get_time() - hello_sent_time_us_) / 1000;
+    link_stats_.OnRttMeasured(rtt_ms_);
+    ESP_LOGI(TAG, "Server hello received, version: %d, rtt: %d ms", version_, rtt_ms_);
+
     auto audio_params = cJSON_GetObjectItem(root, "audio_params");
     if (cJSON_IsObject(audio_params)) {
         auto sample_rate = cJSON_GetObjectItem(audio_params, "sample_rate");
@@ -249,5 +423,47 @@ void WebsocketProtocol::ParseServerHello(const cJSON* root) {
         }
     }
 
+    if (resuming_) {
+        auto resumed = cJSON_GetObjectItem(root, "resumed");
+        ESP_LOGI(TAG, "Session resume %s by server", cJSON_IsTrue(resumed) ? "accepted" : "rejected");
+    }
+
+    // Remember the negotiated parameters if the server allows resuming this session,
+    // otherwise drop the previous token
+    std::lock_guard<std::mutex> lock(hello_cache_mutex_);
+    hello_cache_.resume_token.clear();
+    auto resume = cJSON_GetObjectItem(root, "resume");
+    if (cJSON_IsObject(resume)) {
+        auto token = cJSON_GetObjectItem(resume, "token");
+        auto ttl = cJSON_GetObjectItem(resume, "ttl");
+        if (cJSON_IsString(token) && cJSON_IsNumber(ttl) && ttl->valueint > 0) {
+            int ttl_seconds = std::min(ttl->valueint, WEBSOCKET_PROTOCOL_MAX_RESUME_SECONDS);
+            hello_cache_.url = url_;
+            hello_cache_.resume_token = token->valuestring;
+            hello_cache_.session_id = session_id_;
+            hello_cache_.version = version_;
+            hello_cache_.sample_rate = server_sample_rate_;
+            hello_cache_.frame_duration = server_frame_duration_;
+            hello_cache_.expire_time_us = esp_timer_get_time() + ttl_seconds * 1000000LL;
+        }
+    }
+
     xEventGroupSetBits(event_group_handle_, WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT);
 }
+
+// Callers hold hello_cache_mutex_
+bool WebsocketProtocol::CanResume(const std::string& url) const {
+    return !hello_cache_.resume_token.empty() && hello_cache_.url == url &&
+        esp_timer_get_time() < hello_cache_.expire_time_us;
+}
+
+// Drops a token that has been used or failed, unless a newer server hello already replaced it
+void WebsocketProtocol::ConsumeResumeToken(const std::string& token) {
+    if (token.empty()) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(hello_cache_mutex_);
+    if (hello_cache_.resume_token == token) {
+        hello_cache_.resume_token.clear();
+    }
+}
@@ -7,9 +7,15 @@
 #include <web_socket.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/event_groups.h>
+#include <mutex>
 
 #define WEBSOCKET_PROTOCOL_SERVER_HELLO_EVENT (1 << 0)
 
+// Upper bound of Opus frames packed into one version 4 message
+#define WEBSOCKET_PROTOCOL_MAX_FRAMES_PER_MESSAGE 8
+// Upper bound of the resume window granted by the server
+#define WEBSOCKET_PROTOCOL_MAX_RESUME_SECONDS 300
+
 class WebsocketProtocol : public Protocol {
 public:
     WebsocketProtocol();
@@ -17,18 +23,44 @@ public:
 
     bool Start() override;
     bool SendAudio(std::unique_ptr<AudioStreamPacket> packet) override;
+    bool SendAudioBatch(std::vector<std::unique_ptr<AudioStreamPacket>>& packets) override;
+    size_t GetAudioBatchSize(size_t queued_packets) const override;
     bool OpenAudioChannel() override;
     void CloseAudioChannel() override;
     bool IsAudioChannelOpened() const override;
 
 private:
+    // Parameters negotiated by the last server hello, reused when the server
+    // granted a resume token and the channel is reopened within its lifetime
+    struct HelloCache {
+        std::string url;
+        std::string resume_token;
+        std::string session_id;
+        int version = 0;
+        int sample_rate = 0;
+        int frame_duration = 0;
+        int64_t expire_time_us = 0;
+    };
+
     EventGroupHandle_t event_group_handle_;
     std::unique_ptr<WebSocket> websocket_;
     int version_ = 1;
+    int rtt_ms_ = 0;
+    int64_t hello_sent_time_us_ = 0;
+    // Written by the server hello on the websocket task, read when opening on the main task
+    std::mutex hello_cache_mutex_;
+    HelloCache hello_cache_;
+    std::string url_;
+    bool resuming_ = false;
 
     void ParseServerHello(const cJSON* root);
+    bool SendAudioFrames(std::unique_ptr<AudioStreamPacket>* packets, size_t count);
+    void ParseAudioFrames(const char* data, size_t len);
+    bool SendBinary(const void* data, size_t size);
     bool SendText(const std::string& text) override;
-    std::string GetHelloMessage();
+    std::string GetHelloMessage(const HelloCache* resume);
+    bool CanResume(const std::string& url) const;
+    void ConsumeResumeToken(const std::string& token);
 };
 
 #endif
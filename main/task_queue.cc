@@ -0,0 +1,114 @@
+#include "task_queue.h"
+
+#include <esp_log.h>
+#include <esp_timer.h>
+
+#define TAG "TaskQueue"
+
+void TaskQueue::Push(ScheduledTask&& task, TaskPriority priority) {
+    if (!task.callback.IsInline()) {
+        heap_allocated_[priority].fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!overflow_pending_[priority].load(std::memory_order_acquire) && PushToRing(task, priority)) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(overflow_mutex_);
+    overflow_[priority].push_back(std::move(task));
+    overflow_pending_[priority].store(true, std::memory_order_release);
+    overflowed_[priority].fetch_add(1, std::memory_order_relaxed);
+}
+
+bool TaskQueue::PushToRing(ScheduledTask& task, TaskPriority priority) {
+    if (priority == kTaskPriorityHigh) {
+        return high_ring_.TryPush(task);
+    }
+    return normal_ring_.TryPush(task);
+}
+
+bool TaskQueue::PopFromRing(ScheduledTask& task, TaskPriority priority) {
+    if (priority == kTaskPriorityHigh) {
+        return high_ring_.TryPop(task);
+    }
+    return normal_ring_.TryPop(task);
+}
+
+size_t TaskQueue::RingSize(TaskPriority priority) const {
+    return priority == kTaskPriorityHigh ? high_ring_.size() : normal_ring_.size();
+}
+
+bool TaskQueue::Pop(ScheduledTask& task, TaskPriority& priority) {
+    for (int i = 0; i < kTaskPriorityCount; i++) {
+        priority = (TaskPriority)i;
+        uint32_t depth = RingSize(priority);
+        if (depth > stats_[i].max_depth) {
+            stats_[i].max_depth = depth;
+        }
+        if (PopFromRing(task, priority)) {
+            return true;
+        }
+        // The ring is drained, everything that spilled over comes after it
+        if (overflow_pending_[i].load(std::memory_order_acquire)) {
+            std::lock_guard<std::mutex> lock(overflow_mutex_);
+            auto& overflow = overflow_[i];
+            if (!overflow.empty()) {
+                task = std::move(overflow.front());
+                overflow.pop_front();
+            }
+            if (overflow.empty()) {
+                overflow_pending_[i].store(false, std::memory_order_release);
+            }
+            if (task.callback) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool TaskQueue::RunPending(int max_tasks, LoopProfiler* profiler) {
+    ScheduledTask task;
+    TaskPriority priority;
+    for (int i = 0; i < max_tasks; i++) {
+        if (!Pop(task, priority)) {
+            return false;
+        }
+        int64_t start_time = esp_timer_get_time();
+        task.callback();
+        task.callback.Reset();
+        uint32_t elapsed_us = esp_timer_get_time() - start_time;
+        if (profiler != nullptr) {
+            profiler->RecordTask(task.file, task.line, elapsed_us);
+        }
+
+        auto& stats = stats_[priority];
+        stats.executed++;
+        stats.total_us += elapsed_us;
+        if (elapsed_us > stats.max_us) {
+            stats.max_us = elapsed_us;
+        }
+    }
+    for (int i = 0; i < kTaskPriorityCount; i++) {
+        if (RingSize((TaskPriority)i) > 0 || overflow_pending_[i].load(std::memory_order_acquire)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+TaskLaneStats TaskQueue::GetStats(TaskPriority priority) const {
+    TaskLaneStats stats = stats_[priority];
+    stats.overflowed = overflowed_[priority].load(std::memory_order_relaxed);
+    stats.heap_allocated = heap_allocated_[priority].load(std::memory_order_relaxed);
+    return stats;
+}
+
+void TaskQueue::LogStats() const {
+    static const char* const names[kTaskPriorityCount] = { "high", "normal" };
+    for (int i = 0; i < kTaskPriorityCount; i++) {
+        auto stats = GetStats((TaskPriority)i);
+        ESP_LOGI(TAG, "%s: executed %lu, avg %lu us, max %lu us, max depth %lu, overflowed %lu, heap %lu",
+            names[i], stats.executed, stats.executed > 0 ? (uint32_t)(stats.total_us / stats.executed) : 0,
+            stats.max_us, stats.max_depth, stats.overflowed, stats.heap_allocated);
+    }
+}
@@ -0,0 +1,245 @@
+#ifndef _TASK_QUEUE_H_
+#define _TASK_QUEUE_H_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "loop_profiler.h"
+
+#define TASK_QUEUE_HIGH_CAPACITY 16
+#define TASK_QUEUE_NORMAL_CAPACITY 32
+// Captures up to this size are stored inline, larger ones on the heap
+#define SMALL_TASK_INLINE_SIZE 32
+
+enum TaskPriority {
+    kTaskPriorityHigh,      // Audio and device state, runs before anything else
+    kTaskPriorityNormal,    // UI updates and housekeeping
+    kTaskPriorityCount,
+};
+
+/*
+ * Move-only void() callable with small buffer storage, so scheduling a
+ * lambda does not allocate in the common case.
+ */
+class SmallTask {
+public:
+    SmallTask() = default;
+
+    template<typename F, typename Fn = std::decay_t<F>,
+             typename = std::enable_if_t<!std::is_same_v<Fn, SmallTask>>>
+    SmallTask(F&& f) {
+        if constexpr (sizeof(Fn) <= SMALL_TASK_INLINE_SIZE && alignof(Fn) <= alignof(std::max_align_t) &&
+                      std::is_nothrow_move_constructible_v<Fn>) {
+            new (storage_) Fn(std::forward<F>(f));
+            ops_ = &kInlineOps<Fn>;
+        } else {
+            *reinterpret_cast<Fn**>(storage_) = new Fn(std::forward<F>(f));
+            ops_ = &kHeapOps<Fn>;
+        }
+    }
+
+    SmallTask(SmallTask&& other) noexcept {
+        MoveFrom(other);
+    }
+
+    SmallTask& operator=(SmallTask&& other) noexcept {
+        if (this != &other) {
+            Reset();
+            MoveFrom(other);
+        }
+        return *this;
+    }
+
+    SmallTask(const SmallTask&) = delete;
+    SmallTask& operator=(const SmallTask&) = delete;
+
+    ~SmallTask() {
+        Reset();
+    }
+
+    explicit operator bool() const {
+        return ops_ != nullptr;
+    }
+
+    bool IsInline() const {
+        return ops_ != nullptr && ops_->is_inline;
+    }
+
+    void operator()() {
+        ops_->invoke(storage_);
+    }
+
+    void Reset() {
+        if (ops_ != nullptr) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+private:
+    struct Ops {
+        void (*invoke)(void* storage);
+        void (*move)(void* dst, void* src);     // Move constructs dst and destroys src
+        void (*destroy)(void* storage);
+        bool is_inline;
+    };
+
+    template<typename Fn>
+    static constexpr Ops kInlineOps = {
+        [](void* s) { (*static_cast<Fn*>(s))(); },
+        [](void* d, void* s) {
+            new (d) Fn(std::move(*static_cast<Fn*>(s)));
+            static_cast<Fn*>(s)->~Fn();
+        },
+        [](void* s) { static_cast<Fn*>(s)->~Fn(); },
+        true,
+    };
+
+    template<typename Fn>
+    static constexpr Ops kHeapOps = {
+        [](void* s) { (**static_cast<Fn**>(s))(); },
+        [](void* d, void* s) { *static_cast<Fn**>(d) = *static_cast<Fn**>(s); },
+        [](void* s) { delete *static_cast<Fn**>(s); },
+        false,
+    };
+
+    alignas(std::max_align_t) unsigned char storage_[SMALL_TASK_INLINE_SIZE];
+    const Ops* ops_ = nullptr;
+
+    void MoveFrom(SmallTask& other) {
+        ops_ = other.ops_;
+        if (ops_ != nullptr) {
+            ops_->move(storage_, other.storage_);
+            other.ops_ = nullptr;
+        }
+    }
+};
+
+/*
+ * Bounded multi-producer single-consumer ring (Vyukov). Each cell carries a
+ * sequence number, so producers only contend on one atomic increment and
+ * the consumer never takes a lock.
+ */
+template<typename T, size_t Capacity>
+class BoundedMpscQueue {
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    BoundedMpscQueue() {
+        for (size_t i = 0; i < Capacity; i++) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    ~BoundedMpscQueue() {
+        T item;
+        while (TryPop(item)) {
+        }
+    }
+
+    // Returns false without consuming the item when the ring is full
+    bool TryPush(T& item) {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = cells_[pos & (Capacity - 1)];
+            size_t sequence = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (cell.storage) T(std::move(item));
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer side only
+    bool TryPop(T& item) {
+        Cell& cell = cells_[dequeue_pos_ & (Capacity - 1)];
+        size_t sequence = cell.sequence.load(std::memory_order_acquire);
+        if ((intptr_t)sequence - (intptr_t)(dequeue_pos_ + 1) < 0) {
+            return false;
+        }
+        T* stored = reinterpret_cast<T*>(cell.storage);
+        item = std::move(*stored);
+        stored->~T();
+        cell.sequence.store(dequeue_pos_ + Capacity, std::memory_order_release);
+        dequeue_pos_++;
+        return true;
+    }
+
+    // Approximate when producers are active
+    size_t size() const {
+        return enqueue_pos_.load(std::memory_order_relaxed) - dequeue_pos_;
+    }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    Cell cells_[Capacity];
+    std::atomic<size_t> enqueue_pos_ = 0;
+    size_t dequeue_pos_ = 0;
+};
+
+// A scheduled callback and the source location that scheduled it
+struct ScheduledTask {
+    SmallTask callback;
+    const char* file = nullptr;
+    int line = 0;
+};
+
+struct TaskLaneStats {
+    uint32_t executed = 0;
+    uint32_t overflowed = 0;    // Tasks that did not fit the ring and went to the overflow list
+    uint32_t heap_allocated = 0; // Tasks whose captures did not fit inline
+    uint32_t max_depth = 0;
+    uint64_t total_us = 0;      // uint32_t wraps after about 71 minutes of task time
+    uint32_t max_us = 0;
+};
+
+/*
+ * Task queue of the main event loop with one lane per priority. The high
+ * lane is always drained first. A full lane spills into a locked overflow
+ * list instead of dropping the task, and keeps using it until the consumer
+ * has caught up so the lane stays FIFO.
+ */
+class TaskQueue {
+public:
+    void Push(ScheduledTask&& task, TaskPriority priority);
+    // Runs up to max_tasks tasks, returns true if more are pending
+    bool RunPending(int max_tasks, LoopProfiler* profiler = nullptr);
+    TaskLaneStats GetStats(TaskPriority priority) const;
+    void LogStats() const;
+
+private:
+    BoundedMpscQueue<ScheduledTask, TASK_QUEUE_HIGH_CAPACITY> high_ring_;
+    BoundedMpscQueue<ScheduledTask, TASK_QUEUE_NORMAL_CAPACITY> normal_ring_;
+    std::mutex overflow_mutex_;
+    std::deque<ScheduledTask> overflow_[kTaskPriorityCount];
+    std::atomic<bool> overflow_pending_[kTaskPriorityCount] = {};
+    std::atomic<uint32_t> overflowed_[kTaskPriorityCount] = {};
+    std::atomic<uint32_t> heap_allocated_[kTaskPriorityCount] = {};
+    // Consumer side only
+    TaskLaneStats stats_[kTaskPriorityCount];
+
+    bool PushToRing(ScheduledTask& task, TaskPriority priority);
+    bool PopFromRing(ScheduledTask& task, TaskPriority priority);
+    size_t RingSize(TaskPriority priority) const;
+    bool Pop(ScheduledTask& task, TaskPriority& priority);
+};
+
+#endif // _TASK_QUEUE_H_
@@ -0,0 +1,224 @@
+#include "timer_service.h"
+
+#include <esp_log.h>
+
+#include <algorithm>
+#include <cstring>
+
+#define TAG "TimerService"
+
+TimerHandle& TimerHandle::operator=(TimerHandle&& other) noexcept {
+    if (this != &other) {
+        Cancel();
+        id_ = other.id_;
+        other.id_ = 0;
+    }
+    return *this;
+}
+
+void TimerHandle::Cancel() {
+    if (id_ != 0) {
+        TimerService::GetInstance().Cancel(id_);
+        id_ = 0;
+    }
+}
+
+bool TimerHandle::IsActive() const {
+    return id_ != 0 && TimerService::GetInstance().IsActive(id_);
+}
+
+TimerService::TimerService() {
+    esp_timer_create_args_t timer_args = {
+        .callback = [](void* arg) {
+            static_cast<TimerService*>(arg)->OnAlarm();
+        },
+        .arg = this,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "timer_service",
+        .skip_unhandled_events = false,
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &alarm_timer_));
+}
+
+TimerService::~TimerService() {
+    esp_timer_stop(alarm_timer_);
+    esp_timer_delete(alarm_timer_);
+}
+
+TimerHandle TimerService::StartOnce(const char* name, uint32_t delay_ms, uint32_t slack_ms,
+                                    std::function<void()> callback) {
+    return Start(name, delay_ms, 0, slack_ms, std::move(callback));
+}
+
+TimerHandle TimerService::StartPeriodic(const char* name, uint32_t period_ms, uint32_t slack_ms,
+                                        std::function<void()> callback) {
+    return Start(name, period_ms, period_ms, slack_ms, std::move(callback));
+}
+
+TimerHandle TimerService::Start(const char* name, uint32_t delay_ms, uint32_t period_ms, uint32_t slack_ms,
+                                std::function<void()> callback) {
+    auto timer = std::make_shared<Timer>();
+    timer->name = name;
+    timer->deadline_us = esp_timer_get_time() + (int64_t)delay_ms * 1000;
+    timer->period_us = (int64_t)period_ms * 1000;
+    timer->slack_us = (int64_t)slack_ms * 1000;
+    timer->callback = std::move(callback);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    timer->id = next_id_++;
+    if (next_id_ == 0) {
+        next_id_ = 1;
+    }
+    StatsLocked(name);
+    timers_.push_back(timer);
+    ArmLocked();
+    return TimerHandle(timer->id);
+}
+
+void TimerService::Cancel(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto match = [id](const auto& timer) { return timer->id == id; };
+    auto it = std::find_if(timers_.begin(), timers_.end(), match);
+    if (it != timers_.end()) {
+        (*it)->cancelled = true;
+        timers_.erase(it);
+        ArmLocked();
+        return;
+    }
+    // A one-shot that is already due has left timers_, stop it before its callback runs
+    it = std::find_if(firing_.begin(), firing_.end(), match);
+    if (it != firing_.end()) {
+        (*it)->cancelled = true;
+    }
+}
+
+bool TimerService::IsActive(uint32_t id) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return std::any_of(timers_.begin(), timers_.end(), [id](const auto& timer) { return timer->id == id; });
+}
+
+TimerStats& TimerService::StatsLocked(const char* name) {
+    for (auto& stats : stats_) {
+        if (stats.name == name || strcmp(stats.name, name) == 0) {
+            return stats;
+        }
+    }
+    stats_.push_back(TimerStats{name});
+    return stats_.back();
+}
+
+void TimerService::ArmLocked() {
+    // The alarm goes off at the latest moment the most urgent timer allows
+    int64_t alarm_us = INT64_MAX;
+    const char* owner = nullptr;
+    for (auto& timer : timers_) {
+        int64_t latest_us = timer->deadline_us + timer->slack_us;
+        if (latest_us < alarm_us) {
+            alarm_us = latest_us;
+            owner = timer->name;
+        }
+    }
+
+    if (owner == nullptr) {
+        if (alarm_us_ != 0) {
+            esp_timer_stop(alarm_timer_);
+            alarm_us_ = 0;
+        }
+        return;
+    }
+    alarm_owner_ = owner;
+    if (alarm_us == alarm_us_) {
+        return;
+    }
+    alarm_us_ = alarm_us;
+    int64_t delay_us = std::max<int64_t>(alarm_us - esp_timer_get_time(), 0);
+    esp_timer_stop(alarm_timer_);
+    esp_timer_start_once(alarm_timer_, delay_us);
+}
+
+void TimerService::OnAlarm() {
+    std::vector<std::shared_ptr<Timer>> due;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        alarm_us_ = 0;
+        wakeups_++;
+        if (alarm_owner_ != nullptr) {
+            StatsLocked(alarm_owner_).wakeups++;
+        }
+
+        int64_t now = esp_timer_get_time();
+        for (auto it = timers_.begin(); it != timers_.end();) {
+            auto& timer = *it;
+            if (timer->deadline_us > now) {
+                ++it;
+                continue;
+            }
+            auto& stats = StatsLocked(timer->name);
+            stats.fires++;
+            if (timer->name != alarm_owner_) {
+                stats.coalesced++;
+            }
+            due.push_back(timer);
+            if (timer->period_us > 0) {
+                // Keep the phase, skip the periods that were missed
+                timer->deadline_us += timer->period_us;
+                if (timer->deadline_us <= now) {
+                    timer->deadline_us = now + timer->period_us;
+                }
+                ++it;
+            } else {
+                it = timers_.erase(it);
+            }
+        }
+        firing_ = due;
+    }
+
+    for (auto& timer : due) {
+        // Cancel may have run since the timer was collected, even from an earlier callback
+        if (!timer->cancelled) {
+            timer->callback();
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    firing_.clear();
+    ArmLocked();
+}
+
+uint32_t TimerService::GetWakeupCount() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return wakeups_;
+}
+
+std::vector<TimerStats> TimerService::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+std::string TimerService::GetStatusJson() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::string json = "{\"wakeups\":" + std::to_string(wakeups_);
+    json += ",\"active\":" + std::to_string(timers_.size());
+    json += ",\"timers\":[";
+    for (size_t i = 0; i < stats_.size(); i++) {
+        auto& stats = stats_[i];
+        if (i > 0) {
+            json += ",";
+        }
+        json += "{\"name\":\"" + std::string(stats.name) + "\"";
+        json += ",\"fires\":" + std::to_string(stats.fires);
+        json += ",\"wakeups\":" + std::to_string(stats.wakeups);
+        json += ",\"coalesced\":" + std::to_string(stats.coalesced) + "}";
+    }
+    json += "]}";
+    return json;
+}
+
+void TimerService::LogStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ESP_LOGI(TAG, "wakeups: %lu, active timers: %u", wakeups_, (unsigned)timers_.size());
+    for (auto& stats : stats_) {
+        ESP_LOGI(TAG, "  %s: fires %lu, wakeups %lu, coalesced %lu",
+            stats.name, stats.fires, stats.wakeups, stats.coalesced);
+    }
+}
@@ -0,0 +1,109 @@
+#ifndef _TIMER_SERVICE_H_
+#define _TIMER_SERVICE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <esp_timer.h>
+
+/*
+ * Owning handle of a TimerService timer. Destroying or reassigning the
+ * handle cancels the timer, so a member handle never outlives its owner.
+ */
+class TimerHandle {
+public:
+    TimerHandle() = default;
+    TimerHandle(TimerHandle&& other) noexcept : id_(other.id_) {
+        other.id_ = 0;
+    }
+    TimerHandle& operator=(TimerHandle&& other) noexcept;
+    TimerHandle(const TimerHandle&) = delete;
+    TimerHandle& operator=(const TimerHandle&) = delete;
+    ~TimerHandle() {
+        Cancel();
+    }
+
+    // Safe to call from the timer callback itself, does not wait for a running callback
+    void Cancel();
+    bool IsActive() const;
+
+private:
+    friend class TimerService;
+    explicit TimerHandle(uint32_t id) : id_(id) {}
+
+    uint32_t id_ = 0;
+};
+
+struct TimerStats {
+    const char* name;
+    uint32_t fires = 0;         // Callbacks run
+    uint32_t wakeups = 0;       // Alarms this timer was the reason for
+    uint32_t coalesced = 0;     // Fires that rode on another timer's alarm
+};
+
+/*
+ * Software timers multiplexed onto a single esp_timer. Every timer has a
+ * slack: it may fire up to slack_ms late. The alarm is set to the earliest
+ * deadline + slack of all timers and then runs every timer that is due, so
+ * timers with slack line up and the chip wakes from light sleep less often.
+ * Callbacks run in the esp_timer task, like the esp_timers they replace.
+ */
+class TimerService {
+public:
+    static TimerService& GetInstance() {
+        static TimerService instance;
+        return instance;
+    }
+    TimerService(const TimerService&) = delete;
+    TimerService& operator=(const TimerService&) = delete;
+
+    // name must be a string literal, it keys the statistics
+    TimerHandle StartOnce(const char* name, uint32_t delay_ms, uint32_t slack_ms, std::function<void()> callback);
+    TimerHandle StartPeriodic(const char* name, uint32_t period_ms, uint32_t slack_ms, std::function<void()> callback);
+
+    uint32_t GetWakeupCount();
+    std::vector<TimerStats> GetStats();
+    std::string GetStatusJson();
+    void LogStats();
+
+private:
+    TimerService();
+    ~TimerService();
+
+    struct Timer {
+        uint32_t id;
+        const char* name;
+        int64_t deadline_us;
+        int64_t period_us;      // 0 for one-shot timers
+        int64_t slack_us;
+        std::function<void()> callback;
+        // Checked right before the callback runs, a due timer can still be cancelled
+        std::atomic<bool> cancelled = false;
+    };
+
+    std::mutex mutex_;
+    esp_timer_handle_t alarm_timer_ = nullptr;
+    std::vector<std::shared_ptr<Timer>> timers_;
+    std::vector<std::shared_ptr<Timer>> firing_;   // Due timers whose callbacks OnAlarm is running
+    std::vector<TimerStats> stats_;
+    uint32_t next_id_ = 1;
+    int64_t alarm_us_ = 0;              // 0 when the alarm is not set
+    const char* alarm_owner_ = nullptr;
+    uint32_t wakeups_ = 0;
+
+    friend class TimerHandle;
+    void Cancel(uint32_t id);
+    bool IsActive(uint32_t id);
+    TimerHandle Start(const char* name, uint32_t delay_ms, uint32_t period_ms, uint32_t slack_ms,
+                      std::function<void()> callback);
+    void OnAlarm();
+    void ArmLocked();
+    TimerStats& StatsLocked(const char* name);
+};
+
+#endif // _TIMER_SERVICE_H_
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <string_view>
+
+namespace xiaozhi {
+
+/**
+ * @brief 流式 JSON 写入器
+ *
+ * 直接把 JSON 追加到调用方提供的 std::string，不建 cJSON 树、不做中间解析。
+ * 调用方可以复用同一个缓冲区（clear() 保留容量），稳定后不再分配内存。
+ * 逗号由写入器自动处理，调用方只需保证 Begin/End 成对、对象内先 Key 后值。
+ * 输出与 cJSON_PrintUnformatted 兼容：非 ASCII 字符原样输出，NaN/Inf 写为 null。
+ *
+ * 用法：
+ *     std::string buf;
+ *     JsonWriter json(buf);
+ *     json.BeginObject().Key("mood").Int(80).Key("name").String("猫咪").EndObject();
+ */
+class JsonWriter {
+public:
+    explicit JsonWriter(std::string& out) : out_(out) {}
+
+    std::string& buffer() { return out_; }
+
+    // 写入位置，用于撤回超出大小限制的内容
+    struct Checkpoint {
+        size_t size;
+        bool need_comma;
+    };
+
+    Checkpoint GetCheckpoint() const { return {out_.size(), need_comma_}; }
+
+    void Rollback(const Checkpoint& checkpoint) {
+        out_.resize(checkpoint.size);
+        need_comma_ = checkpoint.need_comma;
+    }
+
+    JsonWriter& BeginObject() {
+        Separate();
+        out_ += '{';
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& EndObject() {
+        out_ += '}';
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& BeginArray() {
+        Separate();
+        out_ += '[';
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& EndArray() {
+        out_ += ']';
+        need_comma_ = true;
+        return *this;
+    }
+
+    /**
+     * @brief 写入键名，紧接着必须写入一个值
+     */
+    JsonWriter& Key(std::string_view key) {
+        Separate();
+        AppendQuoted(key);
+        out_ += ':';
+        need_comma_ = false;
+        return *this;
+    }
+
+    JsonWriter& String(std::string_view value) {
+        Separate();
+        AppendQuoted(value);
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& Int(int64_t value) {
+        Separate();
+        char buf[24];
+        int len = snprintf(buf, sizeof(buf), "%lld", (long long)value);
+        out_.append(buf, len);
+        need_comma_ = true;
+        return *this;
+    }
+
+    /**
+     * @brief 写入浮点数，格式与 cJSON 相同（15 位有效数字，不能还原时用 17 位）
+     */
+    JsonWriter& Double(double value) {
+        Separate();
+        if (!std::isfinite(value)) {
+            out_ += "null";
+        } else if (std::fabs(value) < 1e15 && value == (double)(int64_t)value) {
+            // 先判范围再转换，超出 int64_t 的值强转是未定义行为
+            char buf[24];
+            int len = snprintf(buf, sizeof(buf), "%lld", (long long)value);
+            out_.append(buf, len);
+        } else {
+            char buf[32];
+            int len = snprintf(buf, sizeof(buf), "%1.15g", value);
+            if (strtod(buf, nullptr) != value) {
+                len = snprintf(buf, sizeof(buf), "%1.17g", value);
+            }
+            out_.append(buf, len);
+        }
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& Bool(bool value) {
+        Separate();
+        out_ += value ? "true" : "false";
+        need_comma_ = true;
+        return *this;
+    }
+
+    JsonWriter& Null() {
+        Separate();
+        out_ += "null";
+        need_comma_ = true;
+        return *this;
+    }
+
+    /**
+     * @brief 原样写入一段已序列化的 JSON 值（调用方保证合法）
+     */
+    JsonWriter& Raw(std::string_view json) {
+        Separate();
+        out_.append(json.data(), json.size());
+        need_comma_ = true;
+        return *this;
+    }
+
+private:
+    // 转义控制字符、引号和反斜杠，其余字节（包括 UTF-8）原样输出
+    static void AppendEscaped(std::string& out, std::string_view value) {
+        size_t start = 0;
+        for (size_t i = 0; i < value.size(); i++) {
+            unsigned char c = (unsigned char)value[i];
+            if (c >= 0x20 && c != '"' && c != '\\') {
+                continue;
+            }
+            out.append(value.data() + start, i - start);
+            start = i + 1;
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default: {
+                    char buf[8];
+                    snprintf(buf, sizeof(buf), "\\u%04x", c);
+                    out += buf;
+                    break;
+                }
+            }
+        }
+        out.append(value.data() + start, value.size() - start);
+    }
+
+    void Separate() {
+        if (need_comma_) {
+            out_ += ',';
+        }
+    }
+
+    void AppendQuoted(std::string_view value) {
+        out_ += '"';
+        AppendEscaped(out_, value);
+        out_ += '"';
+    }
+
+    std::string& out_;
+    bool need_comma_ = false;
+};
+
+}  // namespace xiaozhi
@@ -1,40 +1,136 @@
 #pragma once
 
+#include <atomic>
 #include <cstdint>
+#include <ctime>
 #include <esp_timer.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
 #include <sys/time.h>
 
 namespace xiaozhi {
 namespace time_utils {
 
+/**
+ * @brief 虚拟时钟（学习模拟器使用）
+ *
+ * 虚拟时钟只对设置它的任务生效：在该任务中，除 GetTimerUs 外本文件的时间函数
+ * 都返回虚拟时间，其他任务（主循环、定时器、事件总线）始终看到真实时间。
+ * 宠物和学习模块只通过这里读时间，模拟器在自己的任务中推进虚拟时钟即可快速回放作息。
+ */
+struct VirtualClock {
+    std::atomic<TaskHandle_t> owner{nullptr};  // 使用虚拟时间的任务，nullptr 表示未启用
+    std::atomic<int64_t> epoch_ms{0};
+    int64_t uptime_offset_ms = 0;   // 虚拟开机时间 = epoch_ms - uptime_offset_ms
+};
+
+inline VirtualClock& GetVirtualClock() {
+    static VirtualClock clock;
+    return clock;
+}
+
+/**
+ * @brief 为当前任务设置虚拟时间（毫秒），首次设置时启用虚拟时钟，开机时间从当前值继续
+ */
+inline void SetVirtualTimeMs(int64_t epoch_ms) {
+    auto& clock = GetVirtualClock();
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    if (clock.owner.load(std::memory_order_relaxed) != self) {
+        clock.uptime_offset_ms = epoch_ms - esp_timer_get_time() / 1000;
+    }
+    clock.epoch_ms.store(epoch_ms, std::memory_order_relaxed);
+    clock.owner.store(self, std::memory_order_release);
+}
+
+/**
+ * @brief 恢复真实时间
+ */
+inline void ClearVirtualTime() {
+    GetVirtualClock().owner.store(nullptr, std::memory_order_release);
+}
+
+/**
+ * @brief 当前任务是否使用虚拟时间
+ */
+inline bool IsVirtualTime() {
+    TaskHandle_t owner = GetVirtualClock().owner.load(std::memory_order_acquire);
+    return owner != nullptr && owner == xTaskGetCurrentTaskHandle();
+}
+
 /**
  * @brief 获取当前 epoch 时间（毫秒）
  */
 inline int64_t GetEpochTimeMs() {
+    if (IsVirtualTime()) {
+        return GetVirtualClock().epoch_ms.load(std::memory_order_relaxed);
+    }
     struct timeval tv;
     gettimeofday(&tv, nullptr);
     return (int64_t)tv.tv_sec * 1000LL + tv.tv_usec / 1000LL;
 }
 
+/**
+ * @brief 获取当前 epoch 时间（秒），等同于 time(nullptr)
+ */
+inline time_t GetTime() {
+    return (time_t)(GetEpochTimeMs() / 1000);
+}
+
+/**
+ * @brief 获取开机以来的时间（毫秒）
+ */
+inline int64_t GetUptimeMs() {
+    auto& clock = GetVirtualClock();
+    if (IsVirtualTime()) {
+        return clock.epoch_ms.load(std::memory_order_relaxed) - clock.uptime_offset_ms;
+    }
+    return esp_timer_get_time() / 1000;
+}
+
+/**
+ * @brief 获取当前本地时间
+ */
+inline void GetLocalTime(struct tm* timeinfo) {
+    time_t now = GetTime();
+    localtime_r(&now, timeinfo);
+}
+
 /**
  * @brief 获取当前小时（0-23）
  */
 inline int GetCurrentHour() {
-    time_t now;
     struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
+    GetLocalTime(&timeinfo);
     return timeinfo.tm_hour;
 }
 
+/**
+ * @brief 系统时间是否已同步（未同步时从 1970 年开始计时）
+ */
+inline bool IsTimeSynced() {
+    struct tm timeinfo;
+    GetLocalTime(&timeinfo);
+    return timeinfo.tm_year >= 2025 - 1900;
+}
+
+/**
+ * @brief 获取当前在一周中的小时（0-167，周日 0 点为 0），时间未同步时返回 -1
+ */
+inline int GetHourOfWeek() {
+    struct tm timeinfo;
+    GetLocalTime(&timeinfo);
+    if (timeinfo.tm_year < 2025 - 1900) {
+        return -1;
+    }
+    return timeinfo.tm_wday * 24 + timeinfo.tm_hour;
+}
+
 /**
  * @brief 获取当天午夜的时间戳（毫秒）
  */
 inline int64_t GetMidnightTimeMs() {
-    time_t now;
     struct tm timeinfo;
-    time(&now);
-    localtime_r(&now, &timeinfo);
+    GetLocalTime(&timeinfo);
     timeinfo.tm_hour = 0;
     timeinfo.tm_min = 0;
     timeinfo.tm_sec = 0;
@@ -43,7 +139,7 @@ inline int64_t GetMidnightTimeMs() {
 }
 
 /**
- * @brief 获取高精度计时器时间（微秒，用于性能测试）
+ * @brief 获取高精度计时器时间（微秒，用于性能测试），不受虚拟时钟影响
  */
 inline int64_t GetTimerUs() {
     return esp_timer_get_time();
@@ -51,26 +147,3 @@ inline int64_t GetTimerUs() {
 
 } // namespace time_utils
 } // namespace xiaozhi
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
-
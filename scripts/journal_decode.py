@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+'''
+  Decode the flash event journal (main/event_journal.h).
+
+  Get the journal, either straight from flash:
+    parttool.py read_partition --partition-name journal --output journal.bin
+  or from the console: call the MCP tool self.diagnostics.journal with
+  dump=true while `idf.py monitor | tee monitor.log` runs.
+
+  Then:
+    python journal_decode.py extract monitor.log journal.bin
+    python journal_decode.py summary journal.bin
+    python journal_decode.py dump journal.bin --boots 2 --errors monitor.log
+
+  Records are ordered by sequence number and split into boots at each boot
+  record. The device logs "Protocol error <hash>: <message>" next to every
+  protocol error record, pass such a log with --errors to show the messages.
+'''
+import argparse
+import base64
+import re
+import struct
+import sys
+
+MAGIC = 0x4c4a5a58
+RECORD = struct.Struct('<IIIHBB')
+SECTOR_SIZE = 4096
+
+BOOT, STATE, PROTOCOL_ERROR, HEAP_LOW, QUEUE_OVERFLOW, EVENT = range(1, 7)
+SECTOR_HEADER = 0xfe
+TYPE_NAMES = {
+    BOOT: 'boot',
+    STATE: 'state',
+    PROTOCOL_ERROR: 'protocol_error',
+    HEAP_LOW: 'heap_low',
+    QUEUE_OVERFLOW: 'queue_overflow',
+    EVENT: 'event',
+}
+
+# device_state.h
+STATE_NAMES = ['unknown', 'starting', 'configuring', 'idle', 'connecting', 'listening',
+               'speaking', 'upgrading', 'activating', 'audio_testing', 'fatal_error']
+STATE_REJECTED = 0x80
+
+# esp_reset_reason_t
+RESET_REASONS = ['unknown', 'power_on', 'external', 'software', 'panic', 'int_wdt', 'task_wdt',
+                 'wdt', 'deep_sleep', 'brownout', 'sdio', 'usb', 'jtag', 'efuse', 'power_glitch',
+                 'cpu_lockup']
+
+QUEUE_NAMES = {1: 'event_loop', 2: 'payload_pool', 3: 'subscriber'}
+
+# core/event_bus.h, key is base index << 8 | event id
+EVENT_BASES = {
+    1: ('PET', ['STATE_CHANGED', 'DAILY_TASK_DONE', 'MOOD_CRITICAL', 'HUNGRY', 'DIRTY']),
+    2: ('EMO', ['SET', 'BLINK', 'TTS_SPEAKING', 'TTS_STOPPED']),
+    3: ('LOGIC', ['VAD_VOICE_START', 'VAD_VOICE_END', 'WAKE_WORD_DETECTED', 'TTS_START',
+                  'TTS_END', 'CONVERSATION_START', 'CONVERSATION_END', 'INTENT_PARSED',
+                  'USER_FEEDBACK', 'WAKE_CHANNEL_READY']),
+    4: ('CLOUD', ['CONNECTED', 'DISCONNECTED', 'CMD_RECEIVED', 'REPLY_SENT', 'ERROR', 'LINK_STATS']),
+    5: ('LEARNING', ['PROFILE_UPDATED', 'DECISION_MADE']),
+}
+
+
+def crc8(data):
+    crc = 0xff
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xff if crc & 0x80 else (crc << 1) & 0xff
+    return crc
+
+
+class Record:
+    def __init__(self, seq, time_ms, value, code, type):
+        self.seq = seq
+        self.time_ms = time_ms
+        self.value = value
+        self.code = code
+        self.type = type
+
+    def describe(self, error_messages):
+        if self.type == BOOT:
+            reason = RESET_REASONS[self.code] if self.code < len(RESET_REASONS) else str(self.code)
+            return f'reset reason {reason}, {self.value} records recovered'
+        if self.type == STATE:
+            text = f'{state_name(self.code >> 8)} -> {state_name(self.code & 0x7f)}'
+            if self.code & STATE_REJECTED:
+                return text + ' (rejected)'
+            return text + f' after {self.value} ms'
+        if self.type == PROTOCOL_ERROR:
+            message = error_messages.get(self.value)
+            return f'{self.value:08x}' + (f' {message}' if message else '')
+        if self.type == HEAP_LOW:
+            return f'free {self.value} bytes, largest block {self.code} KB'
+        if self.type == QUEUE_OVERFLOW:
+            return f'{QUEUE_NAMES.get(self.code, self.code)} full, {event_name(self.value)}'
+        if self.type == EVENT:
+            return f'{event_name(self.code)} {self.value:08x}'
+        return f'code {self.code} value {self.value}'
+
+
+def state_name(state):
+    return STATE_NAMES[state] if state < len(STATE_NAMES) else str(state)
+
+
+def event_name(key):
+    base, id = key >> 8, key & 0xff
+    if base not in EVENT_BASES:
+        return f'{base}:{id}'
+    name, ids = EVENT_BASES[base]
+    return f'{name}_{ids[id - 1]}' if 0 < id <= len(ids) else f'{name}:{id}'
+
+
+def extract_from_monitor(text):
+    # "JRNL:<base64>" lines, everything else in the monitor output is ignored
+    data = bytearray()
+    for match in re.finditer(r'JRNL:([A-Za-z0-9+/=]+)', text):
+        data += base64.b64decode(match.group(1))
+    return bytes(data)
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if b'JRNL:' in data:
+        data = extract_from_monitor(data.decode('utf-8', errors='replace'))
+    if len(data) % SECTOR_SIZE != 0:
+        print(f'warning: {len(data)} bytes is not a whole number of sectors', file=sys.stderr)
+
+    # Only sectors with a valid header hold journal records, the rest may be stale flash
+    records = {}
+    torn = 0
+    for sector in range(0, len(data) - RECORD.size + 1, SECTOR_SIZE):
+        header = data[sector:sector + RECORD.size]
+        _, _, value, _, type, crc = RECORD.unpack(header)
+        if type != SECTOR_HEADER or value != MAGIC or crc != crc8(header[:-1]):
+            continue
+        for offset in range(sector + RECORD.size, min(sector + SECTOR_SIZE, len(data)), RECORD.size):
+            raw = data[offset:offset + RECORD.size]
+            if raw == b'\xff' * RECORD.size:
+                break
+            seq, time_ms, value, code, type, crc = RECORD.unpack(raw)
+            if crc != crc8(raw[:-1]):
+                torn += 1
+                continue
+            # A record staged before a crash can be written twice, keep one
+            records[seq] = Record(seq, time_ms, value, code, type)
+    if torn:
+        print(f'warning: {torn} torn records skipped', file=sys.stderr)
+    return [records[seq] for seq in sorted(records)]
+
+
+def split_boots(records):
+    boots = []
+    for record in records:
+        if record.type == BOOT or not boots:
+            boots.append([])
+        boots[-1].append(record)
+    return boots
+
+
+def load_error_messages(path):
+    messages = {}
+    if path:
+        with open(path, 'r', errors='replace') as f:
+            for match in re.finditer(r'Protocol error ([0-9a-f]{8}): (.*)', f.read()):
+                messages[int(match.group(1), 16)] = match.group(2).strip()
+    return messages
+
+
+def cmd_extract(args):
+    with open(args.input, 'r', errors='replace') as f:
+        data = extract_from_monitor(f.read())
+    if not data:
+        sys.exit('no JRNL lines found')
+    with open(args.output, 'wb') as f:
+        f.write(data)
+    print(f'{len(data)} bytes written to {args.output}')
+
+
+def cmd_summary(args):
+    records = load(args.input)
+    if not records:
+        print('empty journal')
+        return
+    boots = split_boots(records)
+    print(f'{len(records)} records, seq {records[0].seq}..{records[-1].seq}, {len(boots)} boots')
+    missing = records[-1].seq - records[0].seq + 1 - len(records)
+    if missing:
+        print(f'{missing} records missing (dropped or overwritten)')
+
+    for index, boot in enumerate(boots):
+        first = boot[0]
+        reason = first.describe({}) if first.type == BOOT else 'before the oldest boot record'
+        uptime = boot[-1].time_ms / 1000
+        print(f'\nboot {index}: {reason}, last record at {uptime:.1f} s')
+        counts = {}
+        for record in boot:
+            name = TYPE_NAMES.get(record.type, str(record.type))
+            counts[name] = counts.get(name, 0) + 1
+        for name, count in sorted(counts.items()):
+            print(f'  {name:<16} {count:>6}')
+        last_state = next((r for r in reversed(boot) if r.type == STATE), None)
+        if last_state:
+            print(f'  last state: {state_name(last_state.code & 0x7f)}')
+
+
+def cmd_dump(args):
+    records = load(args.input)
+    error_messages = load_error_messages(args.errors)
+    boots = split_boots(records)
+    if args.boots:
+        boots = boots[-args.boots:]
+    types = set(args.type) if args.type else None
+    for boot in boots:
+        print('-' * 60)
+        for record in boot:
+            name = TYPE_NAMES.get(record.type, str(record.type))
+            if types and name not in types:
+                continue
+            print(f'{record.seq:>8} {record.time_ms:>10} {name:<15} {record.describe(error_messages)}')
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Flash event journal decoder')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+
+    extract = subparsers.add_parser('extract', help='extract the partition image from a monitor capture')
+    extract.add_argument('input')
+    extract.add_argument('output')
+    extract.set_defaults(func=cmd_extract)
+
+    summary = subparsers.add_parser('summary', help='record counts and reset reason per boot')
+    summary.add_argument('input')
+    summary.set_defaults(func=cmd_summary)
+
+    dump = subparsers.add_parser('dump', help='print every record')
+    dump.add_argument('input')
+    dump.add_argument('--boots', type=int, help='only the last N boots')
+    dump.add_argument('--type', action='append', choices=sorted(TYPE_NAMES.values()),
+                      help='only records of this type, may be repeated')
+    dump.add_argument('--errors', help='monitor log to resolve protocol error hashes')
+    dump.set_defaults(func=cmd_dump)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,900 @@
+#!/usr/bin/env python3
+'''
+  Local stand-in for the xiaozhi server, for benchmarking the device and the
+  protocol code without the cloud.
+
+  serve    Websocket server (protocol versions 1-4), a minimal MQTT broker with
+           the UDP audio channel (AES-CTR), and an OTA endpoint that hands out
+           their addresses. Implements the hello / listen / stt / llm / tts /
+           mcp / abort / goodbye flow, the assistant answers every utterance
+           with a few seconds of audio.
+  loadgen  Simulates many devices against a server (this one by default) and
+           reports handshake, response and audio jitter percentiles.
+
+  Both apply configurable jitter, loss and bandwidth to what they send.
+
+  Example:
+    pip install websockets cryptography
+    python local_server.py serve --host-ip 192.168.1.10 --jitter 40 --loss 0.02
+    (set the device OTA url to http://192.168.1.10:8003/ota/)
+    python local_server.py loadgen --devices 200 --transport udp --turns 3
+
+  Network shaping:
+    --bandwidth   kbit/s, queued messages wait for the link
+    --jitter      ms, uniform extra delay per message
+    --loss        probability; UDP packets are dropped, TCP messages
+                  are delayed by one retransmission timeout instead
+'''
+import argparse
+import asyncio
+import json
+import os
+import random
+import ssl
+import struct
+import time
+import uuid
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+import threading
+
+SERVER_SAMPLE_RATE = 24000
+FRAME_DURATION_MS = 60
+TCP_RETRANSMIT_MS = 200
+
+# 60 ms of silence: CELT fullband 20 ms TOC, code 3 with three empty frames
+SILENCE_FRAME = bytes([0xFB, 0x03, 0xFF, 0xFE, 0xFF, 0xFE, 0xFF, 0xFE])
+
+
+def now_ms():
+    return time.monotonic() * 1000
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def load_p3(path):
+    # .p3 files: |type 1u|reserved 1u|payload_size 2u (big endian)|payload|
+    frames = []
+    with open(path, 'rb') as f:
+        while True:
+            header = f.read(4)
+            if len(header) < 4:
+                break
+            _, _, size = struct.unpack('>BBH', header)
+            frames.append(f.read(size))
+    return frames
+
+
+class NetworkShaper:
+    '''Schedules sends to model a link with limited bandwidth, jitter and loss'''
+
+    def __init__(self, bandwidth_kbps=0, jitter_ms=0, loss=0.0, ordered=True):
+        self.bandwidth_kbps = bandwidth_kbps
+        self.jitter_ms = jitter_ms
+        self.loss = loss
+        self.ordered = ordered
+        self.link_free_ms = 0
+        self.last_delivery_ms = 0
+        self.dropped = 0
+
+    def schedule(self, size):
+        '''Return the delay in ms before a message of `size` bytes arrives, None if lost'''
+        now = now_ms()
+        departure = max(now, self.link_free_ms)
+        if self.bandwidth_kbps > 0:
+            departure += size * 8 / self.bandwidth_kbps
+        self.link_free_ms = departure
+        delivery = departure + random.uniform(0, self.jitter_ms)
+        if self.loss > 0 and random.random() < self.loss:
+            if not self.ordered:
+                self.dropped += 1
+                return None
+            delivery += TCP_RETRANSMIT_MS
+        if self.ordered:
+            delivery = max(delivery, self.last_delivery_ms)
+            self.last_delivery_ms = delivery
+        return delivery - now
+
+    @property
+    def idle(self):
+        return self.bandwidth_kbps <= 0 and self.jitter_ms <= 0 and self.loss <= 0
+
+
+class OrderedSender:
+    '''Sends through a NetworkShaper without reordering, for TCP based transports'''
+
+    def __init__(self, shaper, send):
+        self.shaper = shaper
+        self.send = send
+        self.queue = asyncio.Queue()
+        self.task = asyncio.ensure_future(self.run())
+
+    async def run(self):
+        while True:
+            due, message = await self.queue.get()
+            delay = due - now_ms()
+            if delay > 0:
+                await asyncio.sleep(delay / 1000)
+            try:
+                await self.send(message)
+            except Exception:
+                return
+
+    async def put(self, message, size):
+        if self.shaper.idle:
+            await self.send(message)
+            return
+        delay = self.shaper.schedule(size)
+        self.queue.put_nowait((now_ms() + delay, message))
+
+    def close(self):
+        self.task.cancel()
+
+
+class AesCtr:
+    def __init__(self, key):
+        from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+        self.cipher = lambda nonce: Cipher(algorithms.AES(key), modes.CTR(nonce))
+
+    def crypt(self, nonce, data):
+        context = self.cipher(nonce).encryptor()
+        return context.update(data) + context.finalize()
+
+
+# ---------------------------------------------------------------------------
+# Server
+# ---------------------------------------------------------------------------
+
+class Stats:
+    def __init__(self):
+        self.sessions = 0
+        self.active = 0
+        self.messages_in = 0
+        self.messages_out = 0
+        self.audio_in = 0
+        self.audio_out = 0
+        self.udp_lost = 0
+
+    def line(self):
+        return (f'sessions {self.sessions} (active {self.active}), messages in/out '
+                f'{self.messages_in}/{self.messages_out}, audio in/out {self.audio_in}/{self.audio_out}, '
+                f'udp dropped {self.udp_lost}')
+
+
+class Session:
+    '''Conversation logic shared by the websocket and MQTT+UDP transports'''
+
+    def __init__(self, server, transport, device_id):
+        self.server = server
+        self.transport = transport
+        self.device_id = device_id
+        self.session_id = uuid.uuid4().hex[:16]
+        self.listening = False
+        self.listen_mode = 'auto'
+        self.frames_heard = 0
+        self.speak_task = None
+        self.mcp_id = 0
+
+    async def send_json(self, message):
+        raise NotImplementedError
+
+    async def send_audio(self, frames):
+        raise NotImplementedError
+
+    async def on_hello(self, message):
+        raise NotImplementedError
+
+    async def on_json(self, message):
+        self.server.stats.messages_in += 1
+        type = message.get('type')
+        if type == 'hello':
+            await self.on_hello(message)
+            if message.get('features', {}).get('mcp'):
+                await self.send_mcp('initialize', {
+                    'protocolVersion': '2024-11-05',
+                    'capabilities': {},
+                    'clientInfo': {'name': 'local_server', 'version': '1.0'},
+                })
+                await self.send_mcp('tools/list', {'cursor': ''})
+        elif type == 'listen':
+            await self.on_listen(message)
+        elif type == 'abort':
+            self.stop_speaking()
+            await self.send_json({'type': 'tts', 'state': 'stop'})
+        elif type == 'mcp':
+            payload = message.get('payload', {})
+            if self.server.args.verbose:
+                print(f'[{self.device_id}] mcp: {json.dumps(payload, ensure_ascii=False)[:200]}')
+        elif type == 'goodbye':
+            self.close()
+
+    async def send_mcp(self, method, params):
+        self.mcp_id += 1
+        await self.send_json({
+            'session_id': self.session_id,
+            'type': 'mcp',
+            'payload': {'jsonrpc': '2.0', 'id': self.mcp_id, 'method': method, 'params': params},
+        })
+
+    async def on_listen(self, message):
+        state = message.get('state')
+        if state == 'start':
+            self.stop_speaking()
+            self.listening = True
+            self.listen_mode = message.get('mode', 'auto')
+            self.frames_heard = 0
+        elif state == 'stop':
+            if self.listening:
+                self.listening = False
+                self.reply(f'heard {self.frames_heard} frames')
+        elif state == 'detect':
+            self.reply(f'wake word {message.get("text", "")}')
+
+    def on_audio_frame(self):
+        self.server.stats.audio_in += 1
+        if not self.listening:
+            return
+        self.frames_heard += 1
+        # Stand-in for server VAD: stop after a fixed amount of speech
+        if self.listen_mode != 'manual' and self.frames_heard * FRAME_DURATION_MS >= self.server.args.vad_ms:
+            self.listening = False
+            self.reply(f'heard {self.frames_heard} frames')
+
+    def reply(self, text):
+        self.stop_speaking()
+        self.speak_task = asyncio.ensure_future(self.speak(text))
+
+    def stop_speaking(self):
+        if self.speak_task is not None:
+            self.speak_task.cancel()
+            self.speak_task = None
+
+    async def speak(self, text):
+        args = self.server.args
+        await asyncio.sleep(args.think_ms / 1000)
+        await self.send_json({'session_id': self.session_id, 'type': 'stt', 'text': text})
+        await self.send_json({'session_id': self.session_id, 'type': 'llm', 'text': '😊', 'emotion': 'happy'})
+        await self.send_json({'session_id': self.session_id, 'type': 'tts', 'state': 'start'})
+        await self.send_json({'session_id': self.session_id, 'type': 'tts', 'state': 'sentence_start',
+                              'text': f'I {text}'})
+
+        frames = self.server.tts_frames
+        count = max(1, args.tts_ms // FRAME_DURATION_MS)
+        start = now_ms()
+        # Real servers send the first frames ahead of time, then pace at real time
+        for i in range(count):
+            due = start + max(0, i - args.prebuffer) * FRAME_DURATION_MS
+            delay = due - now_ms()
+            if delay > 0:
+                await asyncio.sleep(delay / 1000)
+            await self.send_audio([frames[i % len(frames)]], int(now_ms()) & 0xFFFFFFFF)
+            self.server.stats.audio_out += 1
+
+        await self.send_json({'session_id': self.session_id, 'type': 'tts', 'state': 'stop'})
+        self.speak_task = None
+
+    def close(self):
+        self.stop_speaking()
+
+
+class WebsocketSession(Session):
+    def __init__(self, server, websocket, device_id, version):
+        super().__init__(server, 'websocket', device_id)
+        self.websocket = websocket
+        self.version = version
+        self.sender = OrderedSender(server.shaper(ordered=True), websocket.send)
+
+    async def send_json(self, message):
+        self.server.stats.messages_out += 1
+        text = json.dumps(message, ensure_ascii=False)
+        await self.sender.put(text, len(text))
+
+    async def send_audio(self, frames, timestamp=0):
+        if self.version == 2:
+            messages = [struct.pack('>HHIII', 2, 0, 0, timestamp, len(f)) + f for f in frames]
+        elif self.version == 3:
+            messages = [struct.pack('>BBH', 0, 0, len(f)) + f for f in frames]
+        elif self.version == 4:
+            table = b''.join(struct.pack('>IH', timestamp, len(f)) for f in frames)
+            body = table + b''.join(frames)
+            messages = [struct.pack('>BBH', 0, len(frames), len(body)) + body]
+        else:
+            messages = list(frames)
+        for message in messages:
+            await self.sender.put(message, len(message))
+
+    async def on_hello(self, message):
+        params = message.get('audio_params', {})
+        hello = {
+            'type': 'hello',
+            'transport': 'websocket',
+            'session_id': self.session_id,
+            'audio_params': {'format': 'opus', 'sample_rate': SERVER_SAMPLE_RATE, 'channels': 1,
+                             'frame_duration': params.get('frame_duration', FRAME_DURATION_MS)},
+        }
+        if self.version == 4:
+            hello['version'] = 4
+        await self.send_json(hello)
+
+    def on_binary(self, data):
+        if self.version == 2:
+            offset = 0
+            while offset + 16 <= len(data):
+                size = struct.unpack_from('>I', data, offset + 12)[0]
+                offset += 16 + size
+                self.on_audio_frame()
+        elif self.version == 3:
+            self.on_audio_frame()
+        elif self.version == 4:
+            for _ in range(data[1] if len(data) > 1 else 0):
+                self.on_audio_frame()
+        else:
+            self.on_audio_frame()
+
+    def close(self):
+        super().close()
+        self.sender.close()
+
+
+class MqttSession(Session):
+    def __init__(self, server, connection, device_id):
+        super().__init__(server, 'udp', device_id)
+        self.connection = connection
+        self.ssrc = random.getrandbits(32)
+        self.key = os.urandom(16)
+        self.nonce = struct.pack('>BBHIII', 1, 0, 0, self.ssrc, 0, 0)
+        self.aes = AesCtr(self.key)
+        self.udp_address = None
+        self.local_sequence = 0
+        self.remote_sequence = None
+        self.udp_shaper = server.shaper(ordered=False)
+
+    async def send_json(self, message):
+        self.server.stats.messages_out += 1
+        await self.connection.publish(json.dumps(message, ensure_ascii=False).encode())
+
+    async def send_audio(self, frames, timestamp=0):
+        if self.udp_address is None:
+            return
+        for frame in frames:
+            self.local_sequence += 1
+            header = struct.pack('>BBHIII', 1, 0, len(frame), self.ssrc, timestamp, self.local_sequence)
+            packet = header + self.aes.crypt(header, frame)
+            delay = self.udp_shaper.schedule(len(packet))
+            if delay is None:
+                self.server.stats.udp_lost += 1
+                continue
+            loop = asyncio.get_event_loop()
+            loop.call_later(delay / 1000, self.server.udp.sendto, packet, self.udp_address)
+
+    async def on_hello(self, message):
+        self.server.udp_sessions[self.ssrc] = self
+        await self.send_json({
+            'type': 'hello',
+            'transport': 'udp',
+            'session_id': self.session_id,
+            'audio_params': {'format': 'opus', 'sample_rate': SERVER_SAMPLE_RATE, 'channels': 1,
+                             'frame_duration': FRAME_DURATION_MS},
+            'udp': {'server': self.server.args.host_ip, 'port': self.server.args.udp_port,
+                    'key': self.key.hex().upper(), 'nonce': self.nonce.hex().upper()},
+        })
+
+    def on_udp(self, data, address):
+        self.udp_address = address
+        _, _, size, _, _, sequence = struct.unpack_from('>BBHIII', data)
+        # Decrypt like a real server would, so load tests include the crypto cost
+        self.aes.crypt(data[:16], data[16:16 + size])
+        self.remote_sequence = sequence
+        self.on_audio_frame()
+
+    def close(self):
+        super().close()
+        self.server.udp_sessions.pop(self.ssrc, None)
+
+
+class MqttConnection:
+    '''Just enough of an MQTT 3.1.1 broker for one device: QoS 0/1 publish, subscribe and ping'''
+
+    def __init__(self, server, reader, writer):
+        self.server = server
+        self.reader = reader
+        self.writer = writer
+        self.client_id = None
+        self.session = None
+        self.sender = OrderedSender(server.shaper(ordered=True), self.write)
+
+    async def write(self, data):
+        self.writer.write(data)
+        await self.writer.drain()
+
+    @staticmethod
+    def encode_length(length):
+        encoded = bytearray()
+        while True:
+            byte = length % 128
+            length //= 128
+            encoded.append(byte | 0x80 if length > 0 else byte)
+            if length == 0:
+                return bytes(encoded)
+
+    async def read_packet(self):
+        first = (await self.reader.readexactly(1))[0]
+        length, multiplier = 0, 1
+        while True:
+            byte = (await self.reader.readexactly(1))[0]
+            length += (byte & 0x7F) * multiplier
+            multiplier *= 128
+            if byte & 0x80 == 0:
+                break
+        return first, await self.reader.readexactly(length)
+
+    async def publish(self, payload):
+        topic = f'devices/p2p/{self.client_id}'.encode()
+        body = struct.pack('>H', len(topic)) + topic + payload
+        packet = bytes([0x30]) + self.encode_length(len(body)) + body
+        await self.sender.put(packet, len(packet))
+
+    async def run(self):
+        try:
+            while True:
+                first, body = await self.read_packet()
+                type = first >> 4
+                if type == 1:       # CONNECT
+                    name_length = struct.unpack_from('>H', body)[0]
+                    offset = 2 + name_length + 4
+                    id_length = struct.unpack_from('>H', body, offset)[0]
+                    self.client_id = body[offset + 2:offset + 2 + id_length].decode()
+                    await self.write(bytes([0x20, 0x02, 0x00, 0x00]))
+                elif type == 3:     # PUBLISH
+                    qos = (first >> 1) & 0x03
+                    topic_length = struct.unpack_from('>H', body)[0]
+                    offset = 2 + topic_length
+                    if qos > 0:
+                        packet_id = body[offset:offset + 2]
+                        offset += 2
+                        await self.write(bytes([0x40, 0x02]) + packet_id)
+                    await self.on_publish(body[offset:])
+                elif type == 8:     # SUBSCRIBE
+                    packet_id = body[:2]
+                    topics, offset = 0, 2
+                    while offset < len(body):
+                        offset += 2 + struct.unpack_from('>H', body, offset)[0] + 1
+                        topics += 1
+                    await self.write(bytes([0x90, 2 + topics]) + packet_id + bytes(topics))
+                elif type == 12:    # PINGREQ
+                    await self.write(bytes([0xD0, 0x00]))
+                elif type == 14:    # DISCONNECT
+                    break
+        except (asyncio.IncompleteReadError, ConnectionError):
+            pass
+        finally:
+            if self.session is not None:
+                self.session.close()
+                self.server.stats.active -= 1
+            self.sender.close()
+            self.writer.close()
+
+    async def on_publish(self, payload):
+        try:
+            message = json.loads(payload)
+        except ValueError:
+            return
+        if message.get('type') == 'hello':
+            if self.session is not None:
+                self.session.close()
+            else:
+                self.server.stats.active += 1
+            self.server.stats.sessions += 1
+            self.session = MqttSession(self.server, self, self.client_id)
+        if self.session is not None:
+            await self.session.on_json(message)
+
+
+class UdpEndpoint(asyncio.DatagramProtocol):
+    def __init__(self, server):
+        self.server = server
+        self.transport = None
+
+    def connection_made(self, transport):
+        self.transport = transport
+
+    def datagram_received(self, data, address):
+        if len(data) < 16 or data[0] != 0x01:
+            return
+        if self.server.args.loss > 0 and random.random() < self.server.args.loss:
+            self.server.stats.udp_lost += 1
+            return
+        ssrc = struct.unpack_from('>I', data, 4)[0]
+        session = self.server.udp_sessions.get(ssrc)
+        if session is not None:
+            session.on_udp(data, address)
+
+    def sendto(self, data, address):
+        self.transport.sendto(data, address)
+
+
+class Server:
+    def __init__(self, args):
+        self.args = args
+        self.stats = Stats()
+        self.udp_sessions = {}
+        self.udp = None
+        self.tts_frames = load_p3(args.tts_p3) if args.tts_p3 else [SILENCE_FRAME]
+
+    def shaper(self, ordered):
+        return NetworkShaper(self.args.bandwidth, self.args.jitter, self.args.loss, ordered)
+
+    async def websocket_handler(self, websocket, *_):
+        headers = getattr(websocket, 'request_headers', None) or websocket.request.headers
+        device_id = headers.get('Device-Id', 'unknown')
+        version = int(headers.get('Protocol-Version', '1'))
+        session = WebsocketSession(self, websocket, device_id, version)
+        self.stats.sessions += 1
+        self.stats.active += 1
+        try:
+            async for message in websocket:
+                if isinstance(message, bytes):
+                    session.on_binary(message)
+                else:
+                    try:
+                        await session.on_json(json.loads(message))
+                    except ValueError:
+                        print(f'[{device_id}] invalid json: {message[:100]}')
+        except Exception as e:
+            if self.args.verbose:
+                print(f'[{device_id}] {e}')
+        finally:
+            session.close()
+            self.stats.active -= 1
+
+    def ota_config(self, body):
+        args = self.args
+        try:
+            version = json.loads(body).get('application', {}).get('version', '0.0.0')
+        except ValueError:
+            version = '0.0.0'
+        config = {
+            'server_time': {'timestamp': int(time.time() * 1000), 'timezone_offset': args.timezone_offset},
+            'firmware': {'version': version, 'url': ''},
+        }
+        if args.ota_transport == 'websocket':
+            config['websocket'] = {'url': f'ws://{args.host_ip}:{args.ws_port}/', 'token': 'local',
+                                   'version': args.ws_version}
+        else:
+            config['mqtt'] = {'endpoint': f'{args.host_ip}:{args.mqtt_port}', 'client_id': uuid.uuid4().hex,
+                              'username': 'local', 'password': 'local', 'publish_topic': 'device-server',
+                              'keepalive': 240}
+        return config
+
+    def start_ota(self):
+        server = self
+
+        class Handler(BaseHTTPRequestHandler):
+            def do_POST(self):
+                body = self.rfile.read(int(self.headers.get('Content-Length', 0)))
+                self.reply(body)
+
+            def do_GET(self):
+                self.reply(b'')
+
+            def reply(self, body):
+                data = json.dumps(server.ota_config(body)).encode()
+                self.send_response(200)
+                self.send_header('Content-Type', 'application/json')
+                self.send_header('Content-Length', str(len(data)))
+                self.end_headers()
+                self.wfile.write(data)
+
+            def log_message(self, format, *args):
+                if server.args.verbose:
+                    super().log_message(format, *args)
+
+        httpd = ThreadingHTTPServer(('0.0.0.0', self.args.http_port), Handler)
+        threading.Thread(target=httpd.serve_forever, daemon=True).start()
+
+    async def run(self):
+        import websockets
+
+        args = self.args
+        self.start_ota()
+        loop = asyncio.get_event_loop()
+        _, self.udp = await loop.create_datagram_endpoint(lambda: UdpEndpoint(self), local_addr=('0.0.0.0', args.udp_port))
+
+        mqtt_ssl = None
+        if args.mqtt_cert:
+            mqtt_ssl = ssl.create_default_context(ssl.Purpose.CLIENT_AUTH)
+            mqtt_ssl.load_cert_chain(args.mqtt_cert, args.mqtt_key)
+        await asyncio.start_server(lambda r, w: MqttConnection(self, r, w).run(), '0.0.0.0', args.mqtt_port, ssl=mqtt_ssl)
+
+        async with websockets.serve(self.websocket_handler, '0.0.0.0', args.ws_port, max_size=None):
+            print(f'websocket ws://{args.host_ip}:{args.ws_port}/, mqtt {args.host_ip}:{args.mqtt_port}, '
+                  f'udp {args.udp_port}, ota http://{args.host_ip}:{args.http_port}/ota/')
+            while True:
+                await asyncio.sleep(args.stats_interval)
+                print(self.stats.line())
+
+
+# ---------------------------------------------------------------------------
+# Load generator
+# ---------------------------------------------------------------------------
+
+class Metrics:
+    def __init__(self):
+        self.hello_ms = []
+        self.stt_ms = []
+        self.first_audio_ms = []
+        self.audio_gap_ms = []
+        self.audio_frames = 0
+        self.failures = 0
+        self.turns = 0
+
+    def report(self, elapsed):
+        def line(name, values):
+            print(f'  {name:<18} p50 {percentile(values, 50):7.1f}  p99 {percentile(values, 99):7.1f}  '
+                  f'max {max(values, default=0):7.1f} ms')
+        print(f'{self.turns} turns in {elapsed:.1f} s, {self.failures} failures, {self.audio_frames} audio frames received')
+        line('hello', self.hello_ms)
+        line('stop -> stt', self.stt_ms)
+        line('stop -> audio', self.first_audio_ms)
+        line('audio gap', self.audio_gap_ms)
+
+
+class SimulatedDevice:
+    def __init__(self, index, args, metrics):
+        self.index = index
+        self.args = args
+        self.metrics = metrics
+        self.device_id = ':'.join(f'{b:02x}' for b in struct.pack('>HI', 0xfeed, index))
+        self.events = asyncio.Queue()
+        self.stop_time = 0
+        self.last_audio = None
+        self.shaper = NetworkShaper(args.bandwidth, args.jitter, args.loss, ordered=args.transport == 'websocket')
+
+    def on_json(self, message):
+        self.events.put_nowait(message)
+
+    def on_audio(self):
+        now = now_ms()
+        if self.last_audio is None:
+            self.metrics.first_audio_ms.append(now - self.stop_time)
+        else:
+            self.metrics.audio_gap_ms.append(now - self.last_audio)
+        self.last_audio = now
+        self.metrics.audio_frames += 1
+
+    async def wait_for(self, predicate, timeout):
+        deadline = now_ms() + timeout
+        while True:
+            remaining = (deadline - now_ms()) / 1000
+            if remaining <= 0:
+                raise asyncio.TimeoutError()
+            message = await asyncio.wait_for(self.events.get(), remaining)
+            if predicate(message):
+                return message
+
+    async def conversation(self, send_json, send_audio):
+        for _ in range(self.args.turns):
+            await send_json({'type': 'listen', 'state': 'start', 'mode': 'manual'})
+            start = now_ms()
+            for i in range(self.args.speech_ms // FRAME_DURATION_MS):
+                delay = start + i * FRAME_DURATION_MS - now_ms()
+                if delay > 0:
+                    await asyncio.sleep(delay / 1000)
+                await send_audio(SILENCE_FRAME)
+            self.stop_time = now_ms()
+            self.last_audio = None
+            await send_json({'type': 'listen', 'state': 'stop'})
+            await self.wait_for(lambda m: m.get('type') == 'stt', 10000)
+            self.metrics.stt_ms.append(now_ms() - self.stop_time)
+            await self.wait_for(lambda m: m.get('type') == 'tts' and m.get('state') == 'stop', 60000)
+            self.metrics.turns += 1
+
+    def hello(self, transport):
+        return {'type': 'hello', 'version': self.args.ws_version, 'transport': transport,
+                'features': {'mcp': False},
+                'audio_params': {'format': 'opus', 'sample_rate': 16000, 'channels': 1,
+                                 'frame_duration': FRAME_DURATION_MS}}
+
+    async def run_websocket(self):
+        import websockets
+
+        headers = {'Authorization': 'Bearer local', 'Protocol-Version': str(self.args.ws_version),
+                   'Device-Id': self.device_id, 'Client-Id': str(uuid.uuid4())}
+        try:
+            connection = websockets.connect(self.args.url, additional_headers=headers, max_size=None)
+        except TypeError:
+            connection = websockets.connect(self.args.url, extra_headers=headers, max_size=None)
+        async with connection as websocket:
+            sender = OrderedSender(self.shaper, websocket.send)
+
+            async def receive():
+                async for message in websocket:
+                    if isinstance(message, bytes):
+                        self.on_audio()
+                    else:
+                        self.on_json(json.loads(message))
+            receiver = asyncio.ensure_future(receive())
+
+            async def send_json(message):
+                text = json.dumps(message)
+                await sender.put(text, len(text))
+
+            async def send_audio(frame):
+                if self.args.ws_version == 3:
+                    frame = struct.pack('>BBH', 0, 0, len(frame)) + frame
+                elif self.args.ws_version == 2:
+                    frame = struct.pack('>HHIII', 2, 0, 0, 0, len(frame)) + frame
+                elif self.args.ws_version == 4:
+                    frame = struct.pack('>BBHIH', 0, 1, 6 + len(frame), 0, len(frame)) + frame
+                await sender.put(frame, len(frame))
+
+            try:
+                start = now_ms()
+                await send_json(self.hello('websocket'))
+                await self.wait_for(lambda m: m.get('type') == 'hello', 10000)
+                self.metrics.hello_ms.append(now_ms() - start)
+                await self.conversation(send_json, send_audio)
+            finally:
+                receiver.cancel()
+                sender.close()
+
+    async def run_mqtt(self):
+        host, port = self.args.mqtt.split(':')
+        reader, writer = await asyncio.open_connection(host, int(port))
+        encode_length = MqttConnection.encode_length
+
+        def packet(first, body):
+            return bytes([first]) + encode_length(len(body)) + body
+
+        client_id = f'loadgen-{self.index}'.encode()
+        connect = struct.pack('>H', 4) + b'MQTT' + bytes([4, 0x02]) + struct.pack('>H', 240)
+        connect += struct.pack('>H', len(client_id)) + client_id
+        writer.write(packet(0x10, connect))
+        # The control channel is TCP, only the audio goes through the unordered UDP shaper
+        control_shaper = NetworkShaper(self.args.bandwidth, self.args.jitter, self.args.loss, ordered=True)
+        sender = OrderedSender(control_shaper, self._writer_send(writer))
+        udp = {}
+
+        async def send_json(message):
+            topic = b'device-server'
+            data = packet(0x30, struct.pack('>H', len(topic)) + topic + json.dumps(message).encode())
+            await sender.put(data, len(data))
+
+        async def receive():
+            await reader.readexactly(4)     # CONNACK
+            while True:
+                first = (await reader.readexactly(1))[0]
+                length, multiplier = 0, 1
+                while True:
+                    byte = (await reader.readexactly(1))[0]
+                    length += (byte & 0x7F) * multiplier
+                    multiplier *= 128
+                    if byte & 0x80 == 0:
+                        break
+                body = await reader.readexactly(length)
+                if first >> 4 == 3:
+                    topic_length = struct.unpack_from('>H', body)[0]
+                    self.on_json(json.loads(body[2 + topic_length:]))
+        receiver = asyncio.ensure_future(receive())
+
+        class Endpoint(asyncio.DatagramProtocol):
+            def datagram_received(endpoint, data, address):
+                self.on_audio()
+
+        transport = None
+        try:
+            start = now_ms()
+            await send_json(self.hello('udp'))
+            hello = await self.wait_for(lambda m: m.get('type') == 'hello', 10000)
+            self.metrics.hello_ms.append(now_ms() - start)
+            udp = hello['udp']
+            aes = AesCtr(bytes.fromhex(udp['key']))
+            nonce = bytes.fromhex(udp['nonce'])
+            loop = asyncio.get_event_loop()
+            transport, _ = await loop.create_datagram_endpoint(Endpoint, remote_addr=(udp['server'], udp['port']))
+            sequence = 0
+
+            async def send_audio(frame):
+                nonlocal sequence
+                sequence += 1
+                header = nonce[:2] + struct.pack('>H', len(frame)) + nonce[4:8] + struct.pack('>II', 0, sequence)
+                data = header + aes.crypt(header, frame)
+                delay = self.shaper.schedule(len(data))
+                if delay is not None:
+                    loop.call_later(delay / 1000, transport.sendto, data)
+
+            await self.conversation(send_json, send_audio)
+            await send_json({'type': 'goodbye', 'session_id': hello.get('session_id', '')})
+        finally:
+            if transport is not None:
+                transport.close()
+            receiver.cancel()
+            sender.close()
+            writer.close()
+
+    @staticmethod
+    def _writer_send(writer):
+        async def send(data):
+            writer.write(data)
+            await writer.drain()
+        return send
+
+    async def run(self):
+        # Spread the connections so the server sees a ramp, not a single burst
+        await asyncio.sleep(random.uniform(0, self.args.ramp_ms / 1000))
+        try:
+            if self.args.transport == 'websocket':
+                await self.run_websocket()
+            else:
+                await self.run_mqtt()
+        except Exception as e:
+            self.metrics.failures += 1
+            if self.args.verbose:
+                print(f'device {self.index}: {type(e).__name__} {e}')
+
+
+async def loadgen(args):
+    metrics = Metrics()
+    start = time.monotonic()
+    devices = [SimulatedDevice(i, args, metrics) for i in range(args.devices)]
+    await asyncio.gather(*(device.run() for device in devices))
+    metrics.report(time.monotonic() - start)
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Local stand-in server and device load generator')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+
+    def add_network_options(p):
+        p.add_argument('--bandwidth', type=float, default=0, help='link bandwidth in kbit/s (default: unlimited)')
+        p.add_argument('--jitter', type=float, default=0, help='uniform extra delay in ms (default: 0)')
+        p.add_argument('--loss', type=float, default=0, help='loss probability (default: 0)')
+        p.add_argument('--verbose', '-v', action='store_true')
+
+    serve = subparsers.add_parser('serve', help='run the stand-in server')
+    serve.add_argument('--host-ip', default='127.0.0.1', help='address the devices use to reach this host')
+    serve.add_argument('--ws-port', type=int, default=8765)
+    serve.add_argument('--mqtt-port', type=int, default=1883)
+    serve.add_argument('--mqtt-cert', help='serve MQTT over TLS with this certificate')
+    serve.add_argument('--mqtt-key')
+    serve.add_argument('--udp-port', type=int, default=8888)
+    serve.add_argument('--http-port', type=int, default=8003)
+    serve.add_argument('--ota-transport', choices=['websocket', 'udp'], default='websocket',
+                       help='transport handed out by the OTA endpoint')
+    serve.add_argument('--ws-version', type=int, default=3, help='websocket version handed out by the OTA endpoint')
+    serve.add_argument('--timezone-offset', type=int, default=480)
+    serve.add_argument('--vad-ms', type=int, default=3000, help='speech length that ends an auto mode utterance')
+    serve.add_argument('--think-ms', type=int, default=300, help='delay before the answer')
+    serve.add_argument('--tts-ms', type=int, default=3000, help='length of each answer')
+    serve.add_argument('--prebuffer', type=int, default=3, help='frames sent ahead of real time')
+    serve.add_argument('--tts-p3', help='answer with the opus frames of this .p3 file instead of silence')
+    serve.add_argument('--stats-interval', type=int, default=10)
+    add_network_options(serve)
+
+    load = subparsers.add_parser('loadgen', help='simulate devices against a server')
+    load.add_argument('--devices', type=int, default=10)
+    load.add_argument('--transport', choices=['websocket', 'udp'], default='websocket')
+    load.add_argument('--url', default='ws://127.0.0.1:8765/')
+    load.add_argument('--mqtt', default='127.0.0.1:1883')
+    load.add_argument('--ws-version', type=int, default=3)
+    load.add_argument('--turns', type=int, default=3)
+    load.add_argument('--speech-ms', type=int, default=2000)
+    load.add_argument('--ramp-ms', type=int, default=2000, help='connections are spread over this time')
+    add_network_options(load)
+
+    args = parser.parse_args()
+    try:
+        if args.command == 'serve':
+            asyncio.run(Server(args).run())
+        else:
+            asyncio.run(loadgen(args))
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,305 @@
+#!/usr/bin/env python3
+'''
+  Decode and replay logs captured by the device protocol recorder
+  (main/protocols/protocol_recorder.h).
+
+  Capture a log:
+    1. Call the MCP tool self.protocol_recorder.start, use the device
+    2. Call self.protocol_recorder.dump while `idf.py monitor | tee monitor.log` runs
+
+  Then:
+    python protocol_replay.py extract monitor.log session.bin
+    python protocol_replay.py summary session.bin
+    python protocol_replay.py dump session.bin
+    python protocol_replay.py serve session.bin --port 8765 --speed 2
+
+  `serve` acts as the websocket server for a real device: it answers the
+  device hello with the recorded server hello and sends every recorded
+  server message with its original timing (scaled by --speed), then compares
+  what the device sent back against the recording. Point the device at it
+  by setting the websocket url to ws://<host>:<port>/.
+'''
+import argparse
+import asyncio
+import base64
+import json
+import re
+import struct
+import sys
+import time
+
+MAGIC = 0x52505a58
+HEADER = struct.Struct('<IHHq')
+RECORD = struct.Struct('<IBBH')
+
+TEXT_IN, TEXT_OUT, BINARY_IN, BINARY_OUT, UDP_IN, UDP_OUT, EVENT = range(1, 8)
+TYPE_NAMES = {
+    TEXT_IN: 'text_in',
+    TEXT_OUT: 'text_out',
+    BINARY_IN: 'binary_in',
+    BINARY_OUT: 'binary_out',
+    UDP_IN: 'udp_in',
+    UDP_OUT: 'udp_out',
+    EVENT: 'event',
+}
+
+
+class Record:
+    def __init__(self, time_ms, type, flags, payload):
+        self.time_ms = time_ms
+        self.type = type
+        self.flags = flags
+        self.payload = payload
+
+    @property
+    def truncated(self):
+        return bool(self.flags & 1)
+
+    def text(self):
+        return self.payload.decode('utf-8', errors='replace')
+
+    def json(self):
+        try:
+            return json.loads(self.payload)
+        except ValueError:
+            return None
+
+    def message_type(self):
+        message = self.json() if self.type in (TEXT_IN, TEXT_OUT) else None
+        if not isinstance(message, dict):
+            return None
+        name = message.get('type', '?')
+        if 'state' in message:
+            name += '.' + str(message['state'])
+        return name
+
+
+def extract_from_monitor(text):
+    # "PREC:<base64>" lines, everything else in the monitor output is ignored
+    data = bytearray()
+    for match in re.finditer(r'PREC:([A-Za-z0-9+/=]+)', text):
+        data += base64.b64decode(match.group(1))
+    return bytes(data)
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if len(data) < HEADER.size or HEADER.unpack_from(data)[0] != MAGIC:
+        data = extract_from_monitor(data.decode('utf-8', errors='replace'))
+    if len(data) < HEADER.size:
+        raise ValueError(f'{path}: no protocol recording found')
+    magic, version, _, start_time_us = HEADER.unpack_from(data)
+    if magic != MAGIC or version != 1:
+        raise ValueError(f'{path}: unsupported recording (magic {magic:#x}, version {version})')
+
+    records = []
+    offset = HEADER.size
+    while offset + RECORD.size <= len(data):
+        time_ms, type, flags, size = RECORD.unpack_from(data, offset)
+        offset += RECORD.size
+        if offset + size > len(data):
+            print(f'warning: last record is incomplete', file=sys.stderr)
+            break
+        records.append(Record(time_ms, type, flags, data[offset:offset + size]))
+        offset += size
+    return data, records
+
+
+def percentile(values, p):
+    if not values:
+        return 0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def interval_stats(times):
+    gaps = [b - a for a, b in zip(times, times[1:])]
+    return f'p50 {percentile(gaps, 50)} ms, p99 {percentile(gaps, 99)} ms, max {max(gaps, default=0)} ms'
+
+
+def split_sessions(records):
+    sessions = []
+    for record in records:
+        if record.type == EVENT and record.payload == b'open' or not sessions:
+            sessions.append([])
+        sessions[-1].append(record)
+    return sessions
+
+
+def cmd_extract(args):
+    with open(args.input, 'r', errors='replace') as f:
+        data = extract_from_monitor(f.read())
+    if not data:
+        sys.exit('no PREC lines found')
+    with open(args.output, 'wb') as f:
+        f.write(data)
+    print(f'{len(data)} bytes written to {args.output}')
+
+
+def cmd_summary(args):
+    data, records = load(args.input)
+    if not records:
+        print('empty recording')
+        return
+    duration = records[-1].time_ms - records[0].time_ms
+    print(f'{len(records)} records, {len(data)} bytes, {duration / 1000:.1f} s, '
+          f'{len(split_sessions(records))} sessions')
+
+    print('\nrecords by type:')
+    for type, name in TYPE_NAMES.items():
+        selected = [r for r in records if r.type == type]
+        if selected:
+            size = sum(len(r.payload) for r in selected)
+            print(f'  {name:<12} {len(selected):>7} {size:>10} bytes')
+
+    print('\nmessages:')
+    counts = {}
+    for record in records:
+        name = record.message_type()
+        if name:
+            key = (TYPE_NAMES[record.type], name)
+            counts[key] = counts.get(key, 0) + 1
+    for (direction, name), count in sorted(counts.items()):
+        print(f'  {direction:<9} {name:<24} {count:>6}')
+
+    print('\naudio intervals:')
+    for type in (BINARY_IN, BINARY_OUT, UDP_IN, UDP_OUT):
+        times = [r.time_ms for r in records if r.type == type]
+        if len(times) > 1:
+            print(f'  {TYPE_NAMES[type]:<12} {interval_stats(times)}')
+
+    truncated = sum(1 for r in records if r.truncated)
+    if truncated:
+        print(f'\n{truncated} records were truncated')
+
+
+def cmd_dump(args):
+    _, records = load(args.input)
+    for record in records:
+        name = TYPE_NAMES.get(record.type, str(record.type))
+        if record.type in (TEXT_IN, TEXT_OUT, EVENT):
+            body = record.text()
+        else:
+            body = f'{len(record.payload)} bytes {record.payload[:16].hex()}'
+        print(f'{record.time_ms:>9} {name:<11} {body}')
+
+
+def compare(expected, received):
+    def count_by_type(records):
+        counts = {}
+        for record in records:
+            name = record.message_type() or TYPE_NAMES[record.type]
+            counts[name] = counts.get(name, 0) + 1
+        return counts
+
+    expected_counts = count_by_type(expected)
+    received_counts = count_by_type(received)
+    print(f'  {"message":<24} {"recorded":>9} {"replayed":>9}')
+    for name in sorted(set(expected_counts) | set(received_counts)):
+        print(f'  {name:<24} {expected_counts.get(name, 0):>9} {received_counts.get(name, 0):>9}')
+    for label, records in (('recorded', expected), ('replayed', received)):
+        times = [r.time_ms for r in records if r.type == BINARY_OUT]
+        if len(times) > 1:
+            print(f'  {label} uplink audio {interval_stats(times)}')
+
+
+async def replay_session(websocket, session, speed):
+    hello_index = next((i for i, r in enumerate(session)
+                        if r.type == TEXT_IN and r.message_type() == 'hello'), None)
+    if hello_index is None:
+        print('session has no server hello, skipped')
+        return
+    origin_ms = session[hello_index].time_ms
+    expected = [r for r in session if r.type in (TEXT_OUT, BINARY_OUT) and r.time_ms >= origin_ms]
+    received = []
+
+    # Wait for the device hello before answering with the recorded one
+    message = await websocket.recv()
+    print(f'device hello: {message}')
+    start = time.monotonic()
+
+    async def receive():
+        async for message in websocket:
+            elapsed = int((time.monotonic() - start) * 1000 * speed)
+            if isinstance(message, bytes):
+                received.append(Record(origin_ms + elapsed, BINARY_OUT, 0, message))
+            else:
+                received.append(Record(origin_ms + elapsed, TEXT_OUT, 0, message.encode()))
+
+    receiver = asyncio.ensure_future(receive())
+    late_ms = []
+    for record in session[hello_index:]:
+        if record.type not in (TEXT_IN, BINARY_IN):
+            continue
+        due = start + (record.time_ms - origin_ms) / 1000 / speed
+        delay = due - time.monotonic()
+        if delay > 0:
+            await asyncio.sleep(delay)
+        else:
+            late_ms.append(-delay * 1000)
+        await websocket.send(record.payload if record.type == BINARY_IN else record.text())
+
+    # Give the device time to finish what the last message triggered
+    await asyncio.sleep(2)
+    receiver.cancel()
+    print(f'replayed {len(session) - hello_index} records, '
+          f'{len(late_ms)} sent late (max {max(late_ms, default=0):.1f} ms)')
+    compare(expected, received)
+
+
+async def serve(args):
+    import websockets
+
+    _, records = load(args.input)
+    sessions = [s for s in split_sessions(records)
+                if any(r.type == TEXT_IN and r.message_type() == 'hello' for r in s)]
+    if not sessions:
+        sys.exit('no websocket session with a server hello found')
+    pending = list(sessions)
+    print(f'{len(sessions)} sessions, listening on ws://0.0.0.0:{args.port}/')
+
+    async def handler(websocket, *_):
+        if not pending:
+            await websocket.close()
+            return
+        session = pending.pop(0)
+        print(f'replaying session {len(sessions) - len(pending)} / {len(sessions)}')
+        await replay_session(websocket, session, args.speed)
+        if not pending and args.loop:
+            pending.extend(sessions)
+
+    async with websockets.serve(handler, '0.0.0.0', args.port, max_size=None):
+        await asyncio.Future()
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Protocol recorder decoder and replayer')
+    subparsers = parser.add_subparsers(dest='command', required=True)
+
+    extract = subparsers.add_parser('extract', help='extract the binary log from a monitor capture')
+    extract.add_argument('input')
+    extract.add_argument('output')
+    extract.set_defaults(func=cmd_extract)
+
+    summary = subparsers.add_parser('summary', help='message counts and audio timing')
+    summary.add_argument('input')
+    summary.set_defaults(func=cmd_summary)
+
+    dump = subparsers.add_parser('dump', help='print every record')
+    dump.add_argument('input')
+    dump.set_defaults(func=cmd_dump)
+
+    serve_parser = subparsers.add_parser('serve', help='replay recorded websocket sessions to a device')
+    serve_parser.add_argument('input')
+    serve_parser.add_argument('--port', type=int, default=8765)
+    serve_parser.add_argument('--speed', type=float, default=1.0, help='replay speed factor (default: 1.0)')
+    serve_parser.add_argument('--loop', action='store_true', help='start over after the last session')
+    serve_parser.set_defaults(func=lambda args: asyncio.run(serve(args)))
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == '__main__':
+    main()
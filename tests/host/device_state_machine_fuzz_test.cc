@@ -0,0 +1,170 @@
+#include "host_test.h"
+#include "device_state_machine.h"
+
+#include <esp_timer.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// xorshift32, so a failing seed can be replayed
+struct Random {
+    uint32_t state;
+
+    uint32_t Next() {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    }
+};
+
+constexpr int kSeeds = 200;
+constexpr int kStepsPerSeed = 2000;
+
+// Reads the integer after "key": at or after `from` in the status JSON
+int64_t JsonNumber(const std::string& json, const std::string& key, size_t from = 0) {
+    size_t pos = json.find("\"" + key + "\":", from);
+    if (pos == std::string::npos) {
+        return -1;
+    }
+    return strtoll(json.c_str() + pos + key.size() + 3, nullptr, 10);
+}
+
+// Entries and time spent in one state, -1 if the state is not listed
+void StateStats(const std::string& json, DeviceState state, int64_t& entries, int64_t& total_ms) {
+    size_t pos = json.find("{\"name\":\"" + std::string(DeviceStateName(state)) + "\"");
+    if (pos == std::string::npos) {
+        entries = -1;
+        total_ms = -1;
+        return;
+    }
+    entries = JsonNumber(json, "entries", pos);
+    total_ms = JsonNumber(json, "total_ms", pos);
+}
+
+// Picks the next requested state: mostly legal moves so the walk reaches
+// every state, with illegal requests mixed in
+DeviceState NextRequest(Random& random, DeviceState from) {
+    if (random.Next() % 4 != 0) {
+        uint32_t allowed = kDeviceStateRules[from].next_states;
+        // Fatal error ends the walk, keep it rare
+        if (random.Next() % 64 != 0) {
+            allowed &= ~DeviceStateBit(kDeviceStateFatalError);
+        }
+        if (allowed != 0) {
+            int pick = random.Next() % __builtin_popcount(allowed);
+            for (int i = 0; i < DEVICE_STATE_COUNT; i++) {
+                if ((allowed & DeviceStateBit((DeviceState)i)) && pick-- == 0) {
+                    return (DeviceState)i;
+                }
+            }
+        }
+    }
+    return (DeviceState)(random.Next() % DEVICE_STATE_COUNT);
+}
+
+}  // namespace
+
+TEST(RandomEventSequencesKeepInvariants) {
+    uint32_t reached = 0;
+    for (int seed = 1; seed <= kSeeds; seed++) {
+        Random random{(uint32_t)seed * 2654435761u};
+        DeviceStateMachine machine;
+        host_fake_time_us() = 1000000;
+
+        int64_t accepted = 0;
+        int64_t rejected = 0;
+        int64_t entries[DEVICE_STATE_COUNT] = {};
+        int64_t first_transition_us = -1;
+        int failures_before = HostTestFailures();
+
+        for (int step = 0; step < kStepsPerSeed; step++) {
+            DeviceState from = machine.state();
+            DeviceState to = NextRequest(random, from);
+            bool allowed = IsDeviceStateTransitionAllowed(from, to);
+            bool moved = machine.Transition(to);
+
+            // The machine follows the table exactly
+            CHECK_EQ(moved, allowed);
+            CHECK_EQ(machine.state(), moved ? to : from);
+            if (moved) {
+                accepted++;
+                entries[to]++;
+                reached |= DeviceStateBit(to);
+                if (first_transition_us < 0) {
+                    first_transition_us = host_fake_time_us();
+                }
+            } else {
+                rejected++;
+            }
+
+            // Fatal error is final, every other state can still get back to idle
+            if (from == kDeviceStateFatalError) {
+                CHECK(!moved);
+            } else if (machine.state() != kDeviceStateFatalError) {
+                CHECK(DeviceStatesReachableFrom(machine.state()) & DeviceStateBit(kDeviceStateIdle));
+            }
+
+            host_fake_time_us() += (1 + random.Next() % 5000) * 1000;
+            if (HostTestFailures() != failures_before) {
+                printf("seed %d, step %d: %s -> %s\n", seed, step, DeviceStateName(from), DeviceStateName(to));
+                return;
+            }
+        }
+
+        // The statistics agree with what was driven through the machine
+        std::string json = machine.GetStatusJson();
+        CHECK_EQ(JsonNumber(json, "rejected"), rejected);
+        int64_t sum_entries = 0;
+        int64_t sum_ms = 0;
+        for (int i = 0; i < DEVICE_STATE_COUNT; i++) {
+            int64_t state_entries, total_ms;
+            StateStats(json, (DeviceState)i, state_entries, total_ms);
+            if (state_entries < 0) {
+                CHECK_EQ(entries[i], 0);
+                continue;
+            }
+            CHECK_EQ(state_entries, entries[i]);
+            sum_entries += state_entries;
+            sum_ms += total_ms;
+        }
+        CHECK_EQ(sum_entries, accepted);
+        // Time is advanced in whole ms, so the dwell times add up exactly
+        if (first_transition_us >= 0) {
+            CHECK_EQ(sum_ms, (host_fake_time_us() - first_transition_us) / 1000);
+        }
+        if (HostTestFailures() != failures_before) {
+            printf("seed %d: %s\n", seed, json.c_str());
+            return;
+        }
+    }
+    // The walk covered the whole table
+    CHECK_EQ(reached | DeviceStateBit(kDeviceStateUnknown), (1u << DEVICE_STATE_COUNT) - 1);
+}
+
+TEST(TraceKeepsLastTransitions) {
+    DeviceStateMachine machine;
+    host_fake_time_us() = 5000000;
+    Random random{12345};
+    for (int step = 0; step < DEVICE_STATE_TRACE_SIZE * 3; step++) {
+        machine.Transition(NextRequest(random, machine.state()));
+        host_fake_time_us() += 1000;
+    }
+    std::string json = machine.GetStatusJson();
+    size_t count = 0;
+    for (size_t pos = json.find("{\"t\":"); pos != std::string::npos; pos = json.find("{\"t\":", pos + 1)) {
+        count++;
+    }
+    CHECK_EQ(count, (size_t)DEVICE_STATE_TRACE_SIZE);
+    // The newest entry ends in the current state unless it was rejected
+    size_t last = json.rfind("{\"t\":");
+    if (json.find("\"rejected\":true", last) == std::string::npos) {
+        std::string to = "\"to\":\"" + std::string(DeviceStateName(machine.state())) + "\"";
+        CHECK(json.find(to, last) != std::string::npos);
+    }
+}
+
+HOST_TEST_MAIN()
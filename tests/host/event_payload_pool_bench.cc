@@ -0,0 +1,146 @@
+#include "host_test.h"
+#include "event_payload_pool.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+using xiaozhi::EventPayloadBlock;
+using xiaozhi::EventPayloadPool;
+
+namespace {
+
+constexpr int kBenchEvents = 1000000;
+constexpr int kPayloadSize = 64;
+constexpr int kSubscribers = 3;
+
+// One typed publish: copy into a block, one reference per subscriber, all released
+bool PublishToPool(EventPayloadPool& pool, const uint8_t* payload) {
+    EventPayloadBlock* block = pool.Allocate();
+    if (block == nullptr) {
+        return false;
+    }
+    memcpy(block->data, payload, kPayloadSize);
+    for (int i = 0; i < kSubscribers; i++) {
+        EventPayloadPool::Retain(block);
+    }
+    for (int i = 0; i < kSubscribers; i++) {
+        pool.Release(block);
+    }
+    // The publisher's reference
+    pool.Release(block);
+    return true;
+}
+
+// What esp_event_post_to does with event_data: a heap copy per post
+void PublishByCopy(const uint8_t* payload) {
+    auto* copy = static_cast<uint8_t*>(malloc(kPayloadSize));
+    memcpy(copy, payload, kPayloadSize);
+    // Keeps the copy from being optimized away
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    free(copy);
+}
+
+template <typename F>
+double NanosecondsPerEvent(F&& publish) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchEvents; i++) {
+        publish();
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / kBenchEvents;
+}
+
+}  // namespace
+
+TEST(ExhaustsAndRecovers) {
+    EventPayloadPool pool;
+    std::vector<EventPayloadBlock*> blocks;
+    for (int i = 0; i < EVENT_PAYLOAD_POOL_SIZE; i++) {
+        blocks.push_back(pool.Allocate());
+        CHECK(blocks.back() != nullptr);
+    }
+    CHECK(pool.Allocate() == nullptr);
+    CHECK_EQ(pool.available(), 0);
+    pool.Release(blocks[5]);
+    CHECK(pool.Allocate() == blocks[5]);
+    for (auto* block : blocks) {
+        pool.Release(block);
+    }
+    CHECK_EQ(pool.available(), EVENT_PAYLOAD_POOL_SIZE);
+}
+
+TEST(SharedBlockReturnsAfterLastRelease) {
+    EventPayloadPool pool;
+    EventPayloadBlock* block = pool.Allocate();
+    EventPayloadPool::Retain(block);
+    EventPayloadPool::Retain(block);
+    pool.Release(block);
+    pool.Release(block);
+    CHECK_EQ(pool.available(), EVENT_PAYLOAD_POOL_SIZE - 1);
+    pool.Release(block);
+    CHECK_EQ(pool.available(), EVENT_PAYLOAD_POOL_SIZE);
+    // Null blocks are events without data
+    EventPayloadPool::Retain(nullptr);
+    pool.Release(nullptr);
+    CHECK_EQ(pool.available(), EVENT_PAYLOAD_POOL_SIZE);
+}
+
+TEST(ConcurrentPublishersNeverShareABlock) {
+    EventPayloadPool pool;
+    std::atomic<int> corrupted = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++) {
+        threads.emplace_back([&, t]() {
+            for (int n = 0; n < 50000; n++) {
+                EventPayloadBlock* block = pool.Allocate();
+                if (block == nullptr) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                memset(block->data, t + 1, kPayloadSize);
+                EventPayloadPool::Retain(block);
+                if (n % 16 == 0) {
+                    std::this_thread::yield();
+                }
+                for (int i = 0; i < kPayloadSize; i++) {
+                    if (block->data[i] != t + 1) {
+                        corrupted.fetch_add(1, std::memory_order_relaxed);
+                        break;
+                    }
+                }
+                pool.Release(block);
+                pool.Release(block);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK_EQ(corrupted.load(), 0);
+    CHECK_EQ(pool.available(), EVENT_PAYLOAD_POOL_SIZE);
+}
+
+TEST(BenchPublishPayload) {
+    EventPayloadPool pool;
+    uint8_t payload[kPayloadSize] = {};
+    int failed = 0;
+    double pooled = NanosecondsPerEvent([&]() {
+        payload[0]++;
+        if (!PublishToPool(pool, payload)) {
+            failed++;
+        }
+    });
+    double copied = NanosecondsPerEvent([&]() {
+        payload[0]++;
+        PublishByCopy(payload);
+    });
+    CHECK_EQ(failed, 0);
+    printf("  %d byte payload, %d subscribers: pool %.1f ns/event, heap copy %.1f ns/event\n",
+           kPayloadSize, kSubscribers, pooled, copied);
+}
+
+HOST_TEST_MAIN()
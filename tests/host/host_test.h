@@ -0,0 +1,69 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+/*
+ * Minimal test harness for the host-built tests: TEST registers a case,
+ * CHECK records a failure and keeps going, main() runs every case and
+ * returns non-zero if any check failed.
+ */
+
+#include <cstdio>
+#include <vector>
+
+struct HostTestCase {
+    const char* name;
+    void (*run)();
+};
+
+inline std::vector<HostTestCase>& HostTestCases() {
+    static std::vector<HostTestCase> cases;
+    return cases;
+}
+
+inline int& HostTestFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct HostTestRegistrar {
+    HostTestRegistrar(const char* name, void (*run)()) {
+        HostTestCases().push_back({name, run});
+    }
+};
+
+#define TEST(name)                                                  \
+    static void name();                                             \
+    static HostTestRegistrar name##_registrar(#name, name);         \
+    static void name()
+
+#define CHECK(condition)                                                            \
+    do {                                                                            \
+        if (!(condition)) {                                                         \
+            printf("%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition);   \
+            HostTestFailures()++;                                                   \
+        }                                                                           \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                                  \
+    do {                                                                            \
+        auto actual_value = (actual);                                               \
+        auto expected_value = (expected);                                           \
+        if (!(actual_value == expected_value)) {                                    \
+            printf("%s:%d: CHECK_EQ failed: %s == %lld, expected %lld\n",           \
+                   __FILE__, __LINE__, #actual, (long long)actual_value,            \
+                   (long long)expected_value);                                      \
+            HostTestFailures()++;                                                   \
+        }                                                                           \
+    } while (0)
+
+#define HOST_TEST_MAIN()                                                \
+    int main() {                                                        \
+        for (auto& test : HostTestCases()) {                            \
+            int before = HostTestFailures();                            \
+            test.run();                                                 \
+            printf("%s %s\n", HostTestFailures() == before ? "PASS" : "FAIL", test.name); \
+        }                                                               \
+        return HostTestFailures() == 0 ? 0 : 1;                         \
+    }
+
+#endif // HOST_TEST_H
@@ -0,0 +1,395 @@
+#include "host_test.h"
+#include "mcp_server.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Heap accounting for the whole binary, so the bench can report what the writer allocates
+namespace {
+
+size_t g_heap_bytes = 0;
+size_t g_heap_peak = 0;
+size_t g_heap_allocations = 0;
+
+}  // namespace
+
+void* operator new(size_t size) {
+    auto* block = static_cast<size_t*>(malloc(size + sizeof(std::max_align_t)));
+    if (block == nullptr) {
+        throw std::bad_alloc();
+    }
+    *block = size;
+    g_heap_bytes += size;
+    g_heap_allocations++;
+    if (g_heap_bytes > g_heap_peak) {
+        g_heap_peak = g_heap_bytes;
+    }
+    return reinterpret_cast<char*>(block) + sizeof(std::max_align_t);
+}
+
+void operator delete(void* pointer) noexcept {
+    if (pointer == nullptr) {
+        return;
+    }
+    auto* block = reinterpret_cast<size_t*>(static_cast<char*>(pointer) - sizeof(std::max_align_t));
+    g_heap_bytes -= *block;
+    free(block);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    operator delete(pointer);
+}
+
+namespace {
+
+constexpr int kBenchPasses = 2000;
+
+using ToolList = std::vector<std::unique_ptr<McpTool>>;
+
+void Add(ToolList& tools, bool user_only, const char* name, const char* description, const PropertyList& properties) {
+    tools.push_back(std::make_unique<McpTool>(name, description, properties,
+        [](const PropertyList&) -> ReturnValue { return true; }));
+    tools.back()->set_user_only(user_only);
+}
+
+// The tools McpServer and the Otto robot register on a board with a screen and a camera
+ToolList FullToolSet() {
+    ToolList tools;
+    Add(tools, false, "self.get_device_status",
+        "Provides the real-time information of the device, including the current status of the audio speaker, screen, battery, network, etc.\n"
+        "Use this tool for: \n"
+        "1. Answering questions about current condition (e.g. what is the current volume of the audio speaker?)\n"
+        "2. As the first step to control the device (e.g. turn up / down the volume of the audio speaker, etc.)",
+        PropertyList());
+    Add(tools, false, "self.audio_speaker.set_volume",
+        "Set the volume of the audio speaker. If the current volume is unknown, you must call `self.get_device_status` tool first and then call this tool.",
+        PropertyList({Property("volume", kPropertyTypeInteger, 0, 100)}));
+    Add(tools, false, "self.screen.set_brightness",
+        "Set the brightness of the screen.",
+        PropertyList({Property("brightness", kPropertyTypeInteger, 0, 100)}));
+    Add(tools, false, "self.screen.set_theme",
+        "Set the theme of the screen. The theme can be `light` or `dark`.",
+        PropertyList({Property("theme", kPropertyTypeString)}));
+    Add(tools, false, "self.camera.take_photo",
+        "Take a photo and explain it. Use this tool after the user asks you to see something.\n"
+        "Args:\n"
+        "  `question`: The question that you want to ask about the photo.\n"
+        "Return:\n"
+        "  A JSON object that provides the photo information.",
+        PropertyList({Property("question", kPropertyTypeString)}));
+    Add(tools, false, "self.learning.get_insights",
+        "Get user behavior insights: frequency_level, interactions_7d, emotional_state, favorite_topic. "
+        "Call when user asks about emotions or memory.",
+        PropertyList());
+    Add(tools, false, "self.pet.list_types",
+        "List all available pet types (cat, dog, panda, etc.).",
+        PropertyList());
+    Add(tools, false, "self.pet.select_type",
+        "Change pet type. type_id: cat/dog/rabbit/hamster/parrot/lion/tiger/panda/bear/wolf/fox/penguin/rhino/elephant/giraffe/koala/sloth/dragon/unicorn",
+        PropertyList({Property("type_id", kPropertyTypeString)}));
+    Add(tools, false, "self.pet.get_type_info",
+        "Get info about a specific pet type.",
+        PropertyList({Property("type_id", kPropertyTypeString)}));
+    Add(tools, true, "self.get_system_info",
+        "Get the system information",
+        PropertyList());
+    Add(tools, true, "self.reboot",
+        "Reboot the system",
+        PropertyList());
+    Add(tools, true, "self.protocol_recorder.start",
+        "Start recording every protocol message into PSRAM, discarding the previous recording",
+        PropertyList({Property("size_kb", kPropertyTypeInteger, 512, 16, 4096)}));
+    Add(tools, true, "self.protocol_recorder.stop",
+        "Stop recording protocol messages",
+        PropertyList());
+    Add(tools, true, "self.protocol_recorder.dump",
+        "Print the recorded protocol log to the serial console",
+        PropertyList());
+    Add(tools, true, "self.diagnostics.main_loop",
+        "Main event loop timing: p50/p99/max of loop iterations and scheduled tasks, stall counts and the slowest tasks with where they were scheduled from",
+        PropertyList({Property("reset", kPropertyTypeBoolean, false)}));
+    Add(tools, true, "self.diagnostics.state_trace",
+        "Device state machine trace: time spent in each state, the last transitions with their timing, and transitions the state table rejected",
+        PropertyList());
+    Add(tools, true, "self.diagnostics.timers",
+        "Software timer statistics: total wakeups and, per timer, how often it fired, how often it caused the wakeup and how often it shared another timer's wakeup",
+        PropertyList());
+    Add(tools, true, "self.diagnostics.event_bus",
+        "Event bus statistics: published, dropped and delivered events, payload pool exhaustion, and per delivery policy how many events were coalesced, debounced or dropped",
+        PropertyList());
+    Add(tools, true, "self.diagnostics.event_bus_benchmark",
+        "Publishes the given number of 64-byte events through raw esp_event posts (payload copied per post) and through the typed pooled path, and reports throughput and publish-to-handler latency for each",
+        PropertyList({Property("count", kPropertyTypeInteger, 200, 10, 2000)}));
+    Add(tools, true, "self.diagnostics.journal",
+        "Flash event journal kept across reboots: the most recent records (boots with reset reason, state changes, protocol errors, heap lows, queue overflows, bus events). Set dump to also print the whole journal to the console for scripts/journal_decode.py",
+        PropertyList({Property("count", kPropertyTypeInteger, 32, 1, 128), Property("dump", kPropertyTypeBoolean, false)}));
+    Add(tools, true, "self.diagnostics.persistence",
+        "Write-behind NVS records (user profile, emotional memory, pet state): updates, updates coalesced into one write, commits skipped as unchanged, flash writes and failures per record. Set flush to write dirty records now",
+        PropertyList({Property("flush", kPropertyTypeBoolean, false)}));
+    Add(tools, true, "self.diagnostics.simulate_learning",
+        "Replays a daily schedule on a virtual clock through the pet, user profile, emotional memory and adaptive behavior, starting from default state, and reports the end-of-day trajectory and CPU time per pet wake-up and per action. The real state is left untouched and flash is not written; the simulated state is swapped in one step at a time, so the device keeps working while it runs. Runs in the background: call with days > 0 to start, then with days = 0 to get progress or the last report. Schedule is \"HH:MM action,...\" with actions feed, clean, play, hug, like, dislike or a chat topic (chat, weather, story, pet, smart_home); empty uses a default day",
+        PropertyList({Property("days", kPropertyTypeInteger, 0, 0, 365), Property("absent_days", kPropertyTypeInteger, 0, 0, 365), Property("jitter_min", kPropertyTypeInteger, 20, 0, 120), Property("seed", kPropertyTypeInteger, 1, 0, 1000000), Property("schedule", kPropertyTypeString, "")}));
+    Add(tools, true, "self.diagnostics.mcp_serialization",
+        "Serializes the schemas of all registered tools (as tools/list does, without paging) the given number of times and reports the output size, time per pass and heap used by the writer buffer",
+        PropertyList({Property("iterations", kPropertyTypeInteger, 10, 1, 100)}));
+    Add(tools, true, "self.upgrade_firmware",
+        "Upgrade firmware from a specific URL. This will download and install the firmware, then reboot the device.",
+        PropertyList({Property("url", kPropertyTypeString, "The URL of the firmware binary file to download and install")}));
+    Add(tools, true, "self.screen.get_info",
+        "Information about the screen, including width, height, etc.",
+        PropertyList());
+    Add(tools, true, "self.screen.snapshot",
+        "Snapshot the screen and upload it to a specific URL",
+        PropertyList({Property("url", kPropertyTypeString), Property("quality", kPropertyTypeInteger, 80, 1, 100)}));
+    Add(tools, true, "self.screen.preview_image",
+        "Preview an image on the screen",
+        PropertyList({Property("url", kPropertyTypeString)}));
+    Add(tools, true, "self.assets.set_download_url",
+        "Set the download url for the assets",
+        PropertyList({Property("url", kPropertyTypeString)}));
+    Add(tools, false, "self.pet.get_state",
+        "Get pet status: mood, satiety, cleanliness (0-100), pet type and emotion.",
+        PropertyList());
+    Add(tools, false, "self.pet.check_warning",
+        "Check if pet needs care. Returns warning message or 'Pet is doing fine'.",
+        PropertyList());
+    Add(tools, false, "self.pet.feed",
+        "Feed pet. Satiety +10-20, Mood +3. Cooldown: 60s.",
+        PropertyList({Property("amount", kPropertyTypeInteger, 5, 1, 10)}));
+    Add(tools, false, "self.pet.clean",
+        "Clean pet. Cleanliness +15, Mood +5. Cooldown: 120s.",
+        PropertyList());
+    Add(tools, false, "self.pet.play",
+        "Play with pet. Mood +8, Satiety -3. Cooldown: 60s.",
+        PropertyList({Property("kind", kPropertyTypeString, "dance")}));
+    Add(tools, false, "self.pet.hug",
+        "Hug pet. Mood +5. Cooldown: 30s.",
+        PropertyList());
+    Add(tools, true, "self.pet.reset_daily",
+        "Reset daily tasks (testing).",
+        PropertyList());
+    Add(tools, false, "self.pet.set_state",
+        "Set pet state values directly (for debugging).",
+        PropertyList({Property("mood", kPropertyTypeInteger, 70, 0, 100), Property("satiety", kPropertyTypeInteger, 70, 0, 100), Property("cleanliness", kPropertyTypeInteger, 70, 0, 100)}));
+    Add(tools, false, "self.pet.configure_auto_announcement",
+        "Configure auto pet status announcements. enable: on/off, interval_min: minutes between announcements.",
+        PropertyList({Property("enable", kPropertyTypeBoolean, true), Property("interval_min", kPropertyTypeInteger, 3, 1, 60)}));
+    Add(tools, true, "self.nvs.erase_all",
+        "Erase all NVS data and reboot. WARNING: This will reset all settings!",
+        PropertyList());
+    Add(tools, false, "self.otto.walk_forward",
+        "行走。steps: 行走步数(1-100); speed: "
+        "行走速度(400-1500，数值越小越快，推荐500); "
+        "direction: 行走方向(-1=后退, 1=前进); arm_swing: "
+        "手臂摆动幅度(0-170度)",
+        PropertyList({Property("steps", kPropertyTypeInteger, 8, 1, 100), Property("speed", kPropertyTypeInteger, 500, 400, 1500), Property("arm_swing", kPropertyTypeInteger, 50, 0, 170), Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+    Add(tools, false, "self.otto.turn_left",
+        "转身。steps: 转身步数(1-100); speed: "
+        "转身速度(400-1500，数值越小越快，推荐500); "
+        "direction: 转身方向(1=左转, -1=右转); arm_swing: "
+        "手臂摆动幅度(0-170度)",
+        PropertyList({Property("steps", kPropertyTypeInteger, 10, 1, 100), Property("speed", kPropertyTypeInteger, 500, 400, 1500), Property("arm_swing", kPropertyTypeInteger, 50, 0, 170), Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+    Add(tools, false, "self.otto.jump",
+        "跳跃。steps: 跳跃次数(1-100); speed: "
+        "跳跃速度(400-1500，数值越小越快，推荐700)",
+        PropertyList({Property("steps", kPropertyTypeInteger, 1, 1, 100), Property("speed", kPropertyTypeInteger, 700, 400, 1500)}));
+    Add(tools, false, "self.otto.swing",
+        "左右摇摆。steps: 摇摆次数(1-100); speed: "
+        "摇摆速度(400-1500，数值越小越快，推荐700); amount: 摇摆幅度(0-170度)",
+        PropertyList({Property("steps", kPropertyTypeInteger, 3, 1, 100), Property("speed", kPropertyTypeInteger, 700, 400, 1500), Property("amount", kPropertyTypeInteger, 30, 0, 170)}));
+    Add(tools, false, "self.otto.moonwalk",
+        "太空步。steps: 太空步步数(1-100); speed: "
+        "速度(400-1500，数值越小越快，推荐700); "
+        "direction: 方向(1=左, -1=右); amount: 幅度(0-170度)",
+        PropertyList({Property("steps", kPropertyTypeInteger, 3, 1, 100), Property("speed", kPropertyTypeInteger, 700, 400, 1500), Property("direction", kPropertyTypeInteger, 1, -1, 1), Property("amount", kPropertyTypeInteger, 25, 0, 170)}));
+    Add(tools, false, "self.otto.bend",
+        "弯曲身体。steps: 弯曲次数(1-100); speed: "
+        "弯曲速度(400-1500，数值越小越快，推荐700); direction: 弯曲方向(1=左, "
+        "-1=右)",
+        PropertyList({Property("steps", kPropertyTypeInteger, 1, 1, 100), Property("speed", kPropertyTypeInteger, 700, 400, 1500), Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+    Add(tools, false, "self.otto.shake_leg",
+        "摇腿。steps: 摇腿次数(1-100); speed: "
+        "摇腿速度(400-1500，数值越小越快，推荐700); "
+        "direction: 腿部选择(1=左腿, -1=右腿)",
+        PropertyList({Property("steps", kPropertyTypeInteger, 1, 1, 100), Property("speed", kPropertyTypeInteger, 700, 400, 1500), Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+    Add(tools, false, "self.otto.look_around",
+        "左右看。speed: 动作速度(400-1500，数值越小越快，推荐1000); "
+        "direction: 看的方向(1=向左看, -1=向右看)",
+        PropertyList({Property("speed", kPropertyTypeInteger, 1000, 400, 1500), Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+    Add(tools, false, "self.otto.updown",
+        "上下运动。steps: 上下运动次数(1-100); speed: "
+        "运动速度(400-1500，数值越小越快，推荐700); amount: 运动幅度(0-170度)",
+        PropertyList({Property("steps", kPropertyTypeInteger, 3, 1, 100), Property("speed", kPropertyTypeInteger, 700, 400, 1500), Property("amount", kPropertyTypeInteger, 20, 0, 170)}));
+    Add(tools, false, "self.otto.hands_up",
+        "举手。speed: 举手速度(400-1500，数值越小越快，推荐700); direction: "
+        "手部选择(1=左手, "
+        "-1=右手, 0=双手)",
+        PropertyList({Property("speed", kPropertyTypeInteger, 700, 400, 1500), Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+    Add(tools, false, "self.otto.hands_down",
+        "放手。speed: 放手速度(400-1500，数值越小越快，推荐700); direction: "
+        "手部选择(1=左手, "
+        "-1=右手, 0=双手)",
+        PropertyList({Property("speed", kPropertyTypeInteger, 700, 400, 1500), Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+    Add(tools, false, "self.otto.hand_wave",
+        "挥手。speed: 挥手速度(400-1500，数值越小越快，推荐700); direction: "
+        "手部选择(1=左手, "
+        "-1=右手, 0=双手)",
+        PropertyList({Property("speed", kPropertyTypeInteger, 700, 400, 1500), Property("direction", kPropertyTypeInteger, 1, -1, 1)}));
+    Add(tools, false, "self.otto.stop",
+        "立即停止",
+        PropertyList());
+    Add(tools, false, "self.otto.set_trim",
+        "校准单个舵机位置。设置指定舵机的微调参数以调整Otto的初始站立姿态，设置"
+        "将永久保存。"
+        "servo_type: "
+        "舵机类型(left_leg/right_leg/left_foot/right_foot/left_hand/"
+        "right_hand); "
+        "trim_value: 微调值(-50到50度)",
+        PropertyList({Property("servo_type", kPropertyTypeString, "left_leg"), Property("trim_value", kPropertyTypeInteger, 0, -50, 50)}));
+    Add(tools, false, "self.otto.get_trims",
+        "获取当前的舵机微调设置",
+        PropertyList());
+    Add(tools, false, "self.otto.get_status",
+        "获取机器人状态，返回 moving 或 idle",
+        PropertyList());
+    Add(tools, false, "self.battery.get_level",
+        "获取机器人电池电量和充电状态",
+        PropertyList());
+    return tools;
+}
+
+// tools/list without paging, as McpServer::GetSerializationBenchmarkJson writes it
+void WriteToolsList(const ToolList& tools, std::string& buffer) {
+    buffer.clear();
+    xiaozhi::JsonWriter json(buffer);
+    json.BeginObject()
+        .Key("jsonrpc").String("2.0")
+        .Key("id").Int(2)
+        .Key("result").BeginObject()
+        .Key("tools").BeginArray();
+    for (auto& tool : tools) {
+        tool->WriteJson(json);
+    }
+    json.EndArray().EndObject().EndObject();
+}
+
+size_t Count(const std::string& text, const std::string& pattern) {
+    size_t count = 0;
+    for (size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) {
+        count++;
+    }
+    return count;
+}
+
+std::string Write(void (*write)(xiaozhi::JsonWriter&)) {
+    std::string buffer;
+    xiaozhi::JsonWriter json(buffer);
+    write(json);
+    return buffer;
+}
+
+}  // namespace
+
+TEST(WritesCommasAndNesting) {
+    CHECK(Write([](xiaozhi::JsonWriter& json) {
+        json.BeginObject()
+            .Key("a").BeginArray().Int(1).Int(-2).BeginObject().EndObject().BeginArray().EndArray().EndArray()
+            .Key("b").Bool(true)
+            .Key("c").Null()
+            .Key("d").Raw("{\"x\":1}")
+            .EndObject();
+    }) == "{\"a\":[1,-2,{},[]],\"b\":true,\"c\":null,\"d\":{\"x\":1}}");
+}
+
+TEST(EscapesStringsLikeCJson) {
+    CHECK(Write([](xiaozhi::JsonWriter& json) {
+        json.String("\"\\\b\f\n\r\t\x01/猫咪");
+    }) == "\"\\\"\\\\\\b\\f\\n\\r\\t\\u0001/猫咪\"");
+}
+
+TEST(WritesDoublesLikeCJson) {
+    CHECK(Write([](xiaozhi::JsonWriter& json) {
+        json.BeginArray()
+            .Double(3).Double(-0.5).Double(0.1).Double(1e20).Double(1.0 / 3)
+            .Double(NAN).Double(INFINITY).Double(-std::numeric_limits<double>::infinity())
+            .EndArray();
+    }) == "[3,-0.5,0.1,1e+20,0.33333333333333331,null,null,null]");
+}
+
+TEST(RollbackRestoresCommaState) {
+    std::string buffer;
+    xiaozhi::JsonWriter json(buffer);
+    json.BeginArray().Int(1);
+    auto checkpoint = json.GetCheckpoint();
+    json.String("too long");
+    json.Rollback(checkpoint);
+    json.Int(2).EndArray();
+    CHECK(buffer == "[1,2]");
+}
+
+TEST(ToolsListCoversFullToolSet) {
+    auto tools = FullToolSet();
+    std::string buffer;
+    WriteToolsList(tools, buffer);
+    CHECK_EQ(Count(buffer, "{\"name\":\"self."), tools.size());
+    size_t user_only = 0;
+    for (auto& tool : tools) {
+        user_only += tool->user_only();
+    }
+    CHECK_EQ(user_only, 21u);
+    CHECK_EQ(Count(buffer, "\"annotations\":{\"audience\":[\"user\"]}"), user_only);
+    CHECK(buffer.find("\"self.otto.walk_forward\"") != std::string::npos);
+    CHECK(buffer.find("\"steps\":{\"type\":\"integer\",\"default\":8,\"minimum\":1,\"maximum\":100}") != std::string::npos);
+    CHECK(buffer.find("\"required\":[\"question\"]") != std::string::npos);
+    CHECK(buffer.compare(buffer.size() - 3, 3, "]}}") == 0);
+}
+
+TEST(ToolCallResultInEnvelope) {
+    PropertyList properties({Property("amount", kPropertyTypeInteger, 5, 1, 10)});
+    McpTool tool("self.pet.feed", "Feed the pet", properties,
+        [](const PropertyList& properties) -> ReturnValue {
+            return "fed " + std::to_string(properties["amount"].value<int>()) + "\n\"ok\"";
+        });
+    std::string buffer;
+    xiaozhi::JsonWriter json(buffer);
+    json.BeginObject().Key("jsonrpc").String("2.0").Key("id").Int(7).Key("result");
+    tool.Call(properties, json);
+    json.EndObject();
+    CHECK(buffer == "{\"jsonrpc\":\"2.0\",\"id\":7,\"result\":{\"content\":[{\"type\":\"text\","
+                    "\"text\":\"fed 5\\n\\\"ok\\\"\"}],\"isError\":false}}");
+}
+
+TEST(BenchToolsList) {
+    auto tools = FullToolSet();
+    std::string buffer;
+
+    size_t heap_before = g_heap_bytes;
+    g_heap_peak = heap_before;
+    size_t allocations_before = g_heap_allocations;
+    auto start = std::chrono::steady_clock::now();
+    WriteToolsList(tools, buffer);
+    std::chrono::duration<double, std::micro> first = std::chrono::steady_clock::now() - start;
+    size_t first_allocations = g_heap_allocations - allocations_before;
+    size_t peak = g_heap_peak - heap_before;
+
+    // Later passes reuse the buffer and must not touch the heap
+    allocations_before = g_heap_allocations;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < kBenchPasses; i++) {
+        WriteToolsList(tools, buffer);
+    }
+    std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+    CHECK_EQ(g_heap_allocations - allocations_before, 0u);
+
+    printf("  %zu tools, %zu bytes: first pass %.1f us (%zu allocations, peak heap %zu bytes), "
+           "reused buffer %.1f us/pass\n",
+           tools.size(), buffer.size(), first.count(), first_allocations, peak, elapsed.count() / kBenchPasses);
+}
+
+HOST_TEST_MAIN()
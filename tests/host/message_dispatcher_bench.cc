@@ -0,0 +1,187 @@
+#include "host_test.h"
+#include "message_dispatcher.h"
+
+#include <cJSON.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr int kBenchPasses = 2000;
+
+// One recorded conversation, one server message per line
+std::vector<std::string> LoadTranscript() {
+    std::vector<std::string> lines;
+    std::ifstream file(HOST_TEST_DATA_DIR "/server_transcript.jsonl");
+    std::string line;
+    while (std::getline(file, line)) {
+        if (!line.empty()) {
+            lines.push_back(line);
+        }
+    }
+    return lines;
+}
+
+// Reads the same fields as the handlers in Application::RegisterMessageHandlers
+struct Handlers {
+    int tts_start = 0;
+    int tts_stop = 0;
+    int sentences = 0;
+    int stt = 0;
+    int emotions = 0;
+    int system = 0;
+    int alerts = 0;
+    int custom = 0;
+    std::string last_text;
+
+    void Tts(const IncomingMessage& message) {
+        if (message.Equals("state", "start")) {
+            tts_start++;
+        } else if (message.Equals("state", "stop")) {
+            tts_stop++;
+        } else if (message.Equals("state", "sentence_start")) {
+            if (message.GetString("text", last_text)) {
+                sentences++;
+            }
+        }
+    }
+    void Stt(const IncomingMessage& message) {
+        if (message.GetString("text", last_text)) {
+            stt++;
+        }
+    }
+    void Llm(const IncomingMessage& message) {
+        std::string emotion;
+        if (message.GetString("emotion", emotion)) {
+            emotions++;
+        }
+    }
+    void System(const IncomingMessage& message) {
+        std::string command;
+        if (message.GetString("command", command)) {
+            system++;
+        }
+    }
+    void Alert(const IncomingMessage& message) {
+        std::string status, text, emotion;
+        if (message.GetString("status", status) && message.GetString("message", text) &&
+            message.GetString("emotion", emotion)) {
+            alerts++;
+        }
+    }
+    void Custom(const IncomingMessage& message) {
+        message.root();
+        custom++;
+    }
+
+    void Register(MessageDispatcher& dispatcher) {
+        dispatcher.Register("listen", [](const IncomingMessage&) {});
+        dispatcher.Register("tts", [this](const IncomingMessage& message) { Tts(message); });
+        dispatcher.Register("stt", [this](const IncomingMessage& message) { Stt(message); });
+        dispatcher.Register("llm", [this](const IncomingMessage& message) { Llm(message); });
+        dispatcher.Register("system", [this](const IncomingMessage& message) { System(message); });
+        dispatcher.Register("alert", [this](const IncomingMessage& message) { Alert(message); });
+        dispatcher.Register("custom", [this](const IncomingMessage& message) { Custom(message); });
+    }
+
+    // The strcmp chain the dispatcher replaced, over the same tokenized message
+    bool DispatchChain(const IncomingMessage& message) {
+        std::string type(message.type());
+        const char* name = type.c_str();
+        if (strcmp(name, "listen") == 0) {
+        } else if (strcmp(name, "tts") == 0) {
+            Tts(message);
+        } else if (strcmp(name, "stt") == 0) {
+            Stt(message);
+        } else if (strcmp(name, "llm") == 0) {
+            Llm(message);
+        } else if (strcmp(name, "system") == 0) {
+            System(message);
+        } else if (strcmp(name, "alert") == 0) {
+            Alert(message);
+        } else if (strcmp(name, "custom") == 0) {
+            Custom(message);
+        } else {
+            return false;
+        }
+        return true;
+    }
+};
+
+template <typename F>
+double NanosecondsPerMessage(const std::vector<std::string>& transcript, F&& dispatch) {
+    auto start = std::chrono::steady_clock::now();
+    for (int pass = 0; pass < kBenchPasses; pass++) {
+        for (auto& line : transcript) {
+            IncomingMessage message(line.data(), line.size());
+            dispatch(message);
+        }
+    }
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / (kBenchPasses * transcript.size());
+}
+
+}  // namespace
+
+TEST(TranscriptReachesHandlers) {
+    auto transcript = LoadTranscript();
+    CHECK_EQ(transcript.size(), 28u);
+
+    MessageDispatcher dispatcher;
+    Handlers handlers;
+    handlers.Register(dispatcher);
+    host_cjson_parse_count() = 0;
+
+    int dispatched = 0;
+    for (auto& line : transcript) {
+        IncomingMessage message(line.data(), line.size());
+        if (dispatcher.Dispatch(message)) {
+            dispatched++;
+        }
+    }
+    // iot has no handler
+    CHECK_EQ(dispatched, 27);
+    CHECK_EQ(handlers.tts_start, 3);
+    CHECK_EQ(handlers.tts_stop, 3);
+    CHECK_EQ(handlers.sentences, 6);
+    CHECK_EQ(handlers.stt, 3);
+    CHECK_EQ(handlers.emotions, 3);
+    CHECK_EQ(handlers.system, 1);
+    CHECK_EQ(handlers.alerts, 1);
+    CHECK_EQ(handlers.custom, 1);
+    // Only the custom payload needs a tree
+    CHECK_EQ(host_cjson_parse_count(), 1);
+}
+
+TEST(DecodesEscapedSentence) {
+    std::string line = "{\"type\":\"tts\",\"state\":\"sentence_start\",\"text\":\"a\\\"b\\nc\\u4f60\\ud83d\\ude00\"}";
+    IncomingMessage message(line.data(), line.size());
+    std::string text;
+    CHECK(message.type() == "tts");
+    CHECK(message.GetString("text", text));
+    CHECK(text == "a\"b\nc\xe4\xbd\xa0\xf0\x9f\x98\x80");
+}
+
+TEST(BenchDispatchTranscript) {
+    auto transcript = LoadTranscript();
+    MessageDispatcher dispatcher;
+    Handlers handlers;
+    handlers.Register(dispatcher);
+    host_cjson_parse_count() = 0;
+
+    double table = NanosecondsPerMessage(transcript, [&](const IncomingMessage& message) {
+        dispatcher.Dispatch(message);
+    });
+    double chain = NanosecondsPerMessage(transcript, [&](const IncomingMessage& message) {
+        handlers.DispatchChain(message);
+    });
+    printf("  dispatcher: %.0f ns/message, strcmp chain: %.0f ns/message, cJSON parses: %d of %zu messages\n",
+           table, chain, host_cjson_parse_count(), 2 * kBenchPasses * transcript.size());
+    CHECK_EQ(host_cjson_parse_count(), 2 * kBenchPasses);
+}
+
+HOST_TEST_MAIN()
@@ -0,0 +1,22 @@
+#ifndef CJSON_HOST_STUB_H
+#define CJSON_HOST_STUB_H
+
+// Declarations only. The host build never builds a tree: parsing fails and is
+// counted, so tests can check that a path stays on the in-place tokenizer.
+
+#include <cstddef>
+
+struct cJSON {
+    char* valuestring;
+};
+
+cJSON* cJSON_ParseWithLength(const char* value, size_t length);
+cJSON* cJSON_GetObjectItem(const cJSON* object, const char* name);
+bool cJSON_IsString(const cJSON* item);
+void cJSON_Delete(cJSON* item);
+char* cJSON_PrintUnformatted(const cJSON* item);
+void cJSON_free(void* object);
+
+int& host_cjson_parse_count();
+
+#endif // CJSON_HOST_STUB_H
@@ -0,0 +1,29 @@
+#include <cJSON.h>
+
+int& host_cjson_parse_count() {
+    static int count = 0;
+    return count;
+}
+
+cJSON* cJSON_ParseWithLength(const char*, size_t) {
+    host_cjson_parse_count()++;
+    return nullptr;
+}
+
+cJSON* cJSON_GetObjectItem(const cJSON*, const char*) {
+    return nullptr;
+}
+
+bool cJSON_IsString(const cJSON*) {
+    return false;
+}
+
+void cJSON_Delete(cJSON*) {
+}
+
+char* cJSON_PrintUnformatted(const cJSON*) {
+    return nullptr;
+}
+
+void cJSON_free(void*) {
+}
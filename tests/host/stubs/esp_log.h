@@ -0,0 +1,14 @@
+#ifndef HOST_STUB_ESP_LOG_H
+#define HOST_STUB_ESP_LOG_H
+
+// Host stub: log calls are compiled, their arguments evaluated and dropped
+
+inline void esp_log_host_stub(const char*, const char*, ...) {}
+
+#define ESP_LOGE(tag, format, ...) esp_log_host_stub(tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) esp_log_host_stub(tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) esp_log_host_stub(tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) esp_log_host_stub(tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) esp_log_host_stub(tag, format, ##__VA_ARGS__)
+
+#endif // HOST_STUB_ESP_LOG_H
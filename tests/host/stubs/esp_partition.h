@@ -0,0 +1,6 @@
+#ifndef HOST_STUB_ESP_PARTITION_H
+#define HOST_STUB_ESP_PARTITION_H
+
+typedef struct esp_partition_t esp_partition_t;
+
+#endif // HOST_STUB_ESP_PARTITION_H
@@ -0,0 +1,25 @@
+#ifndef HOST_STUB_ESP_TIMER_H
+#define HOST_STUB_ESP_TIMER_H
+
+#include <chrono>
+#include <cstdint>
+
+// Host stub: esp_timer_get_time follows the steady clock unless a test sets
+// host_fake_time_us to drive time by hand
+
+typedef struct esp_timer* esp_timer_handle_t;
+
+inline int64_t& host_fake_time_us() {
+    static int64_t time_us = -1;
+    return time_us;
+}
+
+inline int64_t esp_timer_get_time() {
+    if (host_fake_time_us() >= 0) {
+        return host_fake_time_us();
+    }
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#endif // HOST_STUB_ESP_TIMER_H
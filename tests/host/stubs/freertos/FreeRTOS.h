@@ -0,0 +1,11 @@
+#ifndef HOST_STUB_FREERTOS_H
+#define HOST_STUB_FREERTOS_H
+
+#include <cstdint>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define portMAX_DELAY ((TickType_t)0xffffffffUL)
+
+#endif // HOST_STUB_FREERTOS_H
@@ -0,0 +1,8 @@
+#ifndef HOST_STUB_FREERTOS_TASK_H
+#define HOST_STUB_FREERTOS_TASK_H
+
+#include "FreeRTOS.h"
+
+typedef struct tskTaskControlBlock* TaskHandle_t;
+
+#endif // HOST_STUB_FREERTOS_TASK_H
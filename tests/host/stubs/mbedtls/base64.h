@@ -0,0 +1,8 @@
+#ifndef MBEDTLS_BASE64_HOST_STUB_H
+#define MBEDTLS_BASE64_HOST_STUB_H
+
+#include <cstddef>
+
+int mbedtls_base64_encode(unsigned char* dst, size_t dlen, size_t* olen, const unsigned char* src, size_t slen);
+
+#endif // MBEDTLS_BASE64_HOST_STUB_H
@@ -0,0 +1,167 @@
+#include "host_test.h"
+#include "task_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr int kTasksPerProducer = 50000;
+
+ScheduledTask MakeTask(SmallTask callback) {
+    return ScheduledTask{std::move(callback), __FILE__, __LINE__};
+}
+
+// Application::Schedule before the task queue: one locked list of std::function
+class LockedTaskList {
+public:
+    void Push(std::function<void()> callback) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        tasks_.push_back(std::move(callback));
+    }
+
+    void RunPending() {
+        std::deque<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks.swap(tasks_);
+        }
+        for (auto& task : tasks) {
+            task();
+        }
+    }
+
+private:
+    std::mutex mutex_;
+    std::deque<std::function<void()>> tasks_;
+};
+
+// Pushes from `producers` threads while one consumer drains, returns pushes per
+// second. Producers hold back while `in_flight` tasks are queued, 0 floods the queue.
+template <typename Push, typename Drain>
+double Throughput(int producers, int in_flight, std::atomic<int>& executed, Push&& push, Drain&& drain) {
+    int total = producers * kTasksPerProducer;
+    executed = 0;
+    std::atomic<int> pushed = 0;
+    std::atomic<bool> go = false;
+    std::vector<std::thread> threads;
+    for (int i = 0; i < producers; i++) {
+        threads.emplace_back([&, i]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (int n = 0; n < kTasksPerProducer; n++) {
+                while (in_flight > 0 && pushed.load(std::memory_order_relaxed) -
+                       executed.load(std::memory_order_relaxed) >= in_flight) {
+                    std::this_thread::yield();
+                }
+                pushed.fetch_add(1, std::memory_order_relaxed);
+                push(i, n);
+            }
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    go.store(true, std::memory_order_release);
+    while (executed.load(std::memory_order_relaxed) < total) {
+        drain();
+        // Let the producers run on machines with fewer cores than threads
+        std::this_thread::yield();
+    }
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    return total / elapsed.count();
+}
+
+}  // namespace
+
+TEST(HighLaneRunsFirstAndLanesStayFifo) {
+    TaskQueue queue;
+    std::vector<int> order;
+    for (int i = 0; i < 5; i++) {
+        queue.Push(MakeTask([&order, i]() { order.push_back(100 + i); }), kTaskPriorityNormal);
+        queue.Push(MakeTask([&order, i]() { order.push_back(i); }), kTaskPriorityHigh);
+    }
+    CHECK(!queue.RunPending(100));
+    CHECK(order == (std::vector<int>{0, 1, 2, 3, 4, 100, 101, 102, 103, 104}));
+    CHECK_EQ(queue.GetStats(kTaskPriorityHigh).executed, 5u);
+    CHECK_EQ(queue.GetStats(kTaskPriorityNormal).executed, 5u);
+}
+
+TEST(OverflowKeepsOrderAndIsCounted) {
+    TaskQueue queue;
+    std::vector<int> order;
+    int count = TASK_QUEUE_NORMAL_CAPACITY * 3;
+    for (int i = 0; i < count; i++) {
+        queue.Push(MakeTask([&order, i]() { order.push_back(i); }), kTaskPriorityNormal);
+    }
+    // Pushed while the overflow list is non-empty, must still run last
+    CHECK(queue.RunPending(10));
+    queue.Push(MakeTask([&order, count]() { order.push_back(count); }), kTaskPriorityNormal);
+    CHECK(!queue.RunPending(count * 2));
+    CHECK_EQ(order.size(), (size_t)count + 1);
+    bool in_order = true;
+    for (int i = 0; i <= count; i++) {
+        in_order = in_order && order[i] == i;
+    }
+    CHECK(in_order);
+    auto stats = queue.GetStats(kTaskPriorityNormal);
+    CHECK_EQ(stats.overflowed, (uint32_t)(count - TASK_QUEUE_NORMAL_CAPACITY + 1));
+    CHECK_EQ(stats.max_depth, (uint32_t)TASK_QUEUE_NORMAL_CAPACITY);
+}
+
+TEST(LargeCapturesAreCountedAsHeap) {
+    TaskQueue queue;
+    char large[SMALL_TASK_INLINE_SIZE + 1] = {};
+    int sum = 0;
+    queue.Push(MakeTask([&sum]() { sum += 1; }), kTaskPriorityHigh);
+    queue.Push(MakeTask([&sum, large]() { sum += 2 + large[0]; }), kTaskPriorityHigh);
+    queue.RunPending(10);
+    CHECK_EQ(sum, 3);
+    CHECK_EQ(queue.GetStats(kTaskPriorityHigh).heap_allocated, 1u);
+}
+
+TEST(BenchProducerThroughputUnderContention) {
+    // Bursts that fit the rings, as the device sees them, then a flood that spills over
+    for (int in_flight : {TASK_QUEUE_HIGH_CAPACITY, 0}) {
+        for (int producers : {1, 2, 4}) {
+            std::atomic<int> executed;
+
+            TaskQueue queue;
+            double lanes = Throughput(producers, in_flight, executed,
+                [&](int producer, int n) {
+                    auto priority = (n & 7) == 0 ? kTaskPriorityHigh : kTaskPriorityNormal;
+                    queue.Push(MakeTask([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); }), priority);
+                },
+                [&]() { queue.RunPending(64); });
+            CHECK_EQ(executed.load(), producers * kTasksPerProducer);
+            auto high = queue.GetStats(kTaskPriorityHigh);
+            auto normal = queue.GetStats(kTaskPriorityNormal);
+            CHECK_EQ(high.executed + normal.executed, (uint32_t)(producers * kTasksPerProducer));
+            CHECK_EQ(high.heap_allocated + normal.heap_allocated, 0u);
+            if (in_flight > 0) {
+                CHECK_EQ(high.overflowed + normal.overflowed, 0u);
+            }
+
+            LockedTaskList list;
+            double locked = Throughput(producers, in_flight, executed,
+                [&](int producer, int n) {
+                    list.Push([&executed]() { executed.fetch_add(1, std::memory_order_relaxed); });
+                },
+                [&]() { list.RunPending(); });
+            CHECK_EQ(executed.load(), producers * kTasksPerProducer);
+
+            printf("  %s, %d producers: task queue %.2f M/s (overflowed %u), locked list %.2f M/s\n",
+                   in_flight > 0 ? "bursts" : "flood", producers, lanes / 1e6,
+                   high.overflowed + normal.overflowed, locked / 1e6);
+        }
+    }
+}
+
+HOST_TEST_MAIN()
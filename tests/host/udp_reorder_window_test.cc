@@ -0,0 +1,125 @@
+#include "host_test.h"
+#include "udp_reorder_window.h"
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+struct Packet {
+    uint32_t sequence;
+};
+
+constexpr uint32_t kWindow = 4;
+
+// Feeds packets through the window the way MqttProtocol::OnUdpMessage does
+class Receiver {
+public:
+    Receiver() : window_([this](std::unique_ptr<Packet> packet) { delivered.push_back(packet->sequence); }) {}
+
+    void Receive(uint32_t sequence) {
+        if (window_.Accept(sequence)) {
+            window_.Insert(sequence, std::make_unique<Packet>(Packet{sequence}));
+        }
+    }
+
+    UdpReorderWindow<Packet, kWindow>& window() { return window_; }
+    std::vector<uint32_t> delivered;
+
+private:
+    UdpReorderWindow<Packet, kWindow> window_;
+};
+
+}  // namespace
+
+TEST(DeliversInOrderPackets) {
+    Receiver receiver;
+    for (uint32_t sequence = 100; sequence < 110; sequence++) {
+        receiver.Receive(sequence);
+    }
+    CHECK_EQ(receiver.delivered.size(), 10u);
+    CHECK_EQ(receiver.delivered.front(), 100u);
+    CHECK_EQ(receiver.delivered.back(), 109u);
+    CHECK_EQ(receiver.window().stats().lost, 0u);
+    CHECK_EQ(receiver.window().stats().reordered, 0u);
+}
+
+TEST(HoldsPacketUntilGapFills) {
+    Receiver receiver;
+    receiver.Receive(1);
+    receiver.Receive(3);
+    CHECK_EQ(receiver.delivered.size(), 1u);
+    CHECK_EQ(receiver.window().pending(), 1);
+    receiver.Receive(2);
+    CHECK(receiver.delivered == (std::vector<uint32_t>{1, 2, 3}));
+    CHECK_EQ(receiver.window().pending(), 0);
+    CHECK_EQ(receiver.window().stats().reordered, 1u);
+}
+
+TEST(CountsDuplicateAndLatePackets) {
+    Receiver receiver;
+    receiver.Receive(1);
+    receiver.Receive(3);
+    receiver.Receive(3);    // Held already
+    receiver.Receive(1);    // Delivered already
+    CHECK_EQ(receiver.window().stats().duplicated, 2u);
+    receiver.Receive(8);    // Slides to 4, 2 and 4 are lost
+    receiver.Receive(2);
+    CHECK_EQ(receiver.window().stats().late, 1u);
+    CHECK_EQ(receiver.window().stats().lost, 2u);
+}
+
+TEST(DrainsHeldPacketsAfterLossThenBurst) {
+    Receiver receiver;
+    receiver.Receive(1);
+    // 2 is lost, 3..5 arrive and are held behind it
+    receiver.Receive(3);
+    receiver.Receive(4);
+    receiver.Receive(5);
+    CHECK_EQ(receiver.window().pending(), 3);
+    // 6 slides the window past 2; 3..5 are in order then and 6 follows them at once
+    receiver.Receive(6);
+    CHECK(receiver.delivered == (std::vector<uint32_t>{1, 3, 4, 5, 6}));
+    CHECK_EQ(receiver.window().pending(), 0);
+    CHECK_EQ(receiver.window().stats().lost, 1u);
+    receiver.Receive(7);
+    CHECK_EQ(receiver.delivered.back(), 7u);
+}
+
+TEST(DrainsHeldPacketsAfterWideGap) {
+    Receiver receiver;
+    receiver.Receive(1);
+    receiver.Receive(4);
+    receiver.Receive(5);
+    // 8 slides to 4: 2 and 3 are lost, 4 and 5 are delivered, 8 waits for 6 and 7
+    receiver.Receive(8);
+    CHECK(receiver.delivered == (std::vector<uint32_t>{1, 4, 5}));
+    CHECK_EQ(receiver.window().pending(), 1);
+    receiver.window().Flush();
+    CHECK(receiver.delivered == (std::vector<uint32_t>{1, 4, 5, 8}));
+    CHECK_EQ(receiver.window().stats().lost, 4u);
+}
+
+TEST(HandlesSequenceWraparound) {
+    Receiver receiver;
+    receiver.Receive(UINT32_MAX - 1);
+    receiver.Receive(0);
+    receiver.Receive(UINT32_MAX);
+    receiver.Receive(1);
+    CHECK(receiver.delivered == (std::vector<uint32_t>{UINT32_MAX - 1, UINT32_MAX, 0, 1}));
+    CHECK_EQ(receiver.window().stats().lost, 0u);
+}
+
+TEST(ResetStartsFromNextSequence) {
+    Receiver receiver;
+    receiver.Receive(10);
+    receiver.Receive(12);
+    receiver.window().Reset();
+    receiver.Receive(500);
+    CHECK(receiver.delivered == (std::vector<uint32_t>{10, 500}));
+    CHECK_EQ(receiver.window().stats().received, 1u);
+    CHECK_EQ(receiver.window().pending(), 0);
+}
+
+HOST_TEST_MAIN()